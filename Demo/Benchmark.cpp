@@ -0,0 +1,1137 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "InputEvent.h"
+#include "JobSystem.h"
+#include "MPSCQueue.h"
+#include "Profiler.h"
+#include "Graphics/AmbientOcclusion.h"
+#include "Graphics/CullingSystem.h"
+#include "Graphics/Float4x4.h"
+#include "Graphics/FrameRenderer.h"
+#include "Graphics/InstanceBatcher.h"
+#include "Graphics/NullRenderBackend.h"
+#include "Graphics/SceneBVH.h"
+#include "Graphics/ShadowDenoiser.h"
+#include "Graphics/ShadowUpsampler.h"
+#include "Graphics/SoftwareRenderBackend.h"
+#include "Graphics/TransformSystem.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace
+{
+	struct Settings
+	{
+		// 0 picks each benchmark's own default
+		uint32_t Count = 0;
+		uint32_t Iterations = 20;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	double MillisecondsSince(const Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool ParseUnsigned(const std::string& text, uint32_t& value)
+	{
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+		if (text.empty() || *end != '\0')
+			return false;
+		value = static_cast<uint32_t>(parsed);
+		return true;
+	}
+
+	// Batching objects spread over a few hundred meshes, most of them on a handful of common ones, at 10k, 50k and 100k
+	// objects or at -count. Checks that the batches cover the instance buffer back to back, one per mesh in use, and that
+	// each holds exactly that mesh's objects in the order they were added.
+	bool RunInstanceBatcher(const Settings& settings)
+	{
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		const uint32_t numMeshes = 500;
+		std::vector<uint32_t> counts = { 10000, 50000, 100000 };
+		if (settings.Count)
+			counts = { settings.Count };
+
+		printf("instance batcher, %u meshes, %u iterations\n", numMeshes, iterations);
+		bool passed = true;
+		for (const uint32_t count : counts)
+		{
+			std::mt19937 random(1234);
+			std::geometric_distribution<uint32_t> mesh(0.02);
+			std::vector<uint32_t> meshIDs(count);
+			for (uint32_t& meshID : meshIDs)
+				meshID = std::min(mesh(random), numMeshes - 1);
+
+			InstanceBatcher batcher;
+			double milliseconds = 0.0;
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				const Clock::time_point start = Clock::now();
+				batcher.Reset();
+				for (uint32_t object = 0; object < count; object++)
+					batcher.AddInstance(meshIDs[object], object);
+				batcher.Build();
+				milliseconds += MillisecondsSince(start);
+			}
+
+			std::vector<uint32_t> meshCounts(numMeshes, 0);
+			for (const uint32_t meshID : meshIDs)
+				meshCounts[meshID]++;
+			const uint32_t numMeshesUsed = static_cast<uint32_t>(
+				std::count_if(meshCounts.begin(), meshCounts.end(), [](const uint32_t meshCount) { return meshCount > 0; }));
+			const std::vector<uint32_t>& sortedObjects = batcher.GetSortedObjects();
+			bool contiguous = batcher.GetNumInstances() == count && sortedObjects.size() == count &&
+				batcher.GetBatches().size() == numMeshesUsed;
+			bool ordered = true;
+			uint32_t nextInstance = 0;
+			for (const DrawBatch& batch : batcher.GetBatches())
+			{
+				contiguous &= batch.FirstInstance == nextInstance && batch.InstanceCount == meshCounts[batch.MeshID];
+				nextInstance += batch.InstanceCount;
+				for (uint32_t i = batch.FirstInstance; i < std::min(nextInstance, count); i++)
+				{
+					ordered &= meshIDs[sortedObjects[i]] == batch.MeshID;
+					ordered &= i == batch.FirstInstance || sortedObjects[i] > sortedObjects[i - 1];
+				}
+			}
+			contiguous &= nextInstance == count;
+			printf("%6u objects     %8.3f ms, %3u batches, ranges %s, %s\n", count, milliseconds / iterations,
+				static_cast<uint32_t>(batcher.GetBatches().size()), contiguous ? "contiguous" : "BROKEN",
+				ordered ? "in order" : "OUT OF ORDER");
+			passed &= contiguous && ordered;
+		}
+		return passed;
+	}
+
+	// Scale, then roll, pitch and yaw, then translation, built from whole matrices the way DirectXMath composes them,
+	// as the reference for TransformSystem.
+	void ReferenceTransform(const Float3& position, const Float3& rotation, const Float3& scale, float* const world,
+		float* const worldInverseTranspose, float* const raytracing)
+	{
+		Float4x4 scaling = Identity4x4();
+		scaling.m[0][0] = scale.x;
+		scaling.m[1][1] = scale.y;
+		scaling.m[2][2] = scale.z;
+		Float4x4 pitch = Identity4x4();
+		pitch.m[1][1] = pitch.m[2][2] = std::cos(rotation.x);
+		pitch.m[1][2] = std::sin(rotation.x);
+		pitch.m[2][1] = -pitch.m[1][2];
+		Float4x4 yaw = Identity4x4();
+		yaw.m[0][0] = yaw.m[2][2] = std::cos(rotation.y);
+		yaw.m[2][0] = std::sin(rotation.y);
+		yaw.m[0][2] = -yaw.m[2][0];
+		Float4x4 roll = Identity4x4();
+		roll.m[0][0] = roll.m[1][1] = std::cos(rotation.z);
+		roll.m[0][1] = std::sin(rotation.z);
+		roll.m[1][0] = -roll.m[0][1];
+		Float4x4 translation = Identity4x4();
+		translation.m[3][0] = position.x;
+		translation.m[3][1] = position.y;
+		translation.m[3][2] = position.z;
+
+		const Float4x4 matrix = Multiply(Multiply(scaling, Multiply(Multiply(roll, pitch), yaw)), translation);
+		const Float4x4 inverse = Inverse(matrix);
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				world[row * 4 + column] = matrix.m[row][column];
+				worldInverseTranspose[row * 4 + column] = inverse.m[column][row];
+				if (row < 3)
+					raytracing[row * 4 + column] = matrix.m[column][row];
+			}
+		}
+	}
+
+	// TransformSystem's batched pass against the matrices composed one object at a time, at 1k, 10k and 100k objects
+	// or at -count. Every matrix must agree with the reference to within float rounding.
+	bool RunTransforms(const Settings& settings)
+	{
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		std::vector<uint32_t> counts = { 1000, 10000, 100000 };
+		if (settings.Count)
+			counts = { settings.Count };
+
+#if defined(__AVX2__)
+		const char* const kernel = "AVX2";
+#else
+		const char* const kernel = "scalar";
+#endif
+		printf("transforms, %s kernel, %u iterations, %u hardware threads\n", kernel, iterations,
+			std::thread::hardware_concurrency());
+		bool passed = true;
+		for (const uint32_t count : counts)
+		{
+			std::mt19937 random(1234);
+			std::uniform_real_distribution<float> position(-100.f, 100.f);
+			std::uniform_real_distribution<float> angle(-6.3f, 6.3f);
+			std::uniform_real_distribution<float> scale(0.5f, 2.f);
+			TransformSystem transforms;
+			transforms.Resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				transforms.SetPosition(i, position(random), position(random), position(random));
+				transforms.SetRotation(i, angle(random), angle(random), angle(random));
+				transforms.SetScale(i, scale(random), scale(random), scale(random));
+			}
+
+			Clock::time_point start = Clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+				transforms.Update();
+			const double batchedMilliseconds = MillisecondsSince(start) / iterations;
+
+			std::vector<float> world(count * size_t(TransformSystem::matrixSize));
+			std::vector<float> worldInverseTranspose(count * size_t(TransformSystem::matrixSize));
+			std::vector<float> raytracing(count * size_t(TransformSystem::raytracingTransformSize));
+			start = Clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				for (uint32_t object = 0; object < count; object++)
+				{
+					ReferenceTransform(transforms.GetPosition(object), transforms.GetRotation(object),
+						transforms.GetScale(object), &world[object * size_t(TransformSystem::matrixSize)],
+						&worldInverseTranspose[object * size_t(TransformSystem::matrixSize)],
+						&raytracing[object * size_t(TransformSystem::raytracingTransformSize)]);
+				}
+			}
+			const double referenceMilliseconds = MillisecondsSince(start) / iterations;
+
+			// relative to the element's size, since translations reach a few hundred
+			float maxError = 0.f;
+			const auto compare = [&maxError](const float* const result, const float* const expected, const uint32_t size)
+			{
+				for (uint32_t i = 0; i < size; i++)
+					maxError = std::max(maxError, std::fabs(result[i] - expected[i]) / (1.f + std::fabs(expected[i])));
+			};
+			for (uint32_t object = 0; object < count; object++)
+			{
+				compare(transforms.GetWorldMatrix(object), &world[object * size_t(TransformSystem::matrixSize)],
+					TransformSystem::matrixSize);
+				compare(transforms.GetWorldInverseTransposeMatrix(object),
+					&worldInverseTranspose[object * size_t(TransformSystem::matrixSize)], TransformSystem::matrixSize);
+				compare(transforms.GetRaytracingTransform(object),
+					&raytracing[object * size_t(TransformSystem::raytracingTransformSize)],
+					TransformSystem::raytracingTransformSize);
+			}
+			printf("%6u objects     %8.3f ms batched, %8.3f ms reference, %5.2fx, results %s, max error %.1e\n", count,
+				batchedMilliseconds, referenceMilliseconds, referenceMilliseconds / batchedMilliseconds,
+				maxError < 5e-4f ? "agree" : "DIFFER", maxError);
+			passed &= maxError < 5e-4f;
+		}
+		return passed;
+	}
+
+	// Refit against full rebuilds as objects drift a little each frame, the incremental rebuild after a tenth of them
+	// jump elsewhere, and the queries, alone and from every hardware thread at once.
+	bool RunSceneBVH(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 100000;
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::uniform_real_distribution<float> size(0.5f, 2.f);
+		std::uniform_real_distribution<float> drift(-0.1f, 0.1f);
+		const auto randomBox = [&](const Float3& center)
+		{
+			const Float3 halfSize = Float3{ size(random), size(random), size(random) } * 0.5f;
+			return BoundingBox{ center - halfSize, center + halfSize };
+		};
+
+		std::vector<BoundingBox> bounds(count);
+		for (BoundingBox& box : bounds)
+			box = randomBox({ position(random), position(random), position(random) });
+
+		SceneBVH bvh;
+		double buildMilliseconds = 0.0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			const Clock::time_point start = Clock::now();
+			bvh.Build(bounds);
+			buildMilliseconds += MillisecondsSince(start);
+		}
+
+		double refitMilliseconds = 0.0;
+		uint32_t numRefitRebuilds = 0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			for (BoundingBox& box : bounds)
+			{
+				const Float3 offset = { drift(random), drift(random), drift(random) };
+				box = { box.Min + offset, box.Max + offset };
+			}
+			const Clock::time_point start = Clock::now();
+			bvh.Update(bounds);
+			refitMilliseconds += MillisecondsSince(start);
+			numRefitRebuilds += bvh.GetStatistics().NumRebuiltSubtrees;
+		}
+
+		double incrementalMilliseconds = 0.0;
+		uint64_t numReinsertedObjects = 0;
+		uint64_t numIncrementalObjects = 0;
+		std::uniform_int_distribution<uint32_t> object(0, count - 1);
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			for (uint32_t moved = 0; moved < count / 10; moved++)
+				bounds[object(random)] = randomBox({ position(random), position(random), position(random) });
+			const Clock::time_point start = Clock::now();
+			bvh.Update(bounds);
+			incrementalMilliseconds += MillisecondsSince(start);
+			numReinsertedObjects += bvh.GetStatistics().NumReinsertedObjects;
+			numIncrementalObjects += bvh.GetStatistics().NumRebuiltObjects;
+		}
+
+		// the updated tree has to find exactly what testing every box finds
+		bool queriesAgree = true;
+		std::vector<uint32_t> found;
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < 100 && queriesAgree; i++)
+		{
+			const Float3 a = { position(random), position(random), position(random) };
+			const Float3 b = { position(random), position(random), position(random) };
+			const BoundingBox box = Union({ a, a }, { b, b });
+			found.clear();
+			bvh.QueryOverlap(box, found);
+			expected.clear();
+			for (uint32_t j = 0; j < count; j++)
+			{
+				if (Overlaps(bounds[j], box))
+					expected.push_back(j);
+			}
+			std::sort(found.begin(), found.end());
+			queriesAgree = found == expected;
+		}
+
+		const Float4x4 viewProjection = Multiply(LookAtLH({ 0.f, 0.f, -600.f }, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }),
+			PerspectiveFovLH(3.14159265f / 4.f, 16.f / 9.f, 0.1f, 1000.f));
+		std::vector<uint32_t> visible;
+		double frustumMilliseconds = 0.0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			visible.clear();
+			const Clock::time_point start = Clock::now();
+			bvh.QueryFrustum(&viewProjection.m[0][0], visible);
+			frustumMilliseconds += MillisecondsSince(start);
+		}
+
+		const uint32_t numRays = 10000;
+		uint32_t numHits = 0;
+		const Clock::time_point rayStart = Clock::now();
+		for (uint32_t i = 0; i < numRays; i++)
+		{
+			const Float3 target = { position(random), position(random), position(random) };
+			const Float3 origin = { 0.f, 0.f, -600.f };
+			if (bvh.Raycast(origin, Normalize(target - origin), 2000.f).Object != SceneBVH::invalidObject)
+				numHits++;
+		}
+		const double rayMilliseconds = MillisecondsSince(rayStart);
+
+		const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		std::vector<std::thread> readers;
+		const Clock::time_point concurrentStart = Clock::now();
+		for (uint32_t thread = 0; thread < numThreads; thread++)
+		{
+			readers.emplace_back([&bvh, &viewProjection, iterations]()
+			{
+				std::vector<uint32_t> objects;
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					objects.clear();
+					bvh.QueryFrustum(&viewProjection.m[0][0], objects);
+				}
+			});
+		}
+		for (std::thread& reader : readers)
+			reader.join();
+		const double concurrentMilliseconds = MillisecondsSince(concurrentStart);
+
+		const SceneBVH::Statistics statistics = bvh.GetStatistics();
+		printf("scene bvh, %u objects, %u nodes, %u iterations\n", count, statistics.NumNodes, iterations);
+		printf("full rebuild       %8.3f ms\n", buildMilliseconds / iterations);
+		printf("refit, small moves %8.3f ms, %u subtree rebuilds\n", refitMilliseconds / iterations, numRefitRebuilds);
+		printf("update, 10%% moved  %8.3f ms, %llu objects reinserted and %llu rebuilt per update, full rebuild past "
+			"%u%% moved\n", incrementalMilliseconds / iterations,
+			static_cast<unsigned long long>(numReinsertedObjects / iterations),
+			static_cast<unsigned long long>(numIncrementalObjects / iterations), SceneBVH::fullRebuildPercent);
+		printf("overlap queries    %s\n", queriesAgree ? "agree with testing every box" : "DIFFER");
+		printf("frustum query      %8.3f ms, %zu visible\n", frustumMilliseconds / iterations, visible.size());
+		printf("raycast            %8.3f us, %u of %u hit\n", rayMilliseconds * 1000.0 / numRays, numHits, numRays);
+		printf("frustum query x%-3u %8.3f ms for all threads\n", numThreads, concurrentMilliseconds / iterations);
+		return queriesAgree;
+	}
+
+	// Random boxes in front of the camera, with a wall over the middle of the view as the one occluder. Checks that
+	// the SIMD, scalar and scene BVH frustum stages agree and that nothing in front of the wall is reported as
+	// occluded.
+	bool RunCulling(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 100000;
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-300.f, 300.f);
+		std::uniform_real_distribution<float> depth(1.f, 600.f);
+		std::uniform_real_distribution<float> size(0.5f, 2.f);
+
+		const float wallDepth = 100.f;
+		const float wallPositions[] = { -40.f, -25.f, wallDepth, 40.f, -25.f, wallDepth, 40.f, 25.f, wallDepth,
+			-40.f, 25.f, wallDepth };
+		const uint32_t wallIndices[] = { 0, 1, 2, 0, 2, 3 };
+		const Float4x4 identity = Identity4x4();
+		std::vector<CullingObject> objects(count);
+		objects[0].Bounds = { { -40.f, -25.f, wallDepth }, { 40.f, 25.f, wallDepth } };
+		objects[0].World = &identity.m[0][0];
+		objects[0].OccluderMesh = 0;
+		for (uint32_t i = 1; i < count; i++)
+		{
+			const Float3 center = { position(random), position(random), depth(random) };
+			const Float3 halfSize = Float3{ size(random), size(random), size(random) } * 0.5f;
+			objects[i].Bounds = { center - halfSize, center + halfSize };
+		}
+
+		CullingSystem culling;
+		culling.SetOccluderMesh(0, wallPositions, 4, sizeof(float) * 3, wallIndices, 6);
+		const Float4x4 viewProjection = Multiply(LookAtLH({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }),
+			PerspectiveFovLH(3.14159265f / 4.f, 16.f / 9.f, 0.1f, 1000.f));
+		const CullingSystem::Settings cullingSettings;
+
+		std::vector<uint32_t> scalarVisible;
+		const CullingSystem::Settings frustumOnly = { false };
+		culling.Cull(&viewProjection.m[0][0], objects, frustumOnly, scalarVisible, false);
+		const double scalarMilliseconds = culling.GetStatistics().FrustumMilliseconds;
+		std::vector<uint32_t> frustumVisible;
+		culling.Cull(&viewProjection.m[0][0], objects, frustumOnly, frustumVisible);
+
+		std::vector<BoundingBox> bounds(count);
+		for (uint32_t i = 0; i < count; i++)
+			bounds[i] = objects[i].Bounds;
+		SceneBVH bvh;
+		bvh.Build(bounds);
+		std::vector<uint32_t> bvhVisible;
+		culling.Cull(&viewProjection.m[0][0], bvh, objects, frustumOnly, bvhVisible);
+		const double bvhMilliseconds = culling.GetStatistics().FrustumMilliseconds;
+
+		std::vector<uint32_t> visible;
+		CullingSystem::Statistics total;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			culling.Cull(&viewProjection.m[0][0], objects, cullingSettings, visible);
+			const CullingSystem::Statistics& statistics = culling.GetStatistics();
+			total.FrustumMilliseconds += statistics.FrustumMilliseconds;
+			total.RasterizeMilliseconds += statistics.RasterizeMilliseconds;
+			total.OcclusionMilliseconds += statistics.OcclusionMilliseconds;
+		}
+		const CullingSystem::Statistics& statistics = culling.GetStatistics();
+
+		uint32_t numWronglyOccluded = 0;
+		for (size_t i = 0, next = 0; i < frustumVisible.size(); i++)
+		{
+			while (next < visible.size() && visible[next] < frustumVisible[i])
+				next++;
+			const bool occluded = next == visible.size() || visible[next] != frustumVisible[i];
+			if (occluded && objects[frustumVisible[i]].Bounds.Min.z <= wallDepth)
+				numWronglyOccluded++;
+		}
+
+		printf("culling, %u objects, one occluder of %u triangles, %u iterations\n", count,
+			statistics.NumOccluderTriangles, iterations);
+		printf("frustum stage      %8.3f ms, %u culled, scalar %.3f ms %s\n", total.FrustumMilliseconds / iterations,
+			statistics.NumFrustumCulled, scalarMilliseconds, scalarVisible == frustumVisible ? "agrees" : "DIFFERS");
+		printf("bvh frustum stage  %8.3f ms, %s\n", bvhMilliseconds,
+			bvhVisible == frustumVisible ? "agrees" : "DIFFERS");
+		printf("occluder raster    %8.3f ms\n", total.RasterizeMilliseconds / iterations);
+		printf("occlusion stage    %8.3f ms, %u culled, %u in front of the occluder culled\n",
+			total.OcclusionMilliseconds / iterations, statistics.NumOcclusionCulled, numWronglyOccluded);
+		return scalarVisible == frustumVisible && bvhVisible == frustumVisible && numWronglyOccluded == 0;
+	}
+
+	// Producers on several threads push numbered events as fast as they can, retrying when the ring is full, while one
+	// consumer drains in batches. Checks that every event arrives exactly once, in order per producer, with timestamps
+	// that never go backwards per producer.
+	bool RunInputQueue(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 1000000;
+		const uint32_t numProducers = std::max(std::thread::hardware_concurrency(), 4u);
+		const uint32_t batchSize = 256;
+		MPSCQueue<InputEvent> queue(1024);
+
+		std::atomic<uint64_t> numRetries = 0;
+		std::vector<std::thread> producers;
+		const Clock::time_point start = Clock::now();
+		for (uint32_t producer = 0; producer < numProducers; producer++)
+		{
+			producers.emplace_back([&queue, &numRetries, producer, count, numProducers]()
+			{
+				for (uint32_t i = producer; i < count; i += numProducers)
+				{
+					while (!queue.Push({ static_cast<int>(i), static_cast<int>(producer), 0.f }))
+					{
+						numRetries.fetch_add(1, std::memory_order_relaxed);
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+
+		std::vector<int> lastInput(numProducers, -1);
+		std::vector<MPSCQueue<InputEvent>::Clock::time_point> lastTimestamp(numProducers);
+		uint32_t numReceived = 0;
+		uint32_t numBatches = 0;
+		uint32_t numOutOfOrder = 0;
+		while (numReceived < count)
+		{
+			const uint32_t numDrained = queue.Drain([&](const InputEvent& event,
+				const MPSCQueue<InputEvent>::Clock::time_point timestamp)
+			{
+				const uint32_t producer = static_cast<uint32_t>(event.port);
+				if (event.input != lastInput[producer] + static_cast<int>(lastInput[producer] < 0 ? producer + 1 :
+					numProducers) || timestamp < lastTimestamp[producer])
+				{
+					numOutOfOrder++;
+				}
+				lastInput[producer] = event.input;
+				lastTimestamp[producer] = timestamp;
+			}, batchSize);
+			numReceived += numDrained;
+			numBatches += numDrained > 0;
+			if (numDrained == 0)
+				std::this_thread::yield();
+		}
+		const double milliseconds = MillisecondsSince(start);
+		for (std::thread& producer : producers)
+			producer.join();
+
+		printf("input queue, %u events from %u producers, capacity %u\n", count, numProducers, queue.GetCapacity());
+		printf("throughput         %8.1f million events/s, %u batches\n", count / milliseconds / 1000.0, numBatches);
+		printf("received           %u of %u, %u out of order, %llu pushes retried on a full ring\n", numReceived, count,
+			numOutOfOrder, static_cast<unsigned long long>(numRetries.load()));
+		printf("counters           %llu pushed, %llu dropped\n", static_cast<unsigned long long>(queue.GetNumPushed()),
+			static_cast<unsigned long long>(queue.GetNumDropped()));
+		return numReceived == count && numOutOfOrder == 0;
+	}
+
+	// Spawns two children and waits for them, down to the given depth, to check fork-join and stealing under nesting.
+	void SpawnTree(JobSystem& jobs, const uint32_t depth, std::atomic<uint32_t>& numLeaves)
+	{
+		if (depth == 0)
+		{
+			numLeaves.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		JobSystem::Counter counter = 0;
+		for (uint32_t child = 0; child < 2; child++)
+			jobs.Run("tree", [&jobs, depth, &numLeaves]() { SpawnTree(jobs, depth - 1, numLeaves); }, &counter);
+		jobs.Wait(counter);
+	}
+
+	// The same parallel-for over a floating point heavy loop with 1 worker up to one per hardware thread, at least 4 so
+	// stealing gets exercised everywhere, then a tree of nested jobs. Results must match the single worker run exactly.
+	bool RunJobs(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 1 << 20;
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		const uint32_t maxWorkers = std::max(std::thread::hardware_concurrency(), 4u);
+		const uint32_t grainSize = 1024;
+		const uint32_t treeDepth = 12;
+
+		printf("jobs, parallel-for over %u items in ranges of at least %u, %u iterations, %u hardware threads\n", count,
+			grainSize, iterations, std::thread::hardware_concurrency());
+		std::vector<float> results(count);
+		std::vector<float> expected;
+		double singleWorkerMilliseconds = 0.0;
+		bool passed = true;
+		for (uint32_t numWorkers = 1; numWorkers <= maxWorkers; numWorkers++)
+		{
+			JobSystem jobs;
+			jobs.Initialize(numWorkers);
+			const Clock::time_point start = Clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				jobs.ParallelFor("benchmark", count, grainSize, [&results](const uint32_t begin, const uint32_t end)
+				{
+					for (uint32_t item = begin; item < end; item++)
+					{
+						float value = static_cast<float>(item);
+						for (uint32_t round = 0; round < 16; round++)
+							value = std::sqrt(std::fabs(value) + 1.f) * std::sin(value * 0.001f + 1.f);
+						results[item] = value;
+					}
+				});
+			}
+			const double milliseconds = MillisecondsSince(start) / iterations;
+
+			std::atomic<uint32_t> numLeaves = 0;
+			JobSystem::Counter root = 0;
+			jobs.Run("tree", [&jobs, treeDepth, &numLeaves]() { SpawnTree(jobs, treeDepth, numLeaves); }, &root);
+			jobs.Wait(root);
+			const JobSystem::Statistics statistics = jobs.GetStatistics();
+			jobs.Shutdown();
+
+			if (numWorkers == 1)
+			{
+				expected = results;
+				singleWorkerMilliseconds = milliseconds;
+			}
+			printf("%2u workers        %8.3f ms, %5.2fx, %llu jobs, %llu stolen, %llu sleeps, results %s, tree %s\n",
+				numWorkers, milliseconds, singleWorkerMilliseconds / milliseconds,
+				static_cast<unsigned long long>(statistics.NumJobs), static_cast<unsigned long long>(statistics.NumStolen),
+				static_cast<unsigned long long>(statistics.NumSleeps), results == expected ? "agree" : "DIFFER",
+				numLeaves.load() == 1u << treeDepth ? "complete" : "INCOMPLETE");
+			passed &= results == expected && numLeaves.load() == 1u << treeDepth;
+		}
+		return passed;
+	}
+
+	// A grid of overlapping quads at staggered heights, each its own mesh so every one is a draw of its own, seen from above.
+	struct DrawHeavyScene
+	{
+		TransformSystem Transforms;
+		std::vector<uint32_t> ObjectMeshIDs;
+		FrameConstants Constants = {};
+
+		void Create(FrameRenderer& renderer, const uint32_t count, const float aspectRatio)
+		{
+			const std::vector<RenderVertex> vertices = {
+				{ { -0.4f, 0.f, -0.4f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f } },
+				{ { -0.4f, 0.f, 0.4f }, { 0.f, 1.f, 0.f }, { 0.f, 1.f } },
+				{ { 0.4f, 0.f, 0.4f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f } },
+				{ { 0.4f, 0.f, -0.4f }, { 0.f, 1.f, 0.f }, { 1.f, 0.f } } };
+			const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+			const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+			Transforms.Resize(count);
+			ObjectMeshIDs.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				ObjectMeshIDs[i] = renderer.AddMesh(vertices, indices);
+				Transforms.SetPosition(i, (i % side - side * 0.5f) * 0.6f, (i % 5) * 0.1f, (i / side - side * 0.5f) * 0.6f);
+			}
+			Transforms.Update();
+
+			const Float3 eye = { 0.f, side * 0.7f, side * -0.2f };
+			const Float4x4 viewProjection = Multiply(LookAtLH(eye, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }),
+				PerspectiveFovLH(3.14159265f / 4.f, aspectRatio, 0.1f, 1000.f));
+			const Float4x4 inverseViewProjection = Inverse(viewProjection);
+			memcpy(Constants.ViewProjection, viewProjection.m, sizeof(Constants.ViewProjection));
+			memcpy(Constants.InverseViewProjection, inverseViewProjection.m, sizeof(Constants.InverseViewProjection));
+			const float cameraPosition[4] = { eye.x, eye.y, eye.z, 1.f };
+			const float lightDirection[4] = { 0.6f, -1.f, 1.f, 0.f };
+			const float lightDiffuse[4] = { 1.f, 1.f, 1.f, 0.f };
+			const float lightAmbient[4] = { 0.1f, 0.1f, 0.1f, 0.f };
+			memcpy(Constants.CameraPosition, cameraPosition, sizeof(cameraPosition));
+			memcpy(Constants.LightDirection, lightDirection, sizeof(lightDirection));
+			memcpy(Constants.LightDiffuse, lightDiffuse, sizeof(lightDiffuse));
+			memcpy(Constants.LightAmbient, lightAmbient, sizeof(lightAmbient));
+		}
+	};
+
+	// Recording a draw heavy frame against the null backend, so only the CPU side of recording is timed, with 1 worker
+	// up to one per hardware thread and at least 4. The software backend then renders a smaller version of the scene
+	// with one list and with the most, which must give the same image.
+	bool RunRecording(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 16384;
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		const uint32_t maxWorkers = std::max(std::thread::hardware_concurrency(), 4u);
+
+		printf("recording, %u objects, %u iterations, %u hardware threads\n", count, iterations,
+			std::thread::hardware_concurrency());
+		double singleWorkerMilliseconds = 0.0;
+		for (uint32_t numWorkers = 1; numWorkers <= maxWorkers; numWorkers++)
+		{
+			JobSystem jobs;
+			jobs.Initialize(numWorkers);
+			NullRenderBackend backend;
+			FrameRenderer renderer;
+			renderer.Initialize(&backend, 64, 64, FrameRenderer::maxFramesInFlight, count);
+			renderer.SetJobSystem(&jobs);
+			DrawHeavyScene scene;
+			scene.Create(renderer, count, 1.f);
+
+			// the first frame grows the lists' streams
+			renderer.Render(scene.Transforms, scene.ObjectMeshIDs, scene.Constants);
+			double recordSeconds = 0.0;
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				renderer.Render(scene.Transforms, scene.ObjectMeshIDs, scene.Constants);
+				recordSeconds += renderer.GetTimings().RecordSeconds;
+			}
+			const double milliseconds = recordSeconds * 1000.0 / iterations;
+			jobs.Shutdown();
+
+			if (numWorkers == 1)
+				singleWorkerMilliseconds = milliseconds;
+			const NullRenderBackend::Statistics& statistics = backend.GetStatistics();
+			printf("%2u workers        %8.3f ms, %5.2fx, %2u lists, %llu draws, %.1f KiB recorded per frame\n",
+				numWorkers, milliseconds, singleWorkerMilliseconds / milliseconds, renderer.GetTimings().NumDrawLists,
+				static_cast<unsigned long long>(statistics.NumDraws / statistics.NumSubmits),
+				statistics.NumBytes / 1024.0 / statistics.NumSubmits);
+		}
+
+		const uint32_t imageCount = FrameRenderer::minDrawsPerList * 4;
+		std::vector<float> images[2];
+		uint32_t numDrawLists[2] = {};
+		for (uint32_t run = 0; run < 2; run++)
+		{
+			JobSystem jobs;
+			jobs.Initialize(run == 0 ? 1 : maxWorkers);
+			SoftwareRenderBackend backend;
+			FrameRenderer renderer;
+			renderer.Initialize(&backend, 160, 120, 1, imageCount);
+			renderer.SetJobSystem(&jobs);
+			DrawHeavyScene scene;
+			scene.Create(renderer, imageCount, 160.f / 120.f);
+			renderer.Render(scene.Transforms, scene.ObjectMeshIDs, scene.Constants);
+			numDrawLists[run] = renderer.GetTimings().NumDrawLists;
+			backend.ReadTexture(renderer.GetOutput(), images[run]);
+			jobs.Shutdown();
+		}
+		uint32_t numCovered = 0;
+		for (size_t i = 0; i < images[0].size(); i += 4)
+			numCovered += images[0][i] + images[0][i + 1] + images[0][i + 2] > 0.f;
+		printf("software backend   %u objects on %u list against %u lists, images %s, %.0f%% covered\n", imageCount,
+			numDrawLists[0], numDrawLists[1], images[0] == images[1] ? "agree" : "DIFFER",
+			numCovered * 400.0 / images[0].size());
+		return images[0] == images[1];
+	}
+
+	// A name for every benchmark thread, since names must outlive the profiler.
+	const char* const profilerThreadNames[] = { "Benchmark 0", "Benchmark 1", "Benchmark 2", "Benchmark 3",
+		"Benchmark 4", "Benchmark 5", "Benchmark 6", "Benchmark 7" };
+
+	// Pairs of nested scopes on 1 thread and then on several at once, while this thread keeps collecting what they
+	// record. Every event collected must be whole, and afterwards each thread's track must hold the newest events of its
+	// ring, properly nested.
+	bool RunProfiler(const Settings& settings)
+	{
+		const uint32_t count = settings.Count ? settings.Count : 1 << 20;
+		const uint32_t maxThreads = std::min(std::max(std::thread::hardware_concurrency(), 2u),
+			static_cast<uint32_t>(std::size(profilerThreadNames)));
+
+		printf("profiler, %u pairs of nested scopes per thread, %u hardware threads\n", count,
+			std::thread::hardware_concurrency());
+		std::vector<Profiler::Track> tracks;
+		bool passed = true;
+		for (const uint32_t numThreads : { 1u, maxThreads })
+		{
+			std::atomic<uint32_t> numRunning = numThreads;
+			std::vector<double> threadNanoseconds(numThreads);
+			const int64_t begin = Profiler::Now();
+			std::vector<std::thread> threads;
+			for (uint32_t t = 0; t < numThreads; t++)
+			{
+				threads.emplace_back([t, count, &numRunning, &threadNanoseconds]()
+				{
+					Profiler::SetThreadName(profilerThreadNames[t]);
+					const Clock::time_point start = Clock::now();
+					for (uint32_t i = 0; i < count; i++)
+					{
+						PROFILE_SCOPE("outer");
+						PROFILE_SCOPE("inner");
+					}
+					threadNanoseconds[t] = MillisecondsSince(start) * 1e6 / (count * 2.0);
+					numRunning--;
+				});
+			}
+
+			// events are copied out while their slots are being reused
+			uint32_t numCollects = 0;
+			bool whole = true;
+			while (numRunning > 0)
+			{
+				Profiler::Collect(begin, INT64_MAX, tracks);
+				for (const Profiler::Track& track : tracks)
+				{
+					for (const Profiler::Event& event : track.Events)
+					{
+						if (strcmp(event.Name, "outer") == 0 || strcmp(event.Name, "inner") == 0)
+							whole &= event.Begin <= event.End && event.Depth == (event.Name[0] == 'o' ? 0u : 1u);
+					}
+				}
+				numCollects++;
+				std::this_thread::yield();
+			}
+			for (std::thread& thread : threads)
+				thread.join();
+
+			// Quiet now, so every track holds all but the oldest slot of its ring, which a writer could have been reusing.
+			Profiler::Collect(begin, Profiler::Now(), tracks);
+			const size_t expectedEvents = std::min<size_t>(count * size_t(2), Profiler::maxEventsPerTrack - 1);
+			uint32_t numTracks = 0;
+			bool complete = true;
+			bool nested = true;
+			for (const Profiler::Track& track : tracks)
+			{
+				if (track.Name.compare(0, 10, "Benchmark ") != 0 || track.Events.empty())
+					continue;
+				numTracks++;
+				complete &= track.Events.size() == expectedEvents;
+				// in the order they ended, each inner scope before the outer one around it
+				for (size_t i = 0; i + 1 < track.Events.size(); i++)
+				{
+					const Profiler::Event& event = track.Events[i];
+					const Profiler::Event& next = track.Events[i + 1];
+					nested &= next.End >= event.End;
+					if (event.Depth == 1)
+						nested &= next.Depth == 0 && next.Begin <= event.Begin && next.End >= event.End;
+				}
+			}
+
+			double nanoseconds = 0.0;
+			for (const double threadTime : threadNanoseconds)
+				nanoseconds += threadTime / numThreads;
+			printf("%2u threads        %8.1f ns/scope, %u collects, events %s, %u tracks %s, %s\n", numThreads,
+				nanoseconds, numCollects, whole ? "whole" : "TORN", numTracks,
+				complete && numTracks == numThreads ? "complete" : "INCOMPLETE", nested ? "nested" : "NOT NESTED");
+			passed &= whole && complete && numTracks == numThreads && nested;
+		}
+		return passed;
+	}
+
+	// A plane at height h over the surface occludes every cosine weighted ray steeper than h / radius, so a still
+	// camera must converge on a visibility of (h / radius)^2. Checked at a few heights over a tile of -count by -count
+	// pixels, since each pixel has its own noise, then the history rules: a point new on screen or seen at a different
+	// distance starts over, and the running mean stops counting at MaxHistory.
+	bool RunAmbientOcclusion(const Settings& settings)
+	{
+		const uint32_t size = settings.Count ? settings.Count : 16;
+		const uint32_t numFrames = 256;
+		const Float3 position = { 0.f, 0.f, 0.f };
+		const Float3 normal = { 0.f, 0.f, 1.f };
+
+		AmbientOcclusion::Settings aoSettings;
+		aoSettings.MaxHistory = numFrames;
+		printf("ambient occlusion, %ux%u pixels, %u frames of %u rays, radius %.1f\n", size, size, numFrames,
+			aoSettings.RaysPerPixel, aoSettings.Radius);
+		bool passed = true;
+		for (const float height : { 0.f, 0.25f, 0.5f, 0.75f, 1.5f })
+		{
+			const AmbientOcclusion::OcclusionQuery plane = [height](const Float3& origin, const Float3& direction,
+				const float maxDistance)
+			{
+				return direction.z > 0.f && (height - origin.z) < direction.z * maxDistance;
+			};
+			const Clock::time_point start = Clock::now();
+			double visibility = 0.0;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+					visibility += AmbientOcclusion::Converge(position, normal, x, y, numFrames, aoSettings, plane);
+			}
+			visibility /= size * size;
+			const double milliseconds = MillisecondsSince(start);
+
+			const float ratio = std::min(height / aoSettings.Radius, 1.f);
+			const double error = std::abs(visibility - ratio * ratio);
+			printf("plane at %.2f      %8.3f ms, visibility %.4f against %.4f, %s\n", height, milliseconds, visibility,
+				ratio * ratio, error < 0.01 ? "agrees" : "DIFFERS");
+			passed &= error < 0.01;
+		}
+
+		AmbientOcclusion::Settings historySettings;
+		const AmbientOcclusion::History first = AmbientOcclusion::Accumulate(nullptr, 0.25f, 10.f, historySettings);
+		const AmbientOcclusion::History second = AmbientOcclusion::Accumulate(&first, 0.75f, 10.2f, historySettings);
+		const bool resets = first.Count == 1.f && first.Visibility == 0.25f && first.Distance == 10.f;
+		const bool accumulates = second.Count == 2.f && std::abs(second.Visibility - 0.5f) < 1e-6f;
+
+		// a surface 10% nearer is something else moving in front, so its history is thrown away
+		const AmbientOcclusion::History disoccluded = AmbientOcclusion::Accumulate(&second, 1.f, 9.f, historySettings);
+		const bool disocclusion = disoccluded.Count == 1.f && disoccluded.Visibility == 1.f;
+
+		AmbientOcclusion::History history = first;
+		for (uint32_t frame = 0; frame < historySettings.MaxHistory * 2; frame++)
+			history = AmbientOcclusion::Accumulate(&history, 0.f, 10.f, historySettings);
+		const AmbientOcclusion::History last = AmbientOcclusion::Accumulate(&history, 1.f, 10.f, historySettings);
+		const float expected = history.Visibility + (1.f - history.Visibility) / historySettings.MaxHistory;
+		const bool capped = history.Count == static_cast<float>(historySettings.MaxHistory) &&
+			last.Count == history.Count && std::abs(last.Visibility - expected) < 1e-6f;
+
+		printf("history            %s when new, %s, %s when disoccluded, %s at %u frames\n",
+			resets ? "resets" : "DOES NOT RESET", accumulates ? "accumulates" : "DOES NOT ACCUMULATE",
+			disocclusion ? "resets" : "DOES NOT RESET", capped ? "capped" : "NOT CAPPED", historySettings.MaxHistory);
+		return passed && resets && accumulates && disocclusion && capped;
+	}
+
+	// A display of -count by half as many pixels: sky over the top rows, then a near surface facing the camera in
+	// shadow on the left and a lit wall much further away, turned side on, on the right. The edges are placed off the
+	// trace grid of every mode. Each traced pixel takes the surface and shadow of the display pixel its ray goes
+	// through, and upsampling must give every display pixel the value of its own surface, with no bleed across either
+	// edge. The same upsample over a flat copy of the surface, which leaves only the tent filter, must bleed, or the
+	// edges were never under test.
+	bool RunUpsampler(const Settings& settings)
+	{
+		const uint32_t width = std::max(settings.Count ? settings.Count : 256, 16u);
+		const uint32_t height = width / 2;
+		const uint32_t iterations = std::max(settings.Iterations, 1u);
+		const uint32_t edgeX = width * 3 / 8 + 1;
+		const uint32_t skyRows = height / 8 + 1;
+
+		ShadowDenoiser::Surface display;
+		display.Width = width;
+		display.Height = height;
+		display.NormalX.resize(width * height);
+		display.NormalY.resize(width * height);
+		display.NormalZ.resize(width * height);
+		display.Distance.resize(width * height);
+		std::vector<float> expected(width * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t index = y * width + x;
+				const bool sky = y < skyRows;
+				const bool near = !sky && x < edgeX;
+				display.NormalX[index] = near ? 0.f : -1.f;
+				display.NormalZ[index] = near ? -1.f : 0.f;
+				display.Distance[index] = sky ? -1.f : near ? 5.f + 0.01f * y : 20.f + 0.05f * x;
+				expected[index] = near ? 0.f : 1.f;
+			}
+		}
+		ShadowDenoiser::Surface flat = display;
+		std::fill(flat.NormalX.begin(), flat.NormalX.end(), 0.f);
+		std::fill(flat.NormalZ.begin(), flat.NormalZ.end(), -1.f);
+		std::fill(flat.Distance.begin(), flat.Distance.end(), 10.f);
+
+		const ShadowUpsampler::Settings upsamplerSettings;
+		std::vector<float> output(width * height);
+		printf("shadow upsampler, %ux%u display, %u iterations\n", width, height, iterations);
+		bool passed = true;
+		for (const ShadowUpsampler::TraceResolution resolution : { ShadowUpsampler::TraceResolution::Full,
+			ShadowUpsampler::TraceResolution::Checkerboard, ShadowUpsampler::TraceResolution::Half,
+			ShadowUpsampler::TraceResolution::Quarter })
+		{
+			const uint32_t traceWidth = ShadowUpsampler::GetTraceWidth(resolution, width);
+			const uint32_t traceHeight = ShadowUpsampler::GetTraceHeight(resolution, height);
+			ShadowDenoiser::Surface traced;
+			traced.Width = traceWidth;
+			traced.Height = traceHeight;
+			traced.NormalX.resize(traceWidth * traceHeight);
+			traced.NormalY.resize(traceWidth * traceHeight);
+			traced.NormalZ.resize(traceWidth * traceHeight);
+			traced.Distance.resize(traceWidth * traceHeight);
+			ShadowDenoiser::Surface tracedFlat = traced;
+			std::vector<float> input(traceWidth * traceHeight);
+
+			double milliseconds = 0.0;
+			float maxBleed = 0.f;
+			float maxFlatBleed = 0.f;
+			// the checkerboard alternates which pixel of each pair it traces
+			for (uint32_t frameIndex = 0; frameIndex < 2; frameIndex++)
+			{
+				for (uint32_t y = 0; y < traceHeight; y++)
+				{
+					for (uint32_t x = 0; x < traceWidth; x++)
+					{
+						float displayX;
+						float displayY;
+						ShadowUpsampler::GetTracePosition(resolution, frameIndex, x, y, displayX, displayY);
+						const uint32_t source = std::min(static_cast<uint32_t>(displayY), height - 1) * width +
+							std::min(static_cast<uint32_t>(displayX), width - 1);
+						const uint32_t index = y * traceWidth + x;
+						traced.NormalX[index] = display.NormalX[source];
+						traced.NormalY[index] = display.NormalY[source];
+						traced.NormalZ[index] = display.NormalZ[source];
+						traced.Distance[index] = display.Distance[source];
+						tracedFlat.NormalX[index] = flat.NormalX[source];
+						tracedFlat.NormalY[index] = flat.NormalY[source];
+						tracedFlat.NormalZ[index] = flat.NormalZ[source];
+						tracedFlat.Distance[index] = flat.Distance[source];
+						input[index] = expected[source];
+					}
+				}
+
+				const Clock::time_point start = Clock::now();
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					ShadowUpsampler::Upsample(resolution, frameIndex, traced, input.data(), display, output.data(),
+						upsamplerSettings);
+				}
+				milliseconds += MillisecondsSince(start) / (iterations * 2);
+				for (uint32_t i = 0; i < width * height; i++)
+					maxBleed = std::max(maxBleed, std::abs(output[i] - expected[i]));
+
+				ShadowUpsampler::Upsample(resolution, frameIndex, tracedFlat, input.data(), flat, output.data(),
+					upsamplerSettings);
+				for (uint32_t i = 0; i < width * height; i++)
+					maxFlatBleed = std::max(maxFlatBleed, std::abs(output[i] - expected[i]));
+			}
+
+			const char* const names[] = { "full", "checkerboard", "half", "quarter" };
+			const bool contained = maxBleed < 1e-3f;
+			const bool edgeTested = resolution == ShadowUpsampler::TraceResolution::Full || maxFlatBleed > 0.1f;
+			printf("%-12s       %8.3f ms, %ux%u traced, bleed %.3f %s, %.3f without surface weights%s\n",
+				names[static_cast<uint32_t>(resolution)], milliseconds, traceWidth, traceHeight, maxBleed,
+				contained ? "contained" : "ACROSS EDGES", maxFlatBleed, edgeTested ? "" : ", EDGES NOT TESTED");
+			passed &= contained && edgeTested;
+		}
+		return passed;
+	}
+
+	// A still view of -count by half as many pixels: sky over the top rows, then a floor crossed by a wide penumbra and
+	// a lit wall on the right. It is traced with one ray per pixel, so each frame's input is 0 or 1 with the true
+	// visibility as the chance of 1. Denoising with and without SIMD must give the same result every frame, and the
+	// error against the true visibility in the penumbra must fall as history builds up.
+	bool RunDenoiser(const Settings& settings)
+	{
+		const uint32_t width = std::max(settings.Count ? settings.Count : 256, 16u);
+		const uint32_t height = width / 2;
+		const uint32_t numPixels = width * height;
+		const uint32_t numFrames = 32;
+		const uint32_t wallX = width * 3 / 4;
+		const uint32_t skyRows = height / 8 + 1;
+
+		ShadowDenoiser::Surface surface;
+		surface.Width = width;
+		surface.Height = height;
+		surface.NormalX.resize(numPixels);
+		surface.NormalY.resize(numPixels);
+		surface.NormalZ.resize(numPixels);
+		surface.Distance.resize(numPixels);
+		std::vector<float> truth(numPixels);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t index = y * width + x;
+				const bool wall = x >= wallX;
+				surface.NormalX[index] = wall ? -1.f : 0.f;
+				surface.NormalY[index] = wall ? 0.f : 1.f;
+				surface.Distance[index] = y < skyRows ? -1.f : wall ? 10.f : 5.f + 20.f / (y - skyRows + 1);
+				const float penumbra = (static_cast<float>(x) - width * 0.25f) / (width * 0.25f);
+				truth[index] = wall ? 1.f : std::min(std::max(penumbra, 0.f), 1.f);
+			}
+		}
+
+		const ShadowDenoiser::Settings denoiserSettings;
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> chance(0.f, 1.f);
+		std::vector<float> current(numPixels);
+		// one set of buffers with SIMD and one without
+		std::vector<float> history[2] = { std::vector<float>(numPixels), std::vector<float>(numPixels) };
+		std::vector<float> historyCount[2] = { std::vector<float>(numPixels), std::vector<float>(numPixels) };
+		std::vector<float> output[2] = { std::vector<float>(numPixels), std::vector<float>(numPixels) };
+		std::vector<float> nextHistory(numPixels);
+		std::vector<float> nextCount(numPixels);
+		double milliseconds[2] = {};
+		float maxDifference = 0.f;
+		double inputError = 0.0;
+		std::vector<double> errors;
+		for (uint32_t frame = 0; frame < numFrames; frame++)
+		{
+			for (uint32_t i = 0; i < numPixels; i++)
+				current[i] = chance(random) < truth[i] ? 1.f : 0.f;
+			for (uint32_t run = 0; run < 2; run++)
+			{
+				const Clock::time_point start = Clock::now();
+				ShadowDenoiser::Denoise(surface, current.data(), history[run].data(), historyCount[run].data(),
+					output[run].data(), nextHistory.data(), nextCount.data(), denoiserSettings, run == 0);
+				milliseconds[run] += MillisecondsSince(start) / numFrames;
+				history[run].swap(nextHistory);
+				historyCount[run].swap(nextCount);
+			}
+
+			double sumOfSquares = 0.0;
+			uint32_t numPenumbra = 0;
+			for (uint32_t i = 0; i < numPixels; i++)
+			{
+				maxDifference = std::max(maxDifference, std::abs(output[0][i] - output[1][i]));
+				if (surface.Distance[i] >= 0.f && truth[i] > 0.f && truth[i] < 1.f)
+				{
+					const double error = output[0][i] - truth[i];
+					sumOfSquares += error * error;
+					if (frame == 0)
+						inputError += (current[i] - truth[i]) * (current[i] - truth[i]);
+					numPenumbra++;
+				}
+			}
+			if (frame == 0)
+				inputError = std::sqrt(inputError / numPenumbra);
+			errors.push_back(std::sqrt(sumOfSquares / numPenumbra));
+		}
+
+		bool falls = errors[0] < inputError;
+		for (uint32_t frame = 1; frame < numFrames; frame *= 2)
+			falls &= errors[std::min(frame * 2, numFrames) - 1] < errors[frame - 1];
+		const bool agree = maxDifference < 1e-5f;
+		printf("shadow denoiser, %ux%u pixels, %u frames of one ray per pixel, %u a-trous passes\n", width, height,
+			numFrames, denoiserSettings.NumIterations);
+		printf("simd               %8.3f ms, scalar %.3f ms, %s, largest difference %g\n", milliseconds[0],
+			milliseconds[1], agree ? "agree" : "DIFFER", maxDifference);
+		printf("penumbra rmse      %.3f traced, %.3f after 1 frame, %.3f after 4, %.3f after %u, %s\n", inputError,
+			errors[0], errors[3], errors[numFrames - 1], numFrames, falls ? "falling" : "NOT FALLING");
+		return agree && falls;
+	}
+
+	struct Entry
+	{
+		const char* Name;
+		bool (*Function)(const Settings& settings);
+	};
+
+	const Entry benchmarks[] = {
+		{ "instancebatcher", &RunInstanceBatcher },
+		{ "transforms", &RunTransforms },
+		{ "scenebvh", &RunSceneBVH },
+		{ "culling", &RunCulling },
+		{ "inputqueue", &RunInputQueue },
+		{ "jobs", &RunJobs },
+		{ "recording", &RunRecording },
+		{ "profiler", &RunProfiler },
+		{ "ambientocclusion", &RunAmbientOcclusion },
+		{ "upsampler", &RunUpsampler },
+		{ "denoiser", &RunDenoiser },
+	};
+}
+
+namespace Benchmark
+{
+	int Run(const std::vector<std::string>& arguments)
+	{
+		std::string name;
+		Settings settings;
+		bool valid = true;
+		for (size_t i = 0; i + 1 < arguments.size() && valid; i += 2)
+		{
+			const std::string& argument = arguments[i];
+			const std::string& value = arguments[i + 1];
+			if (argument == "-benchmark")
+				name = value;
+			else if (argument == "-count")
+				valid = ParseUnsigned(value, settings.Count);
+			else if (argument == "-iterations")
+				valid = ParseUnsigned(value, settings.Iterations);
+			else
+				valid = false;
+		}
+		valid = valid && arguments.size() % 2 == 0;
+
+		bool found = false;
+		bool passed = true;
+		for (const Entry& entry : benchmarks)
+		{
+			if (valid && (name == entry.Name || name == "all"))
+			{
+				if (!entry.Function(settings))
+				{
+					fflush(stdout);
+					fprintf(stderr, "%s: checks FAILED\n", entry.Name);
+					passed = false;
+				}
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			fprintf(stderr, "usage: -benchmark name|all [-count n] [-iterations n]\nbenchmarks:");
+			for (const Entry& entry : benchmarks)
+				fprintf(stderr, " %s", entry.Name);
+			fprintf(stderr, "\n");
+			return -1;
+		}
+		return passed ? 0 : 1;
+	}
+}
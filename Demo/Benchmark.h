@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Timed runs of the CPU side systems at sizes the demo scene never reaches, so changes to them can be compared on machines
+// without a GPU. Each benchmark prints its own results and checks them, and any failed check fails the run.
+namespace Benchmark
+{
+	// -benchmark name|all [-count n] [-iterations n]. Returns the process exit code, 1 when a check failed.
+	int Run(const std::vector<std::string>& arguments);
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include "FileWatcher.h"
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+void FileWatcher::Start(const std::filesystem::path& directory, const std::chrono::milliseconds interval)
+{
+	Stop();
+
+	m_directory = directory;
+	m_interval = interval;
+	m_writeTimes = Scan();
+	m_stop = false;
+	m_thread = std::thread([this]()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stopRequested.wait_for(lock, m_interval, [this] { return m_stop; }))
+		{
+			lock.unlock();
+			Poll();
+			lock.lock();
+		}
+	});
+}
+
+void FileWatcher::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_stopRequested.notify_all();
+	m_thread.join();
+}
+
+std::vector<std::filesystem::path> FileWatcher::TakeChanges()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<std::filesystem::path> changes;
+	changes.swap(m_changes);
+	return changes;
+}
+
+void FileWatcher::Poll()
+{
+	WriteTimes writeTimes = Scan();
+
+	std::vector<std::filesystem::path> changes;
+	for (const auto& [path, writeTime] : writeTimes)
+	{
+		const auto previous = m_writeTimes.find(path);
+		if (previous == m_writeTimes.end() || previous->second != writeTime)
+			changes.push_back(path);
+	}
+	for (const auto& [path, writeTime] : m_writeTimes)
+	{
+		if (writeTimes.find(path) == writeTimes.end())
+			changes.push_back(path);
+	}
+	m_writeTimes.swap(writeTimes);
+
+	if (changes.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& path : changes)
+	{
+		if (std::find(m_changes.begin(), m_changes.end(), path) == m_changes.end())
+			m_changes.push_back(std::move(path));
+	}
+}
+
+// Files that vanish or are locked mid-scan, as happens while an editor saves, are skipped and picked up next time.
+FileWatcher::WriteTimes FileWatcher::Scan() const
+{
+	WriteTimes writeTimes;
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(m_directory, error);
+		!error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		std::error_code entryError;
+		if (!it->is_regular_file(entryError))
+			continue;
+		const auto writeTime = it->last_write_time(entryError);
+		if (!entryError)
+			writeTimes[it->path().string()] = writeTime;
+	}
+	return writeTimes;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches a directory tree for edits by polling file write times on its own thread. Polling keeps it portable and costs
+// next to nothing for a folder of shader sources. Changes accumulate until the owner takes them.
+class FileWatcher
+{
+public:
+	~FileWatcher();
+
+	void Start(const std::filesystem::path& directory, const std::chrono::milliseconds interval);
+	void Stop();
+	// Files added, modified or removed since the last call.
+	std::vector<std::filesystem::path> TakeChanges();
+	// Compares the directory against the last scan once. The watcher thread calls this every interval.
+	void Poll();
+
+private:
+	using WriteTimes = std::unordered_map<std::string, std::filesystem::file_time_type>;
+
+	WriteTimes Scan() const;
+
+private:
+	std::filesystem::path m_directory;
+	std::chrono::milliseconds m_interval = std::chrono::milliseconds(0);
+	WriteTimes m_writeTimes;
+	std::vector<std::filesystem::path> m_changes;
+	std::mutex m_mutex;
+	std::condition_variable m_stopRequested;
+	bool m_stop = false;
+	std::thread m_thread;
+};
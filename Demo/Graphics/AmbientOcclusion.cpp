@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "AmbientOcclusion.h"
+
+static float Frac(const float value)
+{
+	return value - std::floor(value);
+}
+
+void AmbientOcclusion::GetPixelNoise(const uint32_t x, const uint32_t y, float noise[2])
+{
+	const float px = static_cast<float>(x);
+	const float py = static_cast<float>(y);
+	noise[0] = Frac(px * 0.7548776662f + py * 0.5698402910f);
+	noise[1] = Frac(52.9829189f * Frac(px * 0.06711056f + py * 0.00583715f));
+}
+
+void AmbientOcclusion::GetSample(const uint32_t index, const float noise[2], float sample[2])
+{
+	const float i = static_cast<float>(index);
+	sample[0] = Frac(0.5f + i * 0.7548776662f + noise[0]);
+	sample[1] = Frac(0.5f + i * 0.5698402910f + noise[1]);
+}
+
+Float3 AmbientOcclusion::SampleCosineHemisphere(const Float3& normal, const float u[2])
+{
+	const float sign = normal.z >= 0.f ? 1.f : -1.f;
+	const float a = -1.f / (sign + normal.z);
+	const float b = normal.x * normal.y * a;
+	const Float3 tangent = { 1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+	const Float3 bitangent = { b, sign + normal.y * normal.y * a, -normal.y };
+
+	const float r = std::sqrt(u[0]);
+	const float phi = 2.f * 3.14159265f * u[1];
+	return Normalize(tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) +
+		normal * std::sqrt(std::max(0.f, 1.f - u[0])));
+}
+
+float AmbientOcclusion::Trace(const Float3& position, const Float3& normal, const uint32_t x, const uint32_t y,
+	const uint32_t frameIndex, const Settings& settings, const OcclusionQuery& query)
+{
+	float noise[2];
+	GetPixelNoise(x, y, noise);
+	const Float3 origin = position + normal * 0.001f;
+	uint32_t unoccluded = 0;
+	for (uint32_t i = 0; i < settings.RaysPerPixel; i++)
+	{
+		float sample[2];
+		GetSample(frameIndex * settings.RaysPerPixel + i, noise, sample);
+		if (!query(origin, SampleCosineHemisphere(normal, sample), settings.Radius))
+			unoccluded++;
+	}
+	return static_cast<float>(unoccluded) / static_cast<float>(std::max(settings.RaysPerPixel, 1u));
+}
+
+bool AmbientOcclusion::IsHistoryValid(const History& previous, const float distance)
+{
+	return std::abs(previous.Distance - distance) < 0.05f * distance;
+}
+
+AmbientOcclusion::History AmbientOcclusion::Accumulate(const History* const previous, const float visibility,
+	const float distance, const Settings& settings)
+{
+	History history;
+	history.Visibility = visibility;
+	history.Count = 1.f;
+	history.Distance = distance;
+	if (previous && IsHistoryValid(*previous, distance))
+	{
+		history.Count = std::min(previous->Count + 1.f, static_cast<float>(settings.MaxHistory));
+		history.Visibility = previous->Visibility + (visibility - previous->Visibility) / history.Count;
+	}
+	return history;
+}
+
+float AmbientOcclusion::Converge(const Float3& position, const Float3& normal, const uint32_t x, const uint32_t y,
+	const uint32_t numFrames, const Settings& settings, const OcclusionQuery& query)
+{
+	const float distance = 1.f;
+	History history;
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		const float visibility = Trace(position, normal, x, y, frame, settings, query);
+		history = Accumulate(frame > 0 ? &history : nullptr, visibility, distance, settings);
+	}
+	return history.Visibility;
+}
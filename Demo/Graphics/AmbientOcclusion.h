@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "Float3.h"
+
+// CPU versions of the sampling and accumulation done by the ambient occlusion pass in RaytracingShaders.hlsl. They
+// follow the shader step for step, so for the same pixel, frame and scene they trace the same rays. Converge gives the
+// value the pass should settle on for a still camera, to compare the GPU result and any change to the sampling against.
+namespace AmbientOcclusion
+{
+	struct Settings
+	{
+		uint32_t RaysPerPixel = 2;
+		float Radius = 1.f;
+		uint32_t MaxHistory = 32;
+	};
+
+	// one pixel of the history the pass keeps between frames
+	struct History
+	{
+		float Visibility = 1.f;
+		float Count = 0.f;
+		float Distance = 0.f;
+	};
+
+	// Whether anything lies along the ray before maxDistance.
+	using OcclusionQuery = std::function<bool(const Float3& origin, const Float3& direction, const float maxDistance)>;
+
+	void GetPixelNoise(const uint32_t x, const uint32_t y, float noise[2]);
+	void GetSample(const uint32_t index, const float noise[2], float sample[2]);
+	Float3 SampleCosineHemisphere(const Float3& normal, const float u[2]);
+	// Fraction of this frame's rays that leave the surface unoccluded.
+	float Trace(const Float3& position, const Float3& normal, const uint32_t x, const uint32_t y, const uint32_t frameIndex,
+		const Settings& settings, const OcclusionQuery& query);
+	// History is reused when the reprojected pixel last saw a surface at about the same distance from the camera.
+	bool IsHistoryValid(const History& previous, const float distance);
+	// previous is null when the point was not on screen last frame.
+	History Accumulate(const History* const previous, const float visibility, const float distance,
+		const Settings& settings);
+	// Accumulated visibility at one pixel after numFrames frames with a still camera.
+	float Converge(const Float3& position, const Float3& normal, const uint32_t x, const uint32_t y,
+		const uint32_t numFrames, const Settings& settings, const OcclusionQuery& query);
+}
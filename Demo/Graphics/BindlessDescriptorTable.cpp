@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "BindlessDescriptorTable.h"
+
+void BindlessDescriptorTable::Initialize(DescriptorHeapAllocator* const heap, const uint32_t capacityPerType)
+{
+	m_heap = heap;
+	m_table.Initialize(capacityPerType);
+	m_descriptors = m_heap->Allocate(m_table.GetNumDescriptors());
+}
+
+uint32_t BindlessDescriptorTable::AddTexture(ID3D12Device* const device, ID3D12Resource* const texture, const DXGI_FORMAT format)
+{
+	// textures have no GPU virtual address, so they are keyed by the resource itself
+	BindlessResourceTable::Registration registration =
+		m_table.Register(BindlessResourceType::Texture, reinterpret_cast<uint64_t>(texture));
+	assert(registration.ID != BindlessResourceTable::invalidID);
+	if (registration.Created)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = texture->GetDesc().MipLevels;
+		device->CreateShaderResourceView(texture, &srvDesc, GetCPUDescriptorHandle(BindlessResourceType::Texture,
+			registration.ID));
+	}
+	return registration.ID;
+}
+
+uint32_t BindlessDescriptorTable::AddVertexBuffer(ID3D12Device* const device, ID3D12Resource* const buffer,
+	const uint32_t numVertices, const uint32_t stride)
+{
+	BindlessResourceTable::Registration registration =
+		m_table.Register(BindlessResourceType::VertexBuffer, buffer->GetGPUVirtualAddress());
+	assert(registration.ID != BindlessResourceTable::invalidID);
+	if (registration.Created)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = numVertices;
+		srvDesc.Buffer.StructureByteStride = stride;
+		device->CreateShaderResourceView(buffer, &srvDesc, GetCPUDescriptorHandle(BindlessResourceType::VertexBuffer,
+			registration.ID));
+	}
+	return registration.ID;
+}
+
+uint32_t BindlessDescriptorTable::AddIndexBuffer(ID3D12Device* const device, ID3D12Resource* const buffer,
+	const uint32_t numIndices)
+{
+	BindlessResourceTable::Registration registration =
+		m_table.Register(BindlessResourceType::IndexBuffer, buffer->GetGPUVirtualAddress());
+	assert(registration.ID != BindlessResourceTable::invalidID);
+	if (registration.Created)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = DXGI_FORMAT_R32_UINT;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = numIndices;
+		device->CreateShaderResourceView(buffer, &srvDesc, GetCPUDescriptorHandle(BindlessResourceType::IndexBuffer,
+			registration.ID));
+	}
+	return registration.ID;
+}
+
+void BindlessDescriptorTable::Remove(const BindlessResourceType type, const uint32_t id, const uint64_t retireValue)
+{
+	m_table.Release(type, id, retireValue);
+}
+
+std::array<D3D12_DESCRIPTOR_RANGE, static_cast<uint32_t>(BindlessResourceType::Count)>
+	BindlessDescriptorTable::GetDescriptorRanges() const
+{
+	// Unbounded ranges may only be followed by ranges with explicit offsets, so every block is placed explicitly.
+	return { {
+		{ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, textureSpace,
+			m_table.GetDescriptorOffset(BindlessResourceType::Texture, 0) },
+		{ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, vertexBufferSpace,
+			m_table.GetDescriptorOffset(BindlessResourceType::VertexBuffer, 0) },
+		{ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, indexBufferSpace,
+			m_table.GetDescriptorOffset(BindlessResourceType::IndexBuffer, 0) } } };
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessDescriptorTable::GetCPUDescriptorHandle(const BindlessResourceType type,
+	const uint32_t id) const
+{
+	return m_heap->GetCPUDescriptorHandle(m_descriptors, m_table.GetDescriptorOffset(type, id));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "BindlessResourceTable.h"
+#include "DescriptorHeapAllocator.h"
+
+// Bindless SRVs living in one run of a shader visible heap. Shaders see textures, vertex buffers and index buffers as
+// unbounded arrays in register spaces 1, 2 and 3 and index them with the IDs returned here.
+class BindlessDescriptorTable
+{
+public:
+	static const uint32_t textureSpace = 1;
+	static const uint32_t vertexBufferSpace = 2;
+	static const uint32_t indexBufferSpace = 3;
+
+public:
+	void Initialize(DescriptorHeapAllocator* const heap, const uint32_t capacityPerType);
+	uint32_t AddTexture(ID3D12Device* const device, ID3D12Resource* const texture, const DXGI_FORMAT format);
+	uint32_t AddVertexBuffer(ID3D12Device* const device, ID3D12Resource* const buffer, const uint32_t numVertices,
+		const uint32_t stride);
+	// Index buffers are read as 32 bit indices.
+	uint32_t AddIndexBuffer(ID3D12Device* const device, ID3D12Resource* const buffer, const uint32_t numIndices);
+	void Remove(const BindlessResourceType type, const uint32_t id, const uint64_t retireValue);
+	void BeginFrame(const uint64_t completedValue) { m_table.Reclaim(completedValue); }
+	// One range per resource type, to be placed in a single descriptor table parameter.
+	std::array<D3D12_DESCRIPTOR_RANGE, static_cast<uint32_t>(BindlessResourceType::Count)> GetDescriptorRanges() const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandle() const { return m_heap->GetGPUDescriptorHandle(m_descriptors); }
+	const BindlessResourceTable& GetTable() const { return m_table; }
+
+private:
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(const BindlessResourceType type, const uint32_t id) const;
+
+private:
+	DescriptorHeapAllocator* m_heap = nullptr;
+	DescriptorHandle m_descriptors;
+	BindlessResourceTable m_table;
+};
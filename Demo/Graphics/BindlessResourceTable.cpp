@@ -0,0 +1,86 @@
+#include "stdafx.h"
+#include "BindlessResourceTable.h"
+
+void BindlessResourceTable::Initialize(const uint32_t capacityPerType)
+{
+	m_capacityPerType = capacityPerType;
+	for (auto& table : m_tables)
+	{
+		table.KeyToID.clear();
+		table.Keys.assign(capacityPerType, 0);
+		table.RefCounts.assign(capacityPerType, 0);
+		table.PendingReleases.clear();
+		table.NumRegistered = 0;
+
+		// Popped from the back, so the lowest IDs are handed out first.
+		table.FreeIDs.resize(capacityPerType);
+		for (uint32_t i = 0; i < capacityPerType; i++)
+		{
+			table.FreeIDs[i] = capacityPerType - 1 - i;
+		}
+	}
+}
+
+BindlessResourceTable::Registration BindlessResourceTable::Register(const BindlessResourceType type, const uint64_t key)
+{
+	TypeTable& table = m_tables[static_cast<uint32_t>(type)];
+	Registration registration;
+
+	auto existing = table.KeyToID.find(key);
+	if (existing != table.KeyToID.end())
+	{
+		registration.ID = existing->second;
+		table.RefCounts[registration.ID]++;
+		return registration;
+	}
+
+	if (table.FreeIDs.empty())
+		return registration;
+
+	registration.ID = table.FreeIDs.back();
+	registration.Created = true;
+	table.FreeIDs.pop_back();
+	table.KeyToID[key] = registration.ID;
+	table.Keys[registration.ID] = key;
+	table.RefCounts[registration.ID] = 1;
+	table.NumRegistered++;
+	return registration;
+}
+
+void BindlessResourceTable::Release(const BindlessResourceType type, const uint32_t id, const uint64_t retireValue)
+{
+	TypeTable& table = m_tables[static_cast<uint32_t>(type)];
+	assert(id < m_capacityPerType && table.RefCounts[id] > 0);
+	if (--table.RefCounts[id] > 0)
+		return;
+
+	// The key is forgotten now so the resource can be registered again, possibly under a different ID.
+	table.KeyToID.erase(table.Keys[id]);
+	table.NumRegistered--;
+	table.PendingReleases.push_back({ id, retireValue });
+}
+
+void BindlessResourceTable::Reclaim(const uint64_t completedValue)
+{
+	for (auto& table : m_tables)
+	{
+		auto retired = std::partition(table.PendingReleases.begin(), table.PendingReleases.end(),
+			[completedValue](const PendingRelease& pending) { return pending.RetireValue > completedValue; });
+		for (auto it = retired; it != table.PendingReleases.end(); it++)
+		{
+			table.FreeIDs.push_back(it->ID);
+		}
+		table.PendingReleases.erase(retired, table.PendingReleases.end());
+	}
+}
+
+uint32_t BindlessResourceTable::GetDescriptorOffset(const BindlessResourceType type, const uint32_t id) const
+{
+	assert(id < m_capacityPerType);
+	return static_cast<uint32_t>(type) * m_capacityPerType + id;
+}
+
+uint32_t BindlessResourceTable::GetNumRegistered(const BindlessResourceType type) const
+{
+	return m_tables[static_cast<uint32_t>(type)].NumRegistered;
+}
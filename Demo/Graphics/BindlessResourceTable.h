@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum class BindlessResourceType : uint32_t
+{
+	Texture = 0,
+	VertexBuffer,
+	IndexBuffer,
+	Count
+};
+
+// Assigns shader-visible IDs for the bindless descriptor table, independent of D3D. The table holds one block of
+// capacityPerType descriptors per resource type, in BindlessResourceType order, and an ID is an index into its type's
+// block. Resources are identified by a caller supplied key such as their GPU address, so registering the same resource
+// again returns the existing ID. Released IDs are only handed out again once the GPU has retired the value they were
+// released with.
+class BindlessResourceTable
+{
+public:
+	static const uint32_t invalidID = UINT32_MAX;
+
+	struct Registration
+	{
+		uint32_t ID = invalidID;
+		// True when the ID was newly assigned and its descriptor still has to be written.
+		bool Created = false;
+	};
+
+public:
+	void Initialize(const uint32_t capacityPerType);
+	Registration Register(const BindlessResourceType type, const uint64_t key);
+	void Release(const BindlessResourceType type, const uint32_t id, const uint64_t retireValue);
+	// Makes every ID released with a retire value no greater than completedValue available again.
+	void Reclaim(const uint64_t completedValue);
+	uint32_t GetDescriptorOffset(const BindlessResourceType type, const uint32_t id) const;
+	uint32_t GetCapacityPerType() const { return m_capacityPerType; }
+	uint32_t GetNumDescriptors() const { return m_capacityPerType * static_cast<uint32_t>(BindlessResourceType::Count); }
+	uint32_t GetNumRegistered(const BindlessResourceType type) const;
+
+private:
+	struct PendingRelease
+	{
+		uint32_t ID;
+		uint64_t RetireValue;
+	};
+
+	struct TypeTable
+	{
+		std::unordered_map<uint64_t, uint32_t> KeyToID;
+		std::vector<uint64_t> Keys;
+		std::vector<uint32_t> RefCounts;
+		std::vector<uint32_t> FreeIDs;
+		std::vector<PendingRelease> PendingReleases;
+		uint32_t NumRegistered = 0;
+	};
+
+	uint32_t m_capacityPerType = 0;
+	TypeTable m_tables[static_cast<uint32_t>(BindlessResourceType::Count)];
+};
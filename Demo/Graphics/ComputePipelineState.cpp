@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "ComputePipelineState.h"
+#include "RootSignature.h"
+#include "PipelineCache.h"
+#include "../Hash.h"
+
+void ComputePipelineState::SetRootSignature(const RootSignature& rootSignature)
+{
+	m_pipelineDesc.pRootSignature = rootSignature.GetInterfacePtr();
+	m_rootSignatureHash = rootSignature.GetHash();
+}
+
+void ComputePipelineState::SetComputeShader(const size_t bytecodeLength, const void* const pShaderBytecode)
+{
+	m_pipelineDesc.CS.BytecodeLength = bytecodeLength;
+	m_pipelineDesc.CS.pShaderBytecode = pShaderBytecode;
+	m_computeShaderHash = HashBytes(pShaderBytecode, bytecodeLength);
+}
+
+void ComputePipelineState::Create(ID3D12Device* const device, PipelineCache* const cache)
+{
+	uint64_t key = 0;
+	if (cache)
+	{
+		key = ComputeHash();
+		std::vector<uint8_t> cachedBlob;
+		if (cache->Load(key, cachedBlob))
+		{
+			m_pipelineDesc.CachedPSO.pCachedBlob = cachedBlob.data();
+			m_pipelineDesc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
+			HRESULT hr = device->CreateComputePipelineState(&m_pipelineDesc, IID_PPV_ARGS(&m_pipelineState));
+			m_pipelineDesc.CachedPSO = {};
+			if (SUCCEEDED(hr))
+				return;
+
+			cache->Remove(key);
+		}
+	}
+
+	HRESULT hr = device->CreateComputePipelineState(&m_pipelineDesc, IID_PPV_ARGS(&m_pipelineState));
+	assert(SUCCEEDED(hr));
+
+	if (cache)
+	{
+		ComPtr<ID3DBlob> blob;
+		hr = m_pipelineState->GetCachedBlob(&blob);
+		if (SUCCEEDED(hr))
+			cache->Store(key, blob->GetBufferPointer(), blob->GetBufferSize());
+	}
+}
+
+uint64_t ComputePipelineState::ComputeHash() const
+{
+	uint64_t hash = HashString("ComputePipelineState");
+	hash = HashValue(m_rootSignatureHash, hash);
+	hash = HashValue(m_computeShaderHash, hash);
+	hash = HashValue(m_pipelineDesc.NodeMask, hash);
+	hash = HashValue(m_pipelineDesc.Flags, hash);
+	return hash;
+}
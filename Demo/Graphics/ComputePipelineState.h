@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../stdafx.h"
+
+class RootSignature;
+class PipelineCache;
+
+class ComputePipelineState
+{
+public:
+	void SetRootSignature(const RootSignature& rootSignature);
+	void SetComputeShader(const size_t bytecodeLength, const void* const pShaderBytecode);
+	// Uses the cache the same way GraphicsPipelineState::Create does.
+	void Create(ID3D12Device* const device, PipelineCache* const cache = nullptr);
+	ID3D12PipelineState* Get() const { return m_pipelineState.Get(); }
+	// Hash of the full description, including the root signature and shader hashes.
+	uint64_t ComputeHash() const;
+
+private:
+	D3D12_COMPUTE_PIPELINE_STATE_DESC m_pipelineDesc = {};
+	uint64_t m_rootSignatureHash = 0;
+	uint64_t m_computeShaderHash = 0;
+	ComPtr<ID3D12PipelineState> m_pipelineState;
+};
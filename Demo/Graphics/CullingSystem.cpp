@@ -0,0 +1,357 @@
+#include "stdafx.h"
+#include "CullingSystem.h"
+
+#include <chrono>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+	const uint32_t simdWidth = 8;
+
+	double MillisecondsSince(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	Float4x4 LoadMatrix(const float* const matrix)
+	{
+		Float4x4 result;
+		memcpy(result.m, matrix, sizeof(result.m));
+		return result;
+	}
+}
+
+void CullingSystem::SetOccluderMesh(const uint32_t mesh, const void* const vertices, const uint32_t numVertices,
+	const uint32_t stride, const uint32_t* const indices, const uint32_t numIndices)
+{
+	assert(mesh != noOccluder);
+	if (mesh >= m_occluders.size())
+		m_occluders.resize(mesh + 1);
+
+	Occluder& occluder = m_occluders[mesh];
+	occluder.Positions.resize(numVertices * 3);
+	const uint8_t* const bytes = static_cast<const uint8_t*>(vertices);
+	for (uint32_t i = 0; i < numVertices; i++)
+		memcpy(&occluder.Positions[i * 3], bytes + static_cast<size_t>(i) * stride, sizeof(float) * 3);
+	occluder.Indices.assign(indices, indices + numIndices);
+}
+
+void CullingSystem::Cull(const float* const viewProjection, const std::vector<CullingObject>& objects,
+	const Settings& settings, std::vector<uint32_t>& visible, const bool allowSIMD)
+{
+	m_statistics = {};
+	m_statistics.NumObjects = static_cast<uint32_t>(objects.size());
+
+	const auto start = std::chrono::steady_clock::now();
+	CullFrustum(viewProjection, objects, m_frustumVisible, allowSIMD);
+	m_statistics.NumFrustumCulled = static_cast<uint32_t>(objects.size() - m_frustumVisible.size());
+	m_statistics.FrustumMilliseconds = MillisecondsSince(start);
+	CullOcclusion(viewProjection, objects, settings, visible);
+}
+
+void CullingSystem::Cull(const float* const viewProjection, const SceneBVH& bvh,
+	const std::vector<CullingObject>& objects, const Settings& settings, std::vector<uint32_t>& visible)
+{
+	m_statistics = {};
+	m_statistics.NumObjects = static_cast<uint32_t>(objects.size());
+
+	const auto start = std::chrono::steady_clock::now();
+	m_frustumVisible.clear();
+	bvh.QueryFrustum(viewProjection, m_frustumVisible);
+	std::sort(m_frustumVisible.begin(), m_frustumVisible.end());
+	m_statistics.NumFrustumCulled = static_cast<uint32_t>(objects.size() - m_frustumVisible.size());
+	m_statistics.FrustumMilliseconds = MillisecondsSince(start);
+	CullOcclusion(viewProjection, objects, settings, visible);
+}
+
+void CullingSystem::CullOcclusion(const float* const viewProjection, const std::vector<CullingObject>& objects,
+	const Settings& settings, std::vector<uint32_t>& visible)
+{
+	visible.clear();
+	if (!settings.OcclusionEnabled)
+	{
+		visible = m_frustumVisible;
+		return;
+	}
+
+	// the largest objects on screen occlude, nearest first among equals so the depth test rejects less
+	auto start = std::chrono::steady_clock::now();
+	const Float4x4 frustum = LoadMatrix(viewProjection);
+	std::vector<ScreenRect> rects(m_frustumVisible.size());
+	std::vector<bool> projected(m_frustumVisible.size());
+	std::vector<std::pair<float, uint32_t>> candidates;
+	for (uint32_t i = 0; i < m_frustumVisible.size(); i++)
+	{
+		const CullingObject& object = objects[m_frustumVisible[i]];
+		projected[i] = ProjectBounds(frustum, object.Bounds, rects[i]);
+		if (!projected[i] || object.OccluderMesh >= m_occluders.size() || !object.World)
+			continue;
+		const float area = (rects[i].MaxX - rects[i].MinX) * (rects[i].MaxY - rects[i].MinY) /
+			static_cast<float>(depthWidth * depthHeight);
+		if (area >= settings.MinOccluderArea)
+			candidates.push_back({ area, i });
+	}
+	std::sort(candidates.begin(), candidates.end(), [&rects](const auto& a, const auto& b)
+	{
+		return a.first != b.first ? a.first > b.first : rects[a.second].MinZ < rects[b.second].MinZ;
+	});
+	candidates.resize(std::min<size_t>(candidates.size(), settings.MaxOccluders));
+
+	m_depthLevels.resize(1);
+	m_depthLevels[0].assign(depthWidth * depthHeight, 1.f);
+	std::vector<bool> occluding(m_frustumVisible.size());
+	for (const auto& candidate : candidates)
+	{
+		const CullingObject& object = objects[m_frustumVisible[candidate.second]];
+		const Occluder& occluder = m_occluders[object.OccluderMesh];
+		RasterizeOccluder(occluder, Multiply(LoadMatrix(object.World), frustum));
+		occluding[candidate.second] = true;
+		m_statistics.NumOccluderTriangles += static_cast<uint32_t>(occluder.Indices.size() / 3);
+	}
+	m_statistics.NumOccluders = static_cast<uint32_t>(candidates.size());
+	BuildHierarchy();
+	m_statistics.RasterizeMilliseconds = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < m_frustumVisible.size(); i++)
+	{
+		if (occluding[i] || !projected[i] || !IsOccluded(rects[i]))
+			visible.push_back(m_frustumVisible[i]);
+	}
+	m_statistics.NumOcclusionCulled = static_cast<uint32_t>(m_frustumVisible.size() - visible.size());
+	m_statistics.OcclusionMilliseconds = MillisecondsSince(start);
+}
+
+// False when the box reaches behind the near plane, where it cannot be placed on screen. The rect is clamped to the
+// screen.
+bool CullingSystem::ProjectBounds(const Float4x4& viewProjection, const BoundingBox& box, ScreenRect& rect)
+{
+	rect = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, FLT_MAX };
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		float clip[4];
+		TransformPoint(viewProjection, corner & 1 ? box.Max.x : box.Min.x, corner & 2 ? box.Max.y : box.Min.y,
+			corner & 4 ? box.Max.z : box.Min.z, clip);
+		if (clip[2] < 0.f || clip[3] <= 0.f)
+			return false;
+		const float x = (clip[0] / clip[3] * 0.5f + 0.5f) * depthWidth;
+		const float y = (0.5f - clip[1] / clip[3] * 0.5f) * depthHeight;
+		rect.MinX = std::min(rect.MinX, x);
+		rect.MinY = std::min(rect.MinY, y);
+		rect.MaxX = std::max(rect.MaxX, x);
+		rect.MaxY = std::max(rect.MaxY, y);
+		rect.MinZ = std::min(rect.MinZ, clip[2] / clip[3]);
+	}
+	rect.MinX = std::max(rect.MinX, 0.f);
+	rect.MinY = std::max(rect.MinY, 0.f);
+	rect.MaxX = std::min(rect.MaxX, static_cast<float>(depthWidth));
+	rect.MaxY = std::min(rect.MaxY, static_cast<float>(depthHeight));
+	return rect.MinX < rect.MaxX && rect.MinY < rect.MaxY;
+}
+
+// A box is outside when its corner farthest along a plane's normal is still behind the plane. That corner's distance
+// is the sum over the axes of the larger of normal * min and normal * max, which needs no per-box branches.
+void CullingSystem::CullFrustum(const float* const viewProjection, const std::vector<CullingObject>& objects,
+	std::vector<uint32_t>& visible, const bool allowSIMD)
+{
+	// Clip space planes from the columns of the matrix: -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	std::array<std::array<float, 4>, 6> planes;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		const float x = viewProjection[i * 4];
+		const float y = viewProjection[i * 4 + 1];
+		const float z = viewProjection[i * 4 + 2];
+		const float w = viewProjection[i * 4 + 3];
+		planes[0][i] = w + x;
+		planes[1][i] = w - x;
+		planes[2][i] = w + y;
+		planes[3][i] = w - y;
+		planes[4][i] = z;
+		planes[5][i] = w - z;
+	}
+
+	const uint32_t count = static_cast<uint32_t>(objects.size());
+	const uint32_t paddedCount = (count + simdWidth - 1) / simdWidth * simdWidth;
+	for (std::vector<float>& component : m_bounds)
+		component.resize(paddedCount);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const BoundingBox& box = objects[i].Bounds;
+		m_bounds[0][i] = box.Min.x;
+		m_bounds[1][i] = box.Min.y;
+		m_bounds[2][i] = box.Min.z;
+		m_bounds[3][i] = box.Max.x;
+		m_bounds[4][i] = box.Max.y;
+		m_bounds[5][i] = box.Max.z;
+	}
+
+	visible.clear();
+	uint32_t first = 0;
+#if defined(__AVX2__)
+	if (allowSIMD)
+	{
+		for (; first < paddedCount; first += simdWidth)
+		{
+			const __m256 minX = _mm256_loadu_ps(&m_bounds[0][first]);
+			const __m256 minY = _mm256_loadu_ps(&m_bounds[1][first]);
+			const __m256 minZ = _mm256_loadu_ps(&m_bounds[2][first]);
+			const __m256 maxX = _mm256_loadu_ps(&m_bounds[3][first]);
+			const __m256 maxY = _mm256_loadu_ps(&m_bounds[4][first]);
+			const __m256 maxZ = _mm256_loadu_ps(&m_bounds[5][first]);
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (const std::array<float, 4>& plane : planes)
+			{
+				const __m256 a = _mm256_set1_ps(plane[0]);
+				const __m256 b = _mm256_set1_ps(plane[1]);
+				const __m256 c = _mm256_set1_ps(plane[2]);
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_max_ps(_mm256_mul_ps(a, minX), _mm256_mul_ps(a, maxX)),
+						_mm256_max_ps(_mm256_mul_ps(b, minY), _mm256_mul_ps(b, maxY))),
+					_mm256_max_ps(_mm256_mul_ps(c, minZ), _mm256_mul_ps(c, maxZ))),
+					_mm256_set1_ps(plane[3]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < simdWidth && first + lane < count; lane++)
+			{
+				if (mask & (1u << lane))
+					visible.push_back(first + lane);
+			}
+		}
+	}
+#endif
+	for (uint32_t i = first; i < count; i++)
+	{
+		bool inside = true;
+		for (const std::array<float, 4>& plane : planes)
+		{
+			const float distance = std::max(plane[0] * m_bounds[0][i], plane[0] * m_bounds[3][i]) +
+				std::max(plane[1] * m_bounds[1][i], plane[1] * m_bounds[4][i]) +
+				std::max(plane[2] * m_bounds[2][i], plane[2] * m_bounds[5][i]) + plane[3];
+			inside &= distance >= 0.f;
+		}
+		if (inside)
+			visible.push_back(i);
+	}
+}
+
+// Depth is tested at pixel centres and the nearest value kept. Both faces are drawn, and triangles that reach behind the
+// near plane are skipped rather than clipped: leaving out part of an occluder can only keep more objects, never hide
+// one that should be seen.
+void CullingSystem::RasterizeOccluder(const Occluder& occluder, const Float4x4& worldViewProjection)
+{
+	const uint32_t numVertices = static_cast<uint32_t>(occluder.Positions.size() / 3);
+	// screen x, y and depth, with depth below 0 marking vertices behind the near plane
+	std::vector<float> screen(numVertices * 3);
+	for (uint32_t i = 0; i < numVertices; i++)
+	{
+		float clip[4];
+		TransformPoint(worldViewProjection, occluder.Positions[i * 3], occluder.Positions[i * 3 + 1],
+			occluder.Positions[i * 3 + 2], clip);
+		if (clip[2] < 0.f || clip[3] <= 0.f)
+		{
+			screen[i * 3 + 2] = -1.f;
+			continue;
+		}
+		screen[i * 3] = (clip[0] / clip[3] * 0.5f + 0.5f) * depthWidth;
+		screen[i * 3 + 1] = (0.5f - clip[1] / clip[3] * 0.5f) * depthHeight;
+		screen[i * 3 + 2] = clip[2] / clip[3];
+	}
+
+	std::vector<float>& depth = m_depthLevels[0];
+	for (size_t triangle = 0; triangle + 2 < occluder.Indices.size(); triangle += 3)
+	{
+		const float* v0 = &screen[occluder.Indices[triangle] * 3];
+		const float* v1 = &screen[occluder.Indices[triangle + 1] * 3];
+		const float* v2 = &screen[occluder.Indices[triangle + 2] * 3];
+		if (v0[2] < 0.f || v1[2] < 0.f || v2[2] < 0.f)
+			continue;
+		float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+		if (area == 0.f)
+			continue;
+		if (area < 0.f)
+		{
+			std::swap(v1, v2);
+			area = -area;
+		}
+
+		const int minX = std::max(static_cast<int>(std::ceil(std::min({ v0[0], v1[0], v2[0] }) - 0.5f)), 0);
+		const int minY = std::max(static_cast<int>(std::ceil(std::min({ v0[1], v1[1], v2[1] }) - 0.5f)), 0);
+		const int maxX = std::min(static_cast<int>(std::floor(std::max({ v0[0], v1[0], v2[0] }) - 0.5f)),
+			static_cast<int>(depthWidth) - 1);
+		const int maxY = std::min(static_cast<int>(std::floor(std::max({ v0[1], v1[1], v2[1] }) - 0.5f)),
+			static_cast<int>(depthHeight) - 1);
+		const float inverseArea = 1.f / area;
+		for (int y = minY; y <= maxY; y++)
+		{
+			const float py = y + 0.5f;
+			for (int x = minX; x <= maxX; x++)
+			{
+				const float px = x + 0.5f;
+				const float w0 = (v2[0] - v1[0]) * (py - v1[1]) - (v2[1] - v1[1]) * (px - v1[0]);
+				const float w1 = (v0[0] - v2[0]) * (py - v2[1]) - (v0[1] - v2[1]) * (px - v2[0]);
+				const float w2 = (v1[0] - v0[0]) * (py - v0[1]) - (v1[1] - v0[1]) * (px - v0[0]);
+				if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+					continue;
+				const float z = (w0 * v0[2] + w1 * v1[2] + w2 * v2[2]) * inverseArea;
+				float& texel = depth[y * depthWidth + x];
+				texel = std::min(texel, z);
+			}
+		}
+	}
+}
+
+void CullingSystem::BuildHierarchy()
+{
+	uint32_t width = depthWidth;
+	uint32_t height = depthHeight;
+	while (width > 1 || height > 1)
+	{
+		const uint32_t nextWidth = std::max(width / 2, 1u);
+		const uint32_t nextHeight = std::max(height / 2, 1u);
+		const std::vector<float>& source = m_depthLevels.back();
+		std::vector<float> level(nextWidth * nextHeight);
+		for (uint32_t y = 0; y < nextHeight; y++)
+		{
+			const uint32_t y0 = std::min(y * 2, height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < nextWidth; x++)
+			{
+				const uint32_t x0 = std::min(x * 2, width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				level[y * nextWidth + x] = std::max({ source[y0 * width + x0], source[y0 * width + x1],
+					source[y1 * width + x0], source[y1 * width + x1] });
+			}
+		}
+		m_depthLevels.push_back(std::move(level));
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+// Reads the coarsest level at which the rect spans at most two texels each way, so any object costs at most four reads.
+bool CullingSystem::IsOccluded(const ScreenRect& rect) const
+{
+	const uint32_t minX = std::min(static_cast<uint32_t>(rect.MinX), depthWidth - 1);
+	const uint32_t minY = std::min(static_cast<uint32_t>(rect.MinY), depthHeight - 1);
+	const uint32_t maxX = std::min(static_cast<uint32_t>(rect.MaxX), depthWidth - 1);
+	const uint32_t maxY = std::min(static_cast<uint32_t>(rect.MaxY), depthHeight - 1);
+	uint32_t level = 0;
+	while (level + 1 < m_depthLevels.size() && ((maxX >> level) - (minX >> level) > 1 ||
+		(maxY >> level) - (minY >> level) > 1))
+	{
+		level++;
+	}
+
+	const uint32_t width = std::max(depthWidth >> level, 1u);
+	const uint32_t height = std::max(depthHeight >> level, 1u);
+	float farthest = 0.f;
+	for (uint32_t y = minY >> level; y <= std::min(maxY >> level, height - 1); y++)
+	{
+		for (uint32_t x = minX >> level; x <= std::min(maxX >> level, width - 1); x++)
+			farthest = std::max(farthest, m_depthLevels[level][y * width + x]);
+	}
+	return rect.MinZ > farthest;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Float4x4.h"
+#include "SceneBVH.h"
+
+// An object to cull. Objects with an occluder mesh may hide others: that mesh, placed by the row major world matrix, is
+// what gets drawn into the depth buffer.
+struct CullingObject
+{
+	BoundingBox Bounds;
+	const float* World = nullptr;
+	uint32_t OccluderMesh = UINT32_MAX;
+};
+
+// Picks the objects worth drawing in two stages. The frustum stage tests world bounds against the six planes of the view
+// projection, eight boxes at a time when built with AVX2. The occlusion stage rasterizes the largest objects that passed
+// into a small depth buffer, reduces it to a hierarchy of farthest depths and drops the objects whose bounds lie behind
+// it everywhere they cover. Occluders themselves, and objects whose bounds reach behind the near plane, are always kept.
+class CullingSystem
+{
+public:
+	static const uint32_t depthWidth = 256;
+	static const uint32_t depthHeight = 128;
+	static const uint32_t noOccluder = UINT32_MAX;
+
+	struct Settings
+	{
+		bool OcclusionEnabled = true;
+		// share of the screen an object's projected bounds must cover for it to be drawn as an occluder
+		float MinOccluderArea = 0.02f;
+		uint32_t MaxOccluders = 16;
+	};
+
+	struct Statistics
+	{
+		uint32_t NumObjects = 0;
+		uint32_t NumFrustumCulled = 0;
+		uint32_t NumOcclusionCulled = 0;
+		uint32_t NumOccluders = 0;
+		uint32_t NumOccluderTriangles = 0;
+		double FrustumMilliseconds = 0.0;
+		// includes projecting the bounds of every object that passed the frustum stage
+		double RasterizeMilliseconds = 0.0;
+		double OcclusionMilliseconds = 0.0;
+	};
+
+public:
+	// Positions are the first three floats of each vertex, stride bytes apart. Replaces any mesh set before with the ID.
+	void SetOccluderMesh(const uint32_t mesh, const void* const vertices, const uint32_t numVertices,
+		const uint32_t stride, const uint32_t* const indices, const uint32_t numIndices);
+	// Sets visible to the indices of the objects that pass both stages, in increasing order. viewProjection is a row
+	// major 4x4 matrix laid out like XMFLOAT4X4, with D3D clip space.
+	void Cull(const float* const viewProjection, const std::vector<CullingObject>& objects, const Settings& settings,
+		std::vector<uint32_t>& visible, const bool allowSIMD = true);
+	// The same, with the frustum stage answered by a query of bvh, which must be built over the objects' bounds, so
+	// subtrees wholly outside or inside the frustum are settled without testing their boxes one by one.
+	void Cull(const float* const viewProjection, const SceneBVH& bvh, const std::vector<CullingObject>& objects,
+		const Settings& settings, std::vector<uint32_t>& visible);
+
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	struct Occluder
+	{
+		std::vector<float> Positions;
+		std::vector<uint32_t> Indices;
+	};
+
+	// In depth buffer pixels, y down, and the nearest depth of the box.
+	struct ScreenRect
+	{
+		float MinX;
+		float MinY;
+		float MaxX;
+		float MaxY;
+		float MinZ;
+	};
+
+	static bool ProjectBounds(const Float4x4& viewProjection, const BoundingBox& box, ScreenRect& rect);
+	void CullFrustum(const float* const viewProjection, const std::vector<CullingObject>& objects,
+		std::vector<uint32_t>& visible, const bool allowSIMD);
+	// The occlusion stage, over the objects that passed the frustum stage.
+	void CullOcclusion(const float* const viewProjection, const std::vector<CullingObject>& objects,
+		const Settings& settings, std::vector<uint32_t>& visible);
+	void RasterizeOccluder(const Occluder& occluder, const Float4x4& worldViewProjection);
+	void BuildHierarchy();
+	bool IsOccluded(const ScreenRect& rect) const;
+
+private:
+	std::vector<Occluder> m_occluders;
+	// min x, y, z then max x, y, z of every object, padded to a whole number of SIMD blocks
+	std::array<std::vector<float>, 6> m_bounds;
+	// level 0 is depthWidth x depthHeight, each level after holds the farthest depth of 2x2 texels of the one before
+	std::vector<std::vector<float>> m_depthLevels;
+	std::vector<uint32_t> m_frustumVisible;
+	Statistics m_statistics;
+};
@@ -0,0 +1,522 @@
+#include "stdafx.h"
+#include "D3D12RenderBackend.h"
+#include "Direct3DStatics.h"
+#include "InputLayout.h"
+#include "RootSignature.h"
+#include "GraphicsPipelineState.h"
+#include "ComputePipelineState.h"
+#include "Shader.h"
+#include "ShaderPermutation.h"
+#include "BottomLevelAccelerationStructure.h"
+#include "TopLevelAccelerationStructure.h"
+
+#include <DirectXPackedVector.h>
+
+namespace
+{
+	const uint32_t numFrameConstants = sizeof(FrameConstants) / sizeof(uint32_t);
+	// matches numthreads in RenderBackend.hlsl
+	const uint32_t computeGroupSize = 8;
+}
+
+class D3D12RenderBackend::CommandList : public RenderCommandList
+{
+public:
+	CommandList(D3D12RenderBackend* const backend, ID3D12GraphicsCommandList4* const commandList)
+		: m_backend(backend), m_commandList(commandList) {}
+
+	void ClearTexture(const TextureHandle texture, const float* const value) override
+	{
+		Texture& target = m_backend->m_textures[texture.ID - 1];
+		if (target.Format == TextureFormat::Depth32)
+		{
+			m_backend->Transition(m_commandList, target, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+			m_commandList->ClearDepthStencilView(m_backend->m_dsvHeap.GetCPUDescriptorHandle(target.DescriptorIndex),
+				D3D12_CLEAR_FLAG_DEPTH, value[0], 0, 0, nullptr);
+		}
+		else
+		{
+			m_backend->Transition(m_commandList, target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+			m_commandList->ClearRenderTargetView(m_backend->m_rtvHeap.GetCPUDescriptorHandle(target.DescriptorIndex),
+				value, 0, nullptr);
+		}
+	}
+
+	void BeginRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) override
+	{
+		m_backend->Transition(m_commandList, m_backend->m_textures[color.ID - 1], D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_backend->Transition(m_commandList, m_backend->m_textures[surface.ID - 1], D3D12_RESOURCE_STATE_RENDER_TARGET);
+		m_backend->Transition(m_commandList, m_backend->m_textures[depth.ID - 1], D3D12_RESOURCE_STATE_DEPTH_WRITE);
+		ResumeRasterPass(color, surface, depth, constants);
+	}
+
+	// Only reads the textures, so any number of lists can resume the same pass at once.
+	void ResumeRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) override
+	{
+		const Texture& colorTarget = m_backend->m_textures[color.ID - 1];
+		const Texture& surfaceTarget = m_backend->m_textures[surface.ID - 1];
+		const Texture& depthTarget = m_backend->m_textures[depth.ID - 1];
+		const D3D12_CPU_DESCRIPTOR_HANDLE renderTargets[2] = {
+			m_backend->m_rtvHeap.GetCPUDescriptorHandle(colorTarget.DescriptorIndex),
+			m_backend->m_rtvHeap.GetCPUDescriptorHandle(surfaceTarget.DescriptorIndex) };
+		const D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = m_backend->m_dsvHeap.GetCPUDescriptorHandle(depthTarget.DescriptorIndex);
+		m_commandList->OMSetRenderTargets(2, renderTargets, FALSE, &depthStencil);
+
+		const CD3DX12_VIEWPORT viewport(0.f, 0.f, static_cast<float>(depthTarget.Width),
+			static_cast<float>(depthTarget.Height));
+		const CD3DX12_RECT scissorRect(0, 0, static_cast<LONG>(depthTarget.Width), static_cast<LONG>(depthTarget.Height));
+		m_commandList->RSSetViewports(1, &viewport);
+		m_commandList->RSSetScissorRects(1, &scissorRect);
+		m_commandList->SetPipelineState(m_backend->m_rasterPipeline->Get());
+		m_commandList->SetGraphicsRootSignature(m_backend->m_rasterRootSignature->GetInterfacePtr());
+		m_commandList->SetGraphicsRoot32BitConstants(0, numFrameConstants, &constants, 0);
+		m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+
+	void DrawIndexedInstanced(const DrawDesc& draw) override
+	{
+		const Buffer& vertexBuffer = m_backend->m_buffers[draw.VertexBuffer.ID - 1];
+		const Buffer& indexBuffer = m_backend->m_buffers[draw.IndexBuffer.ID - 1];
+		const Buffer& instanceBuffer = m_backend->m_buffers[draw.InstanceBuffer.ID - 1];
+
+		D3D12_VERTEX_BUFFER_VIEW vertexBufferView = {};
+		vertexBufferView.BufferLocation = vertexBuffer.Resource->GetGPUVirtualAddress();
+		vertexBufferView.SizeInBytes = static_cast<UINT>(vertexBuffer.Size);
+		vertexBufferView.StrideInBytes = sizeof(RenderVertex);
+		D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
+		indexBufferView.BufferLocation = indexBuffer.Resource->GetGPUVirtualAddress();
+		indexBufferView.SizeInBytes = static_cast<UINT>(indexBuffer.Size);
+		indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+
+		m_commandList->SetGraphicsRoot32BitConstant(1, draw.FirstInstance, 0);
+		m_commandList->SetGraphicsRootShaderResourceView(2, instanceBuffer.Resource->GetGPUVirtualAddress());
+		m_commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+		m_commandList->IASetIndexBuffer(&indexBufferView);
+		m_commandList->DrawIndexedInstanced(draw.IndexCount, draw.InstanceCount, 0, 0, 0);
+	}
+
+	void EndRasterPass() override {}
+
+	void BuildAccelerationStructure(const AccelerationStructureHandle accelerationStructure) override
+	{
+		TopLevelAccelerationStructure* const topLevel = m_backend->m_accelerationStructures[accelerationStructure.ID - 1].Top.get();
+		assert(topLevel);
+		topLevel->Commit(m_commandList);
+	}
+
+	void TraceShadows(const AccelerationStructureHandle scene, const TextureHandle surface, const TextureHandle output,
+		const FrameConstants& constants) override
+	{
+		const TopLevelAccelerationStructure* const topLevel = m_backend->m_accelerationStructures[scene.ID - 1].Top.get();
+		assert(topLevel);
+		const uint32_t textureIndices[3] = { TextureIndex(surface), 0, TextureIndex(output) };
+		m_commandList->SetPipelineState(m_backend->m_shadowPipeline->Get());
+		m_commandList->SetComputeRoot32BitConstants(0, numFrameConstants, &constants, 0);
+		m_commandList->SetComputeRootShaderResourceView(2, topLevel->GetGPUVirtualAddress());
+		Dispatch(textureIndices, m_backend->m_textures[output.ID - 1]);
+	}
+
+	void Composite(const TextureHandle color, const TextureHandle shadow, const TextureHandle output) override
+	{
+		const uint32_t textureIndices[3] = { TextureIndex(color), TextureIndex(shadow), TextureIndex(output) };
+		m_commandList->SetPipelineState(m_backend->m_compositePipeline->Get());
+		Dispatch(textureIndices, m_backend->m_textures[output.ID - 1]);
+	}
+
+private:
+	// moves the texture to unordered access and returns its index in the UAV heap
+	uint32_t TextureIndex(const TextureHandle texture)
+	{
+		Texture& target = m_backend->m_textures[texture.ID - 1];
+		assert(target.Format != TextureFormat::Depth32);
+		m_backend->Transition(m_commandList, target, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		return target.DescriptorIndex;
+	}
+
+	void Dispatch(const uint32_t* const textureIndices, const Texture& output)
+	{
+		m_commandList->SetComputeRootSignature(m_backend->m_computeRootSignature->GetInterfacePtr());
+		m_commandList->SetComputeRoot32BitConstants(1, 3, textureIndices, 0);
+		m_commandList->SetComputeRootDescriptorTable(3, m_backend->m_uavHeap.GetGPUDescriptorHandleForHeapStart());
+		m_commandList->Dispatch((output.Width + computeGroupSize - 1) / computeGroupSize,
+			(output.Height + computeGroupSize - 1) / computeGroupSize, 1);
+		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+	}
+
+private:
+	D3D12RenderBackend* m_backend = nullptr;
+	ID3D12GraphicsCommandList4* m_commandList = nullptr;
+};
+
+D3D12RenderBackend::D3D12RenderBackend() = default;
+
+D3D12RenderBackend::~D3D12RenderBackend()
+{
+	if (m_device)
+	{
+		WaitForFence(m_fence.Value());
+		CloseHandle(m_fenceEvent);
+	}
+}
+
+void D3D12RenderBackend::Initialize()
+{
+	m_adapter = Direct3D::GetHardwareAdapter(true);
+	m_device = Direct3D::CreateDevice(m_adapter.Get());
+	assert(m_device);
+
+	// inline raytracing needs tier 1.1
+	D3D12_FEATURE_DATA_D3D12_OPTIONS5 options5 = {};
+	HRESULT hr = m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS5, &options5, sizeof(options5));
+	assert(SUCCEEDED(hr) && options5.RaytracingTier >= D3D12_RAYTRACING_TIER_1_1);
+
+	m_queue = Direct3D::CreateCommandQueue(m_device.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT);
+	m_fence.Initialize(m_device.Get(), 0, D3D12_FENCE_FLAG_NONE);
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	assert(m_fenceEvent != nullptr);
+
+	m_rtvHeap.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, maxTextures, false);
+	m_dsvHeap.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, maxTextures, false);
+	m_uavHeap.Initialize(m_device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, maxTextures, true);
+
+	CreatePipelines();
+}
+
+void D3D12RenderBackend::CreatePipelines()
+{
+	m_inputLayout = std::make_unique<InputLayout>();
+	m_inputLayout->AddInputElement("POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(RenderVertex, Position),
+		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
+	m_inputLayout->AddInputElement("NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(RenderVertex, Normal),
+		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
+	m_inputLayout->AddInputElement("TEXTURECOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(RenderVertex, UV),
+		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
+	m_inputLayout->Create();
+
+	// Frame constants go in as root constants, so the backend needs no constant buffer ring.
+	m_rasterRootSignature = std::make_unique<RootSignature>();
+	m_rasterRootSignature->AddRootConstantsParameter(numFrameConstants, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	m_rasterRootSignature->AddRootConstantsParameter(1, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	m_rasterRootSignature->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	m_rasterRootSignature->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	m_rasterRootSignature->Create(m_device.Get());
+
+	ShaderPermutationSet rasterFeatures;
+	rasterFeatures.LoadFeatures("ShaderSource/Shaders.hlsl");
+	Shader vertexShader;
+	vertexShader.FXCCompile(L"ShaderSource/Shaders.hlsl", "vertex", "vs_5_1");
+	Shader pixelShader;
+	pixelShader.FXCCompile(L"ShaderSource/Shaders.hlsl", "pixel", "ps_5_1", nullptr,
+		rasterFeatures.GetDefines(rasterFeatures.GetFeatureBit("LIGHTING")));
+
+	m_rasterPipeline = std::make_unique<GraphicsPipelineState>();
+	m_rasterPipeline->SetInputLayout(m_inputLayout->GetInterfacePtr());
+	m_rasterPipeline->SetRootSignature(*m_rasterRootSignature);
+	m_rasterPipeline->SetVertexShader(vertexShader.BufferLength(), vertexShader.BufferPointer());
+	m_rasterPipeline->SetPixelShader(pixelShader.BufferLength(), pixelShader.BufferPointer());
+	m_rasterPipeline->SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+	m_rasterPipeline->SetRTVFormats(1, GetFormat(TextureFormat::RGBA8));
+	m_rasterPipeline->SetRTVFormat(1, GetFormat(TextureFormat::RGBA16Float));
+	m_rasterPipeline->SetDSVFormat(GetFormat(TextureFormat::Depth32));
+	m_rasterPipeline->SetSampleDesc({ 1, 0 });
+	m_rasterPipeline->SetSampleMask(0xffffffff);
+	m_rasterPipeline->SetRasterizerState(RasterizerState::BackCulling);
+	m_rasterPipeline->SetDepthStencilState(DepthStencilState::Default);
+	m_rasterPipeline->SetBlendState(BlendState::Opaque);
+	m_rasterPipeline->SetNumRenderTargets(2);
+	m_rasterPipeline->Create(m_device.Get());
+
+	// frame constants, texture indices, the scene and every texture's UAV
+	m_computeRootSignature = std::make_unique<RootSignature>();
+	m_computeRootSignature->AddRootConstantsParameter(numFrameConstants, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	m_computeRootSignature->AddRootConstantsParameter(3, 1, 0, D3D12_SHADER_VISIBILITY_ALL);
+	m_computeRootSignature->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	m_computeRootSignature->AddRootDescriptorTableParameter({
+		{D3D12_DESCRIPTOR_RANGE_TYPE_UAV, maxTextures, 0, 1, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
+		}, D3D12_SHADER_VISIBILITY_ALL);
+	m_computeRootSignature->Create(m_device.Get());
+
+	Shader shadowShader;
+	shadowShader.DXCCompile(L"ShaderSource/RenderBackend.hlsl", L"shadows", L"cs_6_5");
+	m_shadowPipeline = std::make_unique<ComputePipelineState>();
+	m_shadowPipeline->SetRootSignature(*m_computeRootSignature);
+	m_shadowPipeline->SetComputeShader(shadowShader.BufferLength(), shadowShader.BufferPointer());
+	m_shadowPipeline->Create(m_device.Get());
+
+	Shader compositeShader;
+	compositeShader.DXCCompile(L"ShaderSource/RenderBackend.hlsl", L"composite", L"cs_6_5");
+	m_compositePipeline = std::make_unique<ComputePipelineState>();
+	m_compositePipeline->SetRootSignature(*m_computeRootSignature);
+	m_compositePipeline->SetComputeShader(compositeShader.BufferLength(), compositeShader.BufferPointer());
+	m_compositePipeline->Create(m_device.Get());
+}
+
+BufferHandle D3D12RenderBackend::CreateBuffer(const BufferUsage usage, const size_t size)
+{
+	Buffer buffer;
+	buffer.Size = size;
+	HRESULT hr = m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(std::max(size, size_t(1))),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer.Resource));
+	assert(SUCCEEDED(hr));
+	hr = buffer.Resource->Map(0, nullptr, reinterpret_cast<void**>(&buffer.CPUAddress));
+	assert(SUCCEEDED(hr));
+
+	m_buffers.push_back(std::move(buffer));
+	return { static_cast<uint32_t>(m_buffers.size()) };
+}
+
+void D3D12RenderBackend::WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data,
+	const size_t size)
+{
+	Buffer& destination = m_buffers[buffer.ID - 1];
+	assert(offset + size <= destination.Size);
+	memcpy(destination.CPUAddress + offset, data, size);
+}
+
+TextureHandle D3D12RenderBackend::CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height)
+{
+	Texture texture;
+	texture.Format = format;
+	texture.Width = width;
+	texture.Height = height;
+
+	const bool isDepth = format == TextureFormat::Depth32;
+	const D3D12_RESOURCE_FLAGS flags = isDepth ? D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL :
+		D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	HRESULT hr = m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(GetFormat(format), width, height, 1, 1, 1, 0, flags),
+		texture.State,
+		nullptr,
+		IID_PPV_ARGS(&texture.Resource));
+	assert(SUCCEEDED(hr));
+
+	if (isDepth)
+	{
+		assert(m_numDepthTextures < maxTextures);
+		texture.DescriptorIndex = m_numDepthTextures++;
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = GetFormat(format);
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		m_device->CreateDepthStencilView(texture.Resource.Get(), &dsvDesc,
+			m_dsvHeap.GetCPUDescriptorHandle(texture.DescriptorIndex));
+	}
+	else
+	{
+		assert(m_numColorTextures < maxTextures);
+		texture.DescriptorIndex = m_numColorTextures++;
+		m_device->CreateRenderTargetView(texture.Resource.Get(), nullptr,
+			m_rtvHeap.GetCPUDescriptorHandle(texture.DescriptorIndex));
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = GetFormat(format);
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+		m_device->CreateUnorderedAccessView(texture.Resource.Get(), nullptr, &uavDesc,
+			m_uavHeap.GetCPUDescriptorHandle(texture.DescriptorIndex));
+	}
+
+	m_textures.push_back(std::move(texture));
+	return { static_cast<uint32_t>(m_textures.size()) };
+}
+
+void D3D12RenderBackend::ReadTexture(const TextureHandle texture, std::vector<float>& rgba)
+{
+	Texture& source = m_textures[texture.ID - 1];
+	const D3D12_RESOURCE_DESC desc = source.Resource->GetDesc();
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+	UINT64 totalSize = 0;
+	m_device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, nullptr, nullptr, &totalSize);
+
+	ComPtr<ID3D12Resource> readback;
+	HRESULT hr = m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(totalSize),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&readback));
+	assert(SUCCEEDED(hr));
+
+	ID3D12GraphicsCommandList4* const commandList = BeginInternalCommandList();
+	Transition(commandList, source, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	commandList->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(readback.Get(), footprint), 0, 0, 0,
+		&CD3DX12_TEXTURE_COPY_LOCATION(source.Resource.Get(), 0), nullptr);
+	WaitForFence(Submit());
+
+	const uint8_t* data = nullptr;
+	hr = readback->Map(0, &CD3DX12_RANGE(0, static_cast<SIZE_T>(totalSize)), reinterpret_cast<void**>(&data));
+	assert(SUCCEEDED(hr));
+	rgba.assign(static_cast<size_t>(source.Width) * source.Height * 4, 0.f);
+	for (uint32_t y = 0; y < source.Height; y++)
+	{
+		const uint8_t* const row = data + footprint.Offset + static_cast<size_t>(y) * footprint.Footprint.RowPitch;
+		for (uint32_t x = 0; x < source.Width; x++)
+		{
+			float* const texel = &rgba[(static_cast<size_t>(y) * source.Width + x) * 4];
+			switch (source.Format)
+			{
+			case TextureFormat::RGBA8:
+				for (uint32_t channel = 0; channel < 4; channel++)
+					texel[channel] = row[x * 4 + channel] / 255.f;
+				break;
+			case TextureFormat::RGBA16Float:
+				for (uint32_t channel = 0; channel < 4; channel++)
+				{
+					texel[channel] = PackedVector::XMConvertHalfToFloat(
+						reinterpret_cast<const PackedVector::HALF*>(row)[x * 4 + channel]);
+				}
+				break;
+			case TextureFormat::Depth32:
+				texel[0] = reinterpret_cast<const float*>(row)[x];
+				break;
+			}
+		}
+	}
+	readback->Unmap(0, &CD3DX12_RANGE(0, 0));
+}
+
+AccelerationStructureHandle D3D12RenderBackend::CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+	const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount)
+{
+	AccelerationStructure accelerationStructure;
+	accelerationStructure.Bottom = std::make_unique<BottomLevelAccelerationStructure>();
+	accelerationStructure.Bottom->Initialize(m_device.Get(), 1);
+	accelerationStructure.Bottom->AddStagedGeometry(m_buffers[vertexBuffer.ID - 1].Resource->GetGPUVirtualAddress(),
+		DXGI_FORMAT_R32G32B32_FLOAT, sizeof(RenderVertex), vertexCount,
+		m_buffers[indexBuffer.ID - 1].Resource->GetGPUVirtualAddress(), indexCount);
+	accelerationStructure.Bottom->BuildStaged(m_device.Get());
+
+	accelerationStructure.Bottom->CommitStaged(BeginInternalCommandList());
+	WaitForFence(Submit());
+
+	m_accelerationStructures.push_back(std::move(accelerationStructure));
+	return { static_cast<uint32_t>(m_accelerationStructures.size()) };
+}
+
+// Every build is a full rebuild, so instances may change meshes or be emptied from frame to frame.
+AccelerationStructureHandle D3D12RenderBackend::CreateTopLevelAccelerationStructure(const uint32_t maxInstances)
+{
+	AccelerationStructure accelerationStructure;
+	accelerationStructure.Top = std::make_unique<TopLevelAccelerationStructure>();
+	accelerationStructure.Top->Initialize(m_device.Get(), maxInstances, false);
+	const float identity[12] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+	for (uint32_t i = 0; i < maxInstances; i++)
+	{
+		accelerationStructure.Top->SetInstance(i, 0, identity, 0, D3D12_RAYTRACING_INSTANCE_FLAG_NONE, 0);
+	}
+	accelerationStructure.Top->Stage(m_device.Get());
+
+	m_accelerationStructures.push_back(std::move(accelerationStructure));
+	return { static_cast<uint32_t>(m_accelerationStructures.size()) };
+}
+
+void D3D12RenderBackend::SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+	const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask)
+{
+	TopLevelAccelerationStructure* const scene = m_accelerationStructures[topLevel.ID - 1].Top.get();
+	assert(scene);
+	const D3D12_GPU_VIRTUAL_ADDRESS address = bottomLevel.IsValid() ?
+		m_accelerationStructures[bottomLevel.ID - 1].Bottom->GetGPUVirtualAddress() : 0;
+	scene->SetInstance(index, 0, transform, address ? mask : 0, D3D12_RAYTRACING_INSTANCE_FLAG_NONE, address);
+}
+
+RenderCommandList& D3D12RenderBackend::BeginCommandList()
+{
+	const uint64_t completedValue = GetCompletedFenceValue();
+	uint32_t allocator = static_cast<uint32_t>(m_allocators.size());
+	for (uint32_t i = 0; i < m_allocators.size(); i++)
+	{
+		if (m_allocators[i].FenceValue <= completedValue)
+		{
+			allocator = i;
+			break;
+		}
+	}
+	if (allocator == m_allocators.size())
+	{
+		m_allocators.push_back({ Direct3D::CreateCommandAllocator(m_device.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT), 0 });
+	}
+	// command lists can be reset as soon as they are submitted, so there are only as many as lists ever open at once
+	const uint32_t index = static_cast<uint32_t>(m_openLists.size());
+	assert(index < maxOpenCommandLists);
+	if (index == m_commandLists.size())
+	{
+		m_commandLists.push_back(Direct3D::CreateCommandList(m_device.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT,
+			m_allocators[allocator].Allocator.Get(), nullptr));
+	}
+
+	ID3D12CommandAllocator* const commandAllocator = m_allocators[allocator].Allocator.Get();
+	ID3D12GraphicsCommandList4* const commandList = m_commandLists[index].Get();
+	HRESULT hr = commandAllocator->Reset();
+	assert(SUCCEEDED(hr));
+	hr = commandList->Reset(commandAllocator, nullptr);
+	assert(SUCCEEDED(hr));
+	ID3D12DescriptorHeap* const heaps[] = { m_uavHeap.GetInterfacePtr() };
+	commandList->SetDescriptorHeaps(1, heaps);
+	m_allocators[allocator].FenceValue = UINT64_MAX;
+
+	m_openLists.push_back({ allocator, std::make_unique<CommandList>(this, commandList) });
+	return *m_openLists.back().Recorder;
+}
+
+uint64_t D3D12RenderBackend::Submit()
+{
+	assert(!m_openLists.empty());
+	ID3D12CommandList* commandLists[maxOpenCommandLists] = {};
+	for (uint32_t i = 0; i < m_openLists.size(); i++)
+	{
+		HRESULT hr = m_commandLists[i]->Close();
+		assert(SUCCEEDED(hr));
+		commandLists[i] = m_commandLists[i].Get();
+	}
+	m_queue->ExecuteCommandLists(static_cast<UINT>(m_openLists.size()), commandLists);
+	const uint64_t value = Direct3D::SignalFenceOnGPU(m_fence.GetInterfacePtr(), m_queue.Get(), m_fence.Value());
+	for (const OpenList& openList : m_openLists)
+		m_allocators[openList.Allocator].FenceValue = value;
+	m_openLists.clear();
+	return value;
+}
+
+uint64_t D3D12RenderBackend::GetCompletedFenceValue()
+{
+	return m_fence.GetInterfacePtr()->GetCompletedValue();
+}
+
+void D3D12RenderBackend::WaitForFence(const uint64_t value)
+{
+	Direct3D::WaitForFenceValueOnCPU(m_fence.GetInterfacePtr(), value, m_fenceEvent);
+}
+
+DXGI_FORMAT D3D12RenderBackend::GetFormat(const TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::RGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case TextureFormat::RGBA16Float: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case TextureFormat::Depth32: return DXGI_FORMAT_D32_FLOAT;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+// For the backend's own copies and builds, which are waited for before returning.
+ID3D12GraphicsCommandList4* D3D12RenderBackend::BeginInternalCommandList()
+{
+	assert(m_openLists.empty());
+	BeginCommandList();
+	return m_commandLists[0].Get();
+}
+
+// Lists that transition textures are recorded in submission order, so the tracked state is the state at the end of
+// everything recorded so far.
+void D3D12RenderBackend::Transition(ID3D12GraphicsCommandList4* const commandList, Texture& texture,
+	const D3D12_RESOURCE_STATES state)
+{
+	if (texture.State == state)
+		return;
+	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Resource.Get(), texture.State, state));
+	texture.State = state;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "RenderBackend.h"
+#include "DescriptorHeap.h"
+#include "Fence.h"
+
+class InputLayout;
+class RootSignature;
+class GraphicsPipelineState;
+class ComputePipelineState;
+class BottomLevelAccelerationStructure;
+class TopLevelAccelerationStructure;
+
+// Runs the RenderBackend reference frame on a D3D12 device of its own, without a window or swap chain. It shares no
+// pipelines with the windowed renderer in main.cpp. Draws use the lit, untextured permutation of Shaders.hlsl. Shadows
+// and the composite are compute shaders in RenderBackend.hlsl that trace with inline raytracing, so no shader table is
+// needed. Buffers live in upload heaps, which keeps WriteBuffer a copy into mapped memory at the cost of slower GPU
+// reads. Every open list has a D3D12 command list and allocator of its own, and Submit hands them all to one
+// ExecuteCommandLists.
+class D3D12RenderBackend : public RenderBackend
+{
+public:
+	static const uint32_t maxTextures = 64;
+	static const uint32_t maxOpenCommandLists = 64;
+
+public:
+	D3D12RenderBackend();
+	~D3D12RenderBackend() override;
+
+	void Initialize();
+
+	const char* GetName() const override { return "D3D12"; }
+
+	BufferHandle CreateBuffer(const BufferUsage usage, const size_t size) override;
+	void WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data, const size_t size) override;
+	TextureHandle CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height) override;
+	void ReadTexture(const TextureHandle texture, std::vector<float>& rgba) override;
+
+	AccelerationStructureHandle CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+		const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount) override;
+	AccelerationStructureHandle CreateTopLevelAccelerationStructure(const uint32_t maxInstances) override;
+	void SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+		const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask) override;
+
+	RenderCommandList& BeginCommandList() override;
+	uint64_t Submit() override;
+	uint64_t GetCompletedFenceValue() override;
+	void WaitForFence(const uint64_t value) override;
+
+private:
+	class CommandList;
+
+	struct Buffer
+	{
+		ComPtr<ID3D12Resource> Resource;
+		uint8_t* CPUAddress = nullptr;
+		size_t Size = 0;
+	};
+
+	// Color textures have a render target view and a UAV at the same index of their heaps, depth textures a depth
+	// stencil view.
+	struct Texture
+	{
+		ComPtr<ID3D12Resource> Resource;
+		TextureFormat Format = TextureFormat::RGBA8;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+		uint32_t DescriptorIndex = 0;
+	};
+
+	struct AccelerationStructure
+	{
+		std::unique_ptr<BottomLevelAccelerationStructure> Bottom;
+		std::unique_ptr<TopLevelAccelerationStructure> Top;
+	};
+
+	struct CommandAllocator
+	{
+		ComPtr<ID3D12CommandAllocator> Allocator;
+		// of the submit that last used it, or UINT64_MAX while a list is open on it
+		uint64_t FenceValue = 0;
+	};
+
+	// The i-th open list records into m_commandLists[i].
+	struct OpenList
+	{
+		uint32_t Allocator = 0;
+		std::unique_ptr<CommandList> Recorder;
+	};
+
+	static DXGI_FORMAT GetFormat(const TextureFormat format);
+	ID3D12GraphicsCommandList4* BeginInternalCommandList();
+	void Transition(ID3D12GraphicsCommandList4* const commandList, Texture& texture, const D3D12_RESOURCE_STATES state);
+	void CreatePipelines();
+
+private:
+	ComPtr<IDXGIAdapter1> m_adapter;
+	ComPtr<ID3D12Device5> m_device;
+	ComPtr<ID3D12CommandQueue> m_queue;
+	std::vector<ComPtr<ID3D12GraphicsCommandList4>> m_commandLists;
+	std::vector<CommandAllocator> m_allocators;
+	std::vector<OpenList> m_openLists;
+	Fence m_fence;
+	HANDLE m_fenceEvent = nullptr;
+
+	DescriptorHeap m_rtvHeap;
+	DescriptorHeap m_dsvHeap;
+	// shader visible, indexed by the shaders through root constants
+	DescriptorHeap m_uavHeap;
+	uint32_t m_numColorTextures = 0;
+	uint32_t m_numDepthTextures = 0;
+
+	std::unique_ptr<InputLayout> m_inputLayout;
+	std::unique_ptr<RootSignature> m_rasterRootSignature;
+	std::unique_ptr<RootSignature> m_computeRootSignature;
+	std::unique_ptr<GraphicsPipelineState> m_rasterPipeline;
+	std::unique_ptr<ComputePipelineState> m_shadowPipeline;
+	std::unique_ptr<ComputePipelineState> m_compositePipeline;
+
+	std::vector<Buffer> m_buffers;
+	std::vector<Texture> m_textures;
+	std::vector<AccelerationStructure> m_accelerationStructures;
+};
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "DescriptorAllocator.h"
+
+void DescriptorAllocator::Initialize(const uint32_t numPersistent, const uint32_t numTransientPerFrame, const uint32_t frameCount)
+{
+	assert(frameCount > 0);
+	m_numPersistent = numPersistent;
+	m_numTransientPerFrame = numTransientPerFrame;
+	m_frameCount = frameCount;
+	m_bitmap.assign((numPersistent + 63) / 64, 0);
+	m_generations.assign(numPersistent, 0);
+	m_runCounts.assign(numPersistent, 0);
+	m_pendingFrees.clear();
+	m_numAllocated = 0;
+	m_searchStart = 0;
+	m_frameIndex = 0;
+	m_transientUsed = 0;
+}
+
+DescriptorHandle DescriptorAllocator::Allocate(const uint32_t count)
+{
+	assert(count > 0);
+	DescriptorHandle handle;
+	if (count > m_numPersistent - m_numAllocated)
+		return handle;
+
+	// Search from where the last allocation ended first, then wrap around to the start.
+	uint32_t index = FindFreeRun(m_searchStart, m_numPersistent, count);
+	if (index == invalidIndex)
+		index = FindFreeRun(0, std::min(m_searchStart + count, m_numPersistent), count);
+	if (index == invalidIndex)
+		return handle;
+
+	SetRange(index, count, true);
+	m_runCounts[index] = count;
+	m_numAllocated += count;
+	m_searchStart = index + count < m_numPersistent ? index + count : 0;
+
+	handle.Index = index;
+	handle.Count = count;
+	handle.Generation = m_generations[index];
+	return handle;
+}
+
+void DescriptorAllocator::Free(const DescriptorHandle& handle, const uint64_t retireValue)
+{
+	assert(IsValid(handle));
+
+	// Invalidate the handle now, but keep the descriptors reserved until the GPU can no longer be reading them.
+	m_generations[handle.Index]++;
+	m_runCounts[handle.Index] = 0;
+	m_pendingFrees.push_back({ handle.Index, handle.Count, retireValue });
+}
+
+bool DescriptorAllocator::IsValid(const DescriptorHandle& handle) const
+{
+	if (handle.IsNull() || handle.Index >= m_numPersistent)
+		return false;
+
+	return m_generations[handle.Index] == handle.Generation && m_runCounts[handle.Index] == handle.Count &&
+		IsSet(handle.Index);
+}
+
+void DescriptorAllocator::Reclaim(const uint64_t completedValue)
+{
+	auto retired = std::partition(m_pendingFrees.begin(), m_pendingFrees.end(), [completedValue](const PendingFree& pending)
+	{
+		return pending.RetireValue > completedValue;
+	});
+	for (auto it = retired; it != m_pendingFrees.end(); it++)
+	{
+		SetRange(it->Index, it->Count, false);
+		m_numAllocated -= it->Count;
+		m_searchStart = std::min(m_searchStart, it->Index);
+	}
+	m_pendingFrees.erase(retired, m_pendingFrees.end());
+}
+
+void DescriptorAllocator::BeginFrame(const uint32_t frameIndex)
+{
+	assert(frameIndex < m_frameCount);
+	m_frameIndex = frameIndex;
+	m_transientUsed = 0;
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(const uint32_t count)
+{
+	if (m_transientUsed + count > m_numTransientPerFrame)
+		return invalidIndex;
+
+	const uint32_t index = m_numPersistent + m_frameIndex * m_numTransientPerFrame + m_transientUsed;
+	m_transientUsed += count;
+	return index;
+}
+
+uint32_t DescriptorAllocator::FindFreeRun(const uint32_t start, const uint32_t end, const uint32_t count) const
+{
+	uint32_t runStart = start;
+	uint32_t runLength = 0;
+	uint32_t index = start;
+	while (index < end)
+	{
+		const uint64_t word = m_bitmap[index / 64];
+		const uint32_t bit = index % 64;
+
+		// Whole words can be skipped or counted at once when they are completely full or completely empty.
+		if (bit == 0 && word == ~0ull)
+		{
+			index += 64;
+			runLength = 0;
+			runStart = index;
+			continue;
+		}
+		if (bit == 0 && word == 0 && index + 64 <= end)
+		{
+			runLength += 64;
+			index += 64;
+			if (runLength >= count)
+				return runStart;
+			continue;
+		}
+
+		if ((word >> bit) & 1)
+		{
+			runLength = 0;
+			runStart = index + 1;
+		}
+		else if (++runLength == count)
+		{
+			return runStart;
+		}
+		index++;
+	}
+
+	return invalidIndex;
+}
+
+void DescriptorAllocator::SetRange(const uint32_t index, const uint32_t count, const bool allocated)
+{
+	for (uint32_t i = index; i < index + count; i++)
+	{
+		const uint64_t mask = 1ull << (i % 64);
+		if (allocated)
+			m_bitmap[i / 64] |= mask;
+		else
+			m_bitmap[i / 64] &= ~mask;
+	}
+}
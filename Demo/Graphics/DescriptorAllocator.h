@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Refers to a contiguous run of persistent descriptors. The generation changes when the run is freed, so a handle kept after
+// its Free is detected as stale instead of silently aliasing whatever is allocated there next.
+struct DescriptorHandle
+{
+	uint32_t Index = UINT32_MAX;
+	uint32_t Count = 0;
+	uint32_t Generation = 0;
+
+	bool IsNull() const { return Index == UINT32_MAX; }
+};
+
+// Index bookkeeping for one descriptor heap, independent of D3D. The heap is split into a persistent region, handed out as
+// contiguous runs from an occupancy bitmap, followed by one transient segment per frame that is bump allocated and reset
+// wholesale when that frame begins again. Persistent frees are deferred until the GPU has retired the value they were freed
+// with, e.g. a fence value or frame number.
+class DescriptorAllocator
+{
+public:
+	static const uint32_t invalidIndex = UINT32_MAX;
+
+public:
+	void Initialize(const uint32_t numPersistent, const uint32_t numTransientPerFrame, const uint32_t frameCount);
+	// Returns a null handle when no run of count free descriptors exists.
+	DescriptorHandle Allocate(const uint32_t count);
+	void Free(const DescriptorHandle& handle, const uint64_t retireValue);
+	bool IsValid(const DescriptorHandle& handle) const;
+	// Releases every run freed with a retire value no greater than completedValue.
+	void Reclaim(const uint64_t completedValue);
+	void BeginFrame(const uint32_t frameIndex);
+	// Returns the heap index of count descriptors valid until this frame index begins again, or invalidIndex when the frame's
+	// segment is full.
+	uint32_t AllocateTransient(const uint32_t count);
+	uint32_t GetNumDescriptors() const { return m_numPersistent + m_numTransientPerFrame * m_frameCount; }
+	uint32_t GetNumPersistent() const { return m_numPersistent; }
+	uint32_t GetNumPersistentAllocated() const { return m_numAllocated; }
+	uint32_t GetNumPendingFrees() const { return static_cast<uint32_t>(m_pendingFrees.size()); }
+	uint32_t GetFrameTransientUsed() const { return m_transientUsed; }
+
+private:
+	uint32_t FindFreeRun(const uint32_t start, const uint32_t end, const uint32_t count) const;
+	bool IsSet(const uint32_t index) const { return (m_bitmap[index / 64] >> (index % 64)) & 1; }
+	void SetRange(const uint32_t index, const uint32_t count, const bool allocated);
+
+private:
+	struct PendingFree
+	{
+		uint32_t Index;
+		uint32_t Count;
+		uint64_t RetireValue;
+	};
+
+	uint32_t m_numPersistent = 0;
+	uint32_t m_numTransientPerFrame = 0;
+	uint32_t m_frameCount = 0;
+	std::vector<uint64_t> m_bitmap;
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_runCounts;
+	std::vector<PendingFree> m_pendingFrees;
+	uint32_t m_numAllocated = 0;
+	uint32_t m_searchStart = 0;
+	uint32_t m_frameIndex = 0;
+	uint32_t m_transientUsed = 0;
+};
@@ -0,0 +1,52 @@
+#include "stdafx.h"
+#include "DescriptorHeapAllocator.h"
+
+void DescriptorHeapAllocator::Initialize(ID3D12Device* const device, const D3D12_DESCRIPTOR_HEAP_TYPE type,
+	const uint32_t numPersistent, const uint32_t numTransientPerFrame, const uint32_t frameCount)
+{
+	m_allocator.Initialize(numPersistent, numTransientPerFrame, frameCount);
+	m_heap.Initialize(device, type, m_allocator.GetNumDescriptors(), true);
+}
+
+DescriptorHandle DescriptorHeapAllocator::Allocate(const uint32_t count)
+{
+	DescriptorHandle handle = m_allocator.Allocate(count);
+	assert(!handle.IsNull());
+	return handle;
+}
+
+void DescriptorHeapAllocator::Free(const DescriptorHandle& handle, const uint64_t retireValue)
+{
+	m_allocator.Free(handle, retireValue);
+}
+
+void DescriptorHeapAllocator::BeginFrame(const uint32_t frameIndex, const uint64_t completedValue)
+{
+	m_allocator.Reclaim(completedValue);
+	m_allocator.BeginFrame(frameIndex);
+}
+
+TransientDescriptors DescriptorHeapAllocator::AllocateTransient(const uint32_t count)
+{
+	const uint32_t index = m_allocator.AllocateTransient(count);
+	assert(index != DescriptorAllocator::invalidIndex);
+
+	TransientDescriptors descriptors;
+	descriptors.CPUHandle = m_heap.GetCPUDescriptorHandle(index);
+	descriptors.GPUHandle = m_heap.GetGPUDescriptorHandle(index);
+	return descriptors;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::GetCPUDescriptorHandle(const DescriptorHandle& handle,
+	const uint32_t offset) const
+{
+	assert(m_allocator.IsValid(handle) && offset < handle.Count);
+	return m_heap.GetCPUDescriptorHandle(handle.Index + offset);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::GetGPUDescriptorHandle(const DescriptorHandle& handle,
+	const uint32_t offset) const
+{
+	assert(m_allocator.IsValid(handle) && offset < handle.Count);
+	return m_heap.GetGPUDescriptorHandle(handle.Index + offset);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "DescriptorHeap.h"
+#include "DescriptorAllocator.h"
+
+struct TransientDescriptors
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE CPUHandle = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE GPUHandle = {};
+};
+
+// A shader visible descriptor heap whose slots are handed out by a DescriptorAllocator.
+class DescriptorHeapAllocator
+{
+public:
+	void Initialize(ID3D12Device* const device, const D3D12_DESCRIPTOR_HEAP_TYPE type, const uint32_t numPersistent,
+		const uint32_t numTransientPerFrame, const uint32_t frameCount);
+	DescriptorHandle Allocate(const uint32_t count);
+	void Free(const DescriptorHandle& handle, const uint64_t retireValue);
+	// completedValue is the highest retire value the GPU is known to be done with.
+	void BeginFrame(const uint32_t frameIndex, const uint64_t completedValue);
+	TransientDescriptors AllocateTransient(const uint32_t count);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(const DescriptorHandle& handle, const uint32_t offset = 0) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandle(const DescriptorHandle& handle, const uint32_t offset = 0) const;
+	ID3D12DescriptorHeap* GetInterfacePtr() const { return m_heap.GetInterfacePtr(); }
+	const DescriptorAllocator& GetAllocator() const { return m_allocator; }
+
+private:
+	DescriptorHeap m_heap;
+	DescriptorAllocator m_allocator;
+};
@@ -5,7 +5,9 @@
 void DynamicConstantBuffer::Initialize(ID3D12Device* const device, const size_t size, const uint32_t backBufferCount, 
 	const uint32_t numInstancesPerFrame)
 {
-	uint32_t bufferSize = static_cast<uint32_t>(size) * numInstancesPerFrame * backBufferCount;
+	m_instanceAlignedSize = ALIGN_TO(size, 256);
+	m_numInstancesPerBackBuffer = numInstancesPerFrame;
+	uint32_t bufferSize = m_instanceAlignedSize * numInstancesPerFrame * backBufferCount;
 	CD3DX12_RANGE readRange(0, 0);
 	HRESULT hr = device->CreateCommittedResource(
 		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
@@ -17,8 +19,6 @@ void DynamicConstantBuffer::Initialize(ID3D12Device* const device, const size_t
 	assert(SUCCEEDED(hr));
 	hr = m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_gpuAddressForHeapStart));
 	assert(SUCCEEDED(hr));
-	m_instanceAlignedSize = ALIGN_TO(size, 256);
-	m_numInstancesPerBackBuffer = numInstancesPerFrame;
 }
 
 void DynamicConstantBuffer::Update(const uint32_t backBufferIndex,
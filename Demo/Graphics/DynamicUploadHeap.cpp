@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "DynamicUploadHeap.h"
+
+void DynamicUploadHeap::Initialize(ID3D12Device* const device, const size_t pageSize, const uint32_t backBufferCount)
+{
+	m_device = device;
+	m_allocator.Initialize(pageSize, backBufferCount);
+}
+
+void DynamicUploadHeap::BeginFrame(const uint32_t backBufferIndex)
+{
+	m_allocator.BeginFrame(backBufferIndex);
+}
+
+DynamicAllocation DynamicUploadHeap::Allocate(const size_t size, const size_t alignment)
+{
+	FrameLinearAllocator::Allocation allocation = m_allocator.Allocate(size, alignment);
+	while (m_pages.size() < m_allocator.GetNumPages())
+	{
+		CreatePage(m_allocator.GetPageSize(static_cast<uint32_t>(m_pages.size())));
+	}
+
+	const Page& page = m_pages[allocation.Page];
+	DynamicAllocation result = {};
+	result.CPUAddress = page.CPUAddress + allocation.Offset;
+	result.GPUAddress = page.GPUAddress + allocation.Offset;
+	return result;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS DynamicUploadHeap::Upload(const void* const src, const size_t size, const size_t alignment)
+{
+	DynamicAllocation allocation = Allocate(size, alignment);
+	memcpy(allocation.CPUAddress, src, size);
+	return allocation.GPUAddress;
+}
+
+void DynamicUploadHeap::CreatePage(const size_t size)
+{
+	Page page = {};
+	CD3DX12_RANGE readRange(0, 0);
+	HRESULT hr = m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&page.Resource));
+	assert(SUCCEEDED(hr));
+	hr = page.Resource->Map(0, &readRange, reinterpret_cast<void**>(&page.CPUAddress));
+	assert(SUCCEEDED(hr));
+	page.GPUAddress = page.Resource->GetGPUVirtualAddress();
+	m_pages.push_back(page);
+}
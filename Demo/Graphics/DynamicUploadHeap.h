@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "FrameLinearAllocator.h"
+
+struct DynamicAllocation
+{
+	void* CPUAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPUAddress = 0;
+};
+
+// Persistently mapped upload memory sub-allocated linearly each frame. Replaces fixed per-instance slots so any number of
+// constant buffers of any size can be uploaded per frame.
+class DynamicUploadHeap
+{
+public:
+	void Initialize(ID3D12Device* const device, const size_t pageSize, const uint32_t backBufferCount);
+	void BeginFrame(const uint32_t backBufferIndex);
+	DynamicAllocation Allocate(const size_t size, const size_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	D3D12_GPU_VIRTUAL_ADDRESS Upload(const void* const src, const size_t size,
+		const size_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	size_t GetFrameUsedBytes() const { return m_allocator.GetFrameUsedBytes(); }
+
+private:
+	void CreatePage(const size_t size);
+
+private:
+	struct Page
+	{
+		ComPtr<ID3D12Resource> Resource;
+		uint8_t* CPUAddress = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GPUAddress = 0;
+	};
+
+	ComPtr<ID3D12Device> m_device;
+	FrameLinearAllocator m_allocator;
+	std::vector<Page> m_pages;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cmath>
+
+struct Float3
+{
+	float x = 0.f;
+	float y = 0.f;
+	float z = 0.f;
+};
+
+inline Float3 operator+(const Float3& a, const Float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(const Float3& a, const float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 Cross(const Float3& a, const Float3& b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+inline float Length(const Float3& a) { return std::sqrt(Dot(a, a)); }
+inline Float3 Normalize(const Float3& a) { return a * (1.f / Length(a)); }
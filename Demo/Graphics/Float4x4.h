@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cmath>
+#include "Float3.h"
+
+// Row major 4x4 matrix for row vectors, laid out like XMFLOAT4X4 and built the same way as the XMMatrix functions of the
+// same names, for code that has to run without DirectXMath.
+struct Float4x4
+{
+	float m[4][4] = {};
+};
+
+inline Float4x4 Identity4x4()
+{
+	Float4x4 result;
+	for (int i = 0; i < 4; i++)
+		result.m[i][i] = 1.f;
+	return result;
+}
+
+inline Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 result;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] +
+				a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+		}
+	}
+	return result;
+}
+
+inline void TransformPoint(const Float4x4& matrix, const float x, const float y, const float z, float* const output)
+{
+	for (int column = 0; column < 4; column++)
+	{
+		output[column] = x * matrix.m[0][column] + y * matrix.m[1][column] + z * matrix.m[2][column] + matrix.m[3][column];
+	}
+}
+
+inline Float4x4 LookAtLH(const Float3& eye, const Float3& focus, const Float3& up)
+{
+	const Float3 zAxis = Normalize(focus - eye);
+	const Float3 xAxis = Normalize(Cross(up, zAxis));
+	const Float3 yAxis = Cross(zAxis, xAxis);
+	Float4x4 result;
+	result.m[0][0] = xAxis.x; result.m[0][1] = yAxis.x; result.m[0][2] = zAxis.x;
+	result.m[1][0] = xAxis.y; result.m[1][1] = yAxis.y; result.m[1][2] = zAxis.y;
+	result.m[2][0] = xAxis.z; result.m[2][1] = yAxis.z; result.m[2][2] = zAxis.z;
+	result.m[3][0] = -Dot(xAxis, eye);
+	result.m[3][1] = -Dot(yAxis, eye);
+	result.m[3][2] = -Dot(zAxis, eye);
+	result.m[3][3] = 1.f;
+	return result;
+}
+
+inline Float4x4 PerspectiveFovLH(const float fovAngleY, const float aspectRatio, const float nearZ, const float farZ)
+{
+	const float height = 1.f / std::tan(fovAngleY * 0.5f);
+	const float range = farZ / (farZ - nearZ);
+	Float4x4 result;
+	result.m[0][0] = height / aspectRatio;
+	result.m[1][1] = height;
+	result.m[2][2] = range;
+	result.m[2][3] = 1.f;
+	result.m[3][2] = -range * nearZ;
+	return result;
+}
+
+// General inverse by cofactors. Returns the identity for singular matrices.
+inline Float4x4 Inverse(const Float4x4& a)
+{
+	const float* const s = &a.m[0][0];
+	float inv[16];
+	inv[0] = s[5] * s[10] * s[15] - s[5] * s[11] * s[14] - s[9] * s[6] * s[15] + s[9] * s[7] * s[14] +
+		s[13] * s[6] * s[11] - s[13] * s[7] * s[10];
+	inv[4] = -s[4] * s[10] * s[15] + s[4] * s[11] * s[14] + s[8] * s[6] * s[15] - s[8] * s[7] * s[14] -
+		s[12] * s[6] * s[11] + s[12] * s[7] * s[10];
+	inv[8] = s[4] * s[9] * s[15] - s[4] * s[11] * s[13] - s[8] * s[5] * s[15] + s[8] * s[7] * s[13] +
+		s[12] * s[5] * s[11] - s[12] * s[7] * s[9];
+	inv[12] = -s[4] * s[9] * s[14] + s[4] * s[10] * s[13] + s[8] * s[5] * s[14] - s[8] * s[6] * s[13] -
+		s[12] * s[5] * s[10] + s[12] * s[6] * s[9];
+	inv[1] = -s[1] * s[10] * s[15] + s[1] * s[11] * s[14] + s[9] * s[2] * s[15] - s[9] * s[3] * s[14] -
+		s[13] * s[2] * s[11] + s[13] * s[3] * s[10];
+	inv[5] = s[0] * s[10] * s[15] - s[0] * s[11] * s[14] - s[8] * s[2] * s[15] + s[8] * s[3] * s[14] +
+		s[12] * s[2] * s[11] - s[12] * s[3] * s[10];
+	inv[9] = -s[0] * s[9] * s[15] + s[0] * s[11] * s[13] + s[8] * s[1] * s[15] - s[8] * s[3] * s[13] -
+		s[12] * s[1] * s[11] + s[12] * s[3] * s[9];
+	inv[13] = s[0] * s[9] * s[14] - s[0] * s[10] * s[13] - s[8] * s[1] * s[14] + s[8] * s[2] * s[13] +
+		s[12] * s[1] * s[10] - s[12] * s[2] * s[9];
+	inv[2] = s[1] * s[6] * s[15] - s[1] * s[7] * s[14] - s[5] * s[2] * s[15] + s[5] * s[3] * s[14] +
+		s[13] * s[2] * s[7] - s[13] * s[3] * s[6];
+	inv[6] = -s[0] * s[6] * s[15] + s[0] * s[7] * s[14] + s[4] * s[2] * s[15] - s[4] * s[3] * s[14] -
+		s[12] * s[2] * s[7] + s[12] * s[3] * s[6];
+	inv[10] = s[0] * s[5] * s[15] - s[0] * s[7] * s[13] - s[4] * s[1] * s[15] + s[4] * s[3] * s[13] +
+		s[12] * s[1] * s[7] - s[12] * s[3] * s[5];
+	inv[14] = -s[0] * s[5] * s[14] + s[0] * s[6] * s[13] + s[4] * s[1] * s[14] - s[4] * s[2] * s[13] -
+		s[12] * s[1] * s[6] + s[12] * s[2] * s[5];
+	inv[3] = -s[1] * s[6] * s[11] + s[1] * s[7] * s[10] + s[5] * s[2] * s[11] - s[5] * s[3] * s[10] -
+		s[9] * s[2] * s[7] + s[9] * s[3] * s[6];
+	inv[7] = s[0] * s[6] * s[11] - s[0] * s[7] * s[10] - s[4] * s[2] * s[11] + s[4] * s[3] * s[10] +
+		s[8] * s[2] * s[7] - s[8] * s[3] * s[6];
+	inv[11] = -s[0] * s[5] * s[11] + s[0] * s[7] * s[9] + s[4] * s[1] * s[11] - s[4] * s[3] * s[9] -
+		s[8] * s[1] * s[7] + s[8] * s[3] * s[5];
+	inv[15] = s[0] * s[5] * s[10] - s[0] * s[6] * s[9] - s[4] * s[1] * s[10] + s[4] * s[2] * s[9] +
+		s[8] * s[1] * s[6] - s[8] * s[2] * s[5];
+
+	const float determinant = s[0] * inv[0] + s[1] * inv[4] + s[2] * inv[8] + s[3] * inv[12];
+	if (determinant == 0.f)
+		return Identity4x4();
+
+	Float4x4 result;
+	float* const r = &result.m[0][0];
+	for (int i = 0; i < 16; i++)
+		r[i] = inv[i] / determinant;
+	return result;
+}
@@ -0,0 +1,59 @@
+#include "stdafx.h"
+#include "FlyCamera.h"
+
+namespace
+{
+	const float degreesToRadians = 3.14159265358979f / 180.f;
+	const float maxPitch = 89.9f;
+}
+
+void FlyCamera::HandleInputEvent(const InputEvent& event, const float deltaSeconds)
+{
+	if (event.consumed)
+		return;
+
+	if (event.input == lookButton)
+		m_looking = event.data == 1.f;
+
+	if (!m_looking)
+		return;
+
+	const float delta = (m_settings.InvertVerticalLook ? event.data : -event.data) * m_settings.LookSensitivity *
+		deltaSeconds;
+	if (event.input == mouseXAxis)
+		m_yaw += delta;
+	if (event.input == mouseYAxis)
+		m_pitch = std::clamp(m_pitch + delta, -maxPitch, maxPitch);
+}
+
+// Right is forward cross up, which for a left handed view points to the camera's left, hence the signs.
+void FlyCamera::Move(const uint32_t moveFlags, const float deltaSeconds)
+{
+	const Float3 forward = GetForward();
+	const Float3 right = Cross(forward, m_up);
+	const float step = deltaSeconds * m_settings.Speed;
+	if (moveFlags & MoveForward)
+		m_position = m_position + forward * step;
+	if (moveFlags & MoveBack)
+		m_position = m_position - forward * step;
+	if (moveFlags & MoveRight)
+		m_position = m_position - right * step;
+	if (moveFlags & MoveLeft)
+		m_position = m_position + right * step;
+	if (moveFlags & MoveUp)
+		m_position = m_position + m_up * step;
+	if (moveFlags & MoveDown)
+		m_position = m_position - m_up * step;
+}
+
+Float3 FlyCamera::GetForward() const
+{
+	const float yaw = m_yaw * degreesToRadians;
+	const float pitch = m_pitch * degreesToRadians;
+	return Normalize({ std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch) });
+}
+
+Float4x4 FlyCamera::GetView() const
+{
+	return LookAtLH(m_position, m_position + GetForward(), m_up);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include "Float3.h"
+#include "Float4x4.h"
+#include "../InputEvent.h"
+
+// The demo's free flying camera: keys move it along its own axes, mouse movement turns it while the look button is held.
+// Angles are in degrees, with a yaw of 90 looking down +z. Shared by the windowed demo and headless runs so a recorded
+// input log flies the same path in both.
+class FlyCamera
+{
+public:
+	// Movement keys held during a frame. InputRecording stores these bits as each frame's key state.
+	enum MoveFlags : uint32_t
+	{
+		MoveForward = 1 << 0,
+		MoveBack = 1 << 1,
+		MoveRight = 1 << 2,
+		MoveLeft = 1 << 3,
+		MoveUp = 1 << 4,
+		MoveDown = 1 << 5,
+	};
+
+	// MOUSEBUTTON_RIGHTMOUSEBUTTON, spelled out so this builds without the Windows headers.
+	static const int lookButton = 0x0002;
+	static const int mouseXAxis = 401;
+	static const int mouseYAxis = 402;
+
+	struct Settings
+	{
+		// units per second
+		float Speed = 5.f;
+		// degrees per second per unit of mouse movement
+		float LookSensitivity = 10.f;
+		bool InvertVerticalLook = false;
+	};
+
+public:
+	// Look button and mouse axis events; anything else is left alone.
+	void HandleInputEvent(const InputEvent& event, const float deltaSeconds);
+	void Move(const uint32_t moveFlags, const float deltaSeconds);
+
+	Settings& GetSettings() { return m_settings; }
+	const Float3& GetPosition() const { return m_position; }
+	Float3 GetForward() const;
+	// Row major, laid out like XMFLOAT4X4.
+	Float4x4 GetView() const;
+
+private:
+	Settings m_settings;
+	Float3 m_position = { 0.f, 0.f, -5.f };
+	Float3 m_up = { 0.f, 1.f, 0.f };
+	float m_yaw = 90.f;
+	float m_pitch = 0.f;
+	bool m_looking = false;
+};
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+#include "FrameLinearAllocator.h"
+#include "../Macros.h"
+
+void FrameLinearAllocator::Initialize(const size_t pageSize, const uint32_t frameCount)
+{
+	assert(pageSize > 0 && frameCount > 0);
+	m_pageSize = pageSize;
+	m_framePages.resize(frameCount);
+}
+
+void FrameLinearAllocator::BeginFrame(const uint32_t frameIndex)
+{
+	assert(frameIndex < m_framePages.size());
+	auto& pages = m_framePages[frameIndex];
+	m_freePages.insert(m_freePages.end(), pages.begin(), pages.end());
+	pages.clear();
+
+	m_currentFrame = frameIndex;
+	m_currentPage = invalidPage;
+	m_currentOffset = 0;
+	m_frameUsedBytes = 0;
+}
+
+FrameLinearAllocator::Allocation FrameLinearAllocator::Allocate(const size_t size, const size_t alignment)
+{
+	assert(size > 0);
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	Allocation allocation = {};
+	if (m_currentPage != invalidPage)
+	{
+		size_t offset = ALIGN_TO(m_currentOffset, alignment);
+		if (offset + size <= m_pageSizes[m_currentPage])
+		{
+			allocation.Page = m_currentPage;
+			allocation.Offset = offset;
+			m_currentOffset = offset + size;
+			m_frameUsedBytes += size;
+			return allocation;
+		}
+	}
+
+	// Pages start on a resource boundary so offset 0 satisfies any alignment the caller can ask for.
+	m_currentPage = AcquirePage(size);
+	m_framePages[m_currentFrame].push_back(m_currentPage);
+	m_currentOffset = size;
+	m_frameUsedBytes += size;
+
+	allocation.Page = m_currentPage;
+	allocation.Offset = 0;
+	return allocation;
+}
+
+uint32_t FrameLinearAllocator::AcquirePage(const size_t minSize)
+{
+	for (size_t i = 0; i < m_freePages.size(); i++)
+	{
+		uint32_t page = m_freePages[i];
+		if (m_pageSizes[page] >= minSize)
+		{
+			m_freePages[i] = m_freePages.back();
+			m_freePages.pop_back();
+			return page;
+		}
+	}
+
+	// Grow. Oversized requests get a page rounded up to a whole number of default pages so it can be reused later.
+	size_t pageSize = ((minSize + m_pageSize - 1) / m_pageSize) * m_pageSize;
+	m_pageSizes.push_back(pageSize);
+	return static_cast<uint32_t>(m_pageSizes.size() - 1);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-frame bump allocator over a growable set of pages. Only page indices and offsets are handed out so the allocation logic
+// does not depend on the device; DynamicUploadHeap maps them onto upload buffers.
+class FrameLinearAllocator
+{
+public:
+	static const uint32_t invalidPage = UINT32_MAX;
+
+	struct Allocation
+	{
+		uint32_t Page = invalidPage;
+		size_t Offset = 0;
+	};
+
+public:
+	void Initialize(const size_t pageSize, const uint32_t frameCount);
+	// Recycles every page used the last time frameIndex was recorded. The caller must have waited on that frame's fence.
+	void BeginFrame(const uint32_t frameIndex);
+	Allocation Allocate(const size_t size, const size_t alignment);
+	uint32_t GetNumPages() const { return static_cast<uint32_t>(m_pageSizes.size()); }
+	size_t GetPageSize(const uint32_t page) const { return m_pageSizes[page]; }
+	size_t GetFrameUsedBytes() const { return m_frameUsedBytes; }
+
+private:
+	uint32_t AcquirePage(const size_t minSize);
+
+private:
+	size_t m_pageSize = 0;
+	std::vector<size_t> m_pageSizes;
+	std::vector<uint32_t> m_freePages;
+	std::vector<std::vector<uint32_t>> m_framePages;
+	uint32_t m_currentFrame = 0;
+	uint32_t m_currentPage = invalidPage;
+	size_t m_currentOffset = 0;
+	size_t m_frameUsedBytes = 0;
+};
@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "FrameRenderer.h"
+#include "TransformSystem.h"
+#include "../JobSystem.h"
+#include "../Profiler.h"
+
+#include <cstring>
+
+namespace
+{
+	double SecondsSince(const std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void FrameRenderer::Initialize(RenderBackend* const backend, const uint32_t width, const uint32_t height,
+	const uint32_t numFramesInFlight, const uint32_t maxObjects)
+{
+	assert(numFramesInFlight > 0 && numFramesInFlight <= maxFramesInFlight);
+	m_backend = backend;
+	m_numFramesInFlight = numFramesInFlight;
+	m_maxObjects = maxObjects;
+
+	for (uint32_t i = 0; i < m_numFramesInFlight; i++)
+	{
+		m_frames[i].Instances = m_backend->CreateBuffer(BufferUsage::Instance, sizeof(RenderInstance) * maxObjects);
+		m_frames[i].Scene = m_backend->CreateTopLevelAccelerationStructure(maxObjects);
+	}
+
+	m_color = m_backend->CreateTexture(TextureFormat::RGBA8, width, height);
+	m_surface = m_backend->CreateTexture(TextureFormat::RGBA16Float, width, height);
+	m_depth = m_backend->CreateTexture(TextureFormat::Depth32, width, height);
+	m_shadows = m_backend->CreateTexture(TextureFormat::RGBA8, width, height);
+	m_output = m_backend->CreateTexture(TextureFormat::RGBA8, width, height);
+	m_instanceData.resize(maxObjects);
+}
+
+uint32_t FrameRenderer::AddMesh(const std::vector<RenderVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	Mesh mesh;
+	mesh.VertexBuffer = m_backend->CreateBuffer(BufferUsage::Vertex, sizeof(RenderVertex) * vertices.size());
+	m_backend->WriteBuffer(mesh.VertexBuffer, 0, vertices.data(), sizeof(RenderVertex) * vertices.size());
+	mesh.IndexBuffer = m_backend->CreateBuffer(BufferUsage::Index, sizeof(uint32_t) * indices.size());
+	m_backend->WriteBuffer(mesh.IndexBuffer, 0, indices.data(), sizeof(uint32_t) * indices.size());
+	m_visibility.SetMesh(static_cast<uint32_t>(m_meshes.size()), vertices.data(),
+		static_cast<uint32_t>(vertices.size()), sizeof(RenderVertex), indices.data(),
+		static_cast<uint32_t>(indices.size()));
+	mesh.IndexCount = static_cast<uint32_t>(indices.size());
+	mesh.BottomLevel = m_backend->CreateBottomLevelAccelerationStructure(mesh.VertexBuffer,
+		static_cast<uint32_t>(vertices.size()), mesh.IndexBuffer, mesh.IndexCount);
+	m_meshes.push_back(mesh);
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint64_t FrameRenderer::Render(const TransformSystem& transforms, const std::vector<uint32_t>& objectMeshIDs,
+	const FrameConstants& constants)
+{
+	const uint32_t numObjects = static_cast<uint32_t>(objectMeshIDs.size());
+	assert(numObjects <= m_maxObjects && numObjects <= transforms.GetCount());
+	FrameResources& frame = m_frames[m_frameIndex % m_numFramesInFlight];
+
+	auto start = std::chrono::steady_clock::now();
+	Profiler::BeginScope("Wait for frame");
+	m_backend->WaitForFence(frame.FenceValue);
+	Profiler::EndScope();
+	m_timings.WaitSeconds = SecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	m_visibility.UpdateBounds(transforms, objectMeshIDs.data(), numObjects);
+	const CullingSystem::Settings cullingSettings;
+	m_visibility.CullAndBatch(constants.ViewProjection, transforms, objectMeshIDs.data(), numObjects, cullingSettings);
+	m_timings.CullSeconds = SecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	Profiler::BeginScope("Instance data");
+	const InstanceBatcher& batcher = m_visibility.GetBatcher();
+	const std::vector<uint32_t>& sortedObjects = batcher.GetSortedObjects();
+	for (uint32_t i = 0; i < batcher.GetNumInstances(); i++)
+	{
+		const uint32_t objectIndex = sortedObjects[i];
+		RenderInstance& instance = m_instanceData[i];
+		memcpy(instance.World, transforms.GetWorldMatrix(objectIndex), sizeof(instance.World));
+		memcpy(instance.WorldInvTranspose, transforms.GetWorldInverseTransposeMatrix(objectIndex),
+			sizeof(instance.WorldInvTranspose));
+		instance.TextureID = 0;
+		instance.VertexBufferID = objectMeshIDs[objectIndex];
+		instance.IndexBufferID = objectMeshIDs[objectIndex];
+		instance.Padding = 0;
+	}
+	m_backend->WriteBuffer(frame.Instances, 0, m_instanceData.data(),
+		sizeof(RenderInstance) * batcher.GetNumInstances());
+
+	// unused slots are left pointing at nothing so they drop out of the build
+	SceneVisibility::UpdateInstances(transforms, objectMeshIDs.data(), numObjects, m_maxObjects,
+		[this, &frame](const uint32_t slot, const uint32_t meshID, const float* const transform, const uint8_t mask)
+	{
+		const AccelerationStructureHandle bottomLevel = meshID != SceneVisibility::noMesh ?
+			m_meshes[meshID].BottomLevel : AccelerationStructureHandle{};
+		m_backend->SetInstance(frame.Scene, slot, bottomLevel, transform, mask);
+	});
+	Profiler::EndScope();
+	m_timings.UpdateSeconds = SecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	Profiler::BeginScope("Record");
+	RenderCommandList& commandList = m_backend->BeginCommandList();
+	const float clearColor[4] = { 0.f, 0.f, 0.f, 1.f };
+	const float clearSurface[4] = { 0.f, 0.f, 0.f, -1.f };
+	const float clearDepth[4] = { 1.f, 0.f, 0.f, 0.f };
+	commandList.ClearTexture(m_color, clearColor);
+	commandList.ClearTexture(m_surface, clearSurface);
+	commandList.ClearTexture(m_depth, clearDepth);
+
+	commandList.BeginRasterPass(m_color, m_surface, m_depth, constants);
+	const uint32_t numBatches = static_cast<uint32_t>(batcher.GetBatches().size());
+	const uint32_t numDrawLists = m_jobs ?
+		std::min({ numBatches / minDrawsPerList, m_jobs->GetNumWorkers(), maxDrawLists }) : 0;
+	if (numDrawLists <= 1)
+	{
+		RecordDraws(commandList, frame, 0, numBatches);
+		commandList.EndRasterPass();
+		RecordShadows(commandList, frame, constants);
+	}
+	else
+	{
+		// The first list is left inside the raster pass and every draw list resumes it. Lists are begun here so their
+		// submission order, and with it the draw order, does not depend on which worker records what.
+		m_drawLists.clear();
+		for (uint32_t i = 0; i < numDrawLists; i++)
+		{
+			m_drawLists.push_back(&m_backend->BeginCommandList());
+		}
+		m_jobs->ParallelFor("Record draws", numDrawLists, 1, [&](const uint32_t begin, const uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				RenderCommandList& drawList = *m_drawLists[i];
+				drawList.ResumeRasterPass(m_color, m_surface, m_depth, constants);
+				RecordDraws(drawList, frame, numBatches * i / numDrawLists, numBatches * (i + 1) / numDrawLists);
+				if (i == numDrawLists - 1)
+					drawList.EndRasterPass();
+			}
+		});
+		RecordShadows(m_backend->BeginCommandList(), frame, constants);
+	}
+	m_timings.NumDrawLists = std::max(numDrawLists, 1u);
+	frame.FenceValue = m_backend->Submit();
+	Profiler::EndScope();
+	m_timings.RecordSeconds = SecondsSince(start);
+
+	m_frameIndex++;
+	return frame.FenceValue;
+}
+
+void FrameRenderer::RecordDraws(RenderCommandList& commandList, const FrameResources& frame, const uint32_t firstBatch,
+	const uint32_t endBatch) const
+{
+	const std::vector<DrawBatch>& batches = m_visibility.GetBatcher().GetBatches();
+	for (uint32_t i = firstBatch; i < endBatch; i++)
+	{
+		const Mesh& mesh = m_meshes[batches[i].MeshID];
+		DrawDesc draw;
+		draw.VertexBuffer = mesh.VertexBuffer;
+		draw.IndexBuffer = mesh.IndexBuffer;
+		draw.IndexCount = mesh.IndexCount;
+		draw.InstanceBuffer = frame.Instances;
+		draw.FirstInstance = batches[i].FirstInstance;
+		draw.InstanceCount = batches[i].InstanceCount;
+		commandList.DrawIndexedInstanced(draw);
+	}
+}
+
+void FrameRenderer::RecordShadows(RenderCommandList& commandList, const FrameResources& frame,
+	const FrameConstants& constants) const
+{
+	commandList.BuildAccelerationStructure(frame.Scene);
+	commandList.TraceShadows(frame.Scene, m_surface, m_shadows, constants);
+	commandList.Composite(m_color, m_shadows, m_output);
+}
+
+void FrameRenderer::WaitForIdle()
+{
+	for (uint32_t i = 0; i < m_numFramesInFlight; i++)
+	{
+		m_backend->WaitForFence(m_frames[i].FenceValue);
+	}
+}
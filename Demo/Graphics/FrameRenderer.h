@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderBackend.h"
+#include "SceneVisibility.h"
+
+class TransformSystem;
+class JobSystem;
+
+struct FrameTimings
+{
+	// waiting for the frame in flight that used the same instance data and acceleration structure
+	double WaitSeconds = 0.0;
+	// refitting the scene BVH, culling and batching
+	double CullSeconds = 0.0;
+	// instance data and acceleration structure instances
+	double UpdateSeconds = 0.0;
+	double RecordSeconds = 0.0;
+	// lists the draws were recorded on
+	uint32_t NumDrawLists = 0;
+};
+
+// Draws the scene through a RenderBackend: raster, shadow trace and composite. Objects are culled and batched by the
+// same SceneVisibility steps the windowed demo runs, and only the visible ones are drawn. Instance data and the top
+// level acceleration structure are kept once per frame in flight, and a frame waits for the one that last used its
+// copies before writing them. Given a job system, the draws are split into contiguous runs recorded on lists of their
+// own by the workers, and the lists are submitted together in draw order, so the frame comes out the same whatever the
+// number of workers. Only this reference frame records in parallel; the windowed renderer in main.cpp records all of
+// its draws on one command list.
+class FrameRenderer
+{
+public:
+	static const uint32_t maxFramesInFlight = 3;
+	// fewer draws than this per list cost more in list overhead than recording them in parallel saves
+	static const uint32_t minDrawsPerList = 64;
+	static const uint32_t maxDrawLists = 16;
+
+public:
+	void Initialize(RenderBackend* const backend, const uint32_t width, const uint32_t height,
+		const uint32_t numFramesInFlight, const uint32_t maxObjects);
+	// Once set, Render records draws on the job system's workers and must be called from one of them.
+	void SetJobSystem(JobSystem* const jobs) { m_jobs = jobs; }
+	uint32_t AddMesh(const std::vector<RenderVertex>& vertices, const std::vector<uint32_t>& indices);
+	// Object i draws mesh objectMeshIDs[i] with the transforms at index i. Returns the fence value of the frame.
+	// constants.ViewProjection is the view culled against.
+	uint64_t Render(const TransformSystem& transforms, const std::vector<uint32_t>& objectMeshIDs,
+		const FrameConstants& constants);
+	void WaitForIdle();
+	TextureHandle GetOutput() const { return m_output; }
+	const FrameTimings& GetTimings() const { return m_timings; }
+	const SceneVisibility& GetVisibility() const { return m_visibility; }
+	uint64_t GetFrameIndex() const { return m_frameIndex; }
+
+private:
+	struct Mesh
+	{
+		BufferHandle VertexBuffer;
+		BufferHandle IndexBuffer;
+		uint32_t IndexCount = 0;
+		AccelerationStructureHandle BottomLevel;
+	};
+
+	struct FrameResources
+	{
+		BufferHandle Instances;
+		AccelerationStructureHandle Scene;
+		uint64_t FenceValue = 0;
+	};
+
+	void RecordDraws(RenderCommandList& commandList, const FrameResources& frame, const uint32_t firstBatch,
+		const uint32_t endBatch) const;
+	void RecordShadows(RenderCommandList& commandList, const FrameResources& frame, const FrameConstants& constants) const;
+
+private:
+	RenderBackend* m_backend = nullptr;
+	JobSystem* m_jobs = nullptr;
+	uint32_t m_numFramesInFlight = 0;
+	uint32_t m_maxObjects = 0;
+	std::vector<Mesh> m_meshes;
+	FrameResources m_frames[maxFramesInFlight] = {};
+	TextureHandle m_color;
+	TextureHandle m_surface;
+	TextureHandle m_depth;
+	TextureHandle m_shadows;
+	TextureHandle m_output;
+	SceneVisibility m_visibility;
+	std::vector<RenderInstance> m_instanceData;
+	std::vector<RenderCommandList*> m_drawLists;
+	FrameTimings m_timings;
+	uint64_t m_frameIndex = 0;
+};
@@ -0,0 +1,122 @@
+#include "stdafx.h"
+#include "GpuProfiler.h"
+
+namespace
+{
+	const uint32_t invalidRange = UINT32_MAX;
+}
+
+void GpuProfiler::Initialize(ID3D12Device* const device, ID3D12CommandQueue* const queue, const uint32_t backBufferCount)
+{
+	m_queue = queue;
+	HRESULT hr = m_queue->GetTimestampFrequency(&m_frequency);
+	assert(SUCCEEDED(hr));
+
+	// a begin and an end timestamp per range
+	const uint32_t numQueries = maxRangesPerFrame * 2 * backBufferCount;
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = numQueries;
+	hr = device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap));
+	assert(SUCCEEDED(hr));
+
+	hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint64_t) * numQueries),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_readback));
+	assert(SUCCEEDED(hr));
+
+	m_ranges.resize(backBufferCount);
+	m_resolved.resize(backBufferCount, false);
+	m_track = Profiler::AddTrack("GPU");
+}
+
+void GpuProfiler::BeginFrame(const uint32_t backBufferIndex)
+{
+	assert(m_depth == 0);
+	Collect(backBufferIndex);
+	m_backBufferIndex = backBufferIndex;
+	m_ranges[backBufferIndex].clear();
+	m_resolved[backBufferIndex] = false;
+}
+
+uint32_t GpuProfiler::BeginRange(ID3D12GraphicsCommandList* const commandList, const char* const name)
+{
+	std::vector<Range>& ranges = m_ranges[m_backBufferIndex];
+	assert(ranges.size() < maxRangesPerFrame && "too many GPU ranges in a frame");
+	if (ranges.size() == maxRangesPerFrame)
+		return invalidRange;
+	const uint32_t range = static_cast<uint32_t>(ranges.size());
+	ranges.push_back({ name, m_depth++ });
+	commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		(m_backBufferIndex * maxRangesPerFrame + range) * 2);
+	return range;
+}
+
+void GpuProfiler::EndRange(ID3D12GraphicsCommandList* const commandList, const uint32_t range)
+{
+	if (range == invalidRange)
+		return;
+	assert(m_depth > 0);
+	m_depth--;
+	commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		(m_backBufferIndex * maxRangesPerFrame + range) * 2 + 1);
+}
+
+void GpuProfiler::EndFrame(ID3D12GraphicsCommandList* const commandList)
+{
+	assert(m_depth == 0);
+	const uint32_t numRanges = static_cast<uint32_t>(m_ranges[m_backBufferIndex].size());
+	if (numRanges == 0)
+		return;
+	const uint32_t firstQuery = m_backBufferIndex * maxRangesPerFrame * 2;
+	commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, numRanges * 2,
+		m_readback.Get(), sizeof(uint64_t) * firstQuery);
+	m_resolved[m_backBufferIndex] = true;
+}
+
+void GpuProfiler::Collect(const uint32_t backBufferIndex)
+{
+	const std::vector<Range>& ranges = m_ranges[backBufferIndex];
+	if (!m_resolved[backBufferIndex] || ranges.empty())
+		return;
+
+	const size_t firstByte = sizeof(uint64_t) * backBufferIndex * maxRangesPerFrame * 2;
+	const size_t numBytes = sizeof(uint64_t) * ranges.size() * 2;
+	const uint64_t* timestamps = nullptr;
+	HRESULT hr = m_readback->Map(0, &CD3DX12_RANGE(firstByte, firstByte + numBytes), reinterpret_cast<void**>(&timestamps));
+	assert(SUCCEEDED(hr));
+	timestamps += backBufferIndex * maxRangesPerFrame * 2;
+
+	// The calibration gives the GPU's timestamp for about now, so ranges are placed back from now by how long ago they
+	// ran on the GPU.
+	uint64_t gpuTimestamp = 0;
+	uint64_t cpuTimestamp = 0;
+	hr = m_queue->GetClockCalibration(&gpuTimestamp, &cpuTimestamp);
+	assert(SUCCEEDED(hr));
+	const int64_t now = Profiler::Now();
+	const auto toProfilerTime = [this, gpuTimestamp, now](const uint64_t timestamp)
+	{
+		const double secondsAgo = (static_cast<double>(gpuTimestamp) - static_cast<double>(timestamp)) / m_frequency;
+		return now - static_cast<int64_t>(secondsAgo * 1e9);
+	};
+
+	// the profiler keeps events in the order they end
+	std::vector<Profiler::Event> events(ranges.size());
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		events[i].Name = ranges[i].Name;
+		events[i].Depth = ranges[i].Depth;
+		events[i].Begin = toProfilerTime(timestamps[i * 2]);
+		events[i].End = std::max(toProfilerTime(timestamps[i * 2 + 1]), events[i].Begin);
+	}
+	m_readback->Unmap(0, &CD3DX12_RANGE(0, 0));
+	std::stable_sort(events.begin(), events.end(), [](const Profiler::Event& a, const Profiler::Event& b)
+	{
+		return a.End < b.End;
+	});
+	for (const Profiler::Event& event : events)
+		Profiler::RecordEvent(m_track, event.Name, event.Begin, event.End, event.Depth);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "../Profiler.h"
+
+// Timestamp queries around ranges of a frame's commands. Every back buffer has its own part of the query heap and of a
+// readback buffer the queries are resolved into at the end of its frame. When the back buffer comes round again its
+// fence has passed, so BeginFrame reads what was resolved and records it on the profiler's GPU track, moved onto the
+// CPU timeline through the queue's clock calibration.
+class GpuProfiler
+{
+public:
+	static const uint32_t maxRangesPerFrame = 64;
+
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& profiler, ID3D12GraphicsCommandList* const commandList, const char* const name)
+			: m_profiler(profiler), m_commandList(commandList), m_range(profiler.BeginRange(commandList, name)) {}
+		~Scope() { m_profiler.EndRange(m_commandList, m_range); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		ID3D12GraphicsCommandList* m_commandList;
+		uint32_t m_range;
+	};
+
+public:
+	void Initialize(ID3D12Device* const device, ID3D12CommandQueue* const queue, const uint32_t backBufferCount);
+	// The back buffer's previous frame must have completed on the GPU.
+	void BeginFrame(const uint32_t backBufferIndex);
+	// Ranges nest like CPU scopes. Names must outlive the profiler.
+	uint32_t BeginRange(ID3D12GraphicsCommandList* const commandList, const char* const name);
+	void EndRange(ID3D12GraphicsCommandList* const commandList, const uint32_t range);
+	// Resolves the frame's queries, after its last range has ended.
+	void EndFrame(ID3D12GraphicsCommandList* const commandList);
+
+private:
+	struct Range
+	{
+		const char* Name = nullptr;
+		uint32_t Depth = 0;
+	};
+
+	void Collect(const uint32_t backBufferIndex);
+
+private:
+	ComPtr<ID3D12QueryHeap> m_queryHeap;
+	ComPtr<ID3D12Resource> m_readback;
+	ID3D12CommandQueue* m_queue = nullptr;
+	uint64_t m_frequency = 0;
+	uint32_t m_track = 0;
+	uint32_t m_backBufferIndex = 0;
+	uint32_t m_depth = 0;
+	// ranges begun in each back buffer's last frame, in the order they were begun
+	std::vector<std::vector<Range>> m_ranges;
+	std::vector<bool> m_resolved;
+};
+
+// Times the commands recorded on commandList for the rest of the enclosing block.
+#define PROFILE_GPU_SCOPE(profiler, commandList, name) \
+	const GpuProfiler::Scope PROFILE_CONCATENATE(gpuProfileScope, __LINE__)(profiler, commandList, name)
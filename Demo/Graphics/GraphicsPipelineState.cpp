@@ -1,5 +1,8 @@
 #include "stdafx.h"
 #include "GraphicsPipelineState.h"
+#include "RootSignature.h"
+#include "PipelineCache.h"
+#include "../Hash.h"
 
 GraphicsPipelineState::GraphicsPipelineState()
 {
@@ -62,21 +65,24 @@ void GraphicsPipelineState::SetInputLayout(const D3D12_INPUT_LAYOUT_DESC& inputL
 	m_pipelineDesc.InputLayout = inputLayout;
 }
 
-void GraphicsPipelineState::SetRootSignature(ID3D12RootSignature* const rootSignature)
+void GraphicsPipelineState::SetRootSignature(const RootSignature& rootSignature)
 {
-	m_pipelineDesc.pRootSignature = rootSignature;
+	m_pipelineDesc.pRootSignature = rootSignature.GetInterfacePtr();
+	m_rootSignatureHash = rootSignature.GetHash();
 }
 
 void GraphicsPipelineState::SetVertexShader(const size_t bytecodeLength, const void* const pShaderBytecode)
 {
 	m_pipelineDesc.VS.BytecodeLength = bytecodeLength;
 	m_pipelineDesc.VS.pShaderBytecode = pShaderBytecode;
+	m_vertexShaderHash = HashBytes(pShaderBytecode, bytecodeLength);
 }
 
 void GraphicsPipelineState::SetPixelShader(const size_t bytecodeLength, const void* pShaderBytecode)
 {
 	m_pipelineDesc.PS.BytecodeLength = bytecodeLength;
 	m_pipelineDesc.PS.pShaderBytecode = pShaderBytecode;
+	m_pixelShaderHash = HashBytes(pShaderBytecode, bytecodeLength);
 }
 
 void GraphicsPipelineState::SetPrimitiveTopologyType(const D3D12_PRIMITIVE_TOPOLOGY_TYPE primitiveTopologyType)
@@ -92,6 +98,11 @@ void GraphicsPipelineState::SetRTVFormats(const uint32_t numRenderTargets, const
 	}
 }
 
+void GraphicsPipelineState::SetRTVFormat(const uint32_t renderTarget, const DXGI_FORMAT format)
+{
+	m_pipelineDesc.RTVFormats[renderTarget] = format;
+}
+
 void GraphicsPipelineState::SetSampleDesc(const DXGI_SAMPLE_DESC& sampleDesc)
 {
 	m_pipelineDesc.SampleDesc = sampleDesc;
@@ -140,8 +151,98 @@ void GraphicsPipelineState::SetNumRenderTargets(const uint32_t numRenderTargets)
 	m_pipelineDesc.NumRenderTargets = numRenderTargets;
 }
 
-void GraphicsPipelineState::Create(ID3D12Device* const device)
+void GraphicsPipelineState::Create(ID3D12Device* const device, PipelineCache* const cache)
 {
+	uint64_t key = 0;
+	if (cache)
+	{
+		key = ComputeHash();
+		std::vector<uint8_t> cachedBlob;
+		if (cache->Load(key, cachedBlob))
+		{
+			m_pipelineDesc.CachedPSO.pCachedBlob = cachedBlob.data();
+			m_pipelineDesc.CachedPSO.CachedBlobSizeInBytes = cachedBlob.size();
+			HRESULT hr = device->CreateGraphicsPipelineState(&m_pipelineDesc, IID_PPV_ARGS(&m_pipelineState));
+			m_pipelineDesc.CachedPSO = {};
+			if (SUCCEEDED(hr))
+				return;
+
+			cache->Remove(key);
+		}
+	}
+
 	HRESULT hr = device->CreateGraphicsPipelineState(&m_pipelineDesc, IID_PPV_ARGS(&m_pipelineState));
 	assert(SUCCEEDED(hr));
+
+	if (cache)
+	{
+		ComPtr<ID3DBlob> blob;
+		hr = m_pipelineState->GetCachedBlob(&blob);
+		if (SUCCEEDED(hr))
+			cache->Store(key, blob->GetBufferPointer(), blob->GetBufferSize());
+	}
+}
+
+// Covers every field this class sets. Structures with padding are hashed field by field so the key never depends on
+// uninitialized bytes.
+uint64_t GraphicsPipelineState::ComputeHash() const
+{
+	uint64_t hash = HashString("GraphicsPipelineState");
+	hash = HashValue(m_rootSignatureHash, hash);
+	hash = HashValue(m_vertexShaderHash, hash);
+	hash = HashValue(m_pixelShaderHash, hash);
+
+	const D3D12_INPUT_LAYOUT_DESC& inputLayout = m_pipelineDesc.InputLayout;
+	hash = HashValue(inputLayout.NumElements, hash);
+	for (uint32_t i = 0; i < inputLayout.NumElements; i++)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = inputLayout.pInputElementDescs[i];
+		hash = HashString(element.SemanticName, hash);
+		hash = HashValue(element.SemanticIndex, hash);
+		hash = HashValue(element.Format, hash);
+		hash = HashValue(element.InputSlot, hash);
+		hash = HashValue(element.AlignedByteOffset, hash);
+		hash = HashValue(element.InputSlotClass, hash);
+		hash = HashValue(element.InstanceDataStepRate, hash);
+	}
+
+	const D3D12_BLEND_DESC& blend = m_pipelineDesc.BlendState;
+	hash = HashValue(blend.AlphaToCoverageEnable, hash);
+	hash = HashValue(blend.IndependentBlendEnable, hash);
+	for (const auto& renderTarget : blend.RenderTarget)
+	{
+		hash = HashValue(renderTarget.BlendEnable, hash);
+		hash = HashValue(renderTarget.LogicOpEnable, hash);
+		hash = HashValue(renderTarget.SrcBlend, hash);
+		hash = HashValue(renderTarget.DestBlend, hash);
+		hash = HashValue(renderTarget.BlendOp, hash);
+		hash = HashValue(renderTarget.SrcBlendAlpha, hash);
+		hash = HashValue(renderTarget.DestBlendAlpha, hash);
+		hash = HashValue(renderTarget.BlendOpAlpha, hash);
+		hash = HashValue(renderTarget.LogicOp, hash);
+		hash = HashValue(renderTarget.RenderTargetWriteMask, hash);
+	}
+
+	hash = HashValue(m_pipelineDesc.RasterizerState, hash);
+
+	const D3D12_DEPTH_STENCIL_DESC& depthStencil = m_pipelineDesc.DepthStencilState;
+	hash = HashValue(depthStencil.DepthEnable, hash);
+	hash = HashValue(depthStencil.DepthWriteMask, hash);
+	hash = HashValue(depthStencil.DepthFunc, hash);
+	hash = HashValue(depthStencil.StencilEnable, hash);
+	hash = HashValue(depthStencil.StencilReadMask, hash);
+	hash = HashValue(depthStencil.StencilWriteMask, hash);
+	hash = HashValue(depthStencil.FrontFace, hash);
+	hash = HashValue(depthStencil.BackFace, hash);
+
+	hash = HashValue(m_pipelineDesc.SampleMask, hash);
+	hash = HashValue(m_pipelineDesc.PrimitiveTopologyType, hash);
+	hash = HashValue(m_pipelineDesc.NumRenderTargets, hash);
+	hash = HashValue(m_pipelineDesc.RTVFormats, hash);
+	hash = HashValue(m_pipelineDesc.DSVFormat, hash);
+	hash = HashValue(m_pipelineDesc.SampleDesc, hash);
+	hash = HashValue(m_pipelineDesc.IBStripCutValue, hash);
+	hash = HashValue(m_pipelineDesc.NodeMask, hash);
+	hash = HashValue(m_pipelineDesc.Flags, hash);
+	return hash;
 }
\ No newline at end of file
@@ -23,6 +23,7 @@ enum class DepthStencilState : uint8_t
 
 class InputLayout;
 class RootSignature;
+class PipelineCache;
 
 class GraphicsPipelineState
 {
@@ -30,11 +31,12 @@ public:
 	GraphicsPipelineState();
 
 	void SetInputLayout(const D3D12_INPUT_LAYOUT_DESC& inputLayout);
-	void SetRootSignature(ID3D12RootSignature* const rootSignature);
+	void SetRootSignature(const RootSignature& rootSignature);
 	void SetVertexShader(const size_t bytecodeLength, const void* const pShaderBytecode);
 	void SetPixelShader(const size_t bytecodeLength, const void* const pShaderBytecode);
 	void SetPrimitiveTopologyType(const D3D12_PRIMITIVE_TOPOLOGY_TYPE primitiveTopologyType);
 	void SetRTVFormats(const uint32_t numRenderTargets, const DXGI_FORMAT format);
+	void SetRTVFormat(const uint32_t renderTarget, const DXGI_FORMAT format);
 	void SetSampleDesc(const DXGI_SAMPLE_DESC& sampleDesc);
 	void SetSampleMask(const uint32_t mask);
 	void SetRasterizerState(const RasterizerState state);
@@ -42,11 +44,18 @@ public:
 	void SetDepthStencilState(const DepthStencilState state);
 	void SetDSVFormat(const DXGI_FORMAT format);
 	void SetNumRenderTargets(const uint32_t numRenderTargets);
-	void Create(ID3D12Device* const device);
+	// With a cache, the driver's serialized PSO is reused whenever the full description hashes the same. A blob the driver
+	// rejects, e.g. after a driver update, is replaced.
+	void Create(ID3D12Device* const device, PipelineCache* const cache = nullptr);
 	ID3D12PipelineState* Get() const { return m_pipelineState.Get(); }
+	// Hash of the full description, including the root signature and shader hashes.
+	uint64_t ComputeHash() const;
 
 private:
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC m_pipelineDesc = {};
+	uint64_t m_rootSignatureHash = 0;
+	uint64_t m_vertexShaderHash = 0;
+	uint64_t m_pixelShaderHash = 0;
 	ComPtr<ID3D12PipelineState> m_pipelineState;
 
 	CD3DX12_BLEND_DESC m_opaqueBlendDesc;
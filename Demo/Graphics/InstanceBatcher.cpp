@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "InstanceBatcher.h"
+
+void InstanceBatcher::Reset()
+{
+	m_instances.clear();
+	std::fill(m_meshCounts.begin(), m_meshCounts.end(), 0);
+}
+
+void InstanceBatcher::AddInstance(const uint32_t meshID, const uint32_t objectIndex)
+{
+	if (meshID >= m_meshCounts.size())
+	{
+		m_meshCounts.resize(meshID + 1, 0);
+	}
+	m_meshCounts[meshID]++;
+	m_instances.push_back({ meshID, objectIndex });
+}
+
+void InstanceBatcher::Build()
+{
+	// Mesh IDs are small and dense so a counting sort orders the instances in linear time. It is stable, keeping objects of
+	// the same mesh in submission order.
+	m_batches.clear();
+	uint32_t firstInstance = 0;
+	for (uint32_t meshID = 0; meshID < m_meshCounts.size(); meshID++)
+	{
+		if (m_meshCounts[meshID] > 0)
+		{
+			DrawBatch batch = {};
+			batch.MeshID = meshID;
+			batch.FirstInstance = firstInstance;
+			m_batches.push_back(batch);
+			firstInstance += m_meshCounts[meshID];
+		}
+	}
+
+	std::vector<uint32_t> batchIndices(m_meshCounts.size(), 0);
+	for (uint32_t i = 0; i < m_batches.size(); i++)
+	{
+		batchIndices[m_batches[i].MeshID] = i;
+	}
+
+	m_sortedObjects.resize(m_instances.size());
+	for (const auto& instance : m_instances)
+	{
+		DrawBatch& batch = m_batches[batchIndices[instance.MeshID]];
+		m_sortedObjects[batch.FirstInstance + batch.InstanceCount] = instance.ObjectIndex;
+		batch.InstanceCount++;
+	}
+}
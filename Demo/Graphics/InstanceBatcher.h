@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct DrawBatch
+{
+	uint32_t MeshID = 0;
+	uint32_t FirstInstance = 0;
+	uint32_t InstanceCount = 0;
+};
+
+// Groups per-object draws by mesh so each mesh is drawn once with an instance count. Instances are ordered so every batch
+// reads a contiguous range of the per-frame instance data buffer.
+class InstanceBatcher
+{
+public:
+	void Reset();
+	void AddInstance(const uint32_t meshID, const uint32_t objectIndex);
+	void Build();
+	uint32_t GetNumInstances() const { return static_cast<uint32_t>(m_instances.size()); }
+	// Object index to write at each position of the instance data buffer, valid after Build.
+	const std::vector<uint32_t>& GetSortedObjects() const { return m_sortedObjects; }
+	const std::vector<DrawBatch>& GetBatches() const { return m_batches; }
+
+private:
+	struct Instance
+	{
+		uint32_t MeshID;
+		uint32_t ObjectIndex;
+	};
+
+	std::vector<Instance> m_instances;
+	std::vector<uint32_t> m_meshCounts;
+	std::vector<uint32_t> m_sortedObjects;
+	std::vector<DrawBatch> m_batches;
+};
@@ -1,5 +1,10 @@
 #include "stdafx.h"
 #include "Model.h"
+#include "RenderBackend.h"
+
+// lets SoftwareRasterizer and the render backends take a model's vertex and index data as they are
+static_assert(sizeof(Vertex) == sizeof(RenderVertex), "Vertex and RenderVertex must have the same layout");
+static_assert(sizeof(DWORD) == sizeof(uint32_t), "indices must be 32 bit");
 
 Model::Model()
 {
@@ -8,20 +13,55 @@ Model::Model()
 	m_blas = std::make_unique<BottomLevelAccelerationStructure>();
 }
 
+void Model::BeginSubmesh(const uint32_t materialID)
+{
+	assert(!m_buildingSubmesh);
+	Submesh submesh = {};
+	submesh.VertexOffset = static_cast<uint32_t>(m_vertices.size());
+	submesh.IndexOffset = static_cast<uint32_t>(m_indices.size());
+	submesh.MaterialID = materialID;
+	m_submeshes.push_back(submesh);
+	m_buildingSubmesh = true;
+}
+
+void Model::EndSubmesh()
+{
+	assert(m_buildingSubmesh);
+	Submesh& submesh = m_submeshes.back();
+	submesh.VertexCount = static_cast<uint32_t>(m_vertices.size()) - submesh.VertexOffset;
+	submesh.IndexCount = static_cast<uint32_t>(m_indices.size()) - submesh.IndexOffset;
+	m_buildingSubmesh = false;
+}
+
 void Model::Initialize(ID3D12Device5* const device)
 {
+	assert(!m_buildingSubmesh);
+
+	// Vertices pushed without a submesh are treated as a single submesh covering the whole model.
+	if (m_submeshes.empty())
+	{
+		Submesh submesh = {};
+		submesh.VertexCount = static_cast<uint32_t>(m_vertices.size());
+		submesh.IndexCount = static_cast<uint32_t>(m_indices.size());
+		m_submeshes.push_back(submesh);
+	}
+
 	m_vertexBuffer->Initialize(device, static_cast<uint32_t>(m_vertices.size() * sizeof(Vertex)),
 		static_cast<uint32_t>(sizeof(Vertex)));
 	m_indexBuffer->Initialize(device, static_cast<uint32_t>(m_indices.size() * sizeof(DWORD)));
-	m_blas->Initialize(device, 1);
+	m_blas->Initialize(device, static_cast<uint32_t>(m_submeshes.size()));
 }
 
 void Model::Stage(ID3D12Device5* const device)
 {
 	m_vertexBuffer->StageData(m_vertices.data());
 	m_indexBuffer->StageData(m_indices.data());
-	m_blas->AddStagedGeometry(m_vertexBuffer->GetHeapGPUVirtualAddress(), DXGI_FORMAT_R32G32B32_FLOAT, sizeof(Vertex), m_vertices.size(),
-		m_indexBuffer->GetHeapGPUVirtualAddress(), m_indices.size());
+	for (const auto& submesh : m_submeshes)
+	{
+		m_blas->AddStagedGeometry(m_vertexBuffer->GetHeapGPUVirtualAddress() + submesh.VertexOffset * sizeof(Vertex),
+			DXGI_FORMAT_R32G32B32_FLOAT, sizeof(Vertex), submesh.VertexCount,
+			m_indexBuffer->GetHeapGPUVirtualAddress() + submesh.IndexOffset * sizeof(DWORD), submesh.IndexCount);
+	}
 	m_blas->BuildStaged(device);
 }
 
@@ -38,32 +78,3 @@ void Model::StagingComplete()
 	m_vertexBuffer->StagingComplete();
 	m_indexBuffer->StagingComplete();
 }
-
-const XMMATRIX& Model::GetWorldMatrix()
-{
-	m_world = XMMatrixScalingFromVector(XMLoadFloat3(&m_scale)) *
-		XMMatrixRotationQuaternion(XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&m_rotation))) *
-		XMMatrixTranslationFromVector(XMLoadFloat3(&m_position));
-	return m_world;
-}
-
-void Model::SetPosition(const float x, const float y, const float z)
-{
-	m_position.x = x;
-	m_position.y = y;
-	m_position.z = z;
-}
-
-void Model::SetRotation(const float x, const float y, const float z)
-{
-	m_rotation.x = x;
-	m_rotation.y = y;
-	m_rotation.z = z;
-}
-
-void Model::SetScale(const float x, const float y, const float z)
-{
-	m_scale.x = x;
-	m_scale.y = y;
-	m_scale.z = z;
-}
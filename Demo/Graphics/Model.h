@@ -17,6 +17,16 @@ struct Vertex
 		: Pos({ posX, posY, posZ }), Norm({ normX, normY, normZ }), Uv({ u, v }) {}
 };
 
+// A range of the model's vertex and index data that is drawn and traced as one geometry. Indices are relative to VertexOffset.
+struct Submesh
+{
+	uint32_t VertexOffset = 0;
+	uint32_t VertexCount = 0;
+	uint32_t IndexOffset = 0;
+	uint32_t IndexCount = 0;
+	uint32_t MaterialID = 0;
+};
+
 class Model
 {
 public:
@@ -25,32 +35,30 @@ public:
 	StaticIndexBuffer* GetIndexBuffer() const { return m_indexBuffer.get(); }
 	void PushBackVertex(const Vertex& vertex) { m_vertices.push_back(vertex); }
 	void PushBackIndex(const DWORD& index) { m_indices.push_back(index); }
+	void BeginSubmesh(const uint32_t materialID);
+	void EndSubmesh();
+	const std::vector<Submesh>& GetSubmeshes() const { return m_submeshes; }
+	uint32_t GetNumSubmeshes() const { return static_cast<uint32_t>(m_submeshes.size()); }
 	void Initialize(ID3D12Device5* const device);
 	void Stage(ID3D12Device5* const device);
 	void Commit(ID3D12GraphicsCommandList4* const commandList);
 	void StagingComplete();
+	const std::vector<Vertex>& GetVertices() const { return m_vertices; }
+	const std::vector<DWORD>& GetIndices() const { return m_indices; }
+	uint32_t GetNumVertices() const { return static_cast<uint32_t>(m_vertices.size()); }
 	uint32_t GetNumIndices() const { return static_cast<uint32_t>(m_indices.size()); }
 	const D3D12_VERTEX_BUFFER_VIEW* GetVertexBufferView() const { return m_vertexBuffer->GetView(); }
 	const D3D12_INDEX_BUFFER_VIEW* GetIndexBufferView() const { return m_indexBuffer->GetView(); }
-	const XMMATRIX& GetWorldMatrix();
-	void SetPosition(const float x, const float y, const float z);
-	void SetRotation(const float x, const float y, const float z);
-	void SetScale(const float x, const float y, const float z);
 	D3D12_GPU_VIRTUAL_ADDRESS GetVertexBufferGPUVirtualAddress() const { return m_vertexBuffer->GetHeapGPUVirtualAddress(); }
 	D3D12_GPU_VIRTUAL_ADDRESS GetIndexBufferGPUVirtualAddress() const { return m_indexBuffer->GetHeapGPUVirtualAddress(); }
 	D3D12_GPU_VIRTUAL_ADDRESS GetBottomLevelAccelerationStructureGPUVirtualAddress() const { return m_blas->GetGPUVirtualAddress(); }
-	const XMFLOAT3& GetPosition() const { return m_position; }
-	const XMFLOAT3& GetRotation() const { return m_rotation; }
-	const XMFLOAT3& GetScale() const { return m_scale; }
 
 private:
 	std::unique_ptr<StaticVertexBuffer> m_vertexBuffer;
 	std::unique_ptr<StaticIndexBuffer> m_indexBuffer;
 	std::vector<Vertex> m_vertices;
 	std::vector<DWORD> m_indices;
-	XMFLOAT3 m_position = { 0.f, 0.f, 0.f };
-	XMFLOAT3 m_rotation = { XMConvertToRadians(90.f), XMConvertToRadians(0.f), XMConvertToRadians(0.f) };
-	XMFLOAT3 m_scale = { 1.f, 1.f, 1.f };
-	XMMATRIX m_world = XMMatrixIdentity();
+	std::vector<Submesh> m_submeshes;
+	bool m_buildingSubmesh = false;
 	std::unique_ptr<BottomLevelAccelerationStructure> m_blas;
 };
\ No newline at end of file
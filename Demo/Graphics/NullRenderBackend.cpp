@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "NullRenderBackend.h"
+
+#include <cstring>
+
+namespace
+{
+	enum class Command : uint8_t
+	{
+		Clear = 0,
+		BeginRasterPass,
+		ResumeRasterPass,
+		Draw,
+		EndRasterPass,
+		Build,
+		TraceShadows,
+		Composite
+	};
+}
+
+class NullRenderBackend::CommandList : public RenderCommandList
+{
+public:
+	void ClearTexture(const TextureHandle texture, const float* const value) override
+	{
+		Write(Command::Clear);
+		Append(&texture, sizeof(texture));
+		Append(value, sizeof(float) * 4);
+	}
+
+	void BeginRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) override
+	{
+		WriteRasterPass(Command::BeginRasterPass, color, surface, depth, constants);
+	}
+
+	void ResumeRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) override
+	{
+		WriteRasterPass(Command::ResumeRasterPass, color, surface, depth, constants);
+	}
+
+	void DrawIndexedInstanced(const DrawDesc& draw) override
+	{
+		Write(Command::Draw);
+		Append(&draw, sizeof(draw));
+		m_numDraws++;
+	}
+
+	void EndRasterPass() override
+	{
+		Write(Command::EndRasterPass);
+	}
+
+	void BuildAccelerationStructure(const AccelerationStructureHandle accelerationStructure) override
+	{
+		Write(Command::Build);
+		Append(&accelerationStructure, sizeof(accelerationStructure));
+	}
+
+	void TraceShadows(const AccelerationStructureHandle scene, const TextureHandle surface, const TextureHandle output,
+		const FrameConstants& constants) override
+	{
+		Write(Command::TraceShadows);
+		Append(&scene, sizeof(scene));
+		Append(&surface, sizeof(surface));
+		Append(&output, sizeof(output));
+		Append(&constants, sizeof(constants));
+	}
+
+	void Composite(const TextureHandle color, const TextureHandle shadow, const TextureHandle output) override
+	{
+		Write(Command::Composite);
+		Append(&color, sizeof(color));
+		Append(&shadow, sizeof(shadow));
+		Append(&output, sizeof(output));
+	}
+
+	void Reset()
+	{
+		m_stream.clear();
+		m_numCommands = 0;
+		m_numDraws = 0;
+	}
+
+	size_t GetNumBytes() const { return m_stream.size(); }
+	uint64_t GetNumCommands() const { return m_numCommands; }
+	uint64_t GetNumDraws() const { return m_numDraws; }
+
+private:
+	void Write(const Command command)
+	{
+		Append(&command, sizeof(command));
+		m_numCommands++;
+	}
+
+	void Append(const void* const data, const size_t size)
+	{
+		const size_t offset = m_stream.size();
+		m_stream.resize(offset + size);
+		memcpy(m_stream.data() + offset, data, size);
+	}
+
+	void WriteRasterPass(const Command command, const TextureHandle color, const TextureHandle surface,
+		const TextureHandle depth, const FrameConstants& constants)
+	{
+		Write(command);
+		Append(&color, sizeof(color));
+		Append(&surface, sizeof(surface));
+		Append(&depth, sizeof(depth));
+		Append(&constants, sizeof(constants));
+	}
+
+private:
+	std::vector<uint8_t> m_stream;
+	uint64_t m_numCommands = 0;
+	uint64_t m_numDraws = 0;
+};
+
+NullRenderBackend::NullRenderBackend() = default;
+
+NullRenderBackend::~NullRenderBackend() = default;
+
+BufferHandle NullRenderBackend::CreateBuffer(const BufferUsage, const size_t)
+{
+	return { ++m_numBuffers };
+}
+
+void NullRenderBackend::WriteBuffer(const BufferHandle buffer, const size_t, const void* const, const size_t)
+{
+	assert(buffer.IsValid() && buffer.ID <= m_numBuffers);
+}
+
+TextureHandle NullRenderBackend::CreateTexture(const TextureFormat, const uint32_t width, const uint32_t height)
+{
+	m_textureSizes.emplace_back(width, height);
+	return { static_cast<uint32_t>(m_textureSizes.size()) };
+}
+
+void NullRenderBackend::ReadTexture(const TextureHandle texture, std::vector<float>& rgba)
+{
+	const std::pair<uint32_t, uint32_t>& size = m_textureSizes[texture.ID - 1];
+	rgba.assign(static_cast<size_t>(size.first) * size.second * 4, 0.f);
+}
+
+AccelerationStructureHandle NullRenderBackend::CreateBottomLevelAccelerationStructure(const BufferHandle,
+	const uint32_t, const BufferHandle, const uint32_t)
+{
+	return { ++m_numAccelerationStructures };
+}
+
+AccelerationStructureHandle NullRenderBackend::CreateTopLevelAccelerationStructure(const uint32_t)
+{
+	return { ++m_numAccelerationStructures };
+}
+
+void NullRenderBackend::SetInstance(const AccelerationStructureHandle topLevel, const uint32_t,
+	const AccelerationStructureHandle, const float* const, const uint8_t)
+{
+	assert(topLevel.IsValid() && topLevel.ID <= m_numAccelerationStructures);
+}
+
+RenderCommandList& NullRenderBackend::BeginCommandList()
+{
+	if (m_numOpenLists == m_commandLists.size())
+		m_commandLists.push_back(std::make_unique<CommandList>());
+	CommandList& commandList = *m_commandLists[m_numOpenLists++];
+	commandList.Reset();
+	return commandList;
+}
+
+uint64_t NullRenderBackend::Submit()
+{
+	assert(m_numOpenLists > 0);
+	for (uint32_t i = 0; i < m_numOpenLists; i++)
+	{
+		const CommandList& commandList = *m_commandLists[i];
+		m_statistics.NumCommands += commandList.GetNumCommands();
+		m_statistics.NumDraws += commandList.GetNumDraws();
+		m_statistics.NumBytes += commandList.GetNumBytes();
+	}
+	m_statistics.NumCommandLists += m_numOpenLists;
+	m_statistics.NumSubmits++;
+	m_numOpenLists = 0;
+	return ++m_fenceValue;
+}
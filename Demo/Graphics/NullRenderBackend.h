@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include "RenderBackend.h"
+
+// Runs nothing. Lists only append each command to a byte stream of their own, as a driver encodes them, and fences
+// complete as soon as they are signaled, so a frame timed against it measures the CPU cost of recording and nothing
+// behind it. Textures read back as zeros.
+class NullRenderBackend : public RenderBackend
+{
+public:
+	struct Statistics
+	{
+		uint64_t NumSubmits = 0;
+		uint64_t NumCommandLists = 0;
+		uint64_t NumCommands = 0;
+		uint64_t NumDraws = 0;
+		uint64_t NumBytes = 0;
+	};
+
+public:
+	NullRenderBackend();
+	~NullRenderBackend() override;
+
+	const char* GetName() const override { return "Null"; }
+
+	BufferHandle CreateBuffer(const BufferUsage usage, const size_t size) override;
+	void WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data, const size_t size) override;
+	TextureHandle CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height) override;
+	void ReadTexture(const TextureHandle texture, std::vector<float>& rgba) override;
+
+	AccelerationStructureHandle CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+		const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount) override;
+	AccelerationStructureHandle CreateTopLevelAccelerationStructure(const uint32_t maxInstances) override;
+	void SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+		const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask) override;
+
+	RenderCommandList& BeginCommandList() override;
+	uint64_t Submit() override;
+	uint64_t GetCompletedFenceValue() override { return m_fenceValue; }
+	void WaitForFence(const uint64_t) override {}
+
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	class CommandList;
+
+private:
+	std::vector<std::pair<uint32_t, uint32_t>> m_textureSizes;
+	uint32_t m_numBuffers = 0;
+	uint32_t m_numAccelerationStructures = 0;
+	// kept between submits so their streams stop allocating after the first frames
+	std::vector<std::unique_ptr<CommandList>> m_commandLists;
+	uint32_t m_numOpenLists = 0;
+	uint64_t m_fenceValue = 0;
+	Statistics m_statistics;
+};
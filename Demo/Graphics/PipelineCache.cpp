@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "PipelineCache.h"
+#include "../Hash.h"
+
+static const uint32_t entryMagic = 0x48435050; // "PPCH"
+
+void PipelineCache::Initialize(const std::string& directory)
+{
+	m_directory = directory;
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+}
+
+bool PipelineCache::Load(const uint64_t key, std::vector<uint8_t>& data)
+{
+	const std::string path = GetEntryPath(key);
+	std::ifstream fs(path, std::ifstream::in | std::ifstream::binary);
+	EntryHeader header = {};
+	if (!fs.good() || !fs.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		m_numMisses++;
+		return false;
+	}
+
+	if (header.Magic != entryMagic || header.Version != version || header.Key != key)
+	{
+		m_numMisses++;
+		return false;
+	}
+
+	// The size in the header is only trusted once it matches the file, so a damaged header cannot ask for a huge buffer.
+	std::error_code error;
+	const uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error || fileSize < sizeof(header) || header.Size != fileSize - sizeof(header))
+	{
+		fs.close();
+		Remove(key);
+		m_numMisses++;
+		return false;
+	}
+
+	data.resize(static_cast<size_t>(header.Size));
+	if (!fs.read(reinterpret_cast<char*>(data.data()), header.Size) || HashBytes(data.data(), data.size()) != header.Checksum)
+	{
+		data.clear();
+		m_numMisses++;
+		return false;
+	}
+
+	m_numHits++;
+	return true;
+}
+
+void PipelineCache::Store(const uint64_t key, const void* const data, const size_t size)
+{
+	EntryHeader header = {};
+	header.Magic = entryMagic;
+	header.Version = version;
+	header.Key = key;
+	header.Size = size;
+	header.Checksum = HashBytes(data, size);
+
+	// Write to a temporary file first so a crash mid-write never leaves a truncated entry under the real name. Each store
+	// has a temporary file of its own, since the same key can be stored from several threads at once.
+	const std::string path = GetEntryPath(key);
+	const std::string temporaryPath = path + "." + std::to_string(m_numTemporaryFiles++) + ".tmp";
+	{
+		std::ofstream fs(temporaryPath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		if (!fs.good())
+			return;
+		fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fs.write(static_cast<const char*>(data), size);
+		if (!fs.good())
+		{
+			fs.close();
+			std::error_code error;
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+		std::filesystem::remove(temporaryPath, error);
+}
+
+void PipelineCache::Remove(const uint64_t key)
+{
+	std::error_code error;
+	std::filesystem::remove(GetEntryPath(key), error);
+}
+
+std::string PipelineCache::GetEntryPath(const uint64_t key) const
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_directory) / (std::string(name) + ".bin")).string();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Persistent key-value store for compiled shader bytecode and serialized pipeline state blobs, one file per entry. Each
+// file starts with a header holding the cache version, the full key and a checksum of the payload, so entries written by
+// an older build or damaged on disk are treated as misses and overwritten.
+class PipelineCache
+{
+public:
+	// Bump when anything that feeds the keys or the entry layout changes.
+	static const uint32_t version = 1;
+
+public:
+	void Initialize(const std::string& directory);
+	bool Load(const uint64_t key, std::vector<uint8_t>& data);
+	void Store(const uint64_t key, const void* const data, const size_t size);
+	// Deletes an entry that turned out to be unusable, e.g. a PSO blob the driver rejected.
+	void Remove(const uint64_t key);
+	uint32_t GetNumHits() const { return m_numHits; }
+	uint32_t GetNumMisses() const { return m_numMisses; }
+
+private:
+	std::string GetEntryPath(const uint64_t key) const;
+
+private:
+	struct EntryHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint64_t Size;
+		uint64_t Checksum;
+	};
+
+	std::string m_directory;
+	// Entries are loaded and stored from several threads once pipelines are created concurrently.
+	std::atomic<uint32_t> m_numHits = 0;
+	std::atomic<uint32_t> m_numMisses = 0;
+	std::atomic<uint32_t> m_numTemporaryFiles = 0;
+};
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "PipelineRegistry.h"
+#include "RootSignature.h"
+#include "GraphicsPipelineState.h"
+#include "ComputePipelineState.h"
+
+void PipelineRegistry::Initialize(ID3D12Device* const device, PipelineCache* const cache)
+{
+	m_device = device;
+	m_cache = cache;
+}
+
+std::shared_ptr<RootSignature> PipelineRegistry::GetRootSignature(std::unique_ptr<RootSignature> description)
+{
+	const uint64_t key = description->ComputeDescriptionHash();
+	return m_rootSignatures.GetOrCreate(key, [this, &description]()
+	{
+		std::shared_ptr<RootSignature> rootSignature = std::move(description);
+		rootSignature->Create(m_device);
+		return rootSignature;
+	});
+}
+
+std::shared_ptr<GraphicsPipelineState> PipelineRegistry::GetGraphicsPipelineState(
+	std::unique_ptr<GraphicsPipelineState> description)
+{
+	const uint64_t key = description->ComputeHash();
+	return m_pipelineStates.GetOrCreate(key, [this, &description]()
+	{
+		std::shared_ptr<GraphicsPipelineState> pipelineState = std::move(description);
+		pipelineState->Create(m_device, m_cache);
+		return pipelineState;
+	});
+}
+
+std::shared_ptr<ComputePipelineState> PipelineRegistry::GetComputePipelineState(
+	std::unique_ptr<ComputePipelineState> description)
+{
+	const uint64_t key = description->ComputeHash();
+	return m_computePipelineStates.GetOrCreate(key, [this, &description]()
+	{
+		std::shared_ptr<ComputePipelineState> pipelineState = std::move(description);
+		pipelineState->Create(m_device, m_cache);
+		return pipelineState;
+	});
+}
+
+uint32_t PipelineRegistry::Trim()
+{
+	return m_pipelineStates.Trim() + m_computePipelineStates.Trim() + m_rootSignatures.Trim();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../stdafx.h"
+#include "SharedObjectCache.h"
+
+class RootSignature;
+class GraphicsPipelineState;
+class ComputePipelineState;
+class PipelineCache;
+
+// Deduplicates root signatures and pipeline states by the hash of their description. Callers fill in a description and
+// hand it over; they get back the shared object for that description, created on first request. Safe to call from
+// several threads at once, and a request for a description that is already being created waits for it rather than
+// creating it again.
+class PipelineRegistry
+{
+public:
+	void Initialize(ID3D12Device* const device, PipelineCache* const cache = nullptr);
+	std::shared_ptr<RootSignature> GetRootSignature(std::unique_ptr<RootSignature> description);
+	// The root signature and shaders set on the description must be final, since they are part of its hash.
+	std::shared_ptr<GraphicsPipelineState> GetGraphicsPipelineState(std::unique_ptr<GraphicsPipelineState> description);
+	std::shared_ptr<ComputePipelineState> GetComputePipelineState(std::unique_ptr<ComputePipelineState> description);
+	// Releases objects only the registry still holds. Call once the GPU can no longer be using them.
+	uint32_t Trim();
+
+	uint32_t GetNumRootSignatures() const { return m_rootSignatures.GetNumEntries(); }
+	uint32_t GetNumPipelineStates() const
+	{
+		return m_pipelineStates.GetNumEntries() + m_computePipelineStates.GetNumEntries();
+	}
+	uint32_t GetNumHits() const
+	{
+		return m_rootSignatures.GetNumHits() + m_pipelineStates.GetNumHits() + m_computePipelineStates.GetNumHits();
+	}
+
+private:
+	ID3D12Device* m_device = nullptr;
+	PipelineCache* m_cache = nullptr;
+	SharedObjectCache<RootSignature> m_rootSignatures;
+	SharedObjectCache<GraphicsPipelineState> m_pipelineStates;
+	SharedObjectCache<ComputePipelineState> m_computePipelineStates;
+};
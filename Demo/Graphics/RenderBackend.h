@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// The small part of the graphics API the reference frame of FrameRenderer needs: buffers, textures, acceleration
+// structures, command recording and fences. D3D12RenderBackend runs it on the GPU and SoftwareRenderBackend on the CPU,
+// so scene updates, instance management and frame scheduling can be profiled and checked without a window or a D3D12
+// device. NullRenderBackend runs nothing, for timing recording alone. The windowed renderer in main.cpp does not go
+// through this interface.
+
+enum class BufferUsage : uint8_t
+{
+	Vertex = 0,
+	Index,
+	// structured buffer of RenderInstance, written by the CPU every frame
+	Instance
+};
+
+enum class TextureFormat : uint8_t
+{
+	RGBA8 = 0,
+	RGBA16Float,
+	Depth32
+};
+
+// Handles are indices into the backend's resource tables, offset by one so a default constructed handle is invalid.
+struct BufferHandle
+{
+	uint32_t ID = 0;
+	bool IsValid() const { return ID != 0; }
+};
+
+struct TextureHandle
+{
+	uint32_t ID = 0;
+	bool IsValid() const { return ID != 0; }
+};
+
+struct AccelerationStructureHandle
+{
+	uint32_t ID = 0;
+	bool IsValid() const { return ID != 0; }
+};
+
+// Same layout as Vertex in Model.h and the input layout of Shaders.hlsl.
+struct RenderVertex
+{
+	float Position[3];
+	float Normal[3];
+	float UV[2];
+};
+
+// Same layout as PerObject in Shaders.hlsl.
+struct RenderInstance
+{
+	float World[16];
+	float WorldInvTranspose[16];
+	uint32_t TextureID;
+	uint32_t VertexBufferID;
+	uint32_t IndexBufferID;
+	uint32_t Padding;
+};
+
+// PerFrame in Shaders.hlsl, followed by what the shadow pass needs to rebuild camera rays. Matrices are row major like
+// XMFLOAT4X4 and the light direction uses the same sign convention as the raster and raytracing shaders.
+struct FrameConstants
+{
+	float ViewProjection[16];
+	float LightDirection[4];
+	float LightDiffuse[4];
+	float LightAmbient[4];
+	float CameraPosition[4];
+	float InverseViewProjection[16];
+};
+
+struct DrawDesc
+{
+	BufferHandle VertexBuffer;
+	BufferHandle IndexBuffer;
+	uint32_t IndexCount = 0;
+	BufferHandle InstanceBuffer;
+	uint32_t FirstInstance = 0;
+	uint32_t InstanceCount = 0;
+};
+
+// Commands run in the order they were recorded once the list is submitted. Textures are moved between states by the
+// backend as commands use them, which needs everything before them in submission order to be recorded already: lists
+// holding clears, BeginRasterPass, TraceShadows or Composite are recorded one after another, while lists that only
+// resume a raster pass and draw can be recorded on several threads at once.
+class RenderCommandList
+{
+public:
+	virtual ~RenderCommandList() = default;
+
+	// value is four floats, of which depth textures use the first
+	virtual void ClearTexture(const TextureHandle texture, const float* const value) = 0;
+	// Binds the lit color target, the surface target (world normal facing the camera and distance, -1 where nothing was
+	// drawn) and depth for the draws that follow.
+	virtual void BeginRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) = 0;
+	// A raster pass can be left open at the end of a list. The next list in submission order continues it by resuming
+	// it with the same targets and constants, without any transitions or clears.
+	virtual void ResumeRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) = 0;
+	virtual void DrawIndexedInstanced(const DrawDesc& draw) = 0;
+	virtual void EndRasterPass() = 0;
+	// Rebuilds a top level acceleration structure from its instances.
+	virtual void BuildAccelerationStructure(const AccelerationStructureHandle accelerationStructure) = 0;
+	// One hard shadow ray towards the light per pixel with a surface. Writes visibility to rgb and 1 to alpha.
+	virtual void TraceShadows(const AccelerationStructureHandle scene, const TextureHandle surface,
+		const TextureHandle output, const FrameConstants& constants) = 0;
+	// output.rgb = color.rgb * shadow.rgb * shadow.a
+	virtual void Composite(const TextureHandle color, const TextureHandle shadow, const TextureHandle output) = 0;
+};
+
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() = default;
+
+	virtual const char* GetName() const = 0;
+
+	virtual BufferHandle CreateBuffer(const BufferUsage usage, const size_t size) = 0;
+	// Written straight away from the CPU. The caller makes sure no submitted work still reads the range.
+	virtual void WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data, const size_t size) = 0;
+	virtual TextureHandle CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height) = 0;
+	// Waits for all submitted work, then returns the texture as RGBA floats row by row.
+	virtual void ReadTexture(const TextureHandle texture, std::vector<float>& rgba) = 0;
+
+	// Built before this returns. Positions are the first three floats of each RenderVertex.
+	virtual AccelerationStructureHandle CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+		const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount) = 0;
+	virtual AccelerationStructureHandle CreateTopLevelAccelerationStructure(const uint32_t maxInstances) = 0;
+	// transform is a row major 3x4 matrix like D3D12_RAYTRACING_INSTANCE_DESC::Transform. An invalid bottomLevel or a
+	// zero mask leaves the slot empty. Like WriteBuffer this takes effect immediately, so a structure still used by
+	// submitted work must not be changed.
+	virtual void SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+		const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask) = 0;
+
+	// Opens another list, which stays open until Submit. Lists are begun on the submitting thread, but each can then be
+	// recorded on a thread of its own.
+	virtual RenderCommandList& BeginCommandList() = 0;
+	// Queues every open list at once in the order they were begun and returns the fence value that completes with them.
+	virtual uint64_t Submit() = 0;
+	virtual uint64_t GetCompletedFenceValue() = 0;
+	virtual void WaitForFence(const uint64_t value) = 0;
+};
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "RootSignature.h"
 #include "SamplerType.h"
+#include "../Hash.h"
 
 RootSignature::~RootSignature()
 {
@@ -65,6 +66,21 @@ void RootSignature::AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE type, c
 	m_parameters.push_back(rootParameter);
 }
 
+void RootSignature::AddRootConstantsParameter(const uint32_t num32BitValues, const uint32_t shaderRegister,
+	const uint32_t registerSpace, D3D12_SHADER_VISIBILITY shaderVisibility)
+{
+	D3D12_ROOT_CONSTANTS rootConstants = {};
+	rootConstants.Num32BitValues = num32BitValues;
+	rootConstants.ShaderRegister = shaderRegister;
+	rootConstants.RegisterSpace = registerSpace;
+
+	D3D12_ROOT_PARAMETER rootParameter = {};
+	rootParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameter.Constants = rootConstants;
+	rootParameter.ShaderVisibility = shaderVisibility;
+	m_parameters.push_back(rootParameter);
+}
+
 void RootSignature::AddStaticSampler(const SamplerType type,
 	const uint32_t shaderRegister, const uint32_t registerSpace, D3D12_SHADER_VISIBILITY shaderVisibility)
 {
@@ -149,4 +165,49 @@ void RootSignature::Create(ID3D12Device* const device)
 	assert(SUCCEEDED(hr));
 	hr = device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature));
 	assert(SUCCEEDED(hr));
-}
\ No newline at end of file
+	m_hash = HashBytes(signature->GetBufferPointer(), signature->GetBufferSize());
+}
+
+uint64_t RootSignature::ComputeDescriptionHash() const
+{
+	uint64_t hash = HashString("RootSignature");
+	hash = HashValue(m_flags, hash);
+	hash = HashValue(m_parameters.size(), hash);
+	for (const auto& parameter : m_parameters)
+	{
+		hash = HashValue(parameter.ParameterType, hash);
+		hash = HashValue(parameter.ShaderVisibility, hash);
+		switch (parameter.ParameterType)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+		{
+			const D3D12_ROOT_DESCRIPTOR_TABLE& table = parameter.DescriptorTable;
+			hash = HashValue(table.NumDescriptorRanges, hash);
+			uint32_t offset = 0;
+			for (uint32_t i = 0; i < table.NumDescriptorRanges; i++)
+			{
+				D3D12_DESCRIPTOR_RANGE range = table.pDescriptorRanges[i];
+				if (range.OffsetInDescriptorsFromTableStart == D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND)
+					range.OffsetInDescriptorsFromTableStart = offset;
+				offset = range.NumDescriptors == UINT_MAX ? UINT_MAX :
+					range.OffsetInDescriptorsFromTableStart + range.NumDescriptors;
+				hash = HashValue(range, hash);
+			}
+			break;
+		}
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			hash = HashValue(parameter.Constants, hash);
+			break;
+		default:
+			hash = HashValue(parameter.Descriptor, hash);
+			break;
+		}
+	}
+
+	hash = HashValue(m_staticSamplers.size(), hash);
+	for (const auto& sampler : m_staticSamplers)
+	{
+		hash = HashValue(sampler, hash);
+	}
+	return hash;
+}
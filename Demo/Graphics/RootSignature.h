@@ -13,11 +13,19 @@ public:
 		D3D12_SHADER_VISIBILITY shaderVisibility);
 	void AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE type, const uint32_t shaderRegister,
 		const uint32_t registerSpace, D3D12_SHADER_VISIBILITY shaderVisibility);
+	void AddRootConstantsParameter(const uint32_t num32BitValues, const uint32_t shaderRegister,
+		const uint32_t registerSpace, D3D12_SHADER_VISIBILITY shaderVisibility);
 	void AddStaticSampler(const SamplerType type,
 		const uint32_t shaderRegister, const uint32_t registerSpace, D3D12_SHADER_VISIBILITY shaderVisibility);
 	void SetFlags(const D3D12_ROOT_SIGNATURE_FLAGS flags);
 	void Create(ID3D12Device* const device);
+	// Hash of the parameters, samplers and flags before serialization. Appended descriptor range offsets are resolved
+	// first, so layouts that describe the same table in different ways hash the same.
+	uint64_t ComputeDescriptionHash() const;
 	ID3D12RootSignature* GetInterfacePtr() const { return m_rootSignature.Get(); }
+	const std::vector<D3D12_ROOT_PARAMETER>& GetParameters() const { return m_parameters; }
+	// Hash of the serialized description, stable across runs.
+	uint64_t GetHash() const { return m_hash; }
 
 private:
 	std::vector<D3D12_DESCRIPTOR_RANGE*> m_descriptorRanges = {};
@@ -25,4 +33,5 @@ private:
 	std::vector<D3D12_STATIC_SAMPLER_DESC> m_staticSamplers = {};
 	D3D12_ROOT_SIGNATURE_FLAGS m_flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 	ComPtr<ID3D12RootSignature> m_rootSignature;
+	uint64_t m_hash = 0;
 };
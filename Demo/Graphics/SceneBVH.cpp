@@ -0,0 +1,703 @@
+#include "stdafx.h"
+#include "SceneBVH.h"
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+
+namespace
+{
+	// Splits switch from SAH to the median this deep, which bounds the depth of the tree well within maxDepth.
+	const uint32_t medianSplitDepth = 32;
+
+	float GetAxis(const Float3& v, const uint32_t axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	Float3 GetCentroid(const BoundingBox& box)
+	{
+		return (box.Min + box.Max) * 0.5f;
+	}
+
+	// Distance along the ray to where it enters the box, or FLT_MAX when it misses it within maxDistance.
+	float IntersectBox(const BoundingBox& box, const Float3& origin, const Float3& inverseDirection, const float maxDistance)
+	{
+		float tMin = 0.f;
+		float tMax = maxDistance;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const float inverse = GetAxis(inverseDirection, axis);
+			float t0 = (GetAxis(box.Min, axis) - GetAxis(origin, axis)) * inverse;
+			float t1 = (GetAxis(box.Max, axis) - GetAxis(origin, axis)) * inverse;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			tMin = std::max(tMin, t0);
+			tMax = std::min(tMax, t1);
+		}
+		return tMin <= tMax ? tMin : FLT_MAX;
+	}
+}
+
+BoundingBox ComputeBoundingBox(const void* const vertices, const uint32_t numVertices, const uint32_t stride)
+{
+	BoundingBox box;
+	const uint8_t* const data = static_cast<const uint8_t*>(vertices);
+	for (uint32_t i = 0; i < numVertices; i++)
+	{
+		float position[3];
+		memcpy(position, data + static_cast<size_t>(i) * stride, sizeof(position));
+		box = Union(box, { { position[0], position[1], position[2] }, { position[0], position[1], position[2] } });
+	}
+	return box;
+}
+
+// The transformed center plus the extents projected onto each axis by the absolute matrix.
+BoundingBox TransformBoundingBox(const BoundingBox& box, const float* const matrix)
+{
+	const Float3 center = GetCentroid(box);
+	const Float3 extents = (box.Max - box.Min) * 0.5f;
+	float newCenter[3];
+	float newExtents[3];
+	for (uint32_t column = 0; column < 3; column++)
+	{
+		newCenter[column] = center.x * matrix[column] + center.y * matrix[4 + column] + center.z * matrix[8 + column] +
+			matrix[12 + column];
+		newExtents[column] = extents.x * std::abs(matrix[column]) + extents.y * std::abs(matrix[4 + column]) +
+			extents.z * std::abs(matrix[8 + column]);
+	}
+	return { { newCenter[0] - newExtents[0], newCenter[1] - newExtents[1], newCenter[2] - newExtents[2] },
+		{ newCenter[0] + newExtents[0], newCenter[1] + newExtents[1], newCenter[2] + newExtents[2] } };
+}
+
+void SceneBVH::Build(const std::vector<BoundingBox>& bounds)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+	m_bounds = bounds;
+	UpdateCentroids();
+	BuildAll();
+}
+
+void SceneBVH::Update(const std::vector<BoundingBox>& bounds)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
+	assert(bounds.size() == m_bounds.size());
+	m_bounds = bounds;
+	if (m_root == invalidNode)
+		return;
+
+	UpdateCentroids();
+	const std::vector<uint32_t> displaced = FindDisplaced();
+	uint32_t numSplitLeaves = 0;
+	uint32_t numSplitObjects = 0;
+	if (displaced.size() * 100 > m_bounds.size() * fullRebuildPercent ||
+		!Reinsert(displaced, numSplitLeaves, numSplitObjects))
+	{
+		BuildAll();
+		return;
+	}
+
+	const float ratio = SurfaceArea(m_nodes[m_root].Box) / std::max(m_nodes[m_root].BuildArea, FLT_MIN);
+	uint32_t numRebuiltObjects = 0;
+	const uint32_t numRebuiltSubtrees = RebuildDegraded(numRebuiltObjects);
+	m_statistics.NumReinsertedObjects = static_cast<uint32_t>(displaced.size());
+	m_statistics.NumRebuiltSubtrees = numSplitLeaves + numRebuiltSubtrees;
+	m_statistics.NumRebuiltObjects = numSplitObjects + numRebuiltObjects;
+	m_statistics.NumNodes = static_cast<uint32_t>(m_nodes.size() - m_freeNodes.size());
+	m_statistics.SurfaceAreaRatio = ratio;
+}
+
+void SceneBVH::QueryFrustum(const float* const viewProjection, std::vector<uint32_t>& objects) const
+{
+	// Clip space planes from the columns of the matrix: -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	const auto column = [viewProjection](const uint32_t index)
+	{
+		return std::array<float, 4>{ viewProjection[index], viewProjection[4 + index], viewProjection[8 + index],
+			viewProjection[12 + index] };
+	};
+	const std::array<float, 4> x = column(0);
+	const std::array<float, 4> y = column(1);
+	const std::array<float, 4> z = column(2);
+	const std::array<float, 4> w = column(3);
+	std::array<std::array<float, 4>, 6> planes;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		planes[0][i] = w[i] + x[i];
+		planes[1][i] = w[i] - x[i];
+		planes[2][i] = w[i] + y[i];
+		planes[3][i] = w[i] - y[i];
+		planes[4][i] = z[i];
+		planes[5][i] = w[i] - z[i];
+	}
+
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	if (m_root == invalidNode)
+		return;
+
+	// each entry carries the planes its box still has to be tested against
+	std::array<std::pair<uint32_t, uint32_t>, maxDepth + 1> stack;
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { m_root, (1u << 6) - 1 };
+	while (stackSize > 0)
+	{
+		const auto [index, planeMask] = stack[--stackSize];
+		const Node& node = m_nodes[index];
+		uint32_t remaining = planeMask;
+		bool outside = false;
+		for (uint32_t i = 0; i < 6 && !outside; i++)
+		{
+			if (!(remaining & (1u << i)))
+				continue;
+			const std::array<float, 4>& plane = planes[i];
+			const float farthest = plane[0] * (plane[0] > 0.f ? node.Box.Max.x : node.Box.Min.x) +
+				plane[1] * (plane[1] > 0.f ? node.Box.Max.y : node.Box.Min.y) +
+				plane[2] * (plane[2] > 0.f ? node.Box.Max.z : node.Box.Min.z) + plane[3];
+			const float nearest = plane[0] * (plane[0] > 0.f ? node.Box.Min.x : node.Box.Max.x) +
+				plane[1] * (plane[1] > 0.f ? node.Box.Min.y : node.Box.Max.y) +
+				plane[2] * (plane[2] > 0.f ? node.Box.Min.z : node.Box.Max.z) + plane[3];
+			outside = farthest < 0.f;
+			if (nearest >= 0.f)
+				remaining &= ~(1u << i);
+		}
+		if (outside)
+			continue;
+
+		// everything under a node inside every plane is visible without further tests
+		if (remaining == 0 || node.Children[0] == invalidNode)
+		{
+			if (remaining == 0)
+			{
+				objects.insert(objects.end(), m_objects.begin() + node.First, m_objects.begin() + node.First + node.Count);
+				continue;
+			}
+			for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			{
+				const uint32_t object = m_objects[i];
+				const BoundingBox& box = m_bounds[object];
+				bool visible = true;
+				for (uint32_t plane = 0; plane < 6 && visible; plane++)
+				{
+					if (!(remaining & (1u << plane)))
+						continue;
+					const std::array<float, 4>& p = planes[plane];
+					visible = p[0] * (p[0] > 0.f ? box.Max.x : box.Min.x) + p[1] * (p[1] > 0.f ? box.Max.y : box.Min.y) +
+						p[2] * (p[2] > 0.f ? box.Max.z : box.Min.z) + p[3] >= 0.f;
+				}
+				if (visible)
+					objects.push_back(object);
+			}
+			continue;
+		}
+		stack[stackSize++] = { node.Children[1], remaining };
+		stack[stackSize++] = { node.Children[0], remaining };
+	}
+}
+
+void SceneBVH::QueryOverlap(const BoundingBox& box, std::vector<uint32_t>& objects) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	if (m_root == invalidNode)
+		return;
+
+	std::array<uint32_t, maxDepth + 1> stack;
+	uint32_t stackSize = 0;
+	stack[stackSize++] = m_root;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (!Overlaps(node.Box, box))
+			continue;
+		if (node.Children[0] == invalidNode)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			{
+				if (Overlaps(m_bounds[m_objects[i]], box))
+					objects.push_back(m_objects[i]);
+			}
+			continue;
+		}
+		stack[stackSize++] = node.Children[1];
+		stack[stackSize++] = node.Children[0];
+	}
+}
+
+SceneBVH::RayHit SceneBVH::Raycast(const Float3& origin, const Float3& direction, const float maxDistance,
+	const std::function<bool(const uint32_t object, float& distance)>& intersect) const
+{
+	const Float3 inverseDirection = { 1.f / direction.x, 1.f / direction.y, 1.f / direction.z };
+	RayHit hit;
+	hit.Distance = maxDistance;
+
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	if (m_root == invalidNode)
+		return {};
+
+	std::array<uint32_t, maxDepth + 1> stack;
+	uint32_t stackSize = 0;
+	stack[stackSize++] = m_root;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (IntersectBox(node.Box, origin, inverseDirection, hit.Distance) == FLT_MAX)
+			continue;
+		if (node.Children[0] == invalidNode)
+		{
+			for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			{
+				const uint32_t object = m_objects[i];
+				float distance = IntersectBox(m_bounds[object], origin, inverseDirection, hit.Distance);
+				if (distance == FLT_MAX || (intersect && !intersect(object, distance)))
+					continue;
+				if (distance <= hit.Distance)
+				{
+					hit.Object = object;
+					hit.Distance = distance;
+				}
+			}
+			continue;
+		}
+
+		// nearer child on top of the stack, so the closest hit is found early and prunes the rest
+		const float near0 = IntersectBox(m_nodes[node.Children[0]].Box, origin, inverseDirection, hit.Distance);
+		const float near1 = IntersectBox(m_nodes[node.Children[1]].Box, origin, inverseDirection, hit.Distance);
+		const bool firstIsNearer = near0 <= near1;
+		stack[stackSize++] = node.Children[firstIsNearer ? 1 : 0];
+		stack[stackSize++] = node.Children[firstIsNearer ? 0 : 1];
+	}
+	return hit.Object == invalidObject ? RayHit() : hit;
+}
+
+SceneBVH::Statistics SceneBVH::GetStatistics() const
+{
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+uint32_t SceneBVH::AllocateNode()
+{
+	if (!m_freeNodes.empty())
+	{
+		const uint32_t index = m_freeNodes.back();
+		m_freeNodes.pop_back();
+		m_nodes[index] = Node();
+		return index;
+	}
+	m_nodes.emplace_back();
+	return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void SceneBVH::FreeSubtree(const uint32_t node)
+{
+	std::vector<uint32_t> stack = { node };
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		if (m_nodes[index].Children[0] != invalidNode)
+		{
+			stack.push_back(m_nodes[index].Children[0]);
+			stack.push_back(m_nodes[index].Children[1]);
+		}
+		m_freeNodes.push_back(index);
+	}
+}
+
+void SceneBVH::UpdateCentroids()
+{
+	m_centroids.resize(m_bounds.size());
+	for (size_t i = 0; i < m_bounds.size(); i++)
+		m_centroids[i] = GetCentroid(m_bounds[i]);
+}
+
+// Rebuilds the whole tree from the current bounds and centroids.
+void SceneBVH::BuildAll()
+{
+	m_objects.resize(m_bounds.size());
+	std::iota(m_objects.begin(), m_objects.end(), 0);
+	m_nodes.clear();
+	m_freeNodes.clear();
+	m_root = invalidNode;
+	m_statistics = {};
+	m_statistics.NumObjects = static_cast<uint32_t>(m_bounds.size());
+	if (m_bounds.empty())
+		return;
+
+	m_root = AllocateNode();
+	m_nodes[m_root].First = 0;
+	m_nodes[m_root].Count = static_cast<uint32_t>(m_bounds.size());
+	for (const BoundingBox& box : m_bounds)
+		m_nodes[m_root].Box = Union(m_nodes[m_root].Box, box);
+	BuildSubtree(m_root, 0);
+	m_statistics.NumNodes = static_cast<uint32_t>(m_nodes.size() - m_freeNodes.size());
+	m_statistics.NumRebuiltSubtrees = 1;
+	m_statistics.NumRebuiltObjects = m_statistics.NumObjects;
+}
+
+// Builds below a node that has its object range and box set, top down.
+void SceneBVH::BuildSubtree(const uint32_t root, const uint32_t rootDepth)
+{
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { root, rootDepth } };
+	while (!stack.empty())
+	{
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+
+		m_nodes[index].BuildArea = SurfaceArea(m_nodes[index].Box);
+		m_nodes[index].Children[0] = invalidNode;
+		m_nodes[index].Children[1] = invalidNode;
+		if (m_nodes[index].Count <= maxLeafSize)
+			continue;
+
+		const uint32_t first = m_nodes[index].First;
+		const uint32_t count = m_nodes[index].Count;
+		BoundingBox boxes[2];
+		const uint32_t numLeft = Partition(first, count, depth, boxes[0], boxes[1]);
+		const uint32_t left = AllocateNode();
+		const uint32_t right = AllocateNode();
+		m_nodes[left].First = first;
+		m_nodes[left].Count = numLeft;
+		m_nodes[left].Box = boxes[0];
+		m_nodes[right].First = first + numLeft;
+		m_nodes[right].Count = count - numLeft;
+		m_nodes[right].Box = boxes[1];
+		m_nodes[index].Children[0] = left;
+		m_nodes[index].Children[1] = right;
+		stack.push_back({ right, depth + 1 });
+		stack.push_back({ left, depth + 1 });
+	}
+}
+
+// Reorders the objects so the first of the returned number go to the left child, and returns the bounds of both sides.
+// Splits along the longest axis of the centroids at the cheapest of the bin boundaries by the surface area heuristic.
+uint32_t SceneBVH::Partition(const uint32_t first, const uint32_t count, const uint32_t depth, BoundingBox& leftBounds,
+	BoundingBox& rightBounds)
+{
+	const auto begin = m_objects.begin() + first;
+	const auto end = begin + count;
+
+	BoundingBox centroidBox;
+	for (auto it = begin; it != end; ++it)
+	{
+		const Float3& centroid = m_centroids[*it];
+		centroidBox = Union(centroidBox, { centroid, centroid });
+	}
+	const Float3 extent = centroidBox.Max - centroidBox.Min;
+	const uint32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	const float axisMin = GetAxis(centroidBox.Min, axis);
+	const float axisExtent = GetAxis(extent, axis);
+
+	const auto medianSplit = [&]()
+	{
+		std::nth_element(begin, begin + count / 2, end, [this, axis](const uint32_t a, const uint32_t b)
+		{
+			return GetAxis(m_centroids[a], axis) < GetAxis(m_centroids[b], axis);
+		});
+		for (auto it = begin; it != end; ++it)
+		{
+			BoundingBox& side = it < begin + count / 2 ? leftBounds : rightBounds;
+			side = Union(side, m_bounds[*it]);
+		}
+		return count / 2;
+	};
+	if (axisExtent <= 0.f || depth >= medianSplitDepth)
+		return medianSplit();
+
+	const float binScale = numBins / axisExtent;
+	const auto getBin = [&](const uint32_t object)
+	{
+		const float position = GetAxis(m_centroids[object], axis);
+		return std::min(static_cast<uint32_t>((position - axisMin) * binScale), numBins - 1);
+	};
+	std::array<BoundingBox, numBins> binBoxes;
+	std::array<uint32_t, numBins> binCounts = {};
+	for (auto it = begin; it != end; ++it)
+	{
+		const uint32_t bin = getBin(*it);
+		binBoxes[bin] = Union(binBoxes[bin], m_bounds[*it]);
+		binCounts[bin]++;
+	}
+
+	// sweep from the right for the bounds of every right side, then from the left to find the cheapest split
+	std::array<BoundingBox, numBins> rightBoxes;
+	std::array<uint32_t, numBins> rightCounts = {};
+	BoundingBox rightBox;
+	uint32_t rightCount = 0;
+	for (uint32_t bin = numBins - 1; bin > 0; bin--)
+	{
+		rightBox = Union(rightBox, binBoxes[bin]);
+		rightCount += binCounts[bin];
+		rightBoxes[bin] = rightBox;
+		rightCounts[bin] = rightCount;
+	}
+	BoundingBox leftBox;
+	uint32_t leftCount = 0;
+	float bestCost = FLT_MAX;
+	uint32_t bestSplit = 0;
+	for (uint32_t split = 1; split < numBins; split++)
+	{
+		leftBox = Union(leftBox, binBoxes[split - 1]);
+		leftCount += binCounts[split - 1];
+		const float cost = SurfaceArea(leftBox) * leftCount + SurfaceArea(rightBoxes[split]) * rightCounts[split];
+		if (leftCount > 0 && leftCount < count && cost < bestCost)
+		{
+			bestCost = cost;
+			bestSplit = split;
+			leftBounds = leftBox;
+		}
+	}
+	if (bestSplit == 0)
+		return medianSplit();
+	rightBounds = rightBoxes[bestSplit];
+
+	const auto middle = std::partition(begin, end, [&](const uint32_t object) { return getBin(object) < bestSplit; });
+	return static_cast<uint32_t>(middle - begin);
+}
+
+// Children come after their parents in preorder, so walking it backwards fits every child before its parent.
+void SceneBVH::Refit()
+{
+	std::vector<uint32_t> order;
+	order.reserve(m_nodes.size());
+	std::vector<uint32_t> stack = { m_root };
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		order.push_back(index);
+		if (m_nodes[index].Children[0] != invalidNode)
+		{
+			stack.push_back(m_nodes[index].Children[1]);
+			stack.push_back(m_nodes[index].Children[0]);
+		}
+	}
+
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		Node& node = m_nodes[*it];
+		if (node.Children[0] != invalidNode)
+		{
+			node.Box = Union(m_nodes[node.Children[0]].Box, m_nodes[node.Children[1]].Box);
+			continue;
+		}
+		BoundingBox box;
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			box = Union(box, m_bounds[m_objects[i]]);
+		node.Box = box;
+	}
+}
+
+// Objects whose new bounds no longer overlap the box of their leaf from the last update. Refitting would stretch the
+// leaf and everything above it to wherever they went.
+std::vector<uint32_t> SceneBVH::FindDisplaced() const
+{
+	std::vector<uint32_t> displaced;
+	std::vector<uint32_t> stack = { m_root };
+	while (!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if (node.Children[0] != invalidNode)
+		{
+			stack.push_back(node.Children[1]);
+			stack.push_back(node.Children[0]);
+			continue;
+		}
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			if (!Overlaps(m_bounds[m_objects[i]], node.Box))
+				displaced.push_back(m_objects[i]);
+		}
+	}
+	return displaced;
+}
+
+// Takes the objects out of their leaves, which keep the rest at the start of their range, and replaces every node left
+// with a single non-empty child by that child. Must not remove every object.
+void SceneBVH::RemoveObjects(const std::vector<uint32_t>& objects)
+{
+	std::vector<bool> removed(m_bounds.size(), false);
+	for (const uint32_t object : objects)
+		removed[object] = true;
+
+	std::vector<uint32_t> order;
+	order.reserve(m_nodes.size());
+	std::vector<uint32_t> stack = { m_root };
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		order.push_back(index);
+		if (m_nodes[index].Children[0] != invalidNode)
+		{
+			stack.push_back(m_nodes[index].Children[1]);
+			stack.push_back(m_nodes[index].Children[0]);
+		}
+	}
+
+	// children before their parents, so an empty child has already been made a leaf
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		Node& node = m_nodes[*it];
+		if (node.Children[0] == invalidNode)
+		{
+			uint32_t kept = node.First;
+			for (uint32_t i = node.First; i < node.First + node.Count; i++)
+			{
+				if (!removed[m_objects[i]])
+					m_objects[kept++] = m_objects[i];
+			}
+			node.Count = kept - node.First;
+			continue;
+		}
+
+		const uint32_t left = node.Children[0];
+		const uint32_t right = node.Children[1];
+		if (m_nodes[left].Count > 0 && m_nodes[right].Count > 0)
+		{
+			node.Count = m_nodes[left].Count + m_nodes[right].Count;
+			continue;
+		}
+		m_freeNodes.push_back(left);
+		m_freeNodes.push_back(right);
+		if (m_nodes[left].Count > 0 || m_nodes[right].Count > 0)
+		{
+			node = m_nodes[m_nodes[left].Count > 0 ? left : right];
+			continue;
+		}
+		node.Children[0] = invalidNode;
+		node.Children[1] = invalidNode;
+		node.Count = 0;
+	}
+	assert(m_nodes[m_root].Count > 0);
+}
+
+// Removes the objects, refits what is left and inserts each object again below the child its box grows the least,
+// splitting the leaves that end up with more than maxLeafSize objects. Returns false, leaving the tree to be rebuilt,
+// when a split could go deeper than maxDepth.
+bool SceneBVH::Reinsert(const std::vector<uint32_t>& objects, uint32_t& numRebuiltSubtrees, uint32_t& numRebuiltObjects)
+{
+	numRebuiltSubtrees = 0;
+	numRebuiltObjects = 0;
+	if (objects.empty())
+	{
+		Refit();
+		return true;
+	}
+	RemoveObjects(objects);
+	Refit();
+
+	// leaf and object
+	std::vector<std::pair<uint32_t, uint32_t>> insertions;
+	insertions.reserve(objects.size());
+	for (const uint32_t object : objects)
+	{
+		const BoundingBox& box = m_bounds[object];
+		uint32_t index = m_root;
+		while (true)
+		{
+			Node& node = m_nodes[index];
+			node.Box = Union(node.Box, box);
+			node.Count++;
+			if (node.Children[0] == invalidNode)
+				break;
+			const BoundingBox& left = m_nodes[node.Children[0]].Box;
+			const BoundingBox& right = m_nodes[node.Children[1]].Box;
+			const float leftGrowth = SurfaceArea(Union(left, box)) - SurfaceArea(left);
+			const float rightGrowth = SurfaceArea(Union(right, box)) - SurfaceArea(right);
+			const bool goLeft = leftGrowth < rightGrowth ||
+				(leftGrowth == rightGrowth && SurfaceArea(left) <= SurfaceArea(right));
+			index = node.Children[goLeft ? 0 : 1];
+		}
+		insertions.push_back({ index, object });
+	}
+	std::sort(insertions.begin(), insertions.end());
+
+	// Lay the objects out again in tree order, each leaf's remaining objects followed by its inserted ones, so every
+	// subtree covers a contiguous range again.
+	std::vector<uint32_t> reordered;
+	reordered.reserve(m_objects.size());
+	std::vector<std::pair<uint32_t, uint32_t>> overfull;
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { m_root, 0 } };
+	while (!stack.empty())
+	{
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+		Node& node = m_nodes[index];
+		const uint32_t first = node.First;
+		node.First = static_cast<uint32_t>(reordered.size());
+		if (node.Children[0] != invalidNode)
+		{
+			stack.push_back({ node.Children[1], depth + 1 });
+			stack.push_back({ node.Children[0], depth + 1 });
+			continue;
+		}
+		const auto byLeaf = [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b)
+		{
+			return a.first < b.first;
+		};
+		const auto inserted = std::equal_range(insertions.begin(), insertions.end(), std::make_pair(index, 0u), byLeaf);
+		const uint32_t numKept = node.Count - static_cast<uint32_t>(inserted.second - inserted.first);
+		reordered.insert(reordered.end(), m_objects.begin() + first, m_objects.begin() + first + numKept);
+		for (auto it = inserted.first; it != inserted.second; ++it)
+			reordered.push_back(it->second);
+		if (node.Count > maxLeafSize)
+			overfull.push_back({ index, depth });
+	}
+	m_objects.swap(reordered);
+
+	for (const auto& [index, depth] : overfull)
+	{
+		// splits are SAH down to medianSplitDepth and halve the objects below it
+		uint32_t splitDepth = std::max(depth, medianSplitDepth);
+		for (uint32_t count = m_nodes[index].Count; count > maxLeafSize; count = (count + 1) / 2)
+			splitDepth++;
+		if (splitDepth > maxDepth)
+			return false;
+		numRebuiltObjects += m_nodes[index].Count;
+		BuildSubtree(index, depth);
+	}
+	numRebuiltSubtrees = static_cast<uint32_t>(overfull.size());
+	return true;
+}
+
+// Rebuilds the highest subtrees that have grown past the threshold and returns how many there were. Objects cannot move
+// between subtrees rebuilt on their own, so when most of the tree needs rebuilding all of it is.
+uint32_t SceneBVH::RebuildDegraded(uint32_t& numRebuiltObjects)
+{
+	std::vector<std::pair<uint32_t, uint32_t>> degraded;
+	uint32_t numDegradedObjects = 0;
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { m_root, 0 } };
+	while (!stack.empty())
+	{
+		const auto [index, depth] = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[index];
+		if (node.Children[0] == invalidNode)
+			continue;
+		if (SurfaceArea(node.Box) > m_rebuildThreshold * std::max(node.BuildArea, FLT_MIN))
+		{
+			degraded.push_back({ index, depth });
+			numDegradedObjects += node.Count;
+			continue;
+		}
+		stack.push_back({ node.Children[1], depth + 1 });
+		stack.push_back({ node.Children[0], depth + 1 });
+	}
+	if (static_cast<uint64_t>(numDegradedObjects) * 100 >
+		static_cast<uint64_t>(m_nodes[m_root].Count) * fullRebuildPercent)
+		degraded = { { m_root, 0 } };
+
+	numRebuiltObjects = 0;
+	for (const auto& [index, depth] : degraded)
+	{
+		if (m_nodes[index].Children[0] != invalidNode)
+		{
+			FreeSubtree(m_nodes[index].Children[0]);
+			FreeSubtree(m_nodes[index].Children[1]);
+		}
+		numRebuiltObjects += m_nodes[index].Count;
+		BuildSubtree(index, depth);
+	}
+	return static_cast<uint32_t>(degraded.size());
+}
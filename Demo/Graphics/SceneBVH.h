@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <vector>
+#include "Float3.h"
+
+// Axis aligned, in world space unless stated otherwise. Default constructed boxes are empty.
+struct BoundingBox
+{
+	Float3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Float3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+};
+
+inline BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+	return { { std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z) },
+		{ std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z) } };
+}
+
+inline bool Overlaps(const BoundingBox& a, const BoundingBox& b)
+{
+	return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x && a.Min.y <= b.Max.y && a.Max.y >= b.Min.y &&
+		a.Min.z <= b.Max.z && a.Max.z >= b.Min.z;
+}
+
+inline float SurfaceArea(const BoundingBox& box)
+{
+	const Float3 size = box.Max - box.Min;
+	if (size.x < 0.f || size.y < 0.f || size.z < 0.f)
+		return 0.f;
+	return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Bounds of vertex positions, each the first three floats of a vertex stride bytes long.
+BoundingBox ComputeBoundingBox(const void* const vertices, const uint32_t numVertices, const uint32_t stride);
+// Bounds of a box transformed by a row major 4x4 matrix laid out like XMFLOAT4X4.
+BoundingBox TransformBoundingBox(const BoundingBox& box, const float* const matrix);
+
+// Bounding volume hierarchy over the world bounds of scene objects, for culling, picking and overlap queries. Objects are
+// the indices of the bounds given to Build. Update refits the tree to new bounds. Objects that no longer overlap their
+// leaf are taken out first and inserted again where they now are, splitting the leaves they overfill, so objects that
+// jump across the scene do not stretch their old subtree over it. Subtrees whose surface area has then grown past the
+// rebuild threshold times what it was when they were built are rebuilt with binned SAH splits. The whole tree is rebuilt
+// instead when more than fullRebuildPercent of the objects left their leaves or are in degraded subtrees. Queries take a
+// shared lock and may run on any number of threads at once; Build and Update wait for them and block them while they
+// change the tree.
+class SceneBVH
+{
+public:
+	static const uint32_t maxLeafSize = 4;
+	static const uint32_t maxDepth = 64;
+	static const uint32_t invalidObject = UINT32_MAX;
+	static const uint32_t fullRebuildPercent = 50;
+
+	struct RayHit
+	{
+		uint32_t Object = invalidObject;
+		float Distance = FLT_MAX;
+	};
+
+	struct Statistics
+	{
+		uint32_t NumObjects = 0;
+		uint32_t NumNodes = 0;
+		// of the last Update
+		uint32_t NumReinsertedObjects = 0;
+		uint32_t NumRebuiltSubtrees = 0;
+		uint32_t NumRebuiltObjects = 0;
+		// root surface area relative to when it was built
+		float SurfaceAreaRatio = 1.f;
+	};
+
+public:
+	void Build(const std::vector<BoundingBox>& bounds);
+	// The number of objects must not change between builds.
+	void Update(const std::vector<BoundingBox>& bounds);
+	void SetRebuildThreshold(const float threshold) { m_rebuildThreshold = threshold; }
+
+	// Both add the objects found to the end of objects, in no particular order. viewProjection is a row major 4x4 matrix
+	// laid out like XMFLOAT4X4, with D3D clip space.
+	void QueryFrustum(const float* const viewProjection, std::vector<uint32_t>& objects) const;
+	void QueryOverlap(const BoundingBox& box, std::vector<uint32_t>& objects) const;
+	// The closest object whose bounds the ray enters within maxDistance. When given, intersect refines each candidate:
+	// it returns whether the ray really hits the object and sets the distance when it does.
+	RayHit Raycast(const Float3& origin, const Float3& direction, const float maxDistance,
+		const std::function<bool(const uint32_t object, float& distance)>& intersect = {}) const;
+
+	Statistics GetStatistics() const;
+
+private:
+	static const uint32_t invalidNode = UINT32_MAX;
+	static const uint32_t numBins = 16;
+
+	// Every node covers objects First to First + Count - 1 of m_objects. Leaves have no children.
+	struct Node
+	{
+		BoundingBox Box;
+		float BuildArea = 0.f;
+		uint32_t Children[2] = { invalidNode, invalidNode };
+		uint32_t First = 0;
+		uint32_t Count = 0;
+	};
+
+	uint32_t AllocateNode();
+	void FreeSubtree(const uint32_t node);
+	void UpdateCentroids();
+	void BuildAll();
+	void BuildSubtree(const uint32_t root, const uint32_t rootDepth);
+	uint32_t Partition(const uint32_t first, const uint32_t count, const uint32_t depth, BoundingBox& leftBounds,
+		BoundingBox& rightBounds);
+	void Refit();
+	std::vector<uint32_t> FindDisplaced() const;
+	void RemoveObjects(const std::vector<uint32_t>& objects);
+	bool Reinsert(const std::vector<uint32_t>& objects, uint32_t& numRebuiltSubtrees, uint32_t& numRebuiltObjects);
+	uint32_t RebuildDegraded(uint32_t& numRebuiltObjects);
+
+private:
+	mutable std::shared_mutex m_mutex;
+	std::vector<BoundingBox> m_bounds;
+	std::vector<Float3> m_centroids;
+	std::vector<uint32_t> m_objects;
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_freeNodes;
+	uint32_t m_root = invalidNode;
+	float m_rebuildThreshold = 1.5f;
+	Statistics m_statistics;
+};
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "SceneVisibility.h"
+#include "../Profiler.h"
+
+void SceneVisibility::SetMesh(const uint32_t mesh, const void* const vertices, const uint32_t numVertices,
+	const uint32_t stride, const uint32_t* const indices, const uint32_t numIndices)
+{
+	if (mesh >= m_meshBounds.size())
+		m_meshBounds.resize(mesh + 1);
+	m_meshBounds[mesh] = ComputeBoundingBox(vertices, numVertices, stride);
+	m_culling.SetOccluderMesh(mesh, vertices, numVertices, stride, indices, numIndices);
+}
+
+void SceneVisibility::UpdateBounds(const TransformSystem& transforms, const uint32_t* const objectMeshIDs,
+	const uint32_t numObjects)
+{
+	PROFILE_SCOPE("Scene BVH");
+	assert(numObjects <= transforms.GetCount());
+	const bool built = m_objectBounds.size() == numObjects && numObjects > 0;
+	m_objectBounds.resize(numObjects);
+	for (uint32_t i = 0; i < numObjects; i++)
+	{
+		m_objectBounds[i] = TransformBoundingBox(m_meshBounds[objectMeshIDs[i]], transforms.GetWorldMatrix(i));
+	}
+	if (built)
+		m_bvh.Update(m_objectBounds);
+	else
+		m_bvh.Build(m_objectBounds);
+}
+
+void SceneVisibility::CullAndBatch(const float* const viewProjection, const TransformSystem& transforms,
+	const uint32_t* const objectMeshIDs, const uint32_t numObjects, const CullingSystem::Settings& settings)
+{
+	PROFILE_SCOPE("Cull and batch");
+	assert(numObjects == m_objectBounds.size());
+	m_cullingObjects.resize(numObjects);
+	for (uint32_t i = 0; i < numObjects; i++)
+	{
+		m_cullingObjects[i].Bounds = m_objectBounds[i];
+		m_cullingObjects[i].World = transforms.GetWorldMatrix(i);
+		m_cullingObjects[i].OccluderMesh = objectMeshIDs[i];
+	}
+	m_culling.Cull(viewProjection, m_bvh, m_cullingObjects, settings, m_visible);
+
+	m_batcher.Reset();
+	for (const uint32_t object : m_visible)
+	{
+		m_batcher.AddInstance(objectMeshIDs[object], object);
+	}
+	m_batcher.Build();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "CullingSystem.h"
+#include "InstanceBatcher.h"
+#include "SceneBVH.h"
+#include "TransformSystem.h"
+
+// The CPU side of a frame ahead of recording, shared by the windowed demo and FrameRenderer so both run the same
+// code: refitting the scene BVH to the objects' world bounds, culling the objects through it against the view and the
+// largest occluders, and batching the visible ones by mesh. Object i draws mesh objectMeshIDs[i] with the transforms
+// at index i.
+class SceneVisibility
+{
+public:
+	static const uint32_t noMesh = UINT32_MAX;
+
+public:
+	// Positions are the first three floats of each vertex, stride bytes apart. Every mesh may occlude.
+	void SetMesh(const uint32_t mesh, const void* const vertices, const uint32_t numVertices, const uint32_t stride,
+		const uint32_t* const indices, const uint32_t numIndices);
+	// Builds the scene BVH the first time and whenever the number of objects changes, and refits it otherwise.
+	void UpdateBounds(const TransformSystem& transforms, const uint32_t* const objectMeshIDs,
+		const uint32_t numObjects);
+	// Culls with the scene BVH as the frustum stage, then batches what is visible. viewProjection is a row major 4x4
+	// matrix laid out like XMFLOAT4X4, with D3D clip space.
+	void CullAndBatch(const float* const viewProjection, const TransformSystem& transforms,
+		const uint32_t* const objectMeshIDs, const uint32_t numObjects, const CullingSystem::Settings& settings);
+
+	// Visible objects in increasing order, valid after CullAndBatch.
+	const std::vector<uint32_t>& GetVisibleObjects() const { return m_visible; }
+	const InstanceBatcher& GetBatcher() const { return m_batcher; }
+	const CullingSystem::Statistics& GetCullingStatistics() const { return m_culling.GetStatistics(); }
+
+	// Slot i of a top level acceleration structure holds object i, whether culled or not, since rays see the whole
+	// scene. Slots past the objects up to numSlots get noMesh, a mask of 0 and object 0's transform, so they drop out
+	// of the build. setInstance(slot, meshID, transform, mask) writes one slot; transform is a row major 3x4 matrix.
+	template <class SetInstance>
+	static void UpdateInstances(const TransformSystem& transforms, const uint32_t* const objectMeshIDs,
+		const uint32_t numObjects, const uint32_t numSlots, const SetInstance& setInstance)
+	{
+		for (uint32_t i = 0; i < numSlots; i++)
+		{
+			if (i < numObjects)
+				setInstance(i, objectMeshIDs[i], transforms.GetRaytracingTransform(i), static_cast<uint8_t>(0xFF));
+			else
+				setInstance(i, noMesh, transforms.GetRaytracingTransform(0), static_cast<uint8_t>(0));
+		}
+	}
+
+private:
+	std::vector<BoundingBox> m_meshBounds;
+	std::vector<BoundingBox> m_objectBounds;
+	SceneBVH m_bvh;
+	CullingSystem m_culling;
+	std::vector<CullingObject> m_cullingObjects;
+	std::vector<uint32_t> m_visible;
+	InstanceBatcher m_batcher;
+};
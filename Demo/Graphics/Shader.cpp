@@ -1,6 +1,20 @@
 #include "stdafx.h"
 #include "Shader.h"
 #include "ShaderBlob.h"
+#include "PipelineCache.h"
+#include "../Hash.h"
+
+static const char* shaderBinaryDirectory = "ShaderBinary";
+
+static std::wstring Widen(const std::string& string)
+{
+	return std::filesystem::path(string).wstring();
+}
+
+static std::string Narrow(LPCWSTR string)
+{
+	return std::filesystem::path(string).string();
+}
 
 Shader::~Shader()
 {
@@ -16,83 +30,119 @@ void Shader::InitializeFromBinary(const std::string& filepath)
 	std::vector<uint8_t> data = ReadData(filepath);
 	blob->MoveDataIntoBlob(data);
 
-	m_blob = blob;
-	m_bufferLength = m_blob->BufferLength();
-	m_bufferPointer = m_blob->BufferPointer();
+	SetBlob(blob);
 }
 
-void Shader::FXCCompile(LPCWSTR filepath, LPCSTR entryPoint, LPCSTR target)
+void Shader::FXCCompile(LPCWSTR filepath, LPCSTR entryPoint, LPCSTR target, PipelineCache* const cache,
+	const std::vector<ShaderDefine>& defines)
 {
+	const uint64_t key = ComputeKey(ShaderCompiler::FXC, filepath, entryPoint, target, defines);
+	if (InitializeFromPrecompiledOrCache(cache, key))
+		return;
+
 	FXCShaderBlob* blob = new FXCShaderBlob;
 
-	ComPtr<ID3DBlob> errBuff;
-	UINT flags1 = 0;
-#ifdef _DEBUG
-	flags1 = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-	HRESULT hr = D3DCompileFromFile(filepath, nullptr, nullptr, entryPoint, target,
-		flags1, 0, blob->GetAddressOf(), &errBuff);
+	std::string errors;
+	HRESULT hr = CompileWithFXC(filepath, entryPoint, target, defines, blob->GetAddressOf(), errors);
 	if (FAILED(hr))
-		std::cout << (char*)errBuff->GetBufferPointer();
+		std::cout << errors;
 	else
 		assert(SUCCEEDED(hr));
 
-	m_blob = blob;
-	m_bufferLength = m_blob->BufferLength();
-	m_bufferPointer = m_blob->BufferPointer();
+	SetBlob(blob);
+	if (cache)
+		cache->Store(key, m_bufferPointer, m_bufferLength);
 }
 
-void Shader::DXCCompile(LPCWSTR filepath, LPCWSTR entryPoint, LPCWSTR target)
+void Shader::DXCCompile(LPCWSTR filepath, LPCWSTR entryPoint, LPCWSTR target, PipelineCache* const cache,
+	const std::vector<ShaderDefine>& defines)
 {
+	const uint64_t key = ComputeKey(ShaderCompiler::DXC, filepath, Narrow(entryPoint), Narrow(target), defines);
+	if (InitializeFromPrecompiledOrCache(cache, key))
+		return;
+
 	DXCShaderBlob* blob = new DXCShaderBlob;
 
-	ComPtr<IDxcLibrary> library;
-	HRESULT hr = DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&library));
-	assert(SUCCEEDED(hr));
+	std::string errors;
+	HRESULT hr = CompileWithDXC(filepath, Narrow(entryPoint), Narrow(target), defines, blob->GetAddressOf(), errors);
+	if (FAILED(hr))
+	{
+		std::cout << errors << std::endl;
+		assert(false);
+	}
 
-	ComPtr<IDxcCompiler> compiler;
-	hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
-	assert(SUCCEEDED(hr));
+	SetBlob(blob);
+	if (cache)
+		cache->Store(key, m_bufferPointer, m_bufferLength);
+}
 
-	uint32_t codePage = CP_UTF8;
-	ComPtr<IDxcBlobEncoding> sourceBlob;
-	hr = library->CreateBlobFromFile(filepath, &codePage, &sourceBlob);
-	assert(SUCCEEDED(hr));
+bool Shader::TryCompile(const ShaderCompiler compiler, const std::filesystem::path& filepath, const std::string& entryPoint,
+	const std::string& target, PipelineCache* const cache, const std::vector<ShaderDefine>& defines, std::string& errors)
+{
+	const uint64_t key = ComputeKey(compiler, filepath, entryPoint, target, defines);
+	if (InitializeFromPrecompiledOrCache(cache, key))
+		return true;
 
-	ComPtr<IDxcOperationResult> result;
-	hr = compiler->Compile(
-		sourceBlob.Get(),
-		filepath,
-		entryPoint,
-		target,
-		NULL, 0,
-		NULL, 0,
-		NULL,
-		&result
-	);
-	result->GetStatus(&hr);
-	if (FAILED(hr))
+	std::vector<uint8_t> bytecode;
+	if (!Compile(compiler, filepath, entryPoint, target, defines, bytecode, errors))
+		return false;
+
+	CompiledShaderBlob* blob = new CompiledShaderBlob;
+	blob->MoveDataIntoBlob(bytecode);
+	SetBlob(blob);
+	if (cache)
+		cache->Store(key, m_bufferPointer, m_bufferLength);
+	return true;
+}
+
+bool Shader::Compile(const ShaderCompiler compiler, const std::filesystem::path& filepath, const std::string& entryPoint,
+	const std::string& target, const std::vector<ShaderDefine>& defines, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	ComPtr<ID3DBlob> fxcBlob;
+	ComPtr<IDxcBlob> dxcBlob;
+	if (compiler == ShaderCompiler::FXC)
 	{
-		if (result)
-		{
-			ComPtr<IDxcBlobEncoding> errorsBlob;
-			HRESULT hr = result->GetErrorBuffer(&errorsBlob);
-			if (SUCCEEDED(hr) && errorsBlob)
-			{
-				std::wcout << (const char*)errorsBlob->GetBufferPointer() << std::endl;
-			}
-			assert(false);
-		}
+		if (FAILED(CompileWithFXC(filepath, entryPoint, target, defines, &fxcBlob, errors)))
+			return false;
+		data = static_cast<const uint8_t*>(fxcBlob->GetBufferPointer());
+		size = fxcBlob->GetBufferSize();
 	}
 	else
 	{
-		assert(SUCCEEDED(hr));
-		result->GetResult(blob->GetAddressOf());
+		if (FAILED(CompileWithDXC(filepath, entryPoint, target, defines, &dxcBlob, errors)))
+			return false;
+		data = static_cast<const uint8_t*>(dxcBlob->GetBufferPointer());
+		size = dxcBlob->GetBufferSize();
 	}
 
-	m_blob = blob;
-	m_bufferLength = m_blob->BufferLength();
-	m_bufferPointer = m_blob->BufferPointer();
+	bytecode.assign(data, data + size);
+	return true;
+}
+
+uint64_t Shader::ComputeKey(const ShaderCompiler compiler, const std::filesystem::path& filepath, const std::string& entryPoint,
+	const std::string& target, const std::vector<ShaderDefine>& defines)
+{
+	std::vector<std::filesystem::path> visited;
+	uint64_t key = HashValue(compiler);
+	key = HashSource(filepath, key, visited);
+	key = HashString(entryPoint, key);
+	key = HashString(target, key);
+	key = HashValue(compiler == ShaderCompiler::FXC ? GetFXCFlags() : 0u, key);
+	for (const auto& define : defines)
+	{
+		key = HashString(define.Name, key);
+		key = HashString(define.Value, key);
+	}
+	return key;
+}
+
+std::string Shader::GetBinaryPath(const std::string& binaryDirectory, const uint64_t key)
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(binaryDirectory) / (std::string(name) + ".cso")).string();
 }
 
 uintmax_t Shader::FileSize(const std::string& filepath)
@@ -114,8 +164,157 @@ std::vector<uint8_t> Shader::ReadData(const std::string& filepath)
 		auto size = FileSize(filepath);
 		data.resize(static_cast<size_t>(size));
 		fs.seekg(0, std::ios::beg);
-		fs.read(reinterpret_cast<char*>(&data[0]), size);
+		fs.read(reinterpret_cast<char*>(data.data()), size);
 		fs.close();
 	}
 	return data;
-}
\ No newline at end of file
+}
+
+// Hashes the file followed by every file it includes, depth first. Include names are resolved relative to the including
+// file; ones that cannot be found still contribute their name so adding the file later changes the hash.
+uint64_t Shader::HashSource(const std::filesystem::path& filepath, uint64_t hash, std::vector<std::filesystem::path>& visited)
+{
+	if (std::find(visited.begin(), visited.end(), filepath) != visited.end())
+		return hash;
+	visited.push_back(filepath);
+
+	std::vector<uint8_t> source = ReadData(filepath.string());
+	hash = HashBytes(source.data(), source.size(), hash);
+
+	std::string text(source.begin(), source.end());
+	size_t position = 0;
+	while ((position = text.find("#include", position)) != std::string::npos)
+	{
+		position += strlen("#include");
+		const size_t open = text.find_first_of("\"<", position);
+		if (open == std::string::npos)
+			break;
+		const size_t close = text.find_first_of("\">", open + 1);
+		if (close == std::string::npos)
+			break;
+
+		const std::string includeName = text.substr(open + 1, close - open - 1);
+		const std::filesystem::path includePath = filepath.parent_path() / includeName;
+		if (std::filesystem::exists(includePath))
+			hash = HashSource(includePath, hash, visited);
+		else
+			hash = HashString(includeName, hash);
+		position = close;
+	}
+
+	return hash;
+}
+
+UINT Shader::GetFXCFlags()
+{
+	UINT flags1 = 0;
+#ifdef _DEBUG
+	flags1 = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+	return flags1;
+}
+
+HRESULT Shader::CompileWithFXC(const std::filesystem::path& filepath, const std::string& entryPoint, const std::string& target,
+	const std::vector<ShaderDefine>& defines, ID3DBlob** const bytecode, std::string& errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const auto& define : defines)
+	{
+		macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+	}
+	macros.push_back({ nullptr, nullptr });
+
+	ComPtr<ID3DBlob> errBuff;
+	HRESULT hr = D3DCompileFromFile(filepath.wstring().c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		entryPoint.c_str(), target.c_str(), GetFXCFlags(), 0, bytecode, &errBuff);
+	if (FAILED(hr) && errBuff)
+		errors = static_cast<const char*>(errBuff->GetBufferPointer());
+	return hr;
+}
+
+HRESULT Shader::CompileWithDXC(const std::filesystem::path& filepath, const std::string& entryPoint, const std::string& target,
+	const std::vector<ShaderDefine>& defines, IDxcBlob** const bytecode, std::string& errors)
+{
+	ComPtr<IDxcLibrary> library;
+	HRESULT hr = DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&library));
+	assert(SUCCEEDED(hr));
+
+	ComPtr<IDxcCompiler> compiler;
+	hr = DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler));
+	assert(SUCCEEDED(hr));
+
+	ComPtr<IDxcIncludeHandler> includeHandler;
+	hr = library->CreateIncludeHandler(&includeHandler);
+	assert(SUCCEEDED(hr));
+
+	uint32_t codePage = CP_UTF8;
+	ComPtr<IDxcBlobEncoding> sourceBlob;
+	hr = library->CreateBlobFromFile(filepath.wstring().c_str(), &codePage, &sourceBlob);
+	if (FAILED(hr))
+	{
+		errors = "Could not open " + filepath.string();
+		return hr;
+	}
+
+	// DxcDefine only points at the strings, so the wide copies have to outlive the compile call.
+	std::vector<std::wstring> defineStrings;
+	defineStrings.reserve(defines.size() * 2);
+	std::vector<DxcDefine> dxcDefines;
+	for (const auto& define : defines)
+	{
+		defineStrings.push_back(Widen(define.Name));
+		const wchar_t* name = defineStrings.back().c_str();
+		defineStrings.push_back(Widen(define.Value));
+		dxcDefines.push_back({ name, defineStrings.back().c_str() });
+	}
+
+	ComPtr<IDxcOperationResult> result;
+	hr = compiler->Compile(
+		sourceBlob.Get(),
+		filepath.wstring().c_str(),
+		Widen(entryPoint).c_str(),
+		Widen(target).c_str(),
+		NULL, 0,
+		dxcDefines.data(), static_cast<UINT32>(dxcDefines.size()),
+		includeHandler.Get(),
+		&result
+	);
+	if (SUCCEEDED(hr))
+		result->GetStatus(&hr);
+
+	if (FAILED(hr))
+	{
+		if (result)
+		{
+			ComPtr<IDxcBlobEncoding> errorsBlob;
+			if (SUCCEEDED(result->GetErrorBuffer(&errorsBlob)) && errorsBlob)
+				errors = std::string(static_cast<const char*>(errorsBlob->GetBufferPointer()), errorsBlob->GetBufferSize());
+		}
+		return hr;
+	}
+
+	return result->GetResult(bytecode);
+}
+
+bool Shader::InitializeFromPrecompiledOrCache(PipelineCache* const cache, const uint64_t key)
+{
+	std::vector<uint8_t> data = ReadData(GetBinaryPath(shaderBinaryDirectory, key));
+	if (data.empty() && cache)
+		cache->Load(key, data);
+	if (data.empty())
+		return false;
+
+	CompiledShaderBlob* blob = new CompiledShaderBlob;
+	blob->MoveDataIntoBlob(data);
+	SetBlob(blob);
+	return true;
+}
+
+void Shader::SetBlob(ShaderBlob* const blob)
+{
+	delete m_blob;
+	m_blob = blob;
+	m_bufferLength = m_blob->BufferLength();
+	m_bufferPointer = m_blob->BufferPointer();
+	m_hash = HashBytes(m_bufferPointer, m_bufferLength);
+}
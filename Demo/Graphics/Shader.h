@@ -1,6 +1,15 @@
 #pragma once
 
 #include "../stdafx.h"
+#include "ShaderPermutation.h"
+
+class PipelineCache;
+
+enum class ShaderCompiler : uint8_t
+{
+	FXC = 0,
+	DXC
+};
 
 class Shader
 {
@@ -8,18 +17,46 @@ public:
 	~Shader();
 
 	void InitializeFromBinary(const std::string& filepath);
-	void FXCCompile(LPCWSTR filepath, LPCSTR entryPoint, LPCSTR target);
-	void DXCCompile(LPCWSTR filepath, LPCWSTR entryPoint, LPCWSTR target);
+	// Bytecode is taken from the first of these that has it: a precompiled blob in ShaderBinary produced by the shader
+	// builder, the pipeline cache, or a fresh compile. Both lookups use the same key, covering the source, its includes,
+	// the entry point, target, flags and defines.
+	void FXCCompile(LPCWSTR filepath, LPCSTR entryPoint, LPCSTR target, PipelineCache* const cache = nullptr,
+		const std::vector<ShaderDefine>& defines = {});
+	void DXCCompile(LPCWSTR filepath, LPCWSTR entryPoint, LPCWSTR target, PipelineCache* const cache = nullptr,
+		const std::vector<ShaderDefine>& defines = {});
+
+	// Same lookup as the compile functions above, but a failed compile is reported through errors instead of asserting,
+	// so shaders can be recompiled while the renderer is running.
+	bool TryCompile(const ShaderCompiler compiler, const std::filesystem::path& filepath, const std::string& entryPoint,
+		const std::string& target, PipelineCache* const cache, const std::vector<ShaderDefine>& defines, std::string& errors);
 
 	size_t BufferLength() const { return m_bufferLength; }
 	const void* BufferPointer() const { return m_bufferPointer; }
+	uint64_t GetHash() const { return m_hash; }
+
+	// Thread safe. Returns false and fills errors when compilation fails.
+	static bool Compile(const ShaderCompiler compiler, const std::filesystem::path& filepath, const std::string& entryPoint,
+		const std::string& target, const std::vector<ShaderDefine>& defines, std::vector<uint8_t>& bytecode,
+		std::string& errors);
+	static uint64_t ComputeKey(const ShaderCompiler compiler, const std::filesystem::path& filepath,
+		const std::string& entryPoint, const std::string& target, const std::vector<ShaderDefine>& defines);
+	static std::string GetBinaryPath(const std::string& binaryDirectory, const uint64_t key);
 
 private:
-	uintmax_t FileSize(const std::string& filepath);
-	std::vector<uint8_t> ReadData(const std::string& filepath);
+	static uintmax_t FileSize(const std::string& filepath);
+	static std::vector<uint8_t> ReadData(const std::string& filepath);
+	static uint64_t HashSource(const std::filesystem::path& filepath, uint64_t hash, std::vector<std::filesystem::path>& visited);
+	static UINT GetFXCFlags();
+	static HRESULT CompileWithFXC(const std::filesystem::path& filepath, const std::string& entryPoint, const std::string& target,
+		const std::vector<ShaderDefine>& defines, ID3DBlob** const bytecode, std::string& errors);
+	static HRESULT CompileWithDXC(const std::filesystem::path& filepath, const std::string& entryPoint, const std::string& target,
+		const std::vector<ShaderDefine>& defines, IDxcBlob** const bytecode, std::string& errors);
+	bool InitializeFromPrecompiledOrCache(PipelineCache* const cache, const uint64_t key);
+	void SetBlob(class ShaderBlob* const blob);
 
 private:
 	size_t m_bufferLength = 0;
 	const void* m_bufferPointer = nullptr;
 	class ShaderBlob* m_blob = nullptr;
+	uint64_t m_hash = 0;
 };
@@ -0,0 +1,212 @@
+#include "stdafx.h"
+#include "ShaderBuilder.h"
+#include <atomic>
+#include <execution>
+#include <mutex>
+#include <sstream>
+
+bool ShaderBuilder::LoadManifest(const std::filesystem::path& manifestPath)
+{
+	std::ifstream fs(manifestPath);
+	if (!fs.good())
+		return false;
+
+	const std::filesystem::path baseDirectory = manifestPath.parent_path();
+	std::string line;
+	uint32_t lineNumber = 0;
+	bool valid = true;
+	while (std::getline(fs, line))
+	{
+		lineNumber++;
+		const size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		std::vector<ShaderBuildEntry> entries;
+		if (ParseLine(line, baseDirectory, entries))
+		{
+			for (const auto& entry : entries)
+			{
+				AddEntry(entry);
+			}
+		}
+		else
+		{
+			std::cout << manifestPath.string() << "(" << lineNumber << "): malformed entry" << std::endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+void ShaderBuilder::AddEntry(const ShaderBuildEntry& entry)
+{
+	m_entries.push_back(entry);
+}
+
+uint32_t ShaderBuilder::Build(const std::string& outputDirectory)
+{
+	std::filesystem::create_directories(outputDirectory);
+
+	// Keys hash every include, so they are computed up front in parallel as well. Entries that map to the same key are
+	// only compiled once.
+	m_keys.resize(m_entries.size());
+	std::vector<uint32_t> indices(m_entries.size());
+	for (uint32_t i = 0; i < indices.size(); i++)
+	{
+		indices[i] = i;
+	}
+	std::for_each(std::execution::par, indices.begin(), indices.end(), [this](const uint32_t i)
+	{
+		const ShaderBuildEntry& entry = m_entries[i];
+		m_keys[i] = Shader::ComputeKey(entry.Compiler, entry.File, entry.EntryPoint, entry.Target, entry.Defines);
+	});
+
+	std::vector<uint32_t> pending;
+	std::vector<uint64_t> pendingKeys;
+	m_numUpToDate = 0;
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		if (std::find(pendingKeys.begin(), pendingKeys.end(), m_keys[i]) != pendingKeys.end() ||
+			std::filesystem::exists(Shader::GetBinaryPath(outputDirectory, m_keys[i])))
+		{
+			m_numUpToDate++;
+			continue;
+		}
+		pending.push_back(i);
+		pendingKeys.push_back(m_keys[i]);
+	}
+
+	std::atomic<uint32_t> numCompiled = 0;
+	std::atomic<uint32_t> numFailed = 0;
+	std::mutex outputMutex;
+	std::for_each(std::execution::par, pending.begin(), pending.end(), [&](const uint32_t i)
+	{
+		const ShaderBuildEntry& entry = m_entries[i];
+		std::vector<uint8_t> bytecode;
+		std::string errors;
+		const bool compiled = Shader::Compile(entry.Compiler, entry.File, entry.EntryPoint, entry.Target, entry.Defines,
+			bytecode, errors);
+		if (compiled)
+		{
+			// Written under a temporary name first so an interrupted build never leaves a truncated binary behind.
+			const std::string path = Shader::GetBinaryPath(outputDirectory, m_keys[i]);
+			const std::string temporaryPath = path + ".tmp";
+			std::ofstream fs(temporaryPath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+			fs.write(reinterpret_cast<const char*>(bytecode.data()), bytecode.size());
+			fs.close();
+
+			std::error_code error;
+			std::filesystem::rename(temporaryPath, path, error);
+			if (!fs.fail() && !error)
+			{
+				numCompiled++;
+				return;
+			}
+			errors = "Could not write " + path;
+		}
+
+		numFailed++;
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cout << entry.File.string() << " (" << (entry.EntryPoint.empty() ? "-" : entry.EntryPoint) << ", " <<
+			entry.Target << "): " << errors << std::endl;
+	});
+
+	m_numCompiled = numCompiled;
+	m_numFailed = numFailed;
+	std::cout << "Shaders: " << m_numCompiled << " compiled, " << m_numUpToDate << " up to date, " << m_numFailed <<
+		" failed" << std::endl;
+	return m_numFailed;
+}
+
+uint32_t ShaderBuilder::Prune(const std::string& outputDirectory)
+{
+	if (m_keys.size() != m_entries.size())
+	{
+		m_keys.resize(m_entries.size());
+		for (uint32_t i = 0; i < m_entries.size(); i++)
+		{
+			const ShaderBuildEntry& entry = m_entries[i];
+			m_keys[i] = Shader::ComputeKey(entry.Compiler, entry.File, entry.EntryPoint, entry.Target, entry.Defines);
+		}
+	}
+
+	std::error_code error;
+	uint32_t numRemoved = 0;
+	for (const auto& file : std::filesystem::directory_iterator(outputDirectory, error))
+	{
+		const std::filesystem::path& path = file.path();
+		const std::string name = path.stem().string();
+		if (path.extension() != ".cso" || name.size() != 16 || name.find_first_not_of("0123456789abcdef") != std::string::npos)
+			continue;
+
+		const uint64_t key = std::stoull(name, nullptr, 16);
+		if (std::find(m_keys.begin(), m_keys.end(), key) == m_keys.end() && std::filesystem::remove(path, error))
+			numRemoved++;
+	}
+	return numRemoved;
+}
+
+bool ShaderBuilder::ParseLine(const std::string& line, const std::filesystem::path& baseDirectory,
+	std::vector<ShaderBuildEntry>& entries)
+{
+	static const std::string permutationsPrefix = "permutations=";
+
+	ShaderBuildEntry entry;
+	std::istringstream stream(line);
+	std::string compiler, file;
+	if (!(stream >> compiler >> file >> entry.EntryPoint >> entry.Target))
+		return false;
+
+	if (compiler == "fxc")
+		entry.Compiler = ShaderCompiler::FXC;
+	else if (compiler == "dxc")
+		entry.Compiler = ShaderCompiler::DXC;
+	else
+		return false;
+
+	entry.File = baseDirectory / file;
+	if (entry.EntryPoint == "-")
+		entry.EntryPoint.clear();
+
+	std::string permutations;
+	std::string define;
+	while (stream >> define)
+	{
+		if (define.compare(0, permutationsPrefix.size(), permutationsPrefix) == 0)
+		{
+			permutations = define.substr(permutationsPrefix.size());
+			continue;
+		}
+
+		const size_t equals = define.find('=');
+		if (equals == 0)
+			return false;
+		if (equals == std::string::npos)
+			entry.Defines.push_back({ define, "1" });
+		else
+			entry.Defines.push_back({ define.substr(0, equals), define.substr(equals + 1) });
+	}
+
+	if (permutations.empty())
+	{
+		entries.push_back(entry);
+		return true;
+	}
+
+	ShaderPermutationSet features;
+	std::vector<uint32_t> keys;
+	if (!features.LoadFeatures(entry.File.string()) || !features.ParseKeys(permutations, keys))
+		return false;
+
+	for (const uint32_t key : keys)
+	{
+		ShaderBuildEntry permutation = entry;
+		const std::vector<ShaderDefine> featureDefines = features.GetDefines(key);
+		permutation.Defines.insert(permutation.Defines.begin(), featureDefines.begin(), featureDefines.end());
+		entries.push_back(permutation);
+	}
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Shader.h"
+
+struct ShaderBuildEntry
+{
+	ShaderCompiler Compiler;
+	std::filesystem::path File;
+	std::string EntryPoint;
+	std::string Target;
+	std::vector<ShaderDefine> Defines;
+};
+
+// Offline shader build. Reads a manifest of entry points and permutations, compiles every one whose content key has no
+// binary yet in parallel, and writes the bytecode as <key>.cso. The key covers the source and all of its includes, so an
+// edit to a shared header rebuilds exactly the shaders that include it and nothing else.
+//
+// Manifest lines are "compiler file entry target [NAME=VALUE ...] [permutations=KEYS]", with files relative to the
+// manifest, "-" for no entry point (libraries) and # starting a comment. permutations= takes the keys to build from the
+// features the source declares, as accepted by ShaderPermutationSet::ParseKeys, and adds one entry per key.
+class ShaderBuilder
+{
+public:
+	bool LoadManifest(const std::filesystem::path& manifestPath);
+	void AddEntry(const ShaderBuildEntry& entry);
+	// Returns the number of entries that failed to compile.
+	uint32_t Build(const std::string& outputDirectory);
+	// Deletes binaries no entry in the manifest maps to any more.
+	uint32_t Prune(const std::string& outputDirectory);
+
+	const std::vector<ShaderBuildEntry>& GetEntries() const { return m_entries; }
+	uint32_t GetNumCompiled() const { return m_numCompiled; }
+	uint32_t GetNumUpToDate() const { return m_numUpToDate; }
+	uint32_t GetNumFailed() const { return m_numFailed; }
+
+private:
+	static bool ParseLine(const std::string& line, const std::filesystem::path& baseDirectory,
+		std::vector<ShaderBuildEntry>& entries);
+
+private:
+	std::vector<ShaderBuildEntry> m_entries;
+	std::vector<uint64_t> m_keys;
+	uint32_t m_numCompiled = 0;
+	uint32_t m_numUpToDate = 0;
+	uint32_t m_numFailed = 0;
+};
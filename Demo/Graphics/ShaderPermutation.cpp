@@ -0,0 +1,153 @@
+#include "stdafx.h"
+#include "ShaderPermutation.h"
+#include <cstring>
+#include <sstream>
+
+static const char* featureDeclaration = "// feature:";
+static const char* featureDefinePrefix = "FEATURE_";
+
+static std::string Trim(const std::string& text)
+{
+	const size_t first = text.find_first_not_of(" \t\r");
+	if (first == std::string::npos)
+		return "";
+	const size_t last = text.find_last_not_of(" \t\r");
+	return text.substr(first, last - first + 1);
+}
+
+static bool IsIdentifier(const std::string& name)
+{
+	if (name.empty() || isdigit(static_cast<unsigned char>(name[0])))
+		return false;
+	return std::all_of(name.begin(), name.end(), [](const char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+}
+
+bool ShaderPermutationSet::LoadFeatures(const std::string& filepath)
+{
+	std::ifstream fs(filepath, std::ifstream::in | std::ifstream::binary);
+	if (!fs.good())
+		return false;
+
+	std::stringstream source;
+	source << fs.rdbuf();
+	return ParseFeatures(source.str());
+}
+
+bool ShaderPermutationSet::ParseFeatures(const std::string& source)
+{
+	m_features.clear();
+
+	std::istringstream stream(source);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		line = Trim(line);
+		if (line.compare(0, strlen(featureDeclaration), featureDeclaration) != 0)
+			continue;
+		if (!AddFeature(Trim(line.substr(strlen(featureDeclaration)))))
+			return false;
+	}
+	return true;
+}
+
+bool ShaderPermutationSet::AddFeature(const std::string& name)
+{
+	if (!IsIdentifier(name) || GetFeatureBit(name) != 0 || m_features.size() == maxFeatures)
+		return false;
+
+	m_features.push_back(name);
+	return true;
+}
+
+uint32_t ShaderPermutationSet::GetFeatureBit(const std::string& name) const
+{
+	for (uint32_t i = 0; i < m_features.size(); i++)
+	{
+		if (m_features[i] == name)
+			return 1u << i;
+	}
+	return 0;
+}
+
+uint32_t ShaderPermutationSet::ParseKey(const std::string& text) const
+{
+	const std::string trimmed = Trim(text);
+	if (trimmed == "0")
+		return 0;
+
+	uint32_t key = 0;
+	size_t start = 0;
+	while (start <= trimmed.size())
+	{
+		size_t end = trimmed.find('|', start);
+		if (end == std::string::npos)
+			end = trimmed.size();
+
+		const uint32_t bit = GetFeatureBit(Trim(trimmed.substr(start, end - start)));
+		if (bit == 0)
+			return invalidKey;
+		key |= bit;
+		start = end + 1;
+	}
+	return key;
+}
+
+bool ShaderPermutationSet::ParseKeys(const std::string& text, std::vector<uint32_t>& keys) const
+{
+	keys.clear();
+	if (Trim(text) == "*")
+	{
+		keys = EnumerateKeys();
+		return true;
+	}
+
+	std::istringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		const uint32_t key = ParseKey(item);
+		if (key == invalidKey)
+			return false;
+		keys.push_back(key);
+	}
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return !keys.empty();
+}
+
+std::vector<uint32_t> ShaderPermutationSet::EnumerateKeys() const
+{
+	std::vector<uint32_t> keys(size_t(1) << m_features.size());
+	for (uint32_t i = 0; i < keys.size(); i++)
+	{
+		keys[i] = i;
+	}
+	return keys;
+}
+
+std::string ShaderPermutationSet::GetKeyName(const uint32_t key) const
+{
+	std::string name;
+	for (uint32_t i = 0; i < m_features.size(); i++)
+	{
+		if ((key & (1u << i)) == 0)
+			continue;
+		if (!name.empty())
+			name += '|';
+		name += m_features[i];
+	}
+	return name.empty() ? "0" : name;
+}
+
+std::vector<ShaderDefine> ShaderPermutationSet::GetDefines(const uint32_t key) const
+{
+	// Every feature is defined, disabled ones as 0, so the shader can use #if without a default.
+	std::vector<ShaderDefine> defines;
+	defines.reserve(m_features.size());
+	for (uint32_t i = 0; i < m_features.size(); i++)
+	{
+		defines.push_back({ featureDefinePrefix + m_features[i], (key & (1u << i)) ? "1" : "0" });
+	}
+	return defines;
+}
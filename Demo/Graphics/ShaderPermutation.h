@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// The compile time features of one shader source. A source declares its features in bit order with lines of the form
+//     // feature: NAME
+// and each permutation is compiled with FEATURE_NAME defined as 0 or 1, so a disabled feature's code is removed by the
+// compiler rather than branched around. A permutation key is the mask of enabled feature bits.
+class ShaderPermutationSet
+{
+public:
+	static const uint32_t maxFeatures = 16;
+	static const uint32_t invalidKey = UINT32_MAX;
+
+public:
+	bool LoadFeatures(const std::string& filepath);
+	bool ParseFeatures(const std::string& source);
+	bool AddFeature(const std::string& name);
+
+	uint32_t GetNumFeatures() const { return static_cast<uint32_t>(m_features.size()); }
+	const std::string& GetFeatureName(const uint32_t index) const { return m_features[index]; }
+	// Returns 0 for features the source does not declare.
+	uint32_t GetFeatureBit(const std::string& name) const;
+	uint32_t GetAllFeaturesKey() const { return (1u << GetNumFeatures()) - 1; }
+
+	// Parses feature names joined by '|', or "0" for none.
+	uint32_t ParseKey(const std::string& text) const;
+	// Parses comma separated keys, or "*" for every combination. Keys come back sorted without duplicates.
+	bool ParseKeys(const std::string& text, std::vector<uint32_t>& keys) const;
+	std::vector<uint32_t> EnumerateKeys() const;
+	std::string GetKeyName(const uint32_t key) const;
+	std::vector<ShaderDefine> GetDefines(const uint32_t key) const;
+
+private:
+	std::vector<std::string> m_features;
+};
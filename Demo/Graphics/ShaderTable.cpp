@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include "ShaderTable.h"
+#include "RootSignature.h"
+#include "../Macros.h"
+
+uint32_t ShaderTable::AddRecord(const ShaderRecordType type, const std::wstring& exportName,
+	const RootSignature* const localRootSignature)
+{
+	assert(!m_buffer);
+	Range& range = m_ranges[static_cast<uint32_t>(type)];
+	Record record;
+	record.ExportName = exportName;
+	record.LocalRootSignature = localRootSignature;
+	record.Data.resize(D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + ComputeRootArgumentsSize(localRootSignature));
+	range.Records.push_back(std::move(record));
+	return static_cast<uint32_t>(range.Records.size() - 1);
+}
+
+uint32_t ShaderTable::AddHitGroupRecords(const uint32_t count, const std::vector<std::wstring>& rayTypeExportNames,
+	const std::vector<const RootSignature*>& rayTypeLocalRootSignatures)
+{
+	assert(rayTypeExportNames.size() == rayTypeLocalRootSignatures.size());
+	const uint32_t first = GetNumRecords(ShaderRecordType::HitGroup);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		for (size_t rayType = 0; rayType < rayTypeExportNames.size(); rayType++)
+		{
+			AddRecord(ShaderRecordType::HitGroup, rayTypeExportNames[rayType], rayTypeLocalRootSignatures[rayType]);
+		}
+	}
+	return first;
+}
+
+void ShaderTable::Create(ID3D12Device* const device, ID3D12StateObject* const stateObject)
+{
+	HRESULT hr = stateObject->QueryInterface(IID_PPV_ARGS(&m_properties));
+	assert(SUCCEEDED(hr));
+
+	uint64_t offset = 0;
+	for (Range& range : m_ranges)
+	{
+		uint32_t recordSize = 0;
+		for (const Record& record : range.Records)
+		{
+			recordSize = std::max(recordSize, static_cast<uint32_t>(record.Data.size()));
+		}
+		range.Offset = ALIGN_TO(offset, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+		range.Stride = ALIGN_TO(recordSize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
+		offset = range.Offset + static_cast<uint64_t>(range.Stride) * range.Records.size();
+	}
+	m_size = offset;
+
+	hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(m_size),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_buffer));
+	assert(SUCCEEDED(hr));
+	hr = m_buffer->Map(0, nullptr, (void**)&m_mappedData);
+	assert(SUCCEEDED(hr));
+	memset(m_mappedData, 0, m_size);
+
+	for (Range& range : m_ranges)
+	{
+		for (Record& record : range.Records)
+		{
+			const void* const identifier = m_properties->GetShaderIdentifier(record.ExportName.c_str());
+			assert(identifier);
+			memcpy(record.Data.data(), identifier, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+		}
+	}
+	Update();
+}
+
+void ShaderTable::SetShader(const ShaderRecordType type, const uint32_t index, const std::wstring& exportName)
+{
+	Record& record = GetRecord(type, index);
+	record.ExportName = exportName;
+	if (m_properties)
+	{
+		const void* const identifier = m_properties->GetShaderIdentifier(exportName.c_str());
+		assert(identifier);
+		memcpy(record.Data.data(), identifier, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+	}
+	record.Dirty = true;
+}
+
+void ShaderTable::SetRootDescriptor(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+	const D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+	const D3D12_ROOT_PARAMETER_TYPE parameterType =
+		GetRecord(type, index).LocalRootSignature->GetParameters()[parameterIndex].ParameterType;
+	assert(parameterType == D3D12_ROOT_PARAMETER_TYPE_CBV || parameterType == D3D12_ROOT_PARAMETER_TYPE_SRV ||
+		parameterType == D3D12_ROOT_PARAMETER_TYPE_UAV);
+	memcpy(GetArgument(type, index, parameterIndex, parameterType), &address, sizeof(address));
+}
+
+void ShaderTable::SetRootDescriptorTable(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+	const D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+	uint8_t* const argument = GetArgument(type, index, parameterIndex, D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE);
+	memcpy(argument, &handle.ptr, sizeof(handle.ptr));
+}
+
+void ShaderTable::SetRootConstants(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+	const void* const data, const uint32_t num32BitValues)
+{
+	assert(GetRecord(type, index).LocalRootSignature->GetParameters()[parameterIndex].Constants.Num32BitValues ==
+		num32BitValues);
+	uint8_t* const argument = GetArgument(type, index, parameterIndex, D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS);
+	memcpy(argument, data, num32BitValues * sizeof(uint32_t));
+}
+
+uint32_t ShaderTable::Update()
+{
+	assert(m_mappedData);
+	uint32_t numUpdated = 0;
+	for (Range& range : m_ranges)
+	{
+		for (size_t i = 0; i < range.Records.size(); i++)
+		{
+			Record& record = range.Records[i];
+			if (!record.Dirty)
+				continue;
+			memcpy(m_mappedData + range.Offset + range.Stride * i, record.Data.data(), record.Data.size());
+			record.Dirty = false;
+			numUpdated++;
+		}
+	}
+	return numUpdated;
+}
+
+void ShaderTable::FillDispatchRaysDesc(D3D12_DISPATCH_RAYS_DESC& desc, const uint32_t rayGenIndex) const
+{
+	const D3D12_GPU_VIRTUAL_ADDRESS address = m_buffer->GetGPUVirtualAddress();
+	const Range& rayGen = m_ranges[static_cast<uint32_t>(ShaderRecordType::RayGen)];
+	const Range& miss = m_ranges[static_cast<uint32_t>(ShaderRecordType::Miss)];
+	const Range& hitGroup = m_ranges[static_cast<uint32_t>(ShaderRecordType::HitGroup)];
+	assert(rayGenIndex < rayGen.Records.size());
+
+	desc.RayGenerationShaderRecord.StartAddress = address + rayGen.Offset + rayGen.Stride * rayGenIndex;
+	desc.RayGenerationShaderRecord.SizeInBytes = rayGen.Stride;
+
+	desc.MissShaderTable.StartAddress = address + miss.Offset;
+	desc.MissShaderTable.StrideInBytes = miss.Stride;
+	desc.MissShaderTable.SizeInBytes = miss.Stride * miss.Records.size();
+
+	desc.HitGroupTable.StartAddress = address + hitGroup.Offset;
+	desc.HitGroupTable.StrideInBytes = hitGroup.Stride;
+	desc.HitGroupTable.SizeInBytes = hitGroup.Stride * hitGroup.Records.size();
+}
+
+uint32_t ShaderTable::GetNumRecords(const ShaderRecordType type) const
+{
+	return static_cast<uint32_t>(m_ranges[static_cast<uint32_t>(type)].Records.size());
+}
+
+uint32_t ShaderTable::ComputeRootArgumentsSize(const RootSignature* const localRootSignature)
+{
+	if (!localRootSignature)
+		return 0;
+	const uint32_t numParameters = static_cast<uint32_t>(localRootSignature->GetParameters().size());
+	return ALIGN_TO(GetArgumentOffset(localRootSignature, numParameters), 8);
+}
+
+ShaderTable::Record& ShaderTable::GetRecord(const ShaderRecordType type, const uint32_t index)
+{
+	Range& range = m_ranges[static_cast<uint32_t>(type)];
+	assert(index < range.Records.size());
+	return range.Records[index];
+}
+
+uint8_t* ShaderTable::GetArgument(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+	const D3D12_ROOT_PARAMETER_TYPE expectedType)
+{
+	Record& record = GetRecord(type, index);
+	assert(record.LocalRootSignature);
+	assert(parameterIndex < record.LocalRootSignature->GetParameters().size());
+	assert(record.LocalRootSignature->GetParameters()[parameterIndex].ParameterType == expectedType);
+	record.Dirty = true;
+	return record.Data.data() + D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES +
+		GetArgumentOffset(record.LocalRootSignature, parameterIndex);
+}
+
+// Offset of a parameter's argument from the end of the shader identifier. Passing the parameter count gives the end of
+// the last argument.
+uint32_t ShaderTable::GetArgumentOffset(const RootSignature* const localRootSignature, const uint32_t parameterIndex)
+{
+	const std::vector<D3D12_ROOT_PARAMETER>& parameters = localRootSignature->GetParameters();
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < parameterIndex; i++)
+	{
+		if (parameters[i].ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+			offset = ALIGN_TO(offset, 4) + parameters[i].Constants.Num32BitValues * 4;
+		else
+			offset = ALIGN_TO(offset, 8) + 8;
+	}
+	if (parameterIndex < parameters.size() &&
+		parameters[parameterIndex].ParameterType != D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+		offset = ALIGN_TO(offset, 8);
+	return offset;
+}
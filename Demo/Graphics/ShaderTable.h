@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../stdafx.h"
+
+class RootSignature;
+
+enum class ShaderRecordType : uint8_t
+{
+	RayGen = 0,
+	Miss,
+	HitGroup,
+	Count
+};
+
+// Lays out the raygen, miss and hit group records of a raytracing pipeline. Each record is a shader identifier followed
+// by the arguments of its local root signature; the stride of each range is the largest record in it, and argument
+// offsets come from the root signature, so callers set arguments by parameter index rather than byte offset.
+// Records can be repointed or have their arguments changed after Create. Update then copies only those records.
+class ShaderTable
+{
+public:
+	// Returns the index of the record within its range. For hit groups that index is what instances use as their
+	// contribution to the hit group index.
+	uint32_t AddRecord(const ShaderRecordType type, const std::wstring& exportName,
+		const RootSignature* const localRootSignature = nullptr);
+	// Records allocated either once per geometry of a mesh or once per instance, each with one hit group per ray type.
+	// Returns the index of the first record.
+	uint32_t AddHitGroupRecords(const uint32_t count, const std::vector<std::wstring>& rayTypeExportNames,
+		const std::vector<const RootSignature*>& rayTypeLocalRootSignatures);
+	void Create(ID3D12Device* const device, ID3D12StateObject* const stateObject);
+
+	void SetShader(const ShaderRecordType type, const uint32_t index, const std::wstring& exportName);
+	void SetRootDescriptor(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+		const D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetRootDescriptorTable(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+		const D3D12_GPU_DESCRIPTOR_HANDLE handle);
+	void SetRootConstants(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+		const void* const data, const uint32_t num32BitValues);
+	// Copies records changed since the last call into the table. The GPU must not be reading it.
+	uint32_t Update();
+
+	void FillDispatchRaysDesc(D3D12_DISPATCH_RAYS_DESC& desc, const uint32_t rayGenIndex = 0) const;
+	uint32_t GetNumRecords(const ShaderRecordType type) const;
+	uint32_t GetStride(const ShaderRecordType type) const { return m_ranges[static_cast<uint32_t>(type)].Stride; }
+	uint64_t GetSize() const { return m_size; }
+
+	// Bytes of local root arguments for a root signature, laid out in parameter order. Descriptors and descriptor tables
+	// take 8 bytes at 8 byte alignment, root constants 4 bytes each.
+	static uint32_t ComputeRootArgumentsSize(const RootSignature* const localRootSignature);
+
+private:
+	struct Record
+	{
+		std::wstring ExportName;
+		const RootSignature* LocalRootSignature = nullptr;
+		std::vector<uint8_t> Data;
+		bool Dirty = true;
+	};
+	struct Range
+	{
+		std::vector<Record> Records;
+		uint64_t Offset = 0;
+		uint32_t Stride = 0;
+	};
+
+	Record& GetRecord(const ShaderRecordType type, const uint32_t index);
+	uint8_t* GetArgument(const ShaderRecordType type, const uint32_t index, const uint32_t parameterIndex,
+		const D3D12_ROOT_PARAMETER_TYPE expectedType);
+	static uint32_t GetArgumentOffset(const RootSignature* const localRootSignature, const uint32_t parameterIndex);
+
+	Range m_ranges[static_cast<uint32_t>(ShaderRecordType::Count)];
+	ComPtr<ID3D12Resource> m_buffer;
+	ComPtr<ID3D12StateObjectProperties> m_properties;
+	uint8_t* m_mappedData = nullptr;
+	uint64_t m_size = 0;
+};
@@ -0,0 +1,287 @@
+#include "stdafx.h"
+#include "ShadowDenoiser.h"
+
+#include <cmath>
+#include <immintrin.h>
+
+static const uint32_t simdWidth = 8;
+static const float kernelWeights[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+static uint32_t Clamp(const int32_t value, const uint32_t size)
+{
+	return static_cast<uint32_t>(std::min(std::max(value, 0), static_cast<int32_t>(size) - 1));
+}
+
+static void TemporalAccumulatePixel(const ShadowDenoiser::Surface& surface, const uint32_t x, const uint32_t y,
+	const float* const current, const float* const history, const float* const historyCount, float* const output,
+	float* const outputCount, const ShadowDenoiser::Settings& settings)
+{
+	const uint32_t index = y * surface.Width + x;
+	if (surface.Distance[index] < 0.f)
+	{
+		output[index] = current[index];
+		outputCount[index] = 0.f;
+		return;
+	}
+
+	float sum = 0.f;
+	float sumOfSquares = 0.f;
+	for (int32_t dy = -1; dy <= 1; dy++)
+	{
+		const uint32_t row = Clamp(static_cast<int32_t>(y) + dy, surface.Height) * surface.Width;
+		for (int32_t dx = -1; dx <= 1; dx++)
+		{
+			const float value = current[row + Clamp(static_cast<int32_t>(x) + dx, surface.Width)];
+			sum += value;
+			sumOfSquares += value * value;
+		}
+	}
+	const float mean = sum / 9.f;
+	const float sigma = std::max(settings.MinimumClipSigma, std::sqrt(std::max(0.f, sumOfSquares / 9.f - mean * mean)));
+
+	if (historyCount[index] <= 0.f)
+	{
+		output[index] = current[index];
+		outputCount[index] = 1.f;
+		return;
+	}
+
+	const float count = historyCount[index] + 1.f;
+	const float alpha = std::max(settings.TemporalAlpha, 1.f / count);
+	const float clipped = std::min(std::max(history[index], mean - settings.VarianceClipGamma * sigma),
+		mean + settings.VarianceClipGamma * sigma);
+	output[index] = clipped + (current[index] - clipped) * alpha;
+	outputCount[index] = count;
+}
+
+static void ATrousPixel(const ShadowDenoiser::Surface& surface, const uint32_t x, const uint32_t y,
+	const uint32_t stepSize, const float* const input, float* const output, const ShadowDenoiser::Settings& settings)
+{
+	const uint32_t index = y * surface.Width + x;
+	const float distance = surface.Distance[index];
+	if (distance < 0.f)
+	{
+		output[index] = input[index];
+		return;
+	}
+
+	const float visibility = input[index];
+	const float depthScale = 1.f / (settings.DepthSigma * distance);
+	const float visibilityScale = 1.f / settings.VisibilitySigma;
+	float weightedSum = 0.f;
+	float weightSum = 0.f;
+	for (int32_t dy = -2; dy <= 2; dy++)
+	{
+		const uint32_t row = Clamp(static_cast<int32_t>(y) + dy * static_cast<int32_t>(stepSize), surface.Height) *
+			surface.Width;
+		for (int32_t dx = -2; dx <= 2; dx++)
+		{
+			const uint32_t neighbour = row + Clamp(static_cast<int32_t>(x) + dx * static_cast<int32_t>(stepSize),
+				surface.Width);
+			const float neighbourDistance = surface.Distance[neighbour];
+			if (neighbourDistance < 0.f)
+				continue;
+
+			const float depthWeight = std::max(0.f, 1.f - std::abs(neighbourDistance - distance) * depthScale);
+			float normalWeight = std::max(0.f, surface.NormalX[index] * surface.NormalX[neighbour] +
+				surface.NormalY[index] * surface.NormalY[neighbour] + surface.NormalZ[index] * surface.NormalZ[neighbour]);
+			for (uint32_t i = 0; i < settings.NormalSharpness; i++)
+			{
+				normalWeight *= normalWeight;
+			}
+			const float visibilityWeight = std::max(0.f, 1.f - std::abs(input[neighbour] - visibility) * visibilityScale);
+			const float weight = kernelWeights[dx + 2] * kernelWeights[dy + 2] * depthWeight * normalWeight *
+				visibilityWeight;
+			weightedSum += weight * input[neighbour];
+			weightSum += weight;
+		}
+	}
+	output[index] = weightSum > 0.f ? weightedSum / weightSum : visibility;
+}
+
+#if defined(__AVX2__)
+static __m256 Abs8(const __m256 value)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.f), value);
+}
+
+// Eight pixels starting at x, whose 3x3 neighbourhoods must lie within the row.
+static void TemporalAccumulate8(const ShadowDenoiser::Surface& surface, const uint32_t x, const uint32_t y,
+	const float* const current, const float* const history, const float* const historyCount, float* const output,
+	float* const outputCount, const ShadowDenoiser::Settings& settings)
+{
+	const uint32_t index = y * surface.Width + x;
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	__m256 sum = zero;
+	__m256 sumOfSquares = zero;
+	for (int32_t dy = -1; dy <= 1; dy++)
+	{
+		const uint32_t row = Clamp(static_cast<int32_t>(y) + dy, surface.Height) * surface.Width;
+		for (int32_t dx = -1; dx <= 1; dx++)
+		{
+			const __m256 value = _mm256_loadu_ps(current + row + x + dx);
+			sum = _mm256_add_ps(sum, value);
+			sumOfSquares = _mm256_add_ps(sumOfSquares, _mm256_mul_ps(value, value));
+		}
+	}
+	const __m256 nine = _mm256_set1_ps(9.f);
+	const __m256 mean = _mm256_div_ps(sum, nine);
+	const __m256 variance = _mm256_sub_ps(_mm256_div_ps(sumOfSquares, nine), _mm256_mul_ps(mean, mean));
+	const __m256 sigma = _mm256_max_ps(_mm256_set1_ps(settings.MinimumClipSigma),
+		_mm256_sqrt_ps(_mm256_max_ps(zero, variance)));
+
+	const __m256 currentValue = _mm256_loadu_ps(current + index);
+	const __m256 previousCount = _mm256_loadu_ps(historyCount + index);
+	const __m256 count = _mm256_add_ps(previousCount, one);
+	const __m256 alpha = _mm256_max_ps(_mm256_set1_ps(settings.TemporalAlpha), _mm256_div_ps(one, count));
+	const __m256 gammaSigma = _mm256_mul_ps(_mm256_set1_ps(settings.VarianceClipGamma), sigma);
+	const __m256 clipped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(history + index), _mm256_sub_ps(mean, gammaSigma)),
+		_mm256_add_ps(mean, gammaSigma));
+	__m256 result = _mm256_add_ps(clipped, _mm256_mul_ps(_mm256_sub_ps(currentValue, clipped), alpha));
+	__m256 resultCount = count;
+
+	// no history: take this frame as is. nothing hit: pass through with no count.
+	const __m256 noHistory = _mm256_cmp_ps(previousCount, zero, _CMP_LE_OQ);
+	result = _mm256_blendv_ps(result, currentValue, noHistory);
+	resultCount = _mm256_blendv_ps(resultCount, one, noHistory);
+	const __m256 sky = _mm256_cmp_ps(_mm256_loadu_ps(surface.Distance.data() + index), zero, _CMP_LT_OQ);
+	result = _mm256_blendv_ps(result, currentValue, sky);
+	resultCount = _mm256_blendv_ps(resultCount, zero, sky);
+
+	_mm256_storeu_ps(output + index, result);
+	_mm256_storeu_ps(outputCount + index, resultCount);
+}
+
+// Eight pixels starting at x, whose taps must lie within the row.
+static void ATrous8(const ShadowDenoiser::Surface& surface, const uint32_t x, const uint32_t y, const uint32_t stepSize,
+	const float* const input, float* const output, const ShadowDenoiser::Settings& settings)
+{
+	const uint32_t index = y * surface.Width + x;
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.f);
+
+	const __m256 distance = _mm256_loadu_ps(surface.Distance.data() + index);
+	const __m256 normalX = _mm256_loadu_ps(surface.NormalX.data() + index);
+	const __m256 normalY = _mm256_loadu_ps(surface.NormalY.data() + index);
+	const __m256 normalZ = _mm256_loadu_ps(surface.NormalZ.data() + index);
+	const __m256 visibility = _mm256_loadu_ps(input + index);
+	const __m256 depthScale = _mm256_div_ps(one, _mm256_mul_ps(_mm256_set1_ps(settings.DepthSigma), distance));
+	const __m256 visibilityScale = _mm256_set1_ps(1.f / settings.VisibilitySigma);
+
+	__m256 weightedSum = zero;
+	__m256 weightSum = zero;
+	for (int32_t dy = -2; dy <= 2; dy++)
+	{
+		const uint32_t row = Clamp(static_cast<int32_t>(y) + dy * static_cast<int32_t>(stepSize), surface.Height) *
+			surface.Width;
+		for (int32_t dx = -2; dx <= 2; dx++)
+		{
+			const uint32_t neighbour = row + x + dx * static_cast<int32_t>(stepSize);
+			const __m256 neighbourDistance = _mm256_loadu_ps(surface.Distance.data() + neighbour);
+			const __m256 depthWeight = _mm256_max_ps(zero,
+				_mm256_sub_ps(one, _mm256_mul_ps(Abs8(_mm256_sub_ps(neighbourDistance, distance)), depthScale)));
+			__m256 normalWeight = _mm256_mul_ps(normalX, _mm256_loadu_ps(surface.NormalX.data() + neighbour));
+			normalWeight = _mm256_add_ps(normalWeight,
+				_mm256_mul_ps(normalY, _mm256_loadu_ps(surface.NormalY.data() + neighbour)));
+			normalWeight = _mm256_add_ps(normalWeight,
+				_mm256_mul_ps(normalZ, _mm256_loadu_ps(surface.NormalZ.data() + neighbour)));
+			normalWeight = _mm256_max_ps(zero, normalWeight);
+			for (uint32_t i = 0; i < settings.NormalSharpness; i++)
+			{
+				normalWeight = _mm256_mul_ps(normalWeight, normalWeight);
+			}
+			const __m256 neighbourVisibility = _mm256_loadu_ps(input + neighbour);
+			const __m256 visibilityWeight = _mm256_max_ps(zero,
+				_mm256_sub_ps(one, _mm256_mul_ps(Abs8(_mm256_sub_ps(neighbourVisibility, visibility)), visibilityScale)));
+
+			__m256 weight = _mm256_set1_ps(kernelWeights[dx + 2] * kernelWeights[dy + 2]);
+			weight = _mm256_mul_ps(weight, depthWeight);
+			weight = _mm256_mul_ps(weight, normalWeight);
+			weight = _mm256_mul_ps(weight, visibilityWeight);
+			weight = _mm256_andnot_ps(_mm256_cmp_ps(neighbourDistance, zero, _CMP_LT_OQ), weight);
+			weightedSum = _mm256_add_ps(weightedSum, _mm256_mul_ps(weight, neighbourVisibility));
+			weightSum = _mm256_add_ps(weightSum, weight);
+		}
+	}
+
+	__m256 result = _mm256_blendv_ps(visibility, _mm256_div_ps(weightedSum, weightSum),
+		_mm256_cmp_ps(weightSum, zero, _CMP_GT_OQ));
+	result = _mm256_blendv_ps(result, visibility, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+	_mm256_storeu_ps(output + index, result);
+}
+#endif
+
+void ShadowDenoiser::TemporalAccumulate(const Surface& surface, const float* const current, const float* const history,
+	const float* const historyCount, float* const output, float* const outputCount, const Settings& settings,
+	const bool allowSIMD)
+{
+	for (uint32_t y = 0; y < surface.Height; y++)
+	{
+		uint32_t x = 0;
+#if defined(__AVX2__)
+		if (allowSIMD && surface.Width >= simdWidth + 2)
+		{
+			TemporalAccumulatePixel(surface, x++, y, current, history, historyCount, output, outputCount, settings);
+			for (; x + simdWidth < surface.Width; x += simdWidth)
+			{
+				TemporalAccumulate8(surface, x, y, current, history, historyCount, output, outputCount, settings);
+			}
+		}
+#endif
+		for (; x < surface.Width; x++)
+		{
+			TemporalAccumulatePixel(surface, x, y, current, history, historyCount, output, outputCount, settings);
+		}
+	}
+}
+
+void ShadowDenoiser::ATrous(const Surface& surface, const uint32_t stepSize, const float* const input,
+	float* const output, const Settings& settings, const bool allowSIMD)
+{
+	for (uint32_t y = 0; y < surface.Height; y++)
+	{
+		uint32_t x = 0;
+#if defined(__AVX2__)
+		const uint32_t border = 2 * stepSize;
+		if (allowSIMD && surface.Width >= simdWidth + 2 * border)
+		{
+			for (; x < border; x++)
+			{
+				ATrousPixel(surface, x, y, stepSize, input, output, settings);
+			}
+			for (; x + simdWidth + border <= surface.Width; x += simdWidth)
+			{
+				ATrous8(surface, x, y, stepSize, input, output, settings);
+			}
+		}
+#endif
+		for (; x < surface.Width; x++)
+		{
+			ATrousPixel(surface, x, y, stepSize, input, output, settings);
+		}
+	}
+}
+
+void ShadowDenoiser::Denoise(const Surface& surface, const float* const current, const float* const history,
+	const float* const historyCount, float* const output, float* const outputHistory, float* const outputCount,
+	const Settings& settings, const bool allowSIMD)
+{
+	TemporalAccumulate(surface, current, history, historyCount, outputHistory, outputCount, settings, allowSIMD);
+	const size_t numPixels = static_cast<size_t>(surface.Width) * surface.Height;
+	if (settings.NumIterations == 0)
+	{
+		std::copy(outputHistory, outputHistory + numPixels, output);
+		return;
+	}
+
+	std::vector<float> scratch[2] = { std::vector<float>(numPixels), std::vector<float>(numPixels) };
+	const float* source = outputHistory;
+	for (uint32_t i = 0; i < settings.NumIterations; i++)
+	{
+		float* const destination = i + 1 == settings.NumIterations ? output : scratch[i % 2].data();
+		ATrous(surface, 1u << i, source, destination, settings, allowSIMD);
+		source = destination;
+	}
+}
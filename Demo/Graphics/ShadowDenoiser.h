@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU versions of the kernels in ShadowDenoiser.hlsl, on single channel images stored row by row. They compute what the
+// compute shaders do, eight pixels at a time when built with AVX2, so the GPU output can be checked against them and
+// shadows can be denoised without a GPU.
+namespace ShadowDenoiser
+{
+	struct Settings
+	{
+		// lower bound on the weight of the new frame, once enough history has built up
+		float TemporalAlpha = 0.1f;
+		// history is clamped to this many standard deviations around the 3x3 neighbourhood mean
+		float VarianceClipGamma = 1.f;
+		// The clip window is never narrower than this either side of the mean. With a ray or two per pixel a
+		// neighbourhood that happens to agree says little about the true visibility, and clipping to it would pull
+		// penumbrae towards fully lit or fully shadowed.
+		float MinimumClipSigma = 0.5f;
+		uint32_t NumIterations = 3;
+		// relative difference in camera distance at which a neighbour stops contributing
+		float DepthSigma = 0.05f;
+		// neighbours are weighted by dot(normal, neighbour normal) raised to 2^NormalSharpness
+		uint32_t NormalSharpness = 4;
+		// difference in visibility at which a neighbour stops contributing. Above 1 so that single ray results, which
+		// are all 0 or 1, still blend with each other.
+		float VisibilitySigma = 2.f;
+	};
+
+	// What each pixel sees: its normal and distance from the camera. A negative distance marks pixels that hit nothing.
+	struct Surface
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<float> NormalX;
+		std::vector<float> NormalY;
+		std::vector<float> NormalZ;
+		std::vector<float> Distance;
+	};
+
+	// history is last frame's result already reprojected to this frame, with a count of 0 where there is none. Writes
+	// the blended visibility and the new history counts.
+	void TemporalAccumulate(const Surface& surface, const float* const current, const float* const history,
+		const float* const historyCount, float* const output, float* const outputCount, const Settings& settings,
+		const bool allowSIMD = true);
+	// One edge-aware a-trous pass of a 5x5 B3 spline kernel with taps stepSize pixels apart.
+	void ATrous(const Surface& surface, const uint32_t stepSize, const float* const input, float* const output,
+		const Settings& settings, const bool allowSIMD = true);
+	// The temporal pass followed by NumIterations a-trous passes with step sizes 1, 2, 4 and so on. The temporal result
+	// is written to outputHistory, to be reprojected as next frame's history; feeding back the filtered result instead
+	// would blur the penumbrae a little more every frame.
+	void Denoise(const Surface& surface, const float* const current, const float* const history,
+		const float* const historyCount, float* const output, float* const outputHistory, float* const outputCount,
+		const Settings& settings, const bool allowSIMD = true);
+}
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "ShadowUpsampler.h"
+
+#include <cfloat>
+
+uint32_t ShadowUpsampler::GetScale(const TraceResolution resolution)
+{
+	switch (resolution)
+	{
+	case TraceResolution::Checkerboard: return 2;
+	case TraceResolution::Half: return 2;
+	case TraceResolution::Quarter: return 4;
+	default: return 1;
+	}
+}
+
+bool ShadowUpsampler::IsCheckerboard(const TraceResolution resolution)
+{
+	return resolution == TraceResolution::Checkerboard;
+}
+
+uint32_t ShadowUpsampler::GetTraceWidth(const TraceResolution resolution, const uint32_t displayWidth)
+{
+	const uint32_t scale = GetScale(resolution);
+	return (displayWidth + scale - 1) / scale;
+}
+
+uint32_t ShadowUpsampler::GetTraceHeight(const TraceResolution resolution, const uint32_t displayHeight)
+{
+	const uint32_t scale = IsCheckerboard(resolution) ? 1 : GetScale(resolution);
+	return (displayHeight + scale - 1) / scale;
+}
+
+void ShadowUpsampler::GetTracePosition(const TraceResolution resolution, const uint32_t frameIndex, const uint32_t x,
+	const uint32_t y, float& displayX, float& displayY)
+{
+	if (IsCheckerboard(resolution))
+	{
+		displayX = static_cast<float>(x * 2 + ((y + frameIndex) & 1)) + 0.5f;
+		displayY = static_cast<float>(y) + 0.5f;
+		return;
+	}
+
+	const float scale = static_cast<float>(GetScale(resolution));
+	displayX = (static_cast<float>(x) + 0.5f) * scale;
+	displayY = (static_cast<float>(y) + 0.5f) * scale;
+}
+
+void ShadowUpsampler::Upsample(const TraceResolution resolution, const uint32_t frameIndex,
+	const ShadowDenoiser::Surface& traced, const float* const input, const ShadowDenoiser::Surface& display,
+	float* const output, const Settings& settings)
+{
+	const uint32_t scale = GetScale(resolution);
+	const uint32_t verticalScale = IsCheckerboard(resolution) ? 1 : scale;
+	const float radius = static_cast<float>(scale);
+	for (uint32_t y = 0; y < display.Height; y++)
+	{
+		for (uint32_t x = 0; x < display.Width; x++)
+		{
+			const uint32_t index = y * display.Width + x;
+			const float distance = display.Distance[index];
+			const int32_t traceX = static_cast<int32_t>(x / scale);
+			const int32_t traceY = static_cast<int32_t>(y / verticalScale);
+
+			float weightedSum = 0.f;
+			float weightSum = 0.f;
+			float closestValue = 0.f;
+			float closestDifference = FLT_MAX;
+			for (int32_t dy = -1; dy <= 1; dy++)
+			{
+				for (int32_t dx = -1; dx <= 1; dx++)
+				{
+					const int32_t tapX = traceX + dx;
+					const int32_t tapY = traceY + dy;
+					if (tapX < 0 || tapY < 0 || tapX >= static_cast<int32_t>(traced.Width) ||
+						tapY >= static_cast<int32_t>(traced.Height))
+						continue;
+
+					float tapDisplayX;
+					float tapDisplayY;
+					GetTracePosition(resolution, frameIndex, tapX, tapY, tapDisplayX, tapDisplayY);
+					const float spatialWeight =
+						std::max(0.f, 1.f - std::abs(tapDisplayX - (static_cast<float>(x) + 0.5f)) / radius) *
+						std::max(0.f, 1.f - std::abs(tapDisplayY - (static_cast<float>(y) + 0.5f)) / radius);
+					if (spatialWeight <= 0.f)
+						continue;
+
+					// sky only blends with sky
+					const uint32_t tap = static_cast<uint32_t>(tapY) * traced.Width + static_cast<uint32_t>(tapX);
+					const float tapDistance = traced.Distance[tap];
+					const bool sameKind = (tapDistance < 0.f) == (distance < 0.f);
+					const float difference = sameKind ? std::abs(tapDistance - distance) : FLT_MAX / 2.f;
+					if (difference < closestDifference)
+					{
+						closestDifference = difference;
+						closestValue = input[tap];
+					}
+					if (!sameKind)
+						continue;
+
+					float weight = spatialWeight;
+					if (distance >= 0.f)
+					{
+						const float depthWeight = std::max(0.f, 1.f - difference / (settings.DepthSigma * distance));
+						float normalWeight = std::max(0.f, display.NormalX[index] * traced.NormalX[tap] +
+							display.NormalY[index] * traced.NormalY[tap] + display.NormalZ[index] * traced.NormalZ[tap]);
+						for (uint32_t i = 0; i < settings.NormalSharpness; i++)
+						{
+							normalWeight *= normalWeight;
+						}
+						weight *= depthWeight * normalWeight;
+					}
+					weightedSum += weight * input[tap];
+					weightSum += weight;
+				}
+			}
+			output[index] = weightSum > 1e-4f ? weightedSum / weightSum : closestValue;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ShadowDenoiser.h"
+
+// Shadows and ambient occlusion can be traced for fewer pixels than the display has. The traced result is brought back
+// to display resolution by a bilateral upsample guided by the normal and camera distance the raster pass saw in each
+// display pixel, so values do not bleed across silhouettes. This is the CPU version of ShadowUpsampler.hlsl.
+namespace ShadowUpsampler
+{
+	enum class TraceResolution : uint32_t
+	{
+		Full = 0,
+		// every other pixel of each row, alternating between frames
+		Checkerboard,
+		Half,
+		Quarter
+	};
+
+	struct Settings
+	{
+		// relative difference in camera distance at which a traced pixel stops contributing
+		float DepthSigma = 0.1f;
+		// traced pixels are weighted by dot(normal, traced normal) raised to 2^NormalSharpness
+		uint32_t NormalSharpness = 2;
+	};
+
+	// Spacing of traced pixels, in display pixels. Checkerboard is only compressed horizontally.
+	uint32_t GetScale(const TraceResolution resolution);
+	bool IsCheckerboard(const TraceResolution resolution);
+	uint32_t GetTraceWidth(const TraceResolution resolution, const uint32_t displayWidth);
+	uint32_t GetTraceHeight(const TraceResolution resolution, const uint32_t displayHeight);
+	// Where in the display the ray for traced pixel (x, y) goes through, in pixels.
+	void GetTracePosition(const TraceResolution resolution, const uint32_t frameIndex, const uint32_t x, const uint32_t y,
+		float& displayX, float& displayY);
+
+	// traced describes the traced pixels and display the display's. Traced pixels are weighted by a tent of the trace
+	// spacing and by how alike their surface is. Where none is alike, the one at the closest distance is taken.
+	void Upsample(const TraceResolution resolution, const uint32_t frameIndex, const ShadowDenoiser::Surface& traced,
+		const float* const input, const ShadowDenoiser::Surface& display, float* const output,
+		const Settings& settings);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Hash-consed store of shared objects. GetOrCreate returns the object registered under a key, or runs the creation
+// function and registers its result. A request for a key whose creation is still in flight on another thread waits for
+// that result instead of creating a duplicate, while requests for other keys carry on; creation runs outside the lock.
+template <class T>
+class SharedObjectCache
+{
+public:
+	// create returns a std::shared_ptr<T>. A null result is not registered, so the next request tries again. An exception
+	// thrown by create leaves the key unregistered the same way before it is passed on, and wakes the waiters.
+	template <class CreateFunction>
+	std::shared_ptr<T> GetOrCreate(const uint64_t key, CreateFunction&& create)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		std::shared_ptr<Entry>& slot = m_entries[key];
+		if (slot)
+		{
+			const std::shared_ptr<Entry> entry = slot;
+			m_entryCreated.wait(lock, [&entry] { return !entry->Pending; });
+			if (entry->Object)
+				m_numHits++;
+			return entry->Object;
+		}
+
+		slot = std::make_shared<Entry>();
+		const std::shared_ptr<Entry> entry = slot;
+		lock.unlock();
+
+		std::shared_ptr<T> object;
+		try
+		{
+			object = create();
+		}
+		catch (...)
+		{
+			lock.lock();
+			entry->Pending = false;
+			m_entries.erase(key);
+			lock.unlock();
+			m_entryCreated.notify_all();
+			throw;
+		}
+
+		lock.lock();
+		entry->Object = object;
+		entry->Pending = false;
+		if (object)
+			m_numCreated++;
+		else
+			m_entries.erase(key);
+		lock.unlock();
+		m_entryCreated.notify_all();
+		return object;
+	}
+
+	// Drops objects nothing outside the cache references any more and returns how many were dropped.
+	uint32_t Trim()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint32_t numRemoved = 0;
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			const Entry& entry = *it->second;
+			if (!entry.Pending && entry.Object.use_count() == 1)
+			{
+				it = m_entries.erase(it);
+				numRemoved++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return numRemoved;
+	}
+
+	uint32_t GetNumEntries() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<uint32_t>(m_entries.size());
+	}
+	uint32_t GetNumCreated() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_numCreated;
+	}
+	uint32_t GetNumHits() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_numHits;
+	}
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<T> Object;
+		bool Pending = true;
+	};
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_entryCreated;
+	std::unordered_map<uint64_t, std::shared_ptr<Entry>> m_entries;
+	uint32_t m_numCreated = 0;
+	uint32_t m_numHits = 0;
+};
@@ -0,0 +1,457 @@
+#include "stdafx.h"
+#include "SoftwareRasterizer.h"
+#include "Float4x4.h"
+
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <immintrin.h>
+
+namespace
+{
+	const uint32_t texelSize = 4;
+
+	// a vertex after the vertex shader: clip position, then world position, local normal and uv
+	struct ClipVertex
+	{
+		float Clip[4];
+		float Attributes[8];
+	};
+
+	ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, const float t)
+	{
+		ClipVertex result;
+		for (int i = 0; i < 4; i++)
+			result.Clip[i] = a.Clip[i] + (b.Clip[i] - a.Clip[i]) * t;
+		for (int i = 0; i < 8; i++)
+			result.Attributes[i] = a.Attributes[i] + (b.Attributes[i] - a.Attributes[i]) * t;
+		return result;
+	}
+
+	// Clips against the D3D near plane, z >= 0. A triangle becomes at most a quad.
+	uint32_t ClipToNearPlane(const ClipVertex* const input, ClipVertex* const output)
+	{
+		uint32_t numOutput = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const ClipVertex& current = input[i];
+			const ClipVertex& next = input[(i + 1) % 3];
+			const bool currentInside = current.Clip[2] >= 0.f;
+			const bool nextInside = next.Clip[2] >= 0.f;
+			if (currentInside)
+				output[numOutput++] = current;
+			if (currentInside != nextInside)
+				output[numOutput++] = Lerp(current, next, current.Clip[2] / (current.Clip[2] - next.Clip[2]));
+		}
+		return numOutput;
+	}
+
+	float EdgeFunction(const float* const a, const float* const b, const float x, const float y)
+	{
+		return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+	}
+
+	int Wrap(const int value, const int size)
+	{
+		const int wrapped = value % size;
+		return wrapped < 0 ? wrapped + size : wrapped;
+	}
+}
+
+void SoftwareRasterizer::Begin(const RasterTarget& target, const FrameConstants& constants)
+{
+	assert(!m_inPass);
+	assert(target.Color && target.Surface && target.Depth);
+	m_inPass = true;
+	m_target = target;
+	m_constants = constants;
+	m_numTilesX = (target.Width + tileSize - 1) / tileSize;
+	m_numTilesY = (target.Height + tileSize - 1) / tileSize;
+	m_bins.resize(m_numTilesX * m_numTilesY);
+	for (std::vector<uint32_t>& bin : m_bins)
+		bin.clear();
+	m_triangles.clear();
+	m_instances.clear();
+	m_statistics = {};
+
+	// Depth is tested in a tightly packed copy so a row of pixels is one load. The padding lets the last block of the
+	// last row load past the end.
+	const uint32_t numPixels = target.Width * target.Height;
+	m_depth.resize(static_cast<size_t>(numPixels) + blockWidth);
+	for (uint32_t i = 0; i < numPixels; i++)
+		m_depth[i] = target.Depth[static_cast<size_t>(i) * texelSize];
+}
+
+void SoftwareRasterizer::SetTextures(const RasterTexture* const textures, const uint32_t numTextures)
+{
+	m_textures = textures;
+	m_numTextures = numTextures;
+}
+
+void SoftwareRasterizer::Draw(const RenderVertex* const vertices, const uint32_t numVertices,
+	const uint32_t* const indices, const uint32_t numIndices, const RenderInstance* const instances,
+	const uint32_t numInstances)
+{
+	assert(m_inPass);
+
+	// the light direction in object space, as the pixel shader computes it
+	const float lightDirection[3] = { m_constants.LightDirection[0], -m_constants.LightDirection[1],
+		-m_constants.LightDirection[2] };
+	const uint32_t firstInstance = static_cast<uint32_t>(m_instances.size());
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		ShadingInstance shading;
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			for (uint32_t column = 0; column < 3; column++)
+				shading.WorldInvTranspose[row][column] = instances[i].WorldInvTranspose[row * 4 + column];
+		}
+		Float3 localLight;
+		float* const localLightComponents = &localLight.x;
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			localLightComponents[row] = lightDirection[0] * shading.WorldInvTranspose[row][0] +
+				lightDirection[1] * shading.WorldInvTranspose[row][1] + lightDirection[2] * shading.WorldInvTranspose[row][2];
+		}
+		localLight = Normalize(localLight);
+		memcpy(shading.LocalLight, &localLight.x, sizeof(shading.LocalLight));
+		shading.TextureID = instances[i].TextureID;
+		m_instances.push_back(shading);
+	}
+
+	// Instances are set up in parallel and binned in order afterwards, which keeps the bins in submission order.
+	std::vector<std::vector<Triangle>> instanceTriangles(numInstances);
+	std::vector<uint32_t> numCulled(numInstances, 0);
+	std::vector<uint32_t> order(numInstances);
+	std::iota(order.begin(), order.end(), 0);
+	std::for_each(std::execution::par, order.begin(), order.end(), [&](const uint32_t i)
+	{
+		SetupTriangles(vertices, numVertices, indices, numIndices, instances[i], firstInstance + i, instanceTriangles[i],
+			numCulled[i]);
+	});
+
+	for (uint32_t i = 0; i < numInstances; i++)
+	{
+		m_statistics.NumTriangles += numIndices / 3;
+		m_statistics.NumCulledTriangles += numCulled[i];
+		for (const Triangle& triangle : instanceTriangles[i])
+		{
+			const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+			m_triangles.push_back(triangle);
+			m_statistics.NumBinnedTriangles++;
+			for (uint32_t tileY = triangle.MinY / tileSize; tileY <= triangle.MaxY / tileSize; tileY++)
+			{
+				for (uint32_t tileX = triangle.MinX / tileSize; tileX <= triangle.MaxX / tileSize; tileX++)
+				{
+					// skip tiles whose pixel centers are all outside one of the edges
+					const float minX = tileX * tileSize + 0.5f;
+					const float maxX = std::min((tileX + 1) * tileSize, m_target.Width) - 0.5f;
+					const float minY = tileY * tileSize + 0.5f;
+					const float maxY = std::min((tileY + 1) * tileSize, m_target.Height) - 0.5f;
+					bool overlaps = true;
+					for (const Plane& edge : triangle.Barycentric)
+					{
+						const float x = edge.X > 0.f ? maxX : minX;
+						const float y = edge.Y > 0.f ? maxY : minY;
+						overlaps = overlaps && edge.X * x + edge.Y * y + edge.Z >= 0.f;
+					}
+					if (overlaps)
+						m_bins[tileY * m_numTilesX + tileX].push_back(index);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::End()
+{
+	assert(m_inPass);
+	std::vector<uint32_t> tiles(m_bins.size());
+	std::iota(tiles.begin(), tiles.end(), 0);
+	std::vector<uint64_t> numShaded(m_bins.size(), 0);
+	std::for_each(std::execution::par, tiles.begin(), tiles.end(), [&](const uint32_t tile)
+	{
+		RasterizeTile(tile, numShaded[tile]);
+	});
+	m_statistics.NumShadedPixels = std::accumulate(numShaded.begin(), numShaded.end(), uint64_t(0));
+
+	const uint32_t numPixels = m_target.Width * m_target.Height;
+	for (uint32_t i = 0; i < numPixels; i++)
+		m_target.Depth[static_cast<size_t>(i) * texelSize] = m_depth[i];
+	m_inPass = false;
+}
+
+void SoftwareRasterizer::SetupTriangles(const RenderVertex* const vertices, const uint32_t numVertices,
+	const uint32_t* const indices, const uint32_t numIndices, const RenderInstance& instance,
+	const uint32_t shadingInstance, std::vector<Triangle>& triangles, uint32_t& numCulled) const
+{
+	Float4x4 world;
+	Float4x4 viewProjection;
+	memcpy(world.m, instance.World, sizeof(world.m));
+	memcpy(viewProjection.m, m_constants.ViewProjection, sizeof(viewProjection.m));
+	const Float4x4 worldViewProjection = Multiply(world, viewProjection);
+
+	std::vector<ClipVertex> transformed(numVertices);
+	for (uint32_t i = 0; i < numVertices; i++)
+	{
+		const float* const position = vertices[i].Position;
+		float worldPosition[4];
+		TransformPoint(worldViewProjection, position[0], position[1], position[2], transformed[i].Clip);
+		TransformPoint(world, position[0], position[1], position[2], worldPosition);
+		memcpy(&transformed[i].Attributes[0], worldPosition, 3 * sizeof(float));
+		memcpy(&transformed[i].Attributes[3], vertices[i].Normal, 3 * sizeof(float));
+		memcpy(&transformed[i].Attributes[6], vertices[i].UV, 2 * sizeof(float));
+	}
+
+	const float width = static_cast<float>(m_target.Width);
+	const float height = static_cast<float>(m_target.Height);
+	for (uint32_t index = 0; index + 2 < numIndices; index += 3)
+	{
+		assert(indices[index] < numVertices && indices[index + 1] < numVertices && indices[index + 2] < numVertices);
+		const ClipVertex input[3] = { transformed[indices[index]], transformed[indices[index + 1]],
+			transformed[indices[index + 2]] };
+		ClipVertex clipped[4];
+		const uint32_t numClipped = ClipToNearPlane(input, clipped);
+		for (uint32_t fan = 1; fan + 1 < numClipped; fan++)
+		{
+			const ClipVertex* const corners[3] = { &clipped[0], &clipped[fan], &clipped[fan + 1] };
+			float screen[3][3];
+			float inverseW[3];
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				inverseW[i] = 1.f / corners[i]->Clip[3];
+				screen[i][0] = (corners[i]->Clip[0] * inverseW[i] * 0.5f + 0.5f) * width;
+				screen[i][1] = (0.5f - corners[i]->Clip[1] * inverseW[i] * 0.5f) * height;
+				screen[i][2] = corners[i]->Clip[2] * inverseW[i];
+			}
+
+			// clockwise on screen is front facing
+			const float area = EdgeFunction(screen[0], screen[1], screen[2][0], screen[2][1]);
+			if (!(area > 0.f))
+			{
+				numCulled++;
+				continue;
+			}
+
+			Triangle triangle;
+			triangle.MinX = std::max(static_cast<int>(std::floor(std::min({ screen[0][0], screen[1][0], screen[2][0] }))), 0);
+			triangle.MaxX = std::min(static_cast<int>(std::ceil(std::max({ screen[0][0], screen[1][0], screen[2][0] }))),
+				static_cast<int>(m_target.Width) - 1);
+			triangle.MinY = std::max(static_cast<int>(std::floor(std::min({ screen[0][1], screen[1][1], screen[2][1] }))), 0);
+			triangle.MaxY = std::min(static_cast<int>(std::ceil(std::max({ screen[0][1], screen[1][1], screen[2][1] }))),
+				static_cast<int>(m_target.Height) - 1);
+			if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+				continue;
+
+			// Barycentric i is the edge function of the edge opposite vertex i. An edge going up the screen is a left
+			// edge and a horizontal one going right is a top edge, for clockwise triangles with y down.
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const float* const a = screen[(i + 1) % 3];
+				const float* const b = screen[(i + 2) % 3];
+				const float dx = b[0] - a[0];
+				const float dy = b[1] - a[1];
+				triangle.Barycentric[i] = { -dy / area, dx / area, (dy * a[0] - dx * a[1]) / area };
+				triangle.TopLeft[i] = dy < 0.f || (dy == 0.f && dx > 0.f);
+			}
+
+			const auto interpolate = [&triangle](const float v0, const float v1, const float v2)
+			{
+				const Plane* const b = triangle.Barycentric;
+				return Plane{ v0 * b[0].X + v1 * b[1].X + v2 * b[2].X, v0 * b[0].Y + v1 * b[1].Y + v2 * b[2].Y,
+					v0 * b[0].Z + v1 * b[1].Z + v2 * b[2].Z };
+			};
+			triangle.Depth = interpolate(screen[0][2], screen[1][2], screen[2][2]);
+			triangle.InverseW = interpolate(inverseW[0], inverseW[1], inverseW[2]);
+			for (uint32_t i = 0; i < numAttributes; i++)
+			{
+				triangle.Attributes[i] = interpolate(corners[0]->Attributes[i] * inverseW[0],
+					corners[1]->Attributes[i] * inverseW[1], corners[2]->Attributes[i] * inverseW[2]);
+			}
+			triangle.Instance = shadingInstance;
+			triangles.push_back(triangle);
+		}
+	}
+}
+
+// Finds the pixels of a row of eight, starting at blockX, that the triangle covers and that pass the depth test, and
+// writes their depth. Returns one bit per pixel.
+uint32_t SoftwareRasterizer::CoverBlock(const Triangle& triangle, const int blockX, const int y, const int minX,
+	const int maxX)
+{
+	float* const depth = &m_depth[static_cast<size_t>(y) * m_target.Width + blockX];
+	const float sampleY = y + 0.5f;
+
+#if defined(__AVX2__)
+	const __m256 lanes = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+	const __m256 pixelX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(blockX)), lanes);
+	const __m256 sampleX = _mm256_add_ps(pixelX, _mm256_set1_ps(0.5f));
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 covered = _mm256_and_ps(_mm256_cmp_ps(pixelX, _mm256_set1_ps(static_cast<float>(minX)), _CMP_GE_OQ),
+		_mm256_cmp_ps(pixelX, _mm256_set1_ps(static_cast<float>(maxX)), _CMP_LE_OQ));
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const Plane& edge = triangle.Barycentric[i];
+		const __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edge.X), sampleX),
+			_mm256_set1_ps(edge.Y * sampleY + edge.Z));
+		const __m256 inside = triangle.TopLeft[i] ? _mm256_cmp_ps(value, zero, _CMP_GE_OQ) :
+			_mm256_cmp_ps(value, zero, _CMP_GT_OQ);
+		covered = _mm256_and_ps(covered, inside);
+	}
+	if (_mm256_movemask_ps(covered) == 0)
+		return 0;
+
+	const Plane& plane = triangle.Depth;
+	const __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.X), sampleX),
+		_mm256_set1_ps(plane.Y * sampleY + plane.Z));
+	const __m256 stored = _mm256_loadu_ps(depth);
+	covered = _mm256_and_ps(covered, _mm256_cmp_ps(z, zero, _CMP_GE_OQ));
+	covered = _mm256_and_ps(covered, _mm256_cmp_ps(z, _mm256_set1_ps(1.f), _CMP_LE_OQ));
+	covered = _mm256_and_ps(covered, _mm256_cmp_ps(z, stored, _CMP_LE_OQ));
+	_mm256_maskstore_ps(depth, _mm256_castps_si256(covered), z);
+	return static_cast<uint32_t>(_mm256_movemask_ps(covered));
+#else
+	uint32_t mask = 0;
+	for (uint32_t lane = 0; lane < blockWidth; lane++)
+	{
+		const int x = blockX + static_cast<int>(lane);
+		if (x < minX || x > maxX)
+			continue;
+		const float sampleX = x + 0.5f;
+		bool covered = true;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const Plane& edge = triangle.Barycentric[i];
+			const float value = edge.X * sampleX + (edge.Y * sampleY + edge.Z);
+			covered = covered && (triangle.TopLeft[i] ? value >= 0.f : value > 0.f);
+		}
+		const Plane& plane = triangle.Depth;
+		const float z = plane.X * sampleX + (plane.Y * sampleY + plane.Z);
+		if (!covered || z < 0.f || z > 1.f || z > depth[lane])
+			continue;
+		depth[lane] = z;
+		mask |= 1u << lane;
+	}
+	return mask;
+#endif
+}
+
+void SoftwareRasterizer::RasterizeTile(const uint32_t tile, uint64_t& numShaded)
+{
+	const int tileMinX = static_cast<int>((tile % m_numTilesX) * tileSize);
+	const int tileMinY = static_cast<int>((tile / m_numTilesX) * tileSize);
+	const int tileMaxX = std::min(tileMinX + static_cast<int>(tileSize), static_cast<int>(m_target.Width)) - 1;
+	const int tileMaxY = std::min(tileMinY + static_cast<int>(tileSize), static_cast<int>(m_target.Height)) - 1;
+
+	for (const uint32_t index : m_bins[tile])
+	{
+		const Triangle& triangle = m_triangles[index];
+		const int minX = std::max(triangle.MinX, tileMinX);
+		const int maxX = std::min(triangle.MaxX, tileMaxX);
+		const int minY = std::max(triangle.MinY, tileMinY);
+		const int maxY = std::min(triangle.MaxY, tileMaxY);
+		// tiles are a whole number of blocks wide, so blocks never cross into the next tile
+		const int firstBlockX = minX & ~static_cast<int>(blockWidth - 1);
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int blockX = firstBlockX; blockX <= maxX; blockX += blockWidth)
+			{
+				uint32_t mask = CoverBlock(triangle, blockX, y, minX, maxX);
+				while (mask != 0)
+				{
+					uint32_t lane = 0;
+					while (!(mask & (1u << lane)))
+						lane++;
+					mask &= mask - 1;
+					ShadePixel(triangle, blockX + lane, y);
+					numShaded++;
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::ShadePixel(const Triangle& triangle, const uint32_t x, const uint32_t y) const
+{
+	const float sampleX = x + 0.5f;
+	const float sampleY = y + 0.5f;
+	const auto evaluate = [sampleX, sampleY](const Plane& plane)
+	{
+		return plane.X * sampleX + (plane.Y * sampleY + plane.Z);
+	};
+	const float w = 1.f / evaluate(triangle.InverseW);
+	float attributes[numAttributes];
+	for (uint32_t i = 0; i < numAttributes; i++)
+		attributes[i] = evaluate(triangle.Attributes[i]) * w;
+	const float* const worldPosition = &attributes[0];
+	const float* const localNormal = &attributes[3];
+
+	const ShadingInstance& instance = m_instances[triangle.Instance];
+	float material[4] = { 1.f, 1.f, 1.f, 1.f };
+	if (instance.TextureID < m_numTextures)
+		SampleTexture(m_textures[instance.TextureID], attributes[6], attributes[7], material);
+
+	// the interpolated normal is not renormalized, as in the pixel shader
+	const float LdotN = std::max(instance.LocalLight[0] * localNormal[0] + instance.LocalLight[1] * localNormal[1] +
+		instance.LocalLight[2] * localNormal[2], 0.f);
+	const size_t texel = (static_cast<size_t>(y) * m_target.Width + x) * texelSize;
+	float* const color = &m_target.Color[texel];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const float ambient = material[i] * m_constants.LightAmbient[i];
+		const float diffuse = m_constants.LightDiffuse[i] * LdotN;
+		color[i] = (ambient + diffuse) * material[i];
+	}
+	color[3] = 1.f;
+	if (m_target.QuantizeColor)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			color[i] = std::round(std::clamp(color[i], 0.f, 1.f) * 255.f) / 255.f;
+	}
+
+	Float3 normal;
+	float* const normalComponents = &normal.x;
+	for (uint32_t column = 0; column < 3; column++)
+	{
+		normalComponents[column] = localNormal[0] * instance.WorldInvTranspose[0][column] +
+			localNormal[1] * instance.WorldInvTranspose[1][column] + localNormal[2] * instance.WorldInvTranspose[2][column];
+	}
+	normal = Normalize(normal);
+	const Float3 toCamera = Float3{ m_constants.CameraPosition[0], m_constants.CameraPosition[1],
+		m_constants.CameraPosition[2] } - Float3{ worldPosition[0], worldPosition[1], worldPosition[2] };
+	if (Dot(normal, toCamera) < 0.f)
+		normal = normal * -1.f;
+	float* const surface = &m_target.Surface[texel];
+	surface[0] = normal.x;
+	surface[1] = normal.y;
+	surface[2] = normal.z;
+	surface[3] = Length(toCamera);
+}
+
+void SoftwareRasterizer::SampleTexture(const RasterTexture& texture, const float u, const float v,
+	float* const output) const
+{
+	const float x = u * texture.Width - 0.5f;
+	const float y = v * texture.Height - 0.5f;
+	const float x0 = std::floor(x);
+	const float y0 = std::floor(y);
+	const float fractionX = x - x0;
+	const float fractionY = y - y0;
+	const int width = static_cast<int>(texture.Width);
+	const int height = static_cast<int>(texture.Height);
+	const int left = Wrap(static_cast<int>(x0), width);
+	const int right = Wrap(static_cast<int>(x0) + 1, width);
+	const int top = Wrap(static_cast<int>(y0), height);
+	const int bottom = Wrap(static_cast<int>(y0) + 1, height);
+	const float* const topLeft = &texture.Data[(static_cast<size_t>(top) * width + left) * texelSize];
+	const float* const topRight = &texture.Data[(static_cast<size_t>(top) * width + right) * texelSize];
+	const float* const bottomLeft = &texture.Data[(static_cast<size_t>(bottom) * width + left) * texelSize];
+	const float* const bottomRight = &texture.Data[(static_cast<size_t>(bottom) * width + right) * texelSize];
+	for (uint32_t i = 0; i < texelSize; i++)
+	{
+		const float upper = topLeft[i] + (topRight[i] - topLeft[i]) * fractionX;
+		const float lower = bottomLeft[i] + (bottomRight[i] - bottomLeft[i]) * fractionX;
+		output[i] = upper + (lower - upper) * fractionY;
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderBackend.h"
+
+// Where a raster pass writes. Every target has four floats per texel, depth is the first of its four.
+struct RasterTarget
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	float* Color = nullptr;
+	float* Surface = nullptr;
+	float* Depth = nullptr;
+	// color is rounded to 8 bits per channel as an R8G8B8A8_UNORM target would store it
+	bool QuantizeColor = true;
+};
+
+// Four floats per texel, sampled with bilinear filtering and wrapping like SamplerType::LinearWrap.
+struct RasterTexture
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	const float* Data = nullptr;
+};
+
+// The vertex and pixel shaders of Shaders.hlsl on the CPU: back faces culled, a less or equal depth test, the D3D top left
+// fill rule and the lit permutation, textured when the instance's TextureID names a bound texture. Draws only transform,
+// set up and bin their triangles into screen tiles; End rasterizes the tiles in parallel, each one's triangles in
+// submission order, so the result does not depend on the number of threads. Edge functions and depth are evaluated for
+// rows of eight pixels at once.
+class SoftwareRasterizer
+{
+public:
+	static const uint32_t tileSize = 64;
+	static const uint32_t blockWidth = 8;
+
+	struct Statistics
+	{
+		uint32_t NumTriangles = 0;
+		uint32_t NumCulledTriangles = 0;
+		uint32_t NumBinnedTriangles = 0;
+		uint64_t NumShadedPixels = 0;
+	};
+
+public:
+	void Begin(const RasterTarget& target, const FrameConstants& constants);
+	// Indexed by RenderInstance::TextureID. Instances past the end are shaded white, like the untextured permutation.
+	void SetTextures(const RasterTexture* const textures, const uint32_t numTextures);
+	// RenderVertex has the layout of Vertex in Model.h, so a Model's vertex and index data can be drawn as they are.
+	void Draw(const RenderVertex* const vertices, const uint32_t numVertices, const uint32_t* const indices,
+		const uint32_t numIndices, const RenderInstance* const instances, const uint32_t numInstances);
+	void End();
+
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	// What the pixel shader needs from the instance, computed once per draw instance.
+	struct ShadingInstance
+	{
+		float WorldInvTranspose[3][3];
+		float LocalLight[3];
+		uint32_t TextureID;
+	};
+
+	// Screen space planes, value = X * x + Y * y + Z at a pixel center. The barycentric planes are normalized by the
+	// area, the attribute planes hold attribute / w so they interpolate linearly on screen.
+	struct Plane
+	{
+		float X;
+		float Y;
+		float Z;
+	};
+
+	static const uint32_t numAttributes = 8;
+
+	struct Triangle
+	{
+		Plane Barycentric[3];
+		// ties on an edge belong to the triangle when it is a top or left edge
+		bool TopLeft[3];
+		Plane Depth;
+		Plane InverseW;
+		// world position, local normal and uv
+		Plane Attributes[numAttributes];
+		int MinX;
+		int MinY;
+		int MaxX;
+		int MaxY;
+		uint32_t Instance;
+	};
+
+	void SetupTriangles(const RenderVertex* const vertices, const uint32_t numVertices, const uint32_t* const indices,
+		const uint32_t numIndices, const RenderInstance& instance, const uint32_t shadingInstance,
+		std::vector<Triangle>& triangles, uint32_t& numCulled) const;
+	uint32_t CoverBlock(const Triangle& triangle, const int blockX, const int y, const int minX, const int maxX);
+	void RasterizeTile(const uint32_t tile, uint64_t& numShaded);
+	void ShadePixel(const Triangle& triangle, const uint32_t x, const uint32_t y) const;
+	void SampleTexture(const RasterTexture& texture, const float u, const float v, float* const output) const;
+
+private:
+	RasterTarget m_target;
+	FrameConstants m_constants = {};
+	const RasterTexture* m_textures = nullptr;
+	uint32_t m_numTextures = 0;
+	uint32_t m_numTilesX = 0;
+	uint32_t m_numTilesY = 0;
+	std::vector<ShadingInstance> m_instances;
+	std::vector<Triangle> m_triangles;
+	// one float per pixel for the duration of the pass
+	std::vector<float> m_depth;
+	// triangle indices overlapping each tile, in submission order
+	std::vector<std::vector<uint32_t>> m_bins;
+	Statistics m_statistics;
+	bool m_inPass = false;
+};
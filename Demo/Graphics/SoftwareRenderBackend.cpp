@@ -0,0 +1,654 @@
+#include "stdafx.h"
+#include "SoftwareRenderBackend.h"
+#include "Float4x4.h"
+#include "SoftwareRasterizer.h"
+#include "../Profiler.h"
+
+#include <cfloat>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+namespace
+{
+	const uint32_t maxLeafSize = 4;
+	const uint32_t maxTraversalDepth = 64;
+	const uint32_t texelSize = 4;
+
+	Float3 ToFloat3(const float* const v) { return { v[0], v[1], v[2] }; }
+
+	// p' = M * [p, w] for a row major 3x4 matrix
+	void TransformByRows(const float* const matrix, const float* const v, const float w, float* const output)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			output[row] = matrix[row * 4] * v[0] + matrix[row * 4 + 1] * v[1] + matrix[row * 4 + 2] * v[2] +
+				matrix[row * 4 + 3] * w;
+		}
+	}
+}
+
+class SoftwareRenderBackend::CommandList : public RenderCommandList
+{
+public:
+	explicit CommandList(SoftwareRenderBackend* const backend) : m_backend(backend) {}
+
+	void ClearTexture(const TextureHandle texture, const float* const value) override
+	{
+		const std::array<float, 4> clearValue = { value[0], value[1], value[2], value[3] };
+		m_commands.push_back([this, texture, clearValue]() { m_backend->ExecuteClear(texture.ID, clearValue); });
+	}
+
+	void BeginRasterPass(const TextureHandle color, const TextureHandle surface, const TextureHandle depth,
+		const FrameConstants& constants) override
+	{
+		assert(!m_inRasterPass);
+		m_inRasterPass = true;
+		RasterState state;
+		state.Color = color.ID;
+		state.Surface = surface.ID;
+		state.Depth = depth.ID;
+		state.Constants = constants;
+		m_commands.push_back([this, state]() { m_backend->ExecuteBeginRasterPass(state); });
+	}
+
+	// The rasterizer stays bound from one list of a submit to the next, so there is nothing to execute.
+	void ResumeRasterPass(const TextureHandle, const TextureHandle, const TextureHandle, const FrameConstants&) override
+	{
+		assert(!m_inRasterPass);
+		m_inRasterPass = true;
+	}
+
+	void DrawIndexedInstanced(const DrawDesc& draw) override
+	{
+		assert(m_inRasterPass);
+		m_commands.push_back([this, draw]() { m_backend->ExecuteDraw(draw); });
+	}
+
+	void EndRasterPass() override
+	{
+		assert(m_inRasterPass);
+		m_inRasterPass = false;
+		m_commands.push_back([this]() { m_backend->ExecuteEndRasterPass(); });
+	}
+
+	void BuildAccelerationStructure(const AccelerationStructureHandle accelerationStructure) override
+	{
+		m_commands.push_back([this, accelerationStructure]() { m_backend->ExecuteBuild(accelerationStructure.ID); });
+	}
+
+	void TraceShadows(const AccelerationStructureHandle scene, const TextureHandle surface, const TextureHandle output,
+		const FrameConstants& constants) override
+	{
+		m_commands.push_back([this, scene, surface, output, constants]()
+		{
+			m_backend->ExecuteTraceShadows(scene.ID, surface.ID, output.ID, constants);
+		});
+	}
+
+	void Composite(const TextureHandle color, const TextureHandle shadow, const TextureHandle output) override
+	{
+		m_commands.push_back([this, color, shadow, output]()
+		{
+			m_backend->ExecuteComposite(color.ID, shadow.ID, output.ID);
+		});
+	}
+
+	void Execute()
+	{
+		for (const std::function<void()>& command : m_commands)
+			command();
+	}
+
+private:
+	SoftwareRenderBackend* m_backend = nullptr;
+	std::vector<std::function<void()>> m_commands;
+	bool m_inRasterPass = false;
+};
+
+SoftwareRenderBackend::SoftwareRenderBackend()
+{
+	m_rasterizer = std::make_unique<SoftwareRasterizer>();
+	m_queueThread = std::thread(&SoftwareRenderBackend::RunQueue, this);
+}
+
+SoftwareRenderBackend::~SoftwareRenderBackend()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_workSubmitted.notify_all();
+	m_queueThread.join();
+}
+
+BufferHandle SoftwareRenderBackend::CreateBuffer(const BufferUsage usage, const size_t size)
+{
+	std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>();
+	buffer->Usage = usage;
+	buffer->Data.resize(size);
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	m_buffers.push_back(std::move(buffer));
+	return { static_cast<uint32_t>(m_buffers.size()) };
+}
+
+void SoftwareRenderBackend::WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data,
+	const size_t size)
+{
+	Buffer& destination = GetBuffer(buffer.ID);
+	assert(offset + size <= destination.Data.size());
+	memcpy(destination.Data.data() + offset, data, size);
+}
+
+TextureHandle SoftwareRenderBackend::CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height)
+{
+	std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+	texture->Format = format;
+	texture->Width = width;
+	texture->Height = height;
+	texture->Data.resize(static_cast<size_t>(width) * height * texelSize, 0.f);
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	m_textures.push_back(std::move(texture));
+	return { static_cast<uint32_t>(m_textures.size()) };
+}
+
+void SoftwareRenderBackend::ReadTexture(const TextureHandle texture, std::vector<float>& rgba)
+{
+	WaitForFence(m_lastSubmittedValue);
+	rgba = GetTexture(texture.ID).Data;
+}
+
+AccelerationStructureHandle SoftwareRenderBackend::CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+	const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount)
+{
+	const Buffer& vertices = GetBuffer(vertexBuffer.ID);
+	const Buffer& indices = GetBuffer(indexBuffer.ID);
+	assert(vertices.Data.size() >= vertexCount * sizeof(RenderVertex));
+	assert(indices.Data.size() >= indexCount * sizeof(uint32_t));
+	const RenderVertex* const vertexData = reinterpret_cast<const RenderVertex*>(vertices.Data.data());
+	const uint32_t* const indexData = reinterpret_cast<const uint32_t*>(indices.Data.data());
+
+	std::unique_ptr<BottomLevel> bottomLevel = std::make_unique<BottomLevel>();
+	const uint32_t numTriangles = indexCount / 3;
+	bottomLevel->Triangles.resize(numTriangles * 9);
+	std::vector<float> bounds(numTriangles * 6);
+	for (uint32_t i = 0; i < numTriangles; i++)
+	{
+		float* const triangle = &bottomLevel->Triangles[i * 9];
+		float* const box = &bounds[i * 6];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			box[axis] = FLT_MAX;
+			box[3 + axis] = -FLT_MAX;
+		}
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			const uint32_t index = indexData[i * 3 + corner];
+			assert(index < vertexCount);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float value = vertexData[index].Position[axis];
+				triangle[corner * 3 + axis] = value;
+				box[axis] = std::min(box[axis], value);
+				box[3 + axis] = std::max(box[3 + axis], value);
+			}
+		}
+	}
+	BuildBVH(bounds, bottomLevel->Hierarchy);
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	m_accelerationStructures.push_back({ std::move(bottomLevel), nullptr });
+	return { static_cast<uint32_t>(m_accelerationStructures.size()) };
+}
+
+AccelerationStructureHandle SoftwareRenderBackend::CreateTopLevelAccelerationStructure(const uint32_t maxInstances)
+{
+	std::unique_ptr<TopLevel> topLevel = std::make_unique<TopLevel>();
+	topLevel->Instances.resize(maxInstances);
+
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	m_accelerationStructures.push_back({ nullptr, std::move(topLevel) });
+	return { static_cast<uint32_t>(m_accelerationStructures.size()) };
+}
+
+void SoftwareRenderBackend::SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+	const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask)
+{
+	TopLevel& scene = GetTopLevel(topLevel.ID);
+	assert(index < scene.Instances.size());
+	Instance& instance = scene.Instances[index];
+	instance.BottomLevelID = bottomLevel.ID;
+	instance.Mesh = bottomLevel.IsValid() ? &GetBottomLevel(bottomLevel.ID) : nullptr;
+	instance.Mask = mask;
+	memcpy(instance.Transform, transform, sizeof(instance.Transform));
+
+	Float4x4 matrix = Identity4x4();
+	memcpy(matrix.m, transform, sizeof(instance.Transform));
+	const Float4x4 inverse = Inverse(matrix);
+	memcpy(instance.InverseTransform, inverse.m, sizeof(instance.InverseTransform));
+}
+
+RenderCommandList& SoftwareRenderBackend::BeginCommandList()
+{
+	m_openLists.push_back(std::make_unique<CommandList>(this));
+	return *m_openLists.back();
+}
+
+uint64_t SoftwareRenderBackend::Submit()
+{
+	assert(!m_openLists.empty());
+	uint64_t value = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		value = ++m_lastSubmittedValue;
+		m_submitted.emplace_back(std::move(m_openLists), value);
+	}
+	m_openLists.clear();
+	m_workSubmitted.notify_one();
+	return value;
+}
+
+uint64_t SoftwareRenderBackend::GetCompletedFenceValue()
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	return m_completedValue;
+}
+
+void SoftwareRenderBackend::WaitForFence(const uint64_t value)
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	m_workCompleted.wait(lock, [this, value]() { return m_completedValue >= value; });
+}
+
+void SoftwareRenderBackend::RunQueue()
+{
+	Profiler::SetThreadName("Software queue");
+	while (true)
+	{
+		std::vector<std::unique_ptr<CommandList>> commandLists;
+		uint64_t value = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_workSubmitted.wait(lock, [this]() { return m_stopping || !m_submitted.empty(); });
+			if (m_submitted.empty())
+				return;
+			commandLists = std::move(m_submitted.front().first);
+			value = m_submitted.front().second;
+			m_submitted.pop_front();
+		}
+
+		Profiler::BeginScope("Execute");
+		for (const std::unique_ptr<CommandList>& commandList : commandLists)
+			commandList->Execute();
+		Profiler::EndScope();
+
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_completedValue = value;
+		}
+		m_workCompleted.notify_all();
+	}
+}
+
+SoftwareRenderBackend::Buffer& SoftwareRenderBackend::GetBuffer(const uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	assert(id > 0 && id <= m_buffers.size());
+	return *m_buffers[id - 1];
+}
+
+SoftwareRenderBackend::Texture& SoftwareRenderBackend::GetTexture(const uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	assert(id > 0 && id <= m_textures.size());
+	return *m_textures[id - 1];
+}
+
+SoftwareRenderBackend::BottomLevel& SoftwareRenderBackend::GetBottomLevel(const uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	assert(id > 0 && id <= m_accelerationStructures.size() && m_accelerationStructures[id - 1].Bottom);
+	return *m_accelerationStructures[id - 1].Bottom;
+}
+
+SoftwareRenderBackend::TopLevel& SoftwareRenderBackend::GetTopLevel(const uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(m_resourceMutex);
+	assert(id > 0 && id <= m_accelerationStructures.size() && m_accelerationStructures[id - 1].Top);
+	return *m_accelerationStructures[id - 1].Top;
+}
+
+// Median split on the longest axis of the primitive centroids, until leaves hold maxLeafSize primitives or fewer.
+void SoftwareRenderBackend::BuildBVH(const std::vector<float>& bounds, BVH& bvh)
+{
+	const uint32_t numPrimitives = static_cast<uint32_t>(bounds.size() / 6);
+	bvh.Nodes.clear();
+	bvh.Primitives.resize(numPrimitives);
+	std::iota(bvh.Primitives.begin(), bvh.Primitives.end(), 0);
+	if (numPrimitives == 0)
+		return;
+
+	struct Range
+	{
+		uint32_t Node;
+		uint32_t First;
+		uint32_t Count;
+	};
+	std::vector<Range> stack = { { 0, 0, numPrimitives } };
+	bvh.Nodes.reserve(numPrimitives * 2);
+	bvh.Nodes.push_back({});
+	while (!stack.empty())
+	{
+		const Range range = stack.back();
+		stack.pop_back();
+
+		BVHNode node = {};
+		float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			node.Min[axis] = FLT_MAX;
+			node.Max[axis] = -FLT_MAX;
+		}
+		for (uint32_t i = range.First; i < range.First + range.Count; i++)
+		{
+			const float* const box = &bounds[bvh.Primitives[i] * 6];
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				node.Min[axis] = std::min(node.Min[axis], box[axis]);
+				node.Max[axis] = std::max(node.Max[axis], box[3 + axis]);
+				const float centroid = (box[axis] + box[3 + axis]) * 0.5f;
+				centroidMin[axis] = std::min(centroidMin[axis], centroid);
+				centroidMax[axis] = std::max(centroidMax[axis], centroid);
+			}
+		}
+
+		uint32_t splitAxis = 0;
+		for (uint32_t axis = 1; axis < 3; axis++)
+		{
+			if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis])
+				splitAxis = axis;
+		}
+
+		if (range.Count <= maxLeafSize || centroidMax[splitAxis] == centroidMin[splitAxis])
+		{
+			node.First = range.First;
+			node.Count = range.Count;
+			bvh.Nodes[range.Node] = node;
+			continue;
+		}
+
+		const uint32_t middle = range.First + range.Count / 2;
+		std::nth_element(bvh.Primitives.begin() + range.First, bvh.Primitives.begin() + middle,
+			bvh.Primitives.begin() + range.First + range.Count, [&bounds, splitAxis](const uint32_t a, const uint32_t b)
+			{
+				return bounds[a * 6 + splitAxis] + bounds[a * 6 + 3 + splitAxis] <
+					bounds[b * 6 + splitAxis] + bounds[b * 6 + 3 + splitAxis];
+			});
+
+		const uint32_t firstChild = static_cast<uint32_t>(bvh.Nodes.size());
+		bvh.Nodes.push_back({});
+		bvh.Nodes.push_back({});
+		node.First = firstChild;
+		node.Count = 0;
+		bvh.Nodes[range.Node] = node;
+		stack.push_back({ firstChild, range.First, middle - range.First });
+		stack.push_back({ firstChild + 1, middle, range.First + range.Count - middle });
+	}
+}
+
+bool SoftwareRenderBackend::IntersectsBox(const float* const origin, const float* const inverseDirection,
+	const float tMax, const BVHNode& node)
+{
+	float tNear = 0.f;
+	float tFar = tMax;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const float t0 = (node.Min[axis] - origin[axis]) * inverseDirection[axis];
+		const float t1 = (node.Max[axis] - origin[axis]) * inverseDirection[axis];
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+	}
+	return tNear <= tFar;
+}
+
+bool SoftwareRenderBackend::AnyHit(const BottomLevel& mesh, const float* const origin, const float* const direction,
+	const float tMin, const float tMax)
+{
+	if (mesh.Hierarchy.Nodes.empty())
+		return false;
+
+	const float inverseDirection[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+	const Float3 rayOrigin = ToFloat3(origin);
+	const Float3 rayDirection = ToFloat3(direction);
+	uint32_t stack[maxTraversalDepth];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BVHNode& node = mesh.Hierarchy.Nodes[stack[--stackSize]];
+		if (!IntersectsBox(origin, inverseDirection, tMax, node))
+			continue;
+
+		if (node.Count == 0)
+		{
+			assert(stackSize + 2 <= maxTraversalDepth);
+			stack[stackSize++] = node.First;
+			stack[stackSize++] = node.First + 1;
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			// Moller-Trumbore
+			const float* const triangle = &mesh.Triangles[mesh.Hierarchy.Primitives[i] * 9];
+			const Float3 v0 = ToFloat3(triangle);
+			const Float3 edge1 = ToFloat3(triangle + 3) - v0;
+			const Float3 edge2 = ToFloat3(triangle + 6) - v0;
+			const Float3 p = Cross(rayDirection, edge2);
+			const float determinant = Dot(edge1, p);
+			if (std::fabs(determinant) < 1e-12f)
+				continue;
+			const float inverseDeterminant = 1.f / determinant;
+			const Float3 s = rayOrigin - v0;
+			const float u = Dot(s, p) * inverseDeterminant;
+			if (u < 0.f || u > 1.f)
+				continue;
+			const Float3 q = Cross(s, edge1);
+			const float v = Dot(rayDirection, q) * inverseDeterminant;
+			if (v < 0.f || u + v > 1.f)
+				continue;
+			const float t = Dot(edge2, q) * inverseDeterminant;
+			if (t >= tMin && t <= tMax)
+				return true;
+		}
+	}
+	return false;
+}
+
+// Rays are taken into each instance's object space without renormalizing, so t means the same distance at both levels.
+bool SoftwareRenderBackend::AnyHit(const TopLevel& scene, const float* const origin, const float* const direction,
+	const float tMin, const float tMax)
+{
+	if (scene.Hierarchy.Nodes.empty())
+		return false;
+
+	const float inverseDirection[3] = { 1.f / direction[0], 1.f / direction[1], 1.f / direction[2] };
+	uint32_t stack[maxTraversalDepth];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const BVHNode& node = scene.Hierarchy.Nodes[stack[--stackSize]];
+		if (!IntersectsBox(origin, inverseDirection, tMax, node))
+			continue;
+
+		if (node.Count == 0)
+		{
+			assert(stackSize + 2 <= maxTraversalDepth);
+			stack[stackSize++] = node.First;
+			stack[stackSize++] = node.First + 1;
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; i++)
+		{
+			const Instance& instance = scene.BuiltInstances[scene.Hierarchy.Primitives[i]];
+			float objectOrigin[3];
+			float objectDirection[3];
+			TransformByRows(instance.InverseTransform, origin, 1.f, objectOrigin);
+			TransformByRows(instance.InverseTransform, direction, 0.f, objectDirection);
+			if (AnyHit(*instance.Mesh, objectOrigin, objectDirection, tMin, tMax))
+				return true;
+		}
+	}
+	return false;
+}
+
+void SoftwareRenderBackend::StoreTexel(Texture& texture, const uint32_t index, const float* const value)
+{
+	float* const texel = &texture.Data[static_cast<size_t>(index) * texelSize];
+	for (uint32_t i = 0; i < texelSize; i++)
+	{
+		texel[i] = texture.Format == TextureFormat::RGBA8 ?
+			std::round(std::clamp(value[i], 0.f, 1.f) * 255.f) / 255.f : value[i];
+	}
+}
+
+void SoftwareRenderBackend::ExecuteClear(const uint32_t texture, const std::array<float, 4>& value)
+{
+	Texture& target = GetTexture(texture);
+	for (uint32_t i = 0; i < target.Width * target.Height; i++)
+		StoreTexel(target, i, value.data());
+}
+
+void SoftwareRenderBackend::ExecuteBeginRasterPass(const RasterState& state)
+{
+	Texture& color = GetTexture(state.Color);
+	Texture& surface = GetTexture(state.Surface);
+	Texture& depth = GetTexture(state.Depth);
+	assert(color.Width == depth.Width && color.Height == depth.Height);
+	assert(surface.Width == depth.Width && surface.Height == depth.Height);
+
+	RasterTarget target;
+	target.Width = depth.Width;
+	target.Height = depth.Height;
+	target.Color = color.Data.data();
+	target.Surface = surface.Data.data();
+	target.Depth = depth.Data.data();
+	target.QuantizeColor = color.Format == TextureFormat::RGBA8;
+	m_rasterizer->Begin(target, state.Constants);
+}
+
+void SoftwareRenderBackend::ExecuteDraw(const DrawDesc& draw)
+{
+	const Buffer& vertexBuffer = GetBuffer(draw.VertexBuffer.ID);
+	const Buffer& indexBuffer = GetBuffer(draw.IndexBuffer.ID);
+	const Buffer& instanceBuffer = GetBuffer(draw.InstanceBuffer.ID);
+	assert((draw.FirstInstance + draw.InstanceCount) * sizeof(RenderInstance) <= instanceBuffer.Data.size());
+	assert(draw.IndexCount * sizeof(uint32_t) <= indexBuffer.Data.size());
+
+	m_rasterizer->Draw(reinterpret_cast<const RenderVertex*>(vertexBuffer.Data.data()),
+		static_cast<uint32_t>(vertexBuffer.Data.size() / sizeof(RenderVertex)),
+		reinterpret_cast<const uint32_t*>(indexBuffer.Data.data()), draw.IndexCount,
+		reinterpret_cast<const RenderInstance*>(instanceBuffer.Data.data()) + draw.FirstInstance, draw.InstanceCount);
+}
+
+void SoftwareRenderBackend::ExecuteEndRasterPass()
+{
+	m_rasterizer->End();
+}
+
+void SoftwareRenderBackend::ExecuteBuild(const uint32_t topLevel)
+{
+	TopLevel& scene = GetTopLevel(topLevel);
+	scene.BuiltInstances.clear();
+	std::vector<float> bounds;
+	for (const Instance& instance : scene.Instances)
+	{
+		if (!instance.Mesh || instance.Mask == 0 || instance.Mesh->Hierarchy.Nodes.empty())
+			continue;
+
+		// world bounds of the transformed corners of the mesh bounds
+		const BVHNode& root = instance.Mesh->Hierarchy.Nodes[0];
+		float box[6] = { FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const float point[3] = { corner & 1 ? root.Max[0] : root.Min[0], corner & 2 ? root.Max[1] : root.Min[1],
+				corner & 4 ? root.Max[2] : root.Min[2] };
+			float worldPoint[3];
+			TransformByRows(instance.Transform, point, 1.f, worldPoint);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				box[axis] = std::min(box[axis], worldPoint[axis]);
+				box[3 + axis] = std::max(box[3 + axis], worldPoint[axis]);
+			}
+		}
+		bounds.insert(bounds.end(), box, box + 6);
+		scene.BuiltInstances.push_back(instance);
+	}
+	BuildBVH(bounds, scene.Hierarchy);
+}
+
+// Same rays as the hard shadows in RaytracingShaders.hlsl, from the surface rebuilt out of the camera ray and distance.
+void SoftwareRenderBackend::ExecuteTraceShadows(const uint32_t scene, const uint32_t surface, const uint32_t output,
+	const FrameConstants& constants)
+{
+	const TopLevel& topLevel = GetTopLevel(scene);
+	const Texture& surfaceTexture = GetTexture(surface);
+	Texture& outputTexture = GetTexture(output);
+	assert(surfaceTexture.Width == outputTexture.Width && surfaceTexture.Height == outputTexture.Height);
+
+	Float4x4 inverseViewProjection;
+	memcpy(inverseViewProjection.m, constants.InverseViewProjection, sizeof(inverseViewProjection.m));
+	const Float3 cameraPosition = ToFloat3(constants.CameraPosition);
+	const Float3 toLight = Normalize({ constants.LightDirection[0], -constants.LightDirection[1],
+		-constants.LightDirection[2] });
+
+	std::vector<uint32_t> rows(outputTexture.Height);
+	std::iota(rows.begin(), rows.end(), 0);
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](const uint32_t y)
+	{
+		for (uint32_t x = 0; x < outputTexture.Width; x++)
+		{
+			const uint32_t pixel = y * outputTexture.Width + x;
+			const float* const texel = &surfaceTexture.Data[static_cast<size_t>(pixel) * texelSize];
+			float visibility = 1.f;
+			if (texel[3] >= 0.f)
+			{
+				const float ndcX = (x + 0.5f) / outputTexture.Width * 2.f - 1.f;
+				const float ndcY = 1.f - (y + 0.5f) / outputTexture.Height * 2.f;
+				float farPoint[4];
+				TransformPoint(inverseViewProjection, ndcX, ndcY, 1.f, farPoint);
+				const Float3 direction = Normalize(Float3{ farPoint[0], farPoint[1], farPoint[2] } * (1.f / farPoint[3]) -
+					cameraPosition);
+				const Float3 position = cameraPosition + direction * texel[3];
+				const Float3 origin = position + ToFloat3(texel) * 0.001f;
+				visibility = AnyHit(topLevel, &origin.x, &toLight.x, 0.01f, 1e+38f) ? 0.f : 1.f;
+			}
+			const float value[4] = { visibility, visibility, visibility, 1.f };
+			StoreTexel(outputTexture, pixel, value);
+		}
+	});
+}
+
+// The final pass: scene color darkened by shadow visibility and ambient occlusion.
+void SoftwareRenderBackend::ExecuteComposite(const uint32_t color, const uint32_t shadow, const uint32_t output)
+{
+	const Texture& colorTexture = GetTexture(color);
+	const Texture& shadowTexture = GetTexture(shadow);
+	Texture& outputTexture = GetTexture(output);
+	assert(colorTexture.Width == outputTexture.Width && shadowTexture.Width == outputTexture.Width);
+	assert(colorTexture.Height == outputTexture.Height && shadowTexture.Height == outputTexture.Height);
+
+	for (uint32_t i = 0; i < outputTexture.Width * outputTexture.Height; i++)
+	{
+		const float* const sceneTexel = &colorTexture.Data[static_cast<size_t>(i) * texelSize];
+		const float* const shadowTexel = &shadowTexture.Data[static_cast<size_t>(i) * texelSize];
+		const float value[4] = { sceneTexel[0] * shadowTexel[0] * shadowTexel[3],
+			sceneTexel[1] * shadowTexel[1] * shadowTexel[3], sceneTexel[2] * shadowTexel[2] * shadowTexel[3], 1.f };
+		StoreTexel(outputTexture, i, value);
+	}
+}
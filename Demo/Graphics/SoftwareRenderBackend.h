@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "RenderBackend.h"
+
+class SoftwareRasterizer;
+
+// Runs the frame on the CPU: triangles are rasterized by SoftwareRasterizer, shadow rays are traced through a
+// bounding volume hierarchy per mesh and one over the instances, and submitted lists execute in order on a queue thread
+// so fences behave like a GPU queue's. Meant for headless runs and for checking the D3D12 backend, not for speed.
+class SoftwareRenderBackend : public RenderBackend
+{
+public:
+	SoftwareRenderBackend();
+	~SoftwareRenderBackend() override;
+
+	const char* GetName() const override { return "Software"; }
+
+	BufferHandle CreateBuffer(const BufferUsage usage, const size_t size) override;
+	void WriteBuffer(const BufferHandle buffer, const size_t offset, const void* const data, const size_t size) override;
+	TextureHandle CreateTexture(const TextureFormat format, const uint32_t width, const uint32_t height) override;
+	void ReadTexture(const TextureHandle texture, std::vector<float>& rgba) override;
+
+	AccelerationStructureHandle CreateBottomLevelAccelerationStructure(const BufferHandle vertexBuffer,
+		const uint32_t vertexCount, const BufferHandle indexBuffer, const uint32_t indexCount) override;
+	AccelerationStructureHandle CreateTopLevelAccelerationStructure(const uint32_t maxInstances) override;
+	void SetInstance(const AccelerationStructureHandle topLevel, const uint32_t index,
+		const AccelerationStructureHandle bottomLevel, const float* const transform, const uint8_t mask) override;
+
+	RenderCommandList& BeginCommandList() override;
+	uint64_t Submit() override;
+	uint64_t GetCompletedFenceValue() override;
+	void WaitForFence(const uint64_t value) override;
+
+private:
+	class CommandList;
+
+	struct Buffer
+	{
+		BufferUsage Usage = BufferUsage::Vertex;
+		std::vector<uint8_t> Data;
+	};
+
+	// Four floats per texel whatever the format. RGBA8 texels are quantized when written, as a UNORM target would be.
+	struct Texture
+	{
+		TextureFormat Format = TextureFormat::RGBA8;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<float> Data;
+	};
+
+	// Leaves have Count primitives starting at First in the primitive order, inner nodes have Count 0 and their children
+	// at First and First + 1.
+	struct BVHNode
+	{
+		float Min[3];
+		float Max[3];
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	struct BVH
+	{
+		std::vector<BVHNode> Nodes;
+		std::vector<uint32_t> Primitives;
+	};
+
+	struct BottomLevel
+	{
+		// three vertices of three floats per triangle
+		std::vector<float> Triangles;
+		BVH Hierarchy;
+	};
+
+	struct Instance
+	{
+		uint32_t BottomLevelID = 0;
+		// resolved when the top level is built
+		const BottomLevel* Mesh = nullptr;
+		float Transform[12] = {};
+		float InverseTransform[12] = {};
+		uint8_t Mask = 0;
+	};
+
+	struct TopLevel
+	{
+		std::vector<Instance> Instances;
+		// instances that point at a mesh, in the order the hierarchy refers to them
+		std::vector<Instance> BuiltInstances;
+		BVH Hierarchy;
+	};
+
+	// both levels share one handle space
+	struct AccelerationStructure
+	{
+		std::unique_ptr<BottomLevel> Bottom;
+		std::unique_ptr<TopLevel> Top;
+	};
+
+	struct RasterState
+	{
+		uint32_t Color = 0;
+		uint32_t Surface = 0;
+		uint32_t Depth = 0;
+		FrameConstants Constants = {};
+	};
+
+	static void BuildBVH(const std::vector<float>& bounds, BVH& bvh);
+	static bool IntersectsBox(const float* const origin, const float* const inverseDirection, const float tMax,
+		const BVHNode& node);
+	static bool AnyHit(const BottomLevel& mesh, const float* const origin, const float* const direction, const float tMin,
+		const float tMax);
+	static bool AnyHit(const TopLevel& scene, const float* const origin, const float* const direction, const float tMin,
+		const float tMax);
+	static void StoreTexel(Texture& texture, const uint32_t index, const float* const value);
+
+	Buffer& GetBuffer(const uint32_t id);
+	Texture& GetTexture(const uint32_t id);
+	BottomLevel& GetBottomLevel(const uint32_t id);
+	TopLevel& GetTopLevel(const uint32_t id);
+	void ExecuteClear(const uint32_t texture, const std::array<float, 4>& value);
+	void ExecuteBeginRasterPass(const RasterState& state);
+	void ExecuteDraw(const DrawDesc& draw);
+	void ExecuteEndRasterPass();
+	void ExecuteBuild(const uint32_t topLevel);
+	void ExecuteTraceShadows(const uint32_t scene, const uint32_t surface, const uint32_t output,
+		const FrameConstants& constants);
+	void ExecuteComposite(const uint32_t color, const uint32_t shadow, const uint32_t output);
+	void RunQueue();
+
+private:
+	// Resources are created on the calling thread while the queue thread runs, so the tables are guarded and hold
+	// pointers that stay put as they grow.
+	std::mutex m_resourceMutex;
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+	std::vector<std::unique_ptr<Texture>> m_textures;
+	std::vector<AccelerationStructure> m_accelerationStructures;
+
+	// only used on the queue thread
+	std::unique_ptr<SoftwareRasterizer> m_rasterizer;
+
+	// recorded commands run in submission order on the queue thread, lists within a submit in the order they were begun
+	std::vector<std::unique_ptr<CommandList>> m_openLists;
+	std::deque<std::pair<std::vector<std::unique_ptr<CommandList>>, uint64_t>> m_submitted;
+	std::mutex m_queueMutex;
+	std::condition_variable m_workSubmitted;
+	std::condition_variable m_workCompleted;
+	uint64_t m_lastSubmittedValue = 0;
+	uint64_t m_completedValue = 0;
+	bool m_stopping = false;
+	std::thread m_queueThread;
+};
@@ -29,6 +29,19 @@ void TopLevelAccelerationStructure::SetInstance(const uint32_t instanceID,
 	m_pInstanceDescs[instanceID].InstanceMask = instanceMask;
 }
 
+void TopLevelAccelerationStructure::SetInstance(const uint32_t instanceID,
+	const uint32_t instanceContributionToHitGroupIndex, const float* const transform,
+	const uint32_t instanceMask, const uint32_t instanceFlags, const D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAccelerationStructureAddress)
+{
+	assert(instanceID < m_maxInstances);
+	m_pInstanceDescs[instanceID].InstanceID = instanceID;
+	m_pInstanceDescs[instanceID].InstanceContributionToHitGroupIndex = instanceContributionToHitGroupIndex;
+	m_pInstanceDescs[instanceID].Flags = instanceFlags;
+	memcpy(m_pInstanceDescs[instanceID].Transform, transform, sizeof(m_pInstanceDescs[instanceID].Transform));
+	m_pInstanceDescs[instanceID].AccelerationStructure = bottomLevelAccelerationStructureAddress;
+	m_pInstanceDescs[instanceID].InstanceMask = instanceMask;
+}
+
 void TopLevelAccelerationStructure::Stage(ID3D12Device5* const device)
 {
 	m_instancesBuffer->Unmap(0, nullptr);
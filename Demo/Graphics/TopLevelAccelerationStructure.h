@@ -7,6 +7,10 @@ public:
 	void SetInstance(const uint32_t instanceID, const uint32_t instanceContributionToHitGroupIndex, const XMMATRIX& transform,
 		const uint32_t instanceMask, const uint32_t instanceFlags,
 		const D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAccelerationStructureAddress);
+	// transform is a row major 3x4 matrix, copied as is
+	void SetInstance(const uint32_t instanceID, const uint32_t instanceContributionToHitGroupIndex, const float* const transform,
+		const uint32_t instanceMask, const uint32_t instanceFlags,
+		const D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAccelerationStructureAddress);
 	void Stage(ID3D12Device5* const device);
 	void Commit(ID3D12GraphicsCommandList4* const commandList);
 	void Update(ID3D12Device5* const device, ID3D12GraphicsCommandList4* const commandList);
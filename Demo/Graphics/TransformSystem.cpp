@@ -0,0 +1,321 @@
+#include "stdafx.h"
+#include "TransformSystem.h"
+
+#include <execution>
+#include <immintrin.h>
+
+// Objects are processed in chunks this large across threads. Must be a multiple of the SIMD width.
+static const uint32_t chunkSize = 1024;
+static const uint32_t simdWidth = 8;
+
+static const float pi = 3.141592654f;
+static const float twoPi = 6.283185307f;
+static const float halfPi = 1.570796327f;
+static const float reciprocalTwoPi = 0.159154943f;
+
+// Same range reduction and minimax polynomials as XMScalarSinCos so the scalar and SIMD paths agree.
+static void ScalarSinCos(const float value, float& sin, float& cos)
+{
+	float quotient = reciprocalTwoPi * value;
+	quotient = static_cast<float>(static_cast<int>(value >= 0.f ? quotient + 0.5f : quotient - 0.5f));
+	float y = value - twoPi * quotient;
+
+	float sign = 1.f;
+	if (y > halfPi)
+	{
+		y = pi - y;
+		sign = -1.f;
+	}
+	else if (y < -halfPi)
+	{
+		y = -pi - y;
+		sign = -1.f;
+	}
+
+	const float y2 = y * y;
+	sin = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2 - 0.16666667f) * y2 + 1.f) * y;
+	cos = (((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2 - 0.5f) * y2 + 1.f) * sign;
+}
+
+#if defined(__AVX2__)
+static void SinCos8(const __m256 value, __m256& sin, __m256& cos)
+{
+	__m256 quotient = _mm256_round_ps(_mm256_mul_ps(value, _mm256_set1_ps(reciprocalTwoPi)),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 y = _mm256_sub_ps(value, _mm256_mul_ps(quotient, _mm256_set1_ps(twoPi)));
+
+	// Reflect into [-pi/2, pi/2]. Cosine changes sign wherever a reflection happened.
+	const __m256 signBit = _mm256_set1_ps(-0.f);
+	const __m256 ySign = _mm256_and_ps(y, signBit);
+	const __m256 piWithSign = _mm256_or_ps(_mm256_set1_ps(pi), ySign);
+	const __m256 reflected = _mm256_sub_ps(piWithSign, y);
+	const __m256 reflect = _mm256_cmp_ps(_mm256_andnot_ps(signBit, y), _mm256_set1_ps(halfPi), _CMP_GT_OQ);
+	y = _mm256_blendv_ps(y, reflected, reflect);
+	const __m256 sign = _mm256_blendv_ps(_mm256_set1_ps(1.f), _mm256_set1_ps(-1.f), reflect);
+
+	const __m256 y2 = _mm256_mul_ps(y, y);
+	__m256 s = _mm256_set1_ps(-2.3889859e-08f);
+	s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(2.7525562e-06f));
+	s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(-0.00019840874f));
+	s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(0.0083333310f));
+	s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(-0.16666667f));
+	s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(1.f));
+	sin = _mm256_mul_ps(s, y);
+
+	__m256 c = _mm256_set1_ps(-2.6051615e-07f);
+	c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(2.4760495e-05f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(-0.0013888378f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(0.041666638f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(-0.5f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(1.f));
+	cos = _mm256_mul_ps(c, sign);
+}
+
+// Turns eight registers holding one matrix element for eight objects into eight registers holding eight consecutive
+// elements of one object.
+static void Transpose8x8(__m256* const rows)
+{
+	const __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	const __m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	const __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	const __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	const __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	const __m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	const __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	const __m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+	const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Writes 16 elements per object for eight objects. elements[e] holds element e of all eight objects.
+static void StoreMatrices8(__m256* const elements, float* const destination)
+{
+	Transpose8x8(elements);
+	Transpose8x8(elements + 8);
+	for (uint32_t i = 0; i < simdWidth; i++)
+	{
+		_mm256_storeu_ps(destination + i * TransformSystem::matrixSize, elements[i]);
+		_mm256_storeu_ps(destination + i * TransformSystem::matrixSize + 8, elements[8 + i]);
+	}
+}
+#endif
+
+void TransformSystem::Resize(const uint32_t count)
+{
+	m_count = count;
+
+	// Arrays are padded to a whole number of SIMD lanes so the last group of objects can be loaded and stored directly.
+	const uint32_t paddedCount = ((count + simdWidth - 1) / simdWidth) * simdWidth;
+	m_positionX.resize(paddedCount, 0.f);
+	m_positionY.resize(paddedCount, 0.f);
+	m_positionZ.resize(paddedCount, 0.f);
+	m_rotationX.resize(paddedCount, 0.f);
+	m_rotationY.resize(paddedCount, 0.f);
+	m_rotationZ.resize(paddedCount, 0.f);
+	m_scaleX.resize(paddedCount, 1.f);
+	m_scaleY.resize(paddedCount, 1.f);
+	m_scaleZ.resize(paddedCount, 1.f);
+	m_world.resize(paddedCount * matrixSize, 0.f);
+	m_worldInverseTranspose.resize(paddedCount * matrixSize, 0.f);
+	m_raytracingTransform.resize(paddedCount * raytracingTransformSize, 0.f);
+}
+
+void TransformSystem::SetPosition(const uint32_t index, const float x, const float y, const float z)
+{
+	assert(index < m_count);
+	m_positionX[index] = x;
+	m_positionY[index] = y;
+	m_positionZ[index] = z;
+}
+
+void TransformSystem::SetRotation(const uint32_t index, const float x, const float y, const float z)
+{
+	assert(index < m_count);
+	m_rotationX[index] = x;
+	m_rotationY[index] = y;
+	m_rotationZ[index] = z;
+}
+
+void TransformSystem::SetScale(const uint32_t index, const float x, const float y, const float z)
+{
+	assert(index < m_count);
+	m_scaleX[index] = x;
+	m_scaleY[index] = y;
+	m_scaleZ[index] = z;
+}
+
+Float3 TransformSystem::GetPosition(const uint32_t index) const
+{
+	assert(index < m_count);
+	return { m_positionX[index], m_positionY[index], m_positionZ[index] };
+}
+
+Float3 TransformSystem::GetRotation(const uint32_t index) const
+{
+	assert(index < m_count);
+	return { m_rotationX[index], m_rotationY[index], m_rotationZ[index] };
+}
+
+Float3 TransformSystem::GetScale(const uint32_t index) const
+{
+	assert(index < m_count);
+	return { m_scaleX[index], m_scaleY[index], m_scaleZ[index] };
+}
+
+void TransformSystem::Update()
+{
+	const uint32_t numChunks = (m_count + chunkSize - 1) / chunkSize;
+	if (numChunks <= 1)
+	{
+		UpdateRange(0, m_count);
+		return;
+	}
+
+	std::vector<uint32_t> chunks(numChunks);
+	for (uint32_t i = 0; i < numChunks; i++)
+	{
+		chunks[i] = i;
+	}
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(), [this](const uint32_t chunk)
+	{
+		UpdateRange(chunk * chunkSize, std::min((chunk + 1) * chunkSize, m_count));
+	});
+}
+
+void TransformSystem::UpdateRange(const uint32_t first, const uint32_t last)
+{
+	uint32_t i = first;
+
+#if defined(__AVX2__)
+	// Chunks start on a multiple of the SIMD width and the arrays are padded, so whole groups of eight can always be processed.
+	for (; i < last; i += simdWidth)
+	{
+		__m256 sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+		SinCos8(_mm256_loadu_ps(&m_rotationX[i]), sinPitch, cosPitch);
+		SinCos8(_mm256_loadu_ps(&m_rotationY[i]), sinYaw, cosYaw);
+		SinCos8(_mm256_loadu_ps(&m_rotationZ[i]), sinRoll, cosRoll);
+
+		// Rotation matrix rows, as XMMatrixRotationRollPitchYaw builds them.
+		const __m256 sinRollSinPitch = _mm256_mul_ps(sinRoll, sinPitch);
+		const __m256 cosRollSinPitch = _mm256_mul_ps(cosRoll, sinPitch);
+		const __m256 r00 = _mm256_add_ps(_mm256_mul_ps(cosRoll, cosYaw), _mm256_mul_ps(sinRollSinPitch, sinYaw));
+		const __m256 r01 = _mm256_mul_ps(sinRoll, cosPitch);
+		const __m256 r02 = _mm256_sub_ps(_mm256_mul_ps(sinRollSinPitch, cosYaw), _mm256_mul_ps(cosRoll, sinYaw));
+		const __m256 r10 = _mm256_sub_ps(_mm256_mul_ps(cosRollSinPitch, sinYaw), _mm256_mul_ps(sinRoll, cosYaw));
+		const __m256 r11 = _mm256_mul_ps(cosRoll, cosPitch);
+		const __m256 r12 = _mm256_add_ps(_mm256_mul_ps(sinRoll, sinYaw), _mm256_mul_ps(cosRollSinPitch, cosYaw));
+		const __m256 r20 = _mm256_mul_ps(cosPitch, sinYaw);
+		const __m256 r21 = _mm256_sub_ps(_mm256_setzero_ps(), sinPitch);
+		const __m256 r22 = _mm256_mul_ps(cosPitch, cosYaw);
+
+		const __m256 sx = _mm256_loadu_ps(&m_scaleX[i]);
+		const __m256 sy = _mm256_loadu_ps(&m_scaleY[i]);
+		const __m256 sz = _mm256_loadu_ps(&m_scaleZ[i]);
+		const __m256 tx = _mm256_loadu_ps(&m_positionX[i]);
+		const __m256 ty = _mm256_loadu_ps(&m_positionY[i]);
+		const __m256 tz = _mm256_loadu_ps(&m_positionZ[i]);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		// world = scale * rotation * translation
+		__m256 world[16] = {
+			_mm256_mul_ps(sx, r00), _mm256_mul_ps(sx, r01), _mm256_mul_ps(sx, r02), zero,
+			_mm256_mul_ps(sy, r10), _mm256_mul_ps(sy, r11), _mm256_mul_ps(sy, r12), zero,
+			_mm256_mul_ps(sz, r20), _mm256_mul_ps(sz, r21), _mm256_mul_ps(sz, r22), zero,
+			tx, ty, tz, one };
+
+		// The raytracing transform is the transposed world matrix without its last column. Gather it before the world
+		// registers are transposed in place.
+		__m256 raytracing[16] = {
+			world[0], world[4], world[8], tx,
+			world[1], world[5], world[9], ty,
+			world[2], world[6], world[10], tz,
+			zero, zero, zero, zero };
+
+		// inverse(transpose(world)) has row i = (rotation row i / scale i, -dot(rotation row i, translation) / scale i)
+		const __m256 invSx = _mm256_div_ps(one, sx);
+		const __m256 invSy = _mm256_div_ps(one, sy);
+		const __m256 invSz = _mm256_div_ps(one, sz);
+		const __m256 d0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r00, tx), _mm256_mul_ps(r01, ty)), _mm256_mul_ps(r02, tz));
+		const __m256 d1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r10, tx), _mm256_mul_ps(r11, ty)), _mm256_mul_ps(r12, tz));
+		const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r20, tx), _mm256_mul_ps(r21, ty)), _mm256_mul_ps(r22, tz));
+		__m256 inverseTranspose[16] = {
+			_mm256_mul_ps(r00, invSx), _mm256_mul_ps(r01, invSx), _mm256_mul_ps(r02, invSx),
+			_mm256_sub_ps(zero, _mm256_mul_ps(d0, invSx)),
+			_mm256_mul_ps(r10, invSy), _mm256_mul_ps(r11, invSy), _mm256_mul_ps(r12, invSy),
+			_mm256_sub_ps(zero, _mm256_mul_ps(d1, invSy)),
+			_mm256_mul_ps(r20, invSz), _mm256_mul_ps(r21, invSz), _mm256_mul_ps(r22, invSz),
+			_mm256_sub_ps(zero, _mm256_mul_ps(d2, invSz)),
+			zero, zero, zero, one };
+
+		StoreMatrices8(world, &m_world[i * matrixSize]);
+		StoreMatrices8(inverseTranspose, &m_worldInverseTranspose[i * matrixSize]);
+
+		Transpose8x8(raytracing);
+		Transpose8x8(raytracing + 8);
+		float* const destination = &m_raytracingTransform[i * raytracingTransformSize];
+		for (uint32_t lane = 0; lane < simdWidth; lane++)
+		{
+			_mm256_storeu_ps(destination + lane * raytracingTransformSize, raytracing[lane]);
+			_mm_storeu_ps(destination + lane * raytracingTransformSize + 8, _mm256_castps256_ps128(raytracing[8 + lane]));
+		}
+	}
+#endif
+
+	for (; i < last; i++)
+	{
+		UpdateScalar(i);
+	}
+}
+
+void TransformSystem::UpdateScalar(const uint32_t index)
+{
+	float sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+	ScalarSinCos(m_rotationX[index], sinPitch, cosPitch);
+	ScalarSinCos(m_rotationY[index], sinYaw, cosYaw);
+	ScalarSinCos(m_rotationZ[index], sinRoll, cosRoll);
+
+	const float rotation[3][3] = {
+		{ cosRoll * cosYaw + sinRoll * sinPitch * sinYaw, sinRoll * cosPitch, sinRoll * sinPitch * cosYaw - cosRoll * sinYaw },
+		{ cosRoll * sinPitch * sinYaw - sinRoll * cosYaw, cosRoll * cosPitch, sinRoll * sinYaw + cosRoll * sinPitch * cosYaw },
+		{ cosPitch * sinYaw, -sinPitch, cosPitch * cosYaw } };
+	const float scale[3] = { m_scaleX[index], m_scaleY[index], m_scaleZ[index] };
+	const float translation[3] = { m_positionX[index], m_positionY[index], m_positionZ[index] };
+
+	float* const world = &m_world[index * matrixSize];
+	float* const inverseTranspose = &m_worldInverseTranspose[index * matrixSize];
+	float* const raytracing = &m_raytracingTransform[index * raytracingTransformSize];
+	for (uint32_t row = 0; row < 3; row++)
+	{
+		const float dot = rotation[row][0] * translation[0] + rotation[row][1] * translation[1] + rotation[row][2] * translation[2];
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			world[row * 4 + column] = rotation[row][column] * scale[row];
+			inverseTranspose[row * 4 + column] = rotation[row][column] / scale[row];
+			raytracing[column * 4 + row] = rotation[row][column] * scale[row];
+		}
+		world[row * 4 + 3] = 0.f;
+		world[12 + row] = translation[row];
+		inverseTranspose[row * 4 + 3] = -dot / scale[row];
+		inverseTranspose[12 + row] = 0.f;
+		raytracing[row * 4 + 3] = translation[row];
+	}
+	world[15] = 1.f;
+	inverseTranspose[15] = 1.f;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Float3.h"
+
+// Object transforms stored as structure of arrays. Update computes every world matrix, inverse transpose world matrix and
+// raytracing instance transform in one batched pass, eight objects at a time when built with AVX2, split into chunks that run
+// in parallel. The Windows build always enables AVX2, the scalar path is for builds without it. Rotations are pitch, yaw and
+// roll in radians, matching XMQuaternionRotationRollPitchYawFromVector.
+class TransformSystem
+{
+public:
+	static const uint32_t matrixSize = 16;
+	static const uint32_t raytracingTransformSize = 12;
+
+public:
+	void Resize(const uint32_t count);
+	uint32_t GetCount() const { return m_count; }
+	void SetPosition(const uint32_t index, const float x, const float y, const float z);
+	void SetRotation(const uint32_t index, const float x, const float y, const float z);
+	void SetScale(const uint32_t index, const float x, const float y, const float z);
+	Float3 GetPosition(const uint32_t index) const;
+	Float3 GetRotation(const uint32_t index) const;
+	Float3 GetScale(const uint32_t index) const;
+	void Update();
+
+	// Row major 4x4 matrices laid out like XMFLOAT4X4.
+	const float* GetWorldMatrix(const uint32_t index) const { return &m_world[index * matrixSize]; }
+	const float* GetWorldInverseTransposeMatrix(const uint32_t index) const { return &m_worldInverseTranspose[index * matrixSize]; }
+	// Row major 3x4 matrix laid out like D3D12_RAYTRACING_INSTANCE_DESC::Transform.
+	const float* GetRaytracingTransform(const uint32_t index) const
+	{
+		return &m_raytracingTransform[index * raytracingTransformSize];
+	}
+
+private:
+	void UpdateRange(const uint32_t first, const uint32_t last);
+	void UpdateScalar(const uint32_t index);
+
+private:
+	uint32_t m_count = 0;
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_scaleX;
+	std::vector<float> m_scaleY;
+	std::vector<float> m_scaleZ;
+	std::vector<float> m_world;
+	std::vector<float> m_worldInverseTranspose;
+	std::vector<float> m_raytracingTransform;
+};
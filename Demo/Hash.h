@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a. Hashes can be chained by passing the previous result as the seed.
+static const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t fnvPrime = 1099511628211ull;
+
+inline uint64_t HashBytes(const void* const data, const size_t size, const uint64_t seed = fnvOffsetBasis)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= fnvPrime;
+	}
+	return hash;
+}
+
+inline uint64_t HashString(const std::string& string, const uint64_t seed = fnvOffsetBasis)
+{
+	// The length is hashed too so consecutive strings cannot shift characters between each other.
+	const uint64_t hash = HashBytes(string.data(), string.size(), seed);
+	const uint64_t length = string.size();
+	return HashBytes(&length, sizeof(length), hash);
+}
+
+template<typename T>
+inline uint64_t HashValue(const T& value, const uint64_t seed = fnvOffsetBasis)
+{
+	return HashBytes(&value, sizeof(T), seed);
+}
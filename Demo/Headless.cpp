@@ -0,0 +1,332 @@
+#include "stdafx.h"
+#include "Headless.h"
+#include "Benchmark.h"
+#include "Hash.h"
+#include "InputRecording.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "Graphics/FlyCamera.h"
+#include "Graphics/Float4x4.h"
+#include "Graphics/FrameRenderer.h"
+#include "Graphics/SoftwareRenderBackend.h"
+#include "Graphics/TransformSystem.h"
+#if defined(_WIN32)
+#include "Graphics/D3D12RenderBackend.h"
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const float pi = 3.14159265358979f;
+	const float fixedTimeDeltaSeconds = 1.f / 60.f;
+	const uint32_t sphereMeshID = 0;
+	const uint32_t floorMeshID = 1;
+
+	// Clockwise when seen from outside, which D3D treats as front facing.
+	void CreateSphere(const uint32_t numSlices, const uint32_t numStacks, std::vector<RenderVertex>& vertices,
+		std::vector<uint32_t>& indices)
+	{
+		for (uint32_t stack = 0; stack <= numStacks; stack++)
+		{
+			const float phi = pi * stack / numStacks;
+			for (uint32_t slice = 0; slice <= numSlices; slice++)
+			{
+				const float theta = 2.f * pi * slice / numSlices;
+				const float x = std::sin(phi) * std::cos(theta);
+				const float y = std::cos(phi);
+				const float z = std::sin(phi) * std::sin(theta);
+				vertices.push_back({ { x, y, z }, { x, y, z },
+					{ static_cast<float>(slice) / numSlices, static_cast<float>(stack) / numStacks } });
+			}
+		}
+		for (uint32_t stack = 0; stack < numStacks; stack++)
+		{
+			for (uint32_t slice = 0; slice < numSlices; slice++)
+			{
+				const uint32_t a = stack * (numSlices + 1) + slice;
+				const uint32_t b = a + numSlices + 1;
+				indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+			}
+		}
+	}
+
+	void CreateFloor(const float halfSize, std::vector<RenderVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		vertices.push_back({ { -halfSize, 0.f, -halfSize }, { 0.f, 1.f, 0.f }, { 0.f, 0.f } });
+		vertices.push_back({ { -halfSize, 0.f, halfSize }, { 0.f, 1.f, 0.f }, { 0.f, 1.f } });
+		vertices.push_back({ { halfSize, 0.f, halfSize }, { 0.f, 1.f, 0.f }, { 1.f, 1.f } });
+		vertices.push_back({ { halfSize, 0.f, -halfSize }, { 0.f, 1.f, 0.f }, { 1.f, 0.f } });
+		indices.insert(indices.end(), { 0, 1, 2, 0, 2, 3 });
+	}
+
+	uint8_t ToUnorm8(const float value)
+	{
+		return static_cast<uint8_t>(std::round(std::clamp(value, 0.f, 1.f) * 255.f));
+	}
+
+	bool ParseUnsigned(const std::string& text, uint32_t& value)
+	{
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+		if (text.empty() || *end != '\0')
+			return false;
+		value = static_cast<uint32_t>(parsed);
+		return true;
+	}
+
+	void WritePPM(const std::string& path, const uint32_t width, const uint32_t height, const std::vector<uint8_t>& rgb)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "P6\n" << width << " " << height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+	}
+}
+
+namespace Headless
+{
+	bool ParseOptions(const std::vector<std::string>& arguments, Options& options)
+	{
+		for (size_t i = 0; i < arguments.size(); i++)
+		{
+			const std::string& argument = arguments[i];
+			if (argument == "-headless")
+				continue;
+			if (i + 1 >= arguments.size())
+				return false;
+
+			const std::string& value = arguments[++i];
+			if (argument == "-backend")
+			{
+				options.Backend = value;
+			}
+			else if (argument == "-frames")
+			{
+				if (!ParseUnsigned(value, options.NumFrames))
+					return false;
+			}
+			else if (argument == "-framesinflight")
+			{
+				if (!ParseUnsigned(value, options.NumFramesInFlight) || options.NumFramesInFlight == 0 ||
+					options.NumFramesInFlight > FrameRenderer::maxFramesInFlight)
+					return false;
+			}
+			else if (argument == "-spheres")
+			{
+				if (!ParseUnsigned(value, options.NumSpheres) || options.NumSpheres == 0)
+					return false;
+			}
+			else if (argument == "-size")
+			{
+				const size_t separator = value.find('x');
+				if (separator == std::string::npos || !ParseUnsigned(value.substr(0, separator), options.Width) ||
+					!ParseUnsigned(value.substr(separator + 1), options.Height) || options.Width == 0 || options.Height == 0)
+					return false;
+			}
+			else if (argument == "-output")
+			{
+				options.OutputPath = value;
+			}
+			else if (argument == "-replay")
+			{
+				options.ReplayPath = value;
+			}
+			else if (argument == "-trace")
+			{
+				options.TracePath = value;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::unique_ptr<RenderBackend> CreateBackend(const std::string& name)
+	{
+		if (name == "software")
+			return std::make_unique<SoftwareRenderBackend>();
+#if defined(_WIN32)
+		if (name == "d3d12")
+		{
+			std::unique_ptr<D3D12RenderBackend> backend = std::make_unique<D3D12RenderBackend>();
+			backend->Initialize();
+			return backend;
+		}
+#endif
+		return nullptr;
+	}
+
+	// The scene of the windowed demo, built from procedural meshes: a spinning sphere, two spheres moving back and
+	// forth along z and any extra spheres in rows behind them, over a floor, animated at a fixed step so every run
+	// renders the same frames.
+	int Run(RenderBackend& backend, const Options& options)
+	{
+		InputRecording replay;
+		if (!options.ReplayPath.empty() && !replay.Load(options.ReplayPath))
+		{
+			fprintf(stderr, "could not load input recording %s\n", options.ReplayPath.c_str());
+			return -1;
+		}
+		const bool replaying = !options.ReplayPath.empty();
+		const uint32_t numFrames = replaying ? replay.GetNumFrames() : options.NumFrames;
+		const float frameTimeDeltaSeconds = replaying ? replay.GetTimestep() : fixedTimeDeltaSeconds;
+
+		FrameRenderer renderer;
+		const uint32_t numObjects = options.NumSpheres + 1;
+		renderer.Initialize(&backend, options.Width, options.Height, options.NumFramesInFlight, numObjects);
+
+		std::vector<RenderVertex> vertices;
+		std::vector<uint32_t> indices;
+		CreateSphere(32, 16, vertices, indices);
+		renderer.AddMesh(vertices, indices);
+		vertices.clear();
+		indices.clear();
+		CreateFloor(20.f, vertices, indices);
+		renderer.AddMesh(vertices, indices);
+
+		std::vector<uint32_t> objectMeshIDs(numObjects, sphereMeshID);
+		objectMeshIDs[options.NumSpheres] = floorMeshID;
+		TransformSystem transforms;
+		transforms.Resize(numObjects);
+		for (uint32_t i = 3; i < options.NumSpheres; i++)
+		{
+			const uint32_t row = (i - 3) / 8;
+			const float column = static_cast<float>((i - 3) % 8) - 3.5f;
+			transforms.SetPosition(i, column * 2.5f, 0.f, 4.f + row * 2.5f);
+		}
+		if (options.NumSpheres > 1)
+			transforms.SetPosition(1, -2.2f, 0.f, 0.f);
+		if (options.NumSpheres > 2)
+			transforms.SetPosition(2, 2.2f, 0.f, 0.f);
+		transforms.SetPosition(options.NumSpheres, 0.f, -1.2f, 0.f);
+
+		FrameConstants constants = {};
+		const Float4x4 projection = PerspectiveFovLH(pi / 4.f, static_cast<float>(options.Width) / options.Height,
+			0.1f, 1000.f);
+		const auto setCamera = [&constants, &projection](const Float3& position, const Float4x4& view)
+		{
+			const Float4x4 viewProjection = Multiply(view, projection);
+			const Float4x4 inverseViewProjection = Inverse(viewProjection);
+			memcpy(constants.ViewProjection, viewProjection.m, sizeof(constants.ViewProjection));
+			memcpy(constants.InverseViewProjection, inverseViewProjection.m, sizeof(constants.InverseViewProjection));
+			const float cameraPositionW[4] = { position.x, position.y, position.z, 1.f };
+			memcpy(constants.CameraPosition, cameraPositionW, sizeof(cameraPositionW));
+		};
+		const Float3 cameraPosition = { 0.f, 3.f, -9.f };
+		setCamera(cameraPosition, LookAtLH(cameraPosition, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }));
+		const float lightDirection[4] = { 0.6f, -1.f, 1.f, 0.f };
+		const float lightDiffuse[4] = { 1.f, 1.f, 1.f, 0.f };
+		const float lightAmbient[4] = { 0.1f, 0.1f, 0.1f, 0.f };
+		memcpy(constants.LightDirection, lightDirection, sizeof(lightDirection));
+		memcpy(constants.LightDiffuse, lightDiffuse, sizeof(lightDiffuse));
+		memcpy(constants.LightAmbient, lightAmbient, sizeof(lightAmbient));
+		FlyCamera camera;
+		Simulation simulation;
+		simulation.Initialize(transforms, options.NumSpheres, fixedTimeDeltaSeconds);
+		const Simulation::Clock::duration frameTimeDelta = replaying ?
+			std::chrono::duration_cast<Simulation::Clock::duration>(std::chrono::duration<float>(frameTimeDeltaSeconds)) :
+			simulation.GetStep();
+
+		double sceneSeconds = 0.0;
+		FrameTimings totals;
+		const auto start = std::chrono::steady_clock::now();
+		Profiler::SetThreadName("Main");
+		for (uint32_t frame = 0; frame < numFrames; frame++)
+		{
+			Profiler::BeginFrame();
+			const auto sceneStart = std::chrono::steady_clock::now();
+			Profiler::BeginScope("Scene update");
+			if (replaying)
+			{
+				// the windowed demo's order: input events, then movement
+				const InputRecording::Frame& recorded = replay.GetFrame(frame);
+				for (uint32_t i = recorded.FirstEvent; i < recorded.FirstEvent + recorded.NumEvents; i++)
+					camera.HandleInputEvent(replay.GetEvent(i).Input, frameTimeDeltaSeconds);
+				camera.Move(recorded.KeyState, frameTimeDeltaSeconds);
+				setCamera(camera.GetPosition(), camera.GetView());
+			}
+			simulation.Advance(frameTimeDelta);
+			simulation.Interpolate(transforms);
+			transforms.Update();
+			Profiler::EndScope();
+			sceneSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - sceneStart).count();
+
+			Profiler::BeginScope("Render");
+			renderer.Render(transforms, objectMeshIDs, constants);
+			Profiler::EndScope();
+			totals.WaitSeconds += renderer.GetTimings().WaitSeconds;
+			totals.CullSeconds += renderer.GetTimings().CullSeconds;
+			totals.UpdateSeconds += renderer.GetTimings().UpdateSeconds;
+			totals.RecordSeconds += renderer.GetTimings().RecordSeconds;
+		}
+		renderer.WaitForIdle();
+		// closes the last frame
+		Profiler::BeginFrame();
+		const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<float> output;
+		backend.ReadTexture(renderer.GetOutput(), output);
+		std::vector<uint8_t> rgb(static_cast<size_t>(options.Width) * options.Height * 3);
+		for (size_t i = 0; i < rgb.size() / 3; i++)
+		{
+			for (size_t channel = 0; channel < 3; channel++)
+				rgb[i * 3 + channel] = ToUnorm8(output[i * 4 + channel]);
+		}
+		if (!options.OutputPath.empty())
+			WritePPM(options.OutputPath, options.Width, options.Height, rgb);
+
+		const double frameCount = std::max(numFrames, 1u);
+		printf("backend %s, %ux%u, %u frames, %u in flight, %u objects\n", backend.GetName(), options.Width,
+			options.Height, numFrames, options.NumFramesInFlight, numObjects);
+		if (replaying)
+			printf("replaying %s at a %.3f ms step\n", options.ReplayPath.c_str(), frameTimeDeltaSeconds * 1000.f);
+		printf("scene update   %8.3f ms/frame\n", sceneSeconds * 1000.0 / frameCount);
+		printf("frame wait     %8.3f ms/frame\n", totals.WaitSeconds * 1000.0 / frameCount);
+		const CullingSystem::Statistics& culling = renderer.GetVisibility().GetCullingStatistics();
+		printf("cull/batch     %8.3f ms/frame, last frame %u of %u objects visible\n",
+			totals.CullSeconds * 1000.0 / frameCount,
+			static_cast<uint32_t>(renderer.GetVisibility().GetVisibleObjects().size()), culling.NumObjects);
+		printf("instance data  %8.3f ms/frame\n", totals.UpdateSeconds * 1000.0 / frameCount);
+		printf("record/submit  %8.3f ms/frame\n", totals.RecordSeconds * 1000.0 / frameCount);
+		printf("total          %8.3f ms/frame\n", totalSeconds * 1000.0 / frameCount);
+		printf("checksum       %016llx\n", static_cast<unsigned long long>(HashBytes(rgb.data(), rgb.size())));
+		if (!options.TracePath.empty() && !Profiler::WriteChromeTrace(options.TracePath))
+		{
+			fprintf(stderr, "could not write trace %s\n", options.TracePath.c_str());
+			return -1;
+		}
+		return 0;
+	}
+
+	int Run(const std::vector<std::string>& arguments)
+	{
+		Options options;
+		if (!ParseOptions(arguments, options))
+		{
+			fprintf(stderr, "usage: -headless [-backend software|d3d12] [-frames n] [-size WxH] [-framesinflight n] "
+				"[-spheres n] [-output file.ppm] [-replay file] [-trace file.json]\n");
+			return -1;
+		}
+
+		std::unique_ptr<RenderBackend> backend = CreateBackend(options.Backend);
+		if (!backend)
+		{
+			fprintf(stderr, "unknown backend %s\n", options.Backend.c_str());
+			return -1;
+		}
+		return Run(*backend, options);
+	}
+}
+
+#if !defined(_WIN32)
+int main(int argc, char** argv)
+{
+	const std::vector<std::string> arguments(argv + 1, argv + argc);
+	if (!arguments.empty() && arguments[0] == "-benchmark")
+		return Benchmark::Run(arguments);
+	return Headless::Run(arguments);
+}
+#endif
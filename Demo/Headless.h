@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class RenderBackend;
+
+// Runs a reference frame without a window: sphere animation, culling, instance batching, acceleration structure
+// instances and frame scheduling through a RenderBackend, with per stage timings and a checksum of the final image so
+// runs can be profiled and compared against each other. Culling, batching and the acceleration structure instances go
+// through SceneVisibility, as in the windowed demo, but the reference frame is not the windowed one. It has a raster
+// pass, one hard shadow ray per pixel and a composite, where wWinMain drives D3D12 directly with the DXR pipeline, soft
+// shadow denoiser and upsampler, so headless timings cover the CPU side of a frame and not the windowed frame's GPU
+// work.
+namespace Headless
+{
+	struct Options
+	{
+		// "software", or "d3d12" on Windows
+		std::string Backend = "software";
+		uint32_t Width = 640;
+		uint32_t Height = 360;
+		uint32_t NumFrames = 120;
+		uint32_t NumFramesInFlight = 2;
+		uint32_t NumSpheres = 3;
+		// the last frame is written here as a binary PPM when set
+		std::string OutputPath;
+		// An InputRecording to fly the camera with, one recorded frame per frame at the recording's timestep, instead
+		// of the fixed view. Replaces NumFrames with the recording's frame count.
+		std::string ReplayPath;
+		// the profiler's scopes are written here as a Chrome trace when set
+		std::string TracePath;
+	};
+
+	// -backend name -frames n -size WxH -framesinflight n -spheres n -output file.ppm -replay file -trace file.json.
+	// Returns false on anything else.
+	bool ParseOptions(const std::vector<std::string>& arguments, Options& options);
+	std::unique_ptr<RenderBackend> CreateBackend(const std::string& name);
+	// Returns the process exit code.
+	int Run(RenderBackend& backend, const Options& options);
+	int Run(const std::vector<std::string>& arguments);
+}
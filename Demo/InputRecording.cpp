@@ -0,0 +1,157 @@
+#include "stdafx.h"
+#include "InputRecording.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char magic[4] = { 'D', 'I', 'N', 'P' };
+	const uint32_t version = 2;
+	// the smallest a stored frame and event can be
+	const uint32_t frameSize = sizeof(uint32_t) * 2;
+	const uint32_t eventSize = 12;
+
+	// flags byte of a stored event
+	const uint8_t repeatKeyFlag = 1 << 0;
+	const uint8_t consumedFlag = 1 << 1;
+
+	template <class T>
+	void Write(std::ofstream& file, const T value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <class T>
+	bool Read(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+void InputRecording::Clear()
+{
+	m_frames.clear();
+	m_events.clear();
+}
+
+void InputRecording::BeginFrame(const uint32_t keyState)
+{
+	m_lastFrameStart = std::chrono::steady_clock::now();
+	if (m_frames.empty())
+		m_start = m_lastFrameStart;
+	m_frames.push_back({ keyState, static_cast<uint32_t>(m_events.size()), 0 });
+}
+
+void InputRecording::AddEvent(const InputEvent& event, const std::chrono::steady_clock::time_point timestamp)
+{
+	assert(!m_frames.empty());
+	// events pushed before the first frame began count as arriving with it
+	const auto sinceStart = std::max(timestamp - m_start, std::chrono::steady_clock::duration::zero());
+	Event recorded;
+	recorded.Input = event;
+	recorded.Microseconds = static_cast<uint32_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(sinceStart).count());
+	m_events.push_back(recorded);
+	m_frames.back().NumEvents++;
+}
+
+// Per frame the key state and a 32 bit event count, then 12 bytes per event: 16 bit input, port, flags, data and time.
+bool InputRecording::Save(const std::string& path)
+{
+	if (m_frames.size() > 1)
+	{
+		m_timestep = std::chrono::duration<float>(m_lastFrameStart - m_start).count() /
+			static_cast<float>(m_frames.size() - 1);
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	file.write(magic, sizeof(magic));
+	Write(file, version);
+	Write(file, m_timestep);
+	Write(file, static_cast<uint32_t>(m_frames.size()));
+	Write(file, static_cast<uint32_t>(m_events.size()));
+	for (const Frame& frame : m_frames)
+	{
+		Write(file, frame.KeyState);
+		Write(file, frame.NumEvents);
+		for (uint32_t i = frame.FirstEvent; i < frame.FirstEvent + frame.NumEvents; i++)
+		{
+			const Event& event = m_events[i];
+			assert(event.Input.input >= INT16_MIN && event.Input.input <= INT16_MAX);
+			assert(event.Input.port >= 0 && event.Input.port <= UINT8_MAX);
+			Write(file, static_cast<int16_t>(event.Input.input));
+			Write(file, static_cast<uint8_t>(event.Input.port));
+			Write(file, static_cast<uint8_t>((event.Input.repeatKey ? repeatKeyFlag : 0) |
+				(event.Input.consumed ? consumedFlag : 0)));
+			Write(file, event.Input.data);
+			Write(file, event.Microseconds);
+		}
+	}
+	return static_cast<bool>(file);
+}
+
+bool InputRecording::Load(const std::string& path)
+{
+	Clear();
+	std::ifstream file(path, std::ios::binary);
+	char fileMagic[sizeof(magic)] = {};
+	uint32_t fileVersion = 0;
+	uint32_t numFrames = 0;
+	uint32_t numEvents = 0;
+	if (!file.read(fileMagic, sizeof(fileMagic)) || memcmp(fileMagic, magic, sizeof(magic)) != 0 ||
+		!Read(file, fileVersion) || fileVersion != version || !Read(file, m_timestep) || !Read(file, numFrames) ||
+		!Read(file, numEvents))
+	{
+		return false;
+	}
+
+	// The counts come from the file, so they are checked against what is left of it before anything is reserved.
+	const std::streampos start = file.tellg();
+	file.seekg(0, std::ios::end);
+	const uint64_t remaining = static_cast<uint64_t>(file.tellg() - start);
+	file.seekg(start);
+	if (static_cast<uint64_t>(numFrames) * frameSize + static_cast<uint64_t>(numEvents) * eventSize > remaining)
+		return false;
+
+	m_frames.reserve(numFrames);
+	m_events.reserve(numEvents);
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		uint32_t keyState = 0;
+		uint32_t numFrameEvents = 0;
+		if (!Read(file, keyState) || !Read(file, numFrameEvents) || numFrameEvents > numEvents - m_events.size())
+		{
+			Clear();
+			return false;
+		}
+		m_frames.push_back({ keyState, static_cast<uint32_t>(m_events.size()), numFrameEvents });
+		for (uint32_t i = 0; i < numFrameEvents; i++)
+		{
+			int16_t input = 0;
+			uint8_t port = 0;
+			uint8_t flags = 0;
+			Event event;
+			if (!Read(file, input) || !Read(file, port) || !Read(file, flags) || !Read(file, event.Input.data) ||
+				!Read(file, event.Microseconds))
+			{
+				Clear();
+				return false;
+			}
+			event.Input.input = input;
+			event.Input.port = port;
+			event.Input.repeatKey = (flags & repeatKeyFlag) != 0;
+			event.Input.consumed = (flags & consumedFlag) != 0;
+			m_events.push_back(event);
+		}
+	}
+	if (m_events.size() != numEvents)
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "InputEvent.h"
+
+// Input of a run, frame by frame, for replaying it exactly: each frame's polled key state (FlyCamera::MoveFlags in the
+// demo) and the events drained that frame with the time they were pushed. Saved as a compact little endian binary log.
+// Replays step every frame by the timestep, which Save sets to the recording's average frame time so the replay covers
+// about the same ground at a rate that does not depend on the machine.
+class InputRecording
+{
+public:
+	struct Event
+	{
+		InputEvent Input;
+		// since the first frame began
+		uint32_t Microseconds = 0;
+	};
+
+	struct Frame
+	{
+		uint32_t KeyState = 0;
+		uint32_t FirstEvent = 0;
+		uint32_t NumEvents = 0;
+	};
+
+public:
+	void Clear();
+	void BeginFrame(const uint32_t keyState);
+	// Adds to the frame begun last.
+	void AddEvent(const InputEvent& event, const std::chrono::steady_clock::time_point timestamp);
+
+	bool Save(const std::string& path);
+	bool Load(const std::string& path);
+
+	uint32_t GetNumFrames() const { return static_cast<uint32_t>(m_frames.size()); }
+	const Frame& GetFrame(const uint32_t index) const { return m_frames[index]; }
+	const Event& GetEvent(const uint32_t index) const { return m_events[index]; }
+	float GetTimestep() const { return m_timestep; }
+
+private:
+	std::vector<Frame> m_frames;
+	std::vector<Event> m_events;
+	std::chrono::steady_clock::time_point m_start;
+	std::chrono::steady_clock::time_point m_lastFrameStart;
+	float m_timestep = 1.f / 60.f;
+};
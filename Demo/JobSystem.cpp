@@ -0,0 +1,246 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+
+namespace
+{
+	const uint32_t invalidWorker = UINT32_MAX;
+	// tries at finding a job before a worker goes to sleep
+	const uint32_t numSpins = 64;
+
+	// the worker the current thread is, for the job system it belongs to
+	thread_local const JobSystem* currentJobSystem = nullptr;
+	thread_local uint32_t currentWorker = invalidWorker;
+
+	uint32_t XorShift(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+JobSystem::WorkStealingQueue::WorkStealingQueue()
+	: m_jobs(std::make_unique<std::atomic<Job*>[]>(maxJobsPerWorker))
+{
+}
+
+bool JobSystem::WorkStealingQueue::Push(Job* const job)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= static_cast<int64_t>(maxJobsPerWorker))
+		return false;
+	m_jobs[bottom & (maxJobsPerWorker - 1)].store(job, std::memory_order_relaxed);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+// Takes the bottom slot first and only races the thieves, through top, for the last job left.
+JobSystem::Job* JobSystem::WorkStealingQueue::Pop()
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_seq_cst);
+	if (top > bottom)
+	{
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_jobs[bottom & (maxJobsPerWorker - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkStealingQueue::Steal()
+{
+	int64_t top = m_top.load(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+	if (top >= bottom)
+		return nullptr;
+
+	Job* const job = m_jobs[top & (maxJobsPerWorker - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+JobSystem::JobSystem()
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Initialize(const uint32_t numWorkers)
+{
+	assert(m_workers.empty() && currentWorker == invalidWorker);
+	const uint32_t count = numWorkers ? numWorkers : std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+		m_workers.back()->Jobs = std::make_unique<Job[]>(maxJobsPerWorker);
+		m_workers.back()->Random = 0x9E3779B9u * (i + 1);
+	}
+
+	m_stopping = false;
+	currentJobSystem = this;
+	currentWorker = 0;
+	for (uint32_t i = 1; i < count; i++)
+		m_workers[i]->Thread = std::thread(&JobSystem::RunWorker, this, i);
+}
+
+void JobSystem::Shutdown()
+{
+	if (m_workers.empty())
+		return;
+	assert(currentJobSystem == this && currentWorker == 0);
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (const std::unique_ptr<Worker>& worker : m_workers)
+	{
+		if (worker->Thread.joinable())
+			worker->Thread.join();
+	}
+	m_workers.clear();
+	currentJobSystem = nullptr;
+	currentWorker = invalidWorker;
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	assert(currentJobSystem == this);
+	while (counter.load(std::memory_order_acquire) != 0)
+	{
+		if (!RunOneJob(currentWorker))
+			std::this_thread::yield();
+	}
+}
+
+JobSystem::Statistics JobSystem::GetStatistics() const
+{
+	Statistics statistics;
+	for (const std::unique_ptr<Worker>& worker : m_workers)
+	{
+		statistics.NumJobs += worker->NumJobs.load(std::memory_order_relaxed);
+		statistics.NumStolen += worker->NumStolen.load(std::memory_order_relaxed);
+		statistics.NumSleeps += worker->NumSleeps.load(std::memory_order_relaxed);
+	}
+	return statistics;
+}
+
+JobSystem::Job& JobSystem::AllocateJob(const char* name, Counter* const counter)
+{
+	assert(currentJobSystem == this && "jobs can only be submitted from the job system's workers");
+	Worker& worker = *m_workers[currentWorker];
+	// Jobs finish in any order, a waiting parent outlives thousands of its descendants, so slots are taken round robin
+	// skipping the ones still in use.
+	uint32_t numTried = 0;
+	while (worker.Jobs[worker.NumAllocatedJobs & (maxJobsPerWorker - 1)].InUse.load(std::memory_order_acquire))
+	{
+		worker.NumAllocatedJobs++;
+		assert(++numTried < maxJobsPerWorker && "too many jobs waiting or running");
+	}
+	Job& job = worker.Jobs[worker.NumAllocatedJobs++ & (maxJobsPerWorker - 1)];
+	job.InUse.store(true, std::memory_order_relaxed);
+	job.Name = name;
+	job.JobCounter = counter;
+	if (counter)
+		counter->fetch_add(1, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::Submit(Job& job)
+{
+	m_numQueued.fetch_add(1, std::memory_order_seq_cst);
+	if (!m_workers[currentWorker]->Queue.Push(&job))
+	{
+		// the deque is full: nothing is lost by running it right here
+		m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+		Execute(job, currentWorker);
+		return;
+	}
+	if (m_numSleeping.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+}
+
+// Own jobs first, newest first since their data is most likely still in cache, then the oldest job of another worker.
+bool JobSystem::RunOneJob(const uint32_t worker)
+{
+	Worker& self = *m_workers[worker];
+	Job* job = self.Queue.Pop();
+	if (!job)
+	{
+		const uint32_t numWorkers = GetNumWorkers();
+		const uint32_t first = numWorkers > 1 ? XorShift(self.Random) % numWorkers : 0;
+		for (uint32_t i = 0; i < numWorkers && !job; i++)
+		{
+			const uint32_t victim = (first + i) % numWorkers;
+			if (victim != worker)
+				job = m_workers[victim]->Queue.Steal();
+		}
+		if (!job)
+			return false;
+		self.NumStolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+	Execute(*job, worker);
+	return true;
+}
+
+void JobSystem::Execute(Job& job, const uint32_t worker)
+{
+	if (m_hooks.BeginJob)
+		m_hooks.BeginJob(m_hooks.UserData, job.Name, worker);
+	job.Execute(job);
+	if (m_hooks.EndJob)
+		m_hooks.EndJob(m_hooks.UserData, job.Name, worker);
+	m_workers[worker]->NumJobs.fetch_add(1, std::memory_order_relaxed);
+	Counter* const counter = job.JobCounter;
+	job.InUse.store(false, std::memory_order_release);
+	if (counter)
+		counter->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::RunWorker(const uint32_t worker)
+{
+	currentJobSystem = this;
+	currentWorker = worker;
+	while (!m_stopping.load(std::memory_order_relaxed))
+	{
+		bool ran = false;
+		for (uint32_t spin = 0; spin < numSpins && !ran; spin++)
+		{
+			ran = RunOneJob(worker);
+			if (!ran)
+				std::this_thread::yield();
+		}
+		if (ran)
+			continue;
+
+		// Submit reads m_numSleeping after publishing the job, so either it sees this worker and wakes it, or the
+		// predicate sees the job.
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+		m_workers[worker]->NumSleeps.fetch_add(1, std::memory_order_relaxed);
+		m_wake.wait(lock, [this]()
+		{
+			return m_numQueued.load(std::memory_order_seq_cst) > 0 || m_stopping.load(std::memory_order_relaxed);
+		});
+		m_numSleeping.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
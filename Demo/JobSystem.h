@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Runs small jobs on a fixed set of worker threads. Every worker, the thread that called Initialize being worker 0, has
+// its own Chase-Lev deque: it pushes and pops jobs at the bottom and idle workers steal from the top of the others, so
+// the common case touches no shared state. Jobs can only be submitted from the workers.
+//
+// Fork-join goes through counters: Run adds one to the job's counter and finishing the job takes it away again, and Wait
+// keeps running jobs, its own first, until the counter reaches zero. Waiting never blocks a worker that has work to do,
+// so jobs can run and wait for jobs of their own.
+class JobSystem
+{
+public:
+	using Counter = std::atomic<uint32_t>;
+
+	// Jobs are kept in a pool per submitting thread, so no thread may have more than this many waiting or running.
+	static const uint32_t maxJobsPerWorker = 4096;
+	// captures up to this size are stored in the job itself
+	static const uint32_t maxJobSize = 48;
+	// ParallelFor splits into at most this many ranges per worker, for stealing to even out
+	static const uint32_t rangesPerWorker = 4;
+
+	// Called on the worker around every job, named by whoever submitted it.
+	struct ProfilingHooks
+	{
+		void (*BeginJob)(void* userData, const char* name, const uint32_t worker) = nullptr;
+		void (*EndJob)(void* userData, const char* name, const uint32_t worker) = nullptr;
+		void* UserData = nullptr;
+	};
+
+	struct Statistics
+	{
+		uint64_t NumJobs = 0;
+		uint64_t NumStolen = 0;
+		// runs out of work and goes to sleep
+		uint64_t NumSleeps = 0;
+	};
+
+public:
+	JobSystem();
+	~JobSystem();
+
+	// 0 workers picks one per hardware thread.
+	void Initialize(const uint32_t numWorkers = 0);
+	void Shutdown();
+	uint32_t GetNumWorkers() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	template <class Function>
+	void Run(const char* name, Function&& function, Counter* counter = nullptr);
+	void Wait(Counter& counter);
+	// Calls function(begin, end) over ranges of at least grainSize of [0, count) and waits for all of them.
+	template <class Function>
+	void ParallelFor(const char* name, const uint32_t count, const uint32_t grainSize, const Function& function);
+
+	// Only while no jobs are running.
+	void SetProfilingHooks(const ProfilingHooks& hooks) { m_hooks = hooks; }
+	Statistics GetStatistics() const;
+
+private:
+	struct Job
+	{
+		void (*Execute)(Job& job) = nullptr;
+		const char* Name = nullptr;
+		Counter* JobCounter = nullptr;
+		// from allocation until the job has finished running
+		std::atomic<bool> InUse = false;
+		alignas(16) unsigned char Storage[maxJobSize];
+	};
+
+	// Chase-Lev deque of fixed capacity. Push and Pop by the owning worker only, Steal from any thread.
+	class WorkStealingQueue
+	{
+	public:
+		WorkStealingQueue();
+		bool Push(Job* const job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		std::atomic<int64_t> m_top = 0;
+		std::atomic<int64_t> m_bottom = 0;
+		std::unique_ptr<std::atomic<Job*>[]> m_jobs;
+	};
+
+	struct alignas(64) Worker
+	{
+		WorkStealingQueue Queue;
+		std::unique_ptr<Job[]> Jobs;
+		uint32_t NumAllocatedJobs = 0;
+		uint32_t Random = 0;
+		std::atomic<uint64_t> NumJobs = 0;
+		std::atomic<uint64_t> NumStolen = 0;
+		std::atomic<uint64_t> NumSleeps = 0;
+		std::thread Thread;
+	};
+
+	Job& AllocateJob(const char* name, Counter* const counter);
+	void Submit(Job& job);
+	bool RunOneJob(const uint32_t worker);
+	void Execute(Job& job, const uint32_t worker);
+	void RunWorker(const uint32_t worker);
+
+private:
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	ProfilingHooks m_hooks;
+
+	// jobs pushed and not yet taken, to know when sleeping workers need waking
+	std::atomic<int32_t> m_numQueued = 0;
+	std::atomic<uint32_t> m_numSleeping = 0;
+	std::atomic<bool> m_stopping = false;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+};
+
+template <class Function>
+void JobSystem::Run(const char* name, Function&& function, Counter* counter)
+{
+	using Stored = typename std::decay<Function>::type;
+	static_assert(sizeof(Stored) <= maxJobSize, "job captures too much, capture a pointer to the data instead");
+	static_assert(alignof(Stored) <= 16, "job capture is over aligned");
+
+	Job& job = AllocateJob(name, counter);
+	new (job.Storage) Stored(std::forward<Function>(function));
+	job.Execute = [](Job& executed)
+	{
+		Stored& stored = *std::launder(reinterpret_cast<Stored*>(executed.Storage));
+		stored();
+		stored.~Stored();
+	};
+	Submit(job);
+}
+
+template <class Function>
+void JobSystem::ParallelFor(const char* name, const uint32_t count, const uint32_t grainSize, const Function& function)
+{
+	const uint32_t numRanges = std::min((count + std::max(grainSize, 1u) - 1) / std::max(grainSize, 1u),
+		GetNumWorkers() * rangesPerWorker);
+	if (numRanges <= 1)
+	{
+		if (count)
+			function(0u, count);
+		return;
+	}
+
+	Counter counter = 0;
+	for (uint32_t range = 0; range < numRanges; range++)
+	{
+		const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * range / numRanges);
+		const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (range + 1) / numRanges);
+		Run(name, [&function, begin, end]() { function(begin, end); }, &counter);
+	}
+	Wait(counter);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free ring that any number of threads push to and one thread drains. Every slot carries a sequence number
+// that says whose turn it is: producers claim a position by advancing the tail, write the slot and publish it by bumping
+// its sequence, and the consumer hands the slot back a lap later once it has read it. Items are stamped with the time
+// they were pushed. A push into a full ring fails and is counted instead of blocking, so size the capacity for the
+// largest burst expected between drains.
+template <class T>
+class MPSCQueue
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// capacity must be a power of two
+	explicit MPSCQueue(const uint32_t capacity)
+		: m_capacity(capacity), m_slots(std::make_unique<Slot[]>(capacity))
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+		for (uint32_t i = 0; i < capacity; i++)
+			m_slots[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// Safe from any thread. Returns false and counts the item as dropped when the ring is full.
+	bool Push(const T& item)
+	{
+		const Clock::time_point timestamp = Clock::now();
+		uint64_t position = m_tail.load(std::memory_order_relaxed);
+		Slot* slot = nullptr;
+		for (;;)
+		{
+			slot = &m_slots[position & (m_capacity - 1)];
+			const uint64_t sequence = slot->Sequence.load(std::memory_order_acquire);
+			const int64_t difference = static_cast<int64_t>(sequence - position);
+			if (difference == 0)
+			{
+				if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+			{
+				m_numDropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else
+			{
+				position = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+		slot->Item = item;
+		slot->Timestamp = timestamp;
+		slot->Sequence.store(position + 1, std::memory_order_release);
+		m_numPushed.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Consumer thread only. Stops at the first slot a producer has claimed but not yet published, which the next drain
+	// picks up.
+	bool Pop(T& item, Clock::time_point& timestamp)
+	{
+		Slot& slot = m_slots[m_head & (m_capacity - 1)];
+		if (slot.Sequence.load(std::memory_order_acquire) != m_head + 1)
+			return false;
+		item = slot.Item;
+		timestamp = slot.Timestamp;
+		slot.Sequence.store(m_head + m_capacity, std::memory_order_release);
+		m_head++;
+		return true;
+	}
+
+	// Consumer thread only. Calls visit(item, timestamp) for up to maxItems items in push order and returns how many.
+	template <class Visitor>
+	uint32_t Drain(const Visitor& visit, const uint32_t maxItems = UINT32_MAX)
+	{
+		uint32_t numDrained = 0;
+		T item;
+		Clock::time_point timestamp;
+		while (numDrained < maxItems && Pop(item, timestamp))
+		{
+			visit(static_cast<const T&>(item), timestamp);
+			numDrained++;
+		}
+		return numDrained;
+	}
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint64_t GetNumPushed() const { return m_numPushed.load(std::memory_order_relaxed); }
+	uint64_t GetNumDropped() const { return m_numDropped.load(std::memory_order_relaxed); }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> Sequence;
+		T Item;
+		Clock::time_point Timestamp;
+	};
+
+	const uint32_t m_capacity;
+	std::unique_ptr<Slot[]> m_slots;
+	// producers and the consumer write these, so they sit on cache lines of their own
+	alignas(64) std::atomic<uint64_t> m_tail = 0;
+	alignas(64) uint64_t m_head = 0;
+	alignas(64) std::atomic<uint64_t> m_numPushed = 0;
+	std::atomic<uint64_t> m_numDropped = 0;
+};
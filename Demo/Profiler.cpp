@@ -0,0 +1,301 @@
+#include "stdafx.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <mutex>
+
+namespace
+{
+	using namespace Profiler;
+
+	const uint32_t invalidTrack = UINT32_MAX;
+
+	// The owner stores the fields and then publishes the slot through the ring's count. Readers copy slots while the
+	// owner may be reusing them, so the fields are atomics and a reader drops whatever the count says was reused.
+	struct EventSlot
+	{
+		std::atomic<const char*> Name;
+		std::atomic<int64_t> Begin;
+		std::atomic<int64_t> End;
+		std::atomic<uint32_t> Depth;
+	};
+
+	struct alignas(64) TrackBuffer
+	{
+		// guarded by trackMutex
+		char Name[maxTrackNameLength] = {};
+		std::unique_ptr<EventSlot[]> Events = std::make_unique<EventSlot[]>(maxEventsPerTrack);
+		std::atomic<uint64_t> NumWritten = 0;
+
+		// scopes begun and not yet ended, only touched by the owner
+		uint32_t Depth = 0;
+		const char* ScopeNames[maxDepth] = {};
+		int64_t ScopeBegins[maxDepth] = {};
+	};
+
+	const Clock::time_point epoch = Clock::now();
+
+	std::mutex trackMutex;
+	std::unique_ptr<TrackBuffer> tracks[maxTracks];
+	std::atomic<uint32_t> numTracks = 0;
+
+	// null until the thread first records, and also once registering failed
+	thread_local TrackBuffer* threadTrack = nullptr;
+	thread_local bool threadRegistered = false;
+
+	// only touched by the thread that marks frames
+	Frame frames[maxFrames];
+	uint64_t numFrames = 0;
+
+	uint32_t RegisterTrack(const char* const name)
+	{
+		std::lock_guard<std::mutex> lock(trackMutex);
+		const uint32_t index = numTracks.load(std::memory_order_relaxed);
+		if (index == maxTracks)
+			return invalidTrack;
+		tracks[index] = std::make_unique<TrackBuffer>();
+		if (name)
+			snprintf(tracks[index]->Name, maxTrackNameLength, "%s", name);
+		else
+			snprintf(tracks[index]->Name, maxTrackNameLength, "Thread %u", index);
+		numTracks.store(index + 1, std::memory_order_release);
+		return index;
+	}
+
+	TrackBuffer* GetThreadTrack()
+	{
+		if (!threadRegistered)
+		{
+			threadRegistered = true;
+			const uint32_t index = RegisterTrack(nullptr);
+			threadTrack = index != invalidTrack ? tracks[index].get() : nullptr;
+		}
+		return threadTrack;
+	}
+
+	void Write(TrackBuffer& track, const char* const name, const int64_t begin, const int64_t end, const uint32_t depth)
+	{
+		const uint64_t index = track.NumWritten.load(std::memory_order_relaxed);
+		EventSlot& slot = track.Events[index & (maxEventsPerTrack - 1)];
+		slot.Name.store(name, std::memory_order_relaxed);
+		slot.Begin.store(begin, std::memory_order_relaxed);
+		slot.End.store(end, std::memory_order_relaxed);
+		slot.Depth.store(depth, std::memory_order_relaxed);
+		track.NumWritten.store(index + 1, std::memory_order_release);
+	}
+
+	// Events end in order on every track, so the walk goes back from the newest and stops at the first that ended
+	// before the range.
+	void CopyEvents(const TrackBuffer& track, const int64_t begin, const int64_t end, std::vector<Event>& events)
+	{
+		thread_local std::vector<uint64_t> indices;
+		const uint64_t numWritten = track.NumWritten.load(std::memory_order_acquire);
+		const uint64_t first = numWritten > maxEventsPerTrack ? numWritten - maxEventsPerTrack : 0;
+		events.clear();
+		indices.clear();
+		for (uint64_t i = numWritten; i > first; i--)
+		{
+			const EventSlot& slot = track.Events[(i - 1) & (maxEventsPerTrack - 1)];
+			Event event;
+			event.Name = slot.Name.load(std::memory_order_relaxed);
+			event.Begin = slot.Begin.load(std::memory_order_relaxed);
+			event.End = slot.End.load(std::memory_order_relaxed);
+			event.Depth = slot.Depth.load(std::memory_order_relaxed);
+			if (event.End < begin)
+				break;
+			if (event.Begin < end)
+			{
+				events.push_back(event);
+				indices.push_back(i - 1);
+			}
+		}
+
+		// Slot i has been reused, or is being, once event i + maxEventsPerTrack has started to be written.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t numWrittenAfter = track.NumWritten.load(std::memory_order_relaxed);
+		const uint64_t firstValid = numWrittenAfter >= maxEventsPerTrack ? numWrittenAfter - maxEventsPerTrack + 1 : 0;
+		size_t numValid = events.size();
+		while (numValid > 0 && indices[numValid - 1] < firstValid)
+			numValid--;
+		events.resize(numValid);
+		std::reverse(events.begin(), events.end());
+	}
+
+	void WriteJSONString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (; *text; text++)
+		{
+			if (*text == '"' || *text == '\\')
+				file << '\\' << *text;
+			else if (static_cast<unsigned char>(*text) >= 0x20)
+				file << *text;
+		}
+		file << '"';
+	}
+
+	void BeginJob(void*, const char* const name, const uint32_t worker)
+	{
+		if (!threadRegistered)
+		{
+			char threadName[maxTrackNameLength];
+			snprintf(threadName, sizeof(threadName), "Worker %u", worker);
+			SetThreadName(threadName);
+		}
+		BeginScope(name);
+	}
+
+	void EndJob(void*, const char*, const uint32_t)
+	{
+		EndScope();
+	}
+}
+
+namespace Profiler
+{
+	int64_t Now()
+	{
+		return ToProfilerTime(Clock::now());
+	}
+
+	int64_t ToProfilerTime(const Clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+	}
+
+	void BeginScope(const char* const name)
+	{
+		TrackBuffer* const track = GetThreadTrack();
+		if (!track)
+			return;
+		// deeper scopes are counted, to keep the nesting, but not timed
+		if (track->Depth < maxDepth)
+		{
+			track->ScopeNames[track->Depth] = name;
+			track->ScopeBegins[track->Depth] = Now();
+		}
+		track->Depth++;
+	}
+
+	void EndScope()
+	{
+		TrackBuffer* const track = threadTrack;
+		if (!track)
+			return;
+		assert(track->Depth > 0 && "EndScope without BeginScope");
+		const uint32_t depth = --track->Depth;
+		if (depth < maxDepth)
+			Write(*track, track->ScopeNames[depth], track->ScopeBegins[depth], Now(), depth);
+	}
+
+	void SetThreadName(const char* const name)
+	{
+		TrackBuffer* const track = GetThreadTrack();
+		if (!track)
+			return;
+		std::lock_guard<std::mutex> lock(trackMutex);
+		snprintf(track->Name, maxTrackNameLength, "%s", name);
+	}
+
+	uint32_t AddTrack(const char* const name)
+	{
+		return RegisterTrack(name);
+	}
+
+	void RecordEvent(const uint32_t track, const char* const name, const int64_t begin, const int64_t end,
+		const uint32_t depth)
+	{
+		if (track == invalidTrack)
+			return;
+		Write(*tracks[track], name, begin, end, depth);
+	}
+
+	void BeginFrame()
+	{
+		const int64_t now = Now();
+		if (numFrames > 0)
+			frames[(numFrames - 1) % maxFrames].End = now;
+		frames[numFrames % maxFrames] = { numFrames, now, 0 };
+		numFrames++;
+	}
+
+	bool GetFrame(const uint32_t framesAgo, Frame& frame)
+	{
+		if (framesAgo + 2 > maxFrames || numFrames < framesAgo + 2)
+			return false;
+		frame = frames[(numFrames - 2 - framesAgo) % maxFrames];
+		return true;
+	}
+
+	void Collect(const int64_t begin, const int64_t end, std::vector<Track>& collected)
+	{
+		const uint32_t count = numTracks.load(std::memory_order_acquire);
+		collected.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			{
+				std::lock_guard<std::mutex> lock(trackMutex);
+				collected[i].Name = tracks[i]->Name;
+			}
+			CopyEvents(*tracks[i], begin, end, collected[i].Events);
+		}
+	}
+
+	bool WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file)
+			return false;
+
+		std::vector<Track> collected;
+		Collect(INT64_MIN, INT64_MAX, collected);
+		char number[64];
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		const auto beginEntry = [&file, &first]()
+		{
+			file << (first ? "" : ",\n");
+			first = false;
+		};
+		for (uint32_t track = 0; track < collected.size(); track++)
+		{
+			beginEntry();
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"name\":";
+			WriteJSONString(file, collected[track].Name.c_str());
+			file << "}}";
+			beginEntry();
+			file << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track <<
+				",\"args\":{\"sort_index\":" << track << "}}";
+			for (const Event& event : collected[track].Events)
+			{
+				beginEntry();
+				file << "{\"name\":";
+				WriteJSONString(file, event.Name);
+				snprintf(number, sizeof(number), ",\"ts\":%.3f,\"dur\":%.3f", event.Begin * 1e-3,
+					(event.End - event.Begin) * 1e-3);
+				file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << track << number << "}";
+			}
+		}
+
+		// frame markers across every track
+		Frame frame;
+		for (uint32_t framesAgo = 0; GetFrame(framesAgo, frame); framesAgo++)
+		{
+			beginEntry();
+			snprintf(number, sizeof(number), ",\"ts\":%.3f", frame.Begin * 1e-3);
+			file << "{\"name\":\"Frame " << frame.Index << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0" << number <<
+				"}";
+		}
+		file << "\n]}\n";
+		return static_cast<bool>(file);
+	}
+
+	void ProfileJobs(JobSystem& jobs)
+	{
+		JobSystem::ProfilingHooks hooks;
+		hooks.BeginJob = &BeginJob;
+		hooks.EndJob = &EndJob;
+		jobs.SetProfilingHooks(hooks);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Timed, nested scopes on every thread, kept in a ring per thread for the last few thousand scopes of each. A scope is
+// written once, when it ends, by the thread that owns the ring and without any locks, so PROFILE_SCOPE can go in hot code.
+// Other timelines, like the GPU's, get tracks of their own that a single thread fills with RecordEvent. Tracks are kept
+// after their threads exit, so only the first maxTracks threads to record are profiled.
+//
+// Frames are marked with BeginFrame on the thread that drives them. Collect copies out what overlaps a time range for
+// display, and WriteChromeTrace everything still held in the rings as JSON that chrome://tracing and Perfetto load.
+namespace Profiler
+{
+	using Clock = std::chrono::steady_clock;
+
+	static const uint32_t maxTracks = 64;
+	// per track, at 32 bytes each
+	static const uint32_t maxEventsPerTrack = 1 << 16;
+	static const uint32_t maxDepth = 32;
+	static const uint32_t maxFrames = 256;
+	static const uint32_t maxTrackNameLength = 32;
+
+	// Times are nanoseconds since the program started.
+	struct Event
+	{
+		const char* Name = nullptr;
+		int64_t Begin = 0;
+		int64_t End = 0;
+		uint32_t Depth = 0;
+	};
+
+	struct Track
+	{
+		std::string Name;
+		std::vector<Event> Events;
+	};
+
+	struct Frame
+	{
+		uint64_t Index = 0;
+		int64_t Begin = 0;
+		int64_t End = 0;
+	};
+
+	int64_t Now();
+	int64_t ToProfilerTime(const Clock::time_point time);
+
+	// Names must outlive the profiler, which string literals do.
+	void BeginScope(const char* const name);
+	void EndScope();
+	// Names the calling thread's track, "Thread n" otherwise.
+	void SetThreadName(const char* const name);
+
+	// A track for a timeline no thread runs. Only one thread at a time may record into it.
+	uint32_t AddTrack(const char* const name);
+	void RecordEvent(const uint32_t track, const char* const name, const int64_t begin, const int64_t end,
+		const uint32_t depth);
+
+	// Ends the previous frame where the next begins. Frames are only marked and read on one thread, like the trace.
+	void BeginFrame();
+	// The frame framesAgo before the one in progress, false when it is no longer or not yet kept.
+	bool GetFrame(const uint32_t framesAgo, Frame& frame);
+	// Every track, with the events that overlap [begin, end) in the order they ended.
+	void Collect(const int64_t begin, const int64_t end, std::vector<Track>& tracks);
+	// Every event still kept, with a marker per frame.
+	bool WriteChromeTrace(const std::string& path);
+
+	// Scopes every job by its name, on tracks named after the workers.
+	void ProfileJobs(JobSystem& jobs);
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* const name) { BeginScope(name); }
+		~Scope() { EndScope(); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+}
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+// Times the rest of the enclosing block.
+#define PROFILE_SCOPE(name) const Profiler::Scope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
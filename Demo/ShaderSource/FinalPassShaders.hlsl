@@ -26,5 +26,6 @@ float4 pixel(VertexOutput input) : SV_TARGET
     float4 sceneTex = gbuffer[0].Sample(samp, float2(input.UV.x, -input.UV.y));
     float4 shadowMap = gbuffer[1].Sample(samp, float2(input.UV.x, -input.UV.y));
 
-    return sceneTex * shadowMap;
+    // the raytracing pass writes shadow visibility to rgb and ambient occlusion to alpha
+    return float4(sceneTex.rgb * shadowMap.rgb * shadowMap.a, sceneTex.a);
 }
\ No newline at end of file
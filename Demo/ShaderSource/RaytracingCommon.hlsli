@@ -0,0 +1,69 @@
+// Shared by the raytracing pass and the shadow denoiser, which reads the same per frame constants.
+
+// Must match RTPerFrameConstantBuffer.
+cbuffer PerFrame : register(b0, space0)
+{
+    float4x4 inverseView;
+    float4x4 inverseProjection;
+    float4 lightDirection;
+    float4x4 previousViewProjection;
+    float4 previousCameraPosition;
+    uint frameIndex;
+    uint aoRaysPerPixel;
+    float aoRadius;
+    uint aoMaxHistory;
+    uint resetHistory;
+    uint shadowRaysPerPixel;
+    float lightConeCosAngle;
+    float shadowTemporalAlpha;
+    float shadowVarianceClipGamma;
+    float shadowMinimumClipSigma;
+    float shadowDepthSigma;
+    uint shadowNormalSharpness;
+    float shadowVisibilitySigma;
+    uint displayWidth;
+    uint displayHeight;
+    // Spacing of traced pixels in display pixels. Checkerboard tracing is only compressed horizontally.
+    uint traceScale;
+    uint checkerboard;
+    float upsampleDepthSigma;
+    uint upsampleNormalSharpness;
+};
+
+float3 GetCameraPosition()
+{
+    return mul(inverseView, float4(0, 0, 0, 1)).xyz;
+}
+
+// Where in the display the ray for a traced pixel goes through, in pixels. Matches ShadowUpsampler::GetTracePosition.
+float2 GetTracePosition(uint2 pixel)
+{
+    if (checkerboard)
+        return float2(pixel.x * 2 + ((pixel.y + frameIndex) & 1), pixel.y) + 0.5f;
+    return (pixel + 0.5f) * traceScale;
+}
+
+// Direction of the primary ray through a position in the display, in pixels. Not normalized.
+float3 GetCameraRayDirection(float2 position)
+{
+    float2 d = (position / float2(displayWidth, displayHeight)) * 2.f - 1.f;
+    float4 target = mul(inverseProjection, float4(d.x, -d.y, 0, 1));
+    return mul(inverseView, float4(target.xyz, 0)).xyz;
+}
+
+// The pixel the position was in last frame. Fails when it was behind the camera or off screen, and after a reset.
+bool GetPreviousPixel(float3 position, uint2 dims, out uint2 previousPixel)
+{
+    float4 previousClip = mul(previousViewProjection, float4(position, 1.f));
+    float2 previousNDC = previousClip.xy / previousClip.w;
+    float2 pixel = float2(previousNDC.x * 0.5f + 0.5f, -previousNDC.y * 0.5f + 0.5f) * dims;
+    previousPixel = uint2(pixel);
+    return resetHistory == 0 && previousClip.w > 0.f && all(pixel >= 0.f) && all(pixel < float2(dims));
+}
+
+// History is dropped when the previous pixel saw something at a different distance, which covers disocclusion.
+bool IsHistoryValid(float historyDistance, float3 position)
+{
+    float distanceFromCamera = length(position - previousCameraPosition.xyz);
+    return abs(historyDistance - distanceFromCamera) < 0.05f * distanceFromCamera;
+}
@@ -1,50 +1,223 @@
+// Permutation features, in bit order. Each is compiled as FEATURE_<NAME> 0 or 1.
+// feature: SHADOWS
+// feature: SMOOTH_NORMALS
+// feature: AMBIENT_OCCLUSION
+// feature: SOFT_SHADOWS
+
+#include "RaytracingCommon.hlsli"
+
 RaytracingAccelerationStructure scene : register(t0, space0);
 RWTexture2D<float4> output : register(u0, space0);
+// Accumulated ambient occlusion, visibility in x, frames accumulated in y and distance from the camera in z. Frames
+// alternate between the two, reading last frame's and writing this frame's.
+RWTexture2D<float4> aoHistory[2] : register(u1, space0);
+// Normal and distance from the camera of what each pixel sees, with a negative distance for misses. Guides the shadow
+// denoiser.
+RWTexture2D<float4> surface : register(u3, space0);
 
 struct PrimaryRayPayload
 {
     float3 col;
+    float3 normal;
+    float hitT;
+};
+
+struct Vertex
+{
+    float3 pos;
+    float3 norm;
+    float2 uv;
 };
 
-cbuffer PerFrame : register(b0, space0)
+struct PerObject
 {
-    float4x4 inverseView;
-    float4x4 inverseProjection;
-    float4 lightDirection;
+    float4x4 world;
+    float4x4 worldInvTranspose;
+    uint textureID;
+    uint vertexBufferID;
+    uint indexBufferID;
+    uint padding;
+};
+
+// All objects for the frame in object order, so InstanceID() indexes it directly.
+StructuredBuffer<PerObject> objects : register(t1, space0);
+
+// bindless geometry, indexed by the buffer IDs in each object's instance data
+StructuredBuffer<Vertex> vertexBuffers[] : register(t0, space2);
+Buffer<uint> indexBuffers[] : register(t0, space3);
+
+// Where the hit geometry starts within its model's index and vertex buffers. Set per hit group record.
+cbuffer Geometry : register(b1, space0)
+{
+    uint indexOffset;
+    uint vertexOffset;
+};
+
+struct ShadowRayPayload
+{
+    bool InShadow;
 };
 
+// Per pixel offsets that are well spread in screen space: the R2 dither mask and interleaved gradient noise.
+float2 GetPixelNoise(uint2 pixel)
+{
+    float r2 = frac(dot(float2(pixel), float2(0.7548776662f, 0.5698402910f)));
+    float ign = frac(52.9829189f * frac(dot(float2(pixel), float2(0.06711056f, 0.00583715f))));
+    return float2(r2, ign);
+}
+
+// The R2 low discrepancy sequence, rotated by the pixel's noise so neighbouring pixels take different samples.
+float2 GetSample(uint index, float2 noise)
+{
+    return frac(float2(0.5f, 0.5f) + float(index) * float2(0.7548776662f, 0.5698402910f) + noise);
+}
+
+// Orthonormal basis around a unit vector, from Duff et al. 2017.
+void GetBasis(float3 normal, out float3 tangent, out float3 bitangent)
+{
+    float sign = normal.z >= 0.f ? 1.f : -1.f;
+    float a = -1.f / (sign + normal.z);
+    float b = normal.x * normal.y * a;
+    tangent = float3(1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    bitangent = float3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+float3 SampleCosineHemisphere(float3 normal, float2 u)
+{
+    float3 tangent;
+    float3 bitangent;
+    GetBasis(normal, tangent, bitangent);
+
+    float r = sqrt(u.x);
+    float phi = 2.f * 3.14159265f * u.y;
+    return normalize(tangent * (r * cos(phi)) + bitangent * (r * sin(phi)) + normal * sqrt(max(0.f, 1.f - u.x)));
+}
+
+// Uniform over the solid angle of the cone around axis whose half angle has the given cosine.
+float3 SampleCone(float3 axis, float cosMaxAngle, float2 u)
+{
+    float3 tangent;
+    float3 bitangent;
+    GetBasis(axis, tangent, bitangent);
+
+    float cosAngle = 1.f - u.x * (1.f - cosMaxAngle);
+    float sinAngle = sqrt(max(0.f, 1.f - cosAngle * cosAngle));
+    float phi = 2.f * 3.14159265f * u.y;
+    return normalize(tangent * (sinAngle * cos(phi)) + bitangent * (sinAngle * sin(phi)) + axis * cosAngle);
+}
+
+// Fraction of shadowRaysPerPixel rays towards a light of angular size acos(lightConeCosAngle) that reach it. The
+// result is noisy at one or two rays, so the shadow denoiser filters it afterwards.
+float TraceSoftShadow(float3 position, float3 normal, float3 direction, uint2 pixel)
+{
+    // the ambient occlusion rays use the same sequence, so start from the other noise value
+    float2 noise = GetPixelNoise(pixel).yx;
+    uint unoccluded = 0;
+    for (uint i = 0; i < shadowRaysPerPixel; i++)
+    {
+        RayDesc ray;
+        ray.Origin = position + normal * 0.001f;
+        ray.Direction = SampleCone(direction, lightConeCosAngle, GetSample(frameIndex * shadowRaysPerPixel + i, noise));
+        ray.TMin = 0.01f;
+        ray.TMax = 1e+38f;
+
+        ShadowRayPayload payload;
+        payload.InShadow = true;
+        TraceRay(scene, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER, 0xFF, 1, 2, 1, ray,
+            payload);
+        unoccluded += payload.InShadow ? 0 : 1;
+    }
+    return float(unoccluded) / float(max(shadowRaysPerPixel, 1));
+}
+
+// Fraction of short cosine weighted rays that leave the surface without hitting anything within aoRadius.
+float TraceAmbientOcclusion(float3 position, float3 normal, uint2 pixel)
+{
+    float2 noise = GetPixelNoise(pixel);
+    uint unoccluded = 0;
+    for (uint i = 0; i < aoRaysPerPixel; i++)
+    {
+        RayDesc ray;
+        ray.Origin = position + normal * 0.001f;
+        ray.Direction = SampleCosineHemisphere(normal, GetSample(frameIndex * aoRaysPerPixel + i, noise));
+        ray.TMin = 0.f;
+        ray.TMax = aoRadius;
+
+        // the shadow ray type, which only needs to know whether anything was hit
+        ShadowRayPayload payload;
+        payload.InShadow = true;
+        TraceRay(scene, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER, 0xFF, 1, 2, 1, ray,
+            payload);
+        unoccluded += payload.InShadow ? 0 : 1;
+    }
+    return float(unoccluded) / float(max(aoRaysPerPixel, 1));
+}
+
+// Blends this frame's estimate with the history at the position's pixel last frame.
+float AccumulateAmbientOcclusion(float3 position, float ao, uint2 dims)
+{
+    float count = 1.f;
+    float accumulated = ao;
+
+    uint2 previousPixel;
+    if (GetPreviousPixel(position, dims, previousPixel))
+    {
+        float4 history = aoHistory[(frameIndex + 1) & 1][previousPixel];
+        if (IsHistoryValid(history.z, position))
+        {
+            count = min(history.y + 1.f, float(aoMaxHistory));
+            accumulated = lerp(history.x, ao, 1.f / count);
+        }
+    }
+
+    float distanceFromCamera = length(position - GetCameraPosition());
+    aoHistory[frameIndex & 1][DispatchRaysIndex().xy] = float4(accumulated, count, distanceFromCamera, 0.f);
+    return accumulated;
+}
+
 [shader("raygeneration")]
 void RayGen()
 {
     uint2 currentPixel = DispatchRaysIndex().xy;
 
     uint2 dims = DispatchRaysDimensions().xy;
-    float2 d = (((currentPixel + 0.5f) / dims.xy) * 2.f - 1.f);
     
     RayDesc ray;
-    ray.Origin = mul(inverseView, float4(0, 0, 0, 1));
-    float4 target = mul(inverseProjection, float4(d.x, -d.y, 0, 1));
-    ray.Direction = mul(inverseView, float4(target.xyz, 0));
+    ray.Origin = GetCameraPosition();
+    ray.Direction = GetCameraRayDirection(GetTracePosition(currentPixel));
     ray.TMin = 0.0f;
     ray.TMax = 1e+38f;
     
     PrimaryRayPayload payload;
     TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, 0xFF, 0, 2, 0, ray, payload);
-    
-    output[currentPixel.xy] = float4(payload.col, 1.f);
+
+    float ao = 1.f;
+#if FEATURE_AMBIENT_OCCLUSION
+    if (payload.hitT >= 0.f)
+    {
+        float3 position = ray.Origin + ray.Direction * payload.hitT;
+        ao = TraceAmbientOcclusion(position, payload.normal, currentPixel);
+        ao = AccumulateAmbientOcclusion(position, ao, dims);
+    }
+    else
+    {
+        aoHistory[frameIndex & 1][currentPixel] = float4(1.f, 0.f, 0.f, 0.f);
+    }
+#endif
+
+    float distanceFromCamera = payload.hitT >= 0.f ? payload.hitT * length(ray.Direction) : -1.f;
+    surface[currentPixel] = float4(payload.normal, distanceFromCamera);
+    output[currentPixel.xy] = float4(payload.col, ao);
 }
 
 [shader("miss")]
 void Miss(inout PrimaryRayPayload payload)
 {
     payload.col = float3(1, 1, 1);
+    payload.normal = float3(0, 0, 0);
+    payload.hitT = -1.f;
 }
 
-struct ShadowRayPayload
-{
-    bool InShadow;
-};
-
 [shader("closesthit")]
 void ClosestHit(inout PrimaryRayPayload payload, in BuiltInTriangleIntersectionAttributes attribs)
 {
@@ -53,8 +226,37 @@ void ClosestHit(inout PrimaryRayPayload payload, in BuiltInTriangleIntersectionA
     float3 rayOriginW = WorldRayOrigin();
     
     float3 hitPosW = rayOriginW + hitT * rayDirW;
+    payload.hitT = hitT;
+    payload.normal = float3(0, 0, 0);
+
+#if FEATURE_SHADOWS || FEATURE_AMBIENT_OCCLUSION || FEATURE_SOFT_SHADOWS
+    PerObject object = objects[InstanceID()];
+    Buffer<uint> indices = indexBuffers[NonUniformResourceIndex(object.indexBufferID)];
+    StructuredBuffer<Vertex> vertices = vertexBuffers[NonUniformResourceIndex(object.vertexBufferID)];
+    uint firstIndex = indexOffset + PrimitiveIndex() * 3;
+    uint3 triangleIndices = uint3(indices[firstIndex], indices[firstIndex + 1], indices[firstIndex + 2]) + vertexOffset;
+    float3 barycentrics = float3(1.f - attribs.barycentrics.x - attribs.barycentrics.y, attribs.barycentrics.x,
+        attribs.barycentrics.y);
+#if FEATURE_SMOOTH_NORMALS
+    float3 normal = vertices[triangleIndices.x].norm * barycentrics.x + vertices[triangleIndices.y].norm * barycentrics.y +
+        vertices[triangleIndices.z].norm * barycentrics.z;
+#else
+    float3 normal = cross(vertices[triangleIndices.y].pos - vertices[triangleIndices.x].pos,
+        vertices[triangleIndices.z].pos - vertices[triangleIndices.x].pos);
+#endif
+    float3 normalW = normalize(mul((float3x3)object.worldInvTranspose, normal));
+    normalW = dot(normalW, rayDirW) > 0.f ? -normalW : normalW;
+    payload.normal = normalW;
+#endif
+
+#if FEATURE_SHADOWS && FEATURE_SOFT_SHADOWS
+    float val = TraceSoftShadow(hitPosW, normalW, normalize(float3(lightDirection.x, -lightDirection.y,
+        -lightDirection.z)), DispatchRaysIndex().xy);
+    payload.col = float3(val, val, val);
+#elif FEATURE_SHADOWS
+    // start the shadow ray just off the surface so it does not hit the triangle it leaves from
     RayDesc shadowRay;
-    shadowRay.Origin = hitPosW;
+    shadowRay.Origin = hitPosW + normalW * 0.001f;
     shadowRay.Direction = normalize(float3(lightDirection.x, -lightDirection.y, -lightDirection.z));
     shadowRay.TMin = 0.01f;
     shadowRay.TMax = 1e+38f;
@@ -64,6 +266,9 @@ void ClosestHit(inout PrimaryRayPayload payload, in BuiltInTriangleIntersectionA
 
     float val = shadowPayload.InShadow ? 0 : 1;
     payload.col = float3(val, val, val);
+#else
+    payload.col = float3(1, 1, 1);
+#endif
 }
 
 [shader("miss")]
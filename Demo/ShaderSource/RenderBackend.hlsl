@@ -0,0 +1,73 @@
+// Compute passes of D3D12RenderBackend. Shadows trace with inline raytracing, so they need no shader table, and
+// textures are picked out of the backend's UAV heap by index. SoftwareRenderBackend.cpp has the same passes.
+
+// Must match FrameConstants in RenderBackend.h.
+cbuffer PerFrame : register(b0, space0)
+{
+    float4x4 viewProjection;
+    float4 lightDirection;
+    float4 lightDiffuse;
+    float4 lightAmbient;
+    float4 cameraPosition;
+    float4x4 inverseViewProjection;
+};
+
+cbuffer Pass : register(b1, space0)
+{
+    uint sourceIndex;
+    uint shadowIndex;
+    uint outputIndex;
+};
+
+RaytracingAccelerationStructure scene : register(t0, space0);
+// D3D12RenderBackend::maxTextures
+RWTexture2D<float4> textures[64] : register(u0, space1);
+
+// Hard shadows from the surface the raster pass left behind, rebuilt out of the camera ray and distance.
+[numthreads(8, 8, 1)]
+void shadows(uint3 id : SV_DispatchThreadID)
+{
+    uint2 dims;
+    textures[outputIndex].GetDimensions(dims.x, dims.y);
+    uint2 pixel = id.xy;
+    if (any(pixel >= dims))
+        return;
+
+    float4 surface = textures[sourceIndex][pixel];
+    float visibility = 1.f;
+    if (surface.w >= 0.f)
+    {
+        float2 ndc = (pixel + 0.5f) / dims * 2.f - 1.f;
+        float4 farPoint = mul(inverseViewProjection, float4(ndc.x, -ndc.y, 1.f, 1.f));
+        float3 direction = normalize(farPoint.xyz / farPoint.w - cameraPosition.xyz);
+        float3 position = cameraPosition.xyz + direction * surface.w;
+
+        RayDesc ray;
+        ray.Origin = position + surface.xyz * 0.001f;
+        ray.Direction = normalize(float3(lightDirection.x, -lightDirection.y, -lightDirection.z));
+        ray.TMin = 0.01f;
+        ray.TMax = 1e+38f;
+
+        RayQuery<RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_FORCE_OPAQUE> query;
+        query.TraceRayInline(scene, RAY_FLAG_NONE, 0xFF, ray);
+        query.Proceed();
+        if (query.CommittedStatus() == COMMITTED_TRIANGLE_HIT)
+            visibility = 0.f;
+    }
+    textures[outputIndex][pixel] = float4(visibility, visibility, visibility, 1.f);
+}
+
+// Scene color darkened by shadow visibility and ambient occlusion.
+[numthreads(8, 8, 1)]
+void composite(uint3 id : SV_DispatchThreadID)
+{
+    uint2 dims;
+    textures[outputIndex].GetDimensions(dims.x, dims.y);
+    uint2 pixel = id.xy;
+    if (any(pixel >= dims))
+        return;
+
+    float4 color = textures[sourceIndex][pixel];
+    float4 shadow = textures[shadowIndex][pixel];
+    textures[outputIndex][pixel] = float4(color.rgb * shadow.rgb * shadow.a, 1.f);
+}
@@ -1,3 +1,7 @@
+// Permutation features, in bit order. Each is compiled as FEATURE_<NAME> 0 or 1.
+// feature: TEXTURE
+// feature: LIGHTING
+
 struct VertexInput
 {
 	float3 pos : POSITION;
@@ -9,8 +13,10 @@ struct VertexOutput
 {
 	float4 pos : SV_POSITION;
     float3 localSpaceNormal : LS_NORMAL;
+    float3 worldPos : WORLDPOS;
     float2 uv : TEXTURECOORD;
     float4x4 worldInvTranspose : WORLDINVTRANSPOSE;
+    nointerpolation uint textureID : TEXTUREID;
 };
 
 struct DirectionalLight
@@ -27,33 +33,62 @@ cbuffer PerFrame : register(b0, space0)
 {
     float4x4 viewProjection;
     DirectionalLight light;
+    float4 cameraPosition;
 }
 
-cbuffer PerObject : register(b1, space0)
+struct PerObject
 {
     float4x4 world;
     float4x4 worldInvTranspose;
+    uint textureID;
+    uint vertexBufferID;
+    uint indexBufferID;
+    uint padding;
+};
+
+// All objects for the frame, ordered so each instanced draw reads a contiguous range starting at firstInstance.
+StructuredBuffer<PerObject> objects : register(t1, space0);
+
+cbuffer PerDraw : register(b1, space0)
+{
+    uint firstInstance;
 }
 
-VertexOutput vertex(VertexInput input)
+VertexOutput vertex(VertexInput input, uint instanceID : SV_InstanceID)
 {
-    float4x4 wvp = mul(viewProjection, world);
+    PerObject object = objects[firstInstance + instanceID];
+    float4x4 wvp = mul(viewProjection, object.world);
 	
 	VertexOutput output;
     output.pos = mul(wvp, float4(input.pos, 1.f));
     output.localSpaceNormal = input.norm;
+    output.worldPos = mul(object.world, float4(input.pos, 1.f)).xyz;
     output.uv = input.uv;
-    output.worldInvTranspose = worldInvTranspose;
+    output.worldInvTranspose = object.worldInvTranspose;
+    output.textureID = object.textureID;
 	return output;
 }
 
 SamplerState samp: register(s0, space0);
-Texture2D<float4> tex : register(t0, space0);
+// bindless textures, indexed by the texture ID in each object's instance data
+Texture2D<float4> textures[] : register(t0, space1);
 
-float4 pixel(VertexOutput input) : SV_TARGET
+struct PixelOutput
 {
-    float3 materialCol = float3(tex.Sample(samp, input.uv.xy).xyz);
-    
+    float4 color : SV_TARGET0;
+    // world space normal facing the camera and distance from it, guiding the shadow upsampler
+    float4 surface : SV_TARGET1;
+};
+
+PixelOutput pixel(VertexOutput input)
+{
+#if FEATURE_TEXTURE
+    float3 materialCol = float3(textures[NonUniformResourceIndex(input.textureID)].Sample(samp, input.uv.xy).xyz);
+#else
+    float3 materialCol = float3(1.f, 1.f, 1.f);
+#endif
+
+#if FEATURE_LIGHTING
     float3 ambient = materialCol * light.ambient;
 
     float3 L = normalize(mul(
@@ -65,6 +100,16 @@ float4 pixel(VertexOutput input) : SV_TARGET
     float3 finalColor;
     finalColor = (ambient + diffuse) * materialCol;
     clamp(finalColor.xyz, 0.f, 1.f);
+#else
+    float3 finalColor = materialCol;
+#endif
+
+    float3 toCamera = cameraPosition.xyz - input.worldPos;
+    float3 normal = normalize(mul((float3x3)input.worldInvTranspose, input.localSpaceNormal));
+    normal = dot(normal, toCamera) < 0.f ? -normal : normal;
 
-    return float4(finalColor, 1.0f);
+    PixelOutput output;
+    output.color = float4(finalColor, 1.0f);
+    output.surface = float4(normal, length(toCamera));
+    return output;
 }
\ No newline at end of file
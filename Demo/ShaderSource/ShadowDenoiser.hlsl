@@ -0,0 +1,136 @@
+// Denoises the soft shadows the raytracing pass leaves in output.rgb. The temporal pass blends each pixel with its
+// reprojected history, clipped to the spread of its neighbourhood, then a-trous passes filter the result with taps
+// 1, 2, 4 and so on pixels apart, weighted by how alike the surfaces are. ShadowDenoiser.cpp has the same kernels.
+
+#include "RaytracingCommon.hlsli"
+
+RWTexture2D<float4> output : register(u0, space0);
+RWTexture2D<float4> surface : register(u1, space0);
+// Denoised visibility before spatial filtering in x, frames accumulated in y and distance from the camera in z. Frames
+// alternate between the two, like the ambient occlusion history.
+RWTexture2D<float4> shadowHistory[2] : register(u2, space0);
+// a-trous ping-pong buffers
+RWTexture2D<float> denoised[2] : register(u4, space0);
+
+cbuffer Pass : register(b1, space0)
+{
+    uint stepSize;
+    uint source;
+    // the last pass writes to output instead of the other ping-pong buffer
+    uint isLastPass;
+};
+
+static const float kernelWeights[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+uint2 GetDimensions()
+{
+    uint2 dims;
+    output.GetDimensions(dims.x, dims.y);
+    return dims;
+}
+
+uint2 ClampToScreen(int2 pixel, uint2 dims)
+{
+    return uint2(clamp(pixel, int2(0, 0), int2(dims) - 1));
+}
+
+[numthreads(8, 8, 1)]
+void temporal(uint3 id : SV_DispatchThreadID)
+{
+    uint2 dims = GetDimensions();
+    uint2 pixel = id.xy;
+    if (any(pixel >= dims))
+        return;
+
+    float current = output[pixel].r;
+    float4 centre = surface[pixel];
+    if (centre.w < 0.f)
+    {
+        shadowHistory[frameIndex & 1][pixel] = float4(current, 0.f, 0.f, 0.f);
+        denoised[0][pixel] = current;
+        return;
+    }
+
+    float sum = 0.f;
+    float sumOfSquares = 0.f;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            float value = output[ClampToScreen(int2(pixel) + int2(dx, dy), dims)].r;
+            sum += value;
+            sumOfSquares += value * value;
+        }
+    }
+    float mean = sum / 9.f;
+    float sigma = max(shadowMinimumClipSigma, sqrt(max(0.f, sumOfSquares / 9.f - mean * mean)));
+
+    float3 position = GetCameraPosition() + normalize(GetCameraRayDirection(GetTracePosition(pixel))) * centre.w;
+    float count = 1.f;
+    float result = current;
+    uint2 previousPixel;
+    if (GetPreviousPixel(position, dims, previousPixel))
+    {
+        float4 history = shadowHistory[(frameIndex + 1) & 1][previousPixel];
+        if (history.y > 0.f && IsHistoryValid(history.z, position))
+        {
+            count = history.y + 1.f;
+            float alpha = max(shadowTemporalAlpha, 1.f / count);
+            float clipped = clamp(history.x, mean - shadowVarianceClipGamma * sigma,
+                mean + shadowVarianceClipGamma * sigma);
+            result = lerp(clipped, current, alpha);
+        }
+    }
+
+    shadowHistory[frameIndex & 1][pixel] = float4(result, count, centre.w, 0.f);
+    denoised[0][pixel] = result;
+}
+
+[numthreads(8, 8, 1)]
+void atrous(uint3 id : SV_DispatchThreadID)
+{
+    uint2 dims = GetDimensions();
+    uint2 pixel = id.xy;
+    if (any(pixel >= dims))
+        return;
+
+    float visibility = denoised[source][pixel];
+    float4 centre = surface[pixel];
+    float result = visibility;
+    if (centre.w >= 0.f)
+    {
+        float depthScale = 1.f / (shadowDepthSigma * centre.w);
+        float visibilityScale = 1.f / shadowVisibilitySigma;
+        float weightedSum = 0.f;
+        float weightSum = 0.f;
+        for (int dy = -2; dy <= 2; dy++)
+        {
+            for (int dx = -2; dx <= 2; dx++)
+            {
+                uint2 neighbour = ClampToScreen(int2(pixel) + int2(dx, dy) * int(stepSize), dims);
+                float4 neighbourSurface = surface[neighbour];
+                if (neighbourSurface.w < 0.f)
+                    continue;
+
+                float neighbourVisibility = denoised[source][neighbour];
+                float depthWeight = max(0.f, 1.f - abs(neighbourSurface.w - centre.w) * depthScale);
+                float normalWeight = max(0.f, dot(centre.xyz, neighbourSurface.xyz));
+                for (uint i = 0; i < shadowNormalSharpness; i++)
+                {
+                    normalWeight *= normalWeight;
+                }
+                float visibilityWeight = max(0.f, 1.f - abs(neighbourVisibility - visibility) * visibilityScale);
+                float weight = kernelWeights[dx + 2] * kernelWeights[dy + 2] * depthWeight * normalWeight *
+                    visibilityWeight;
+                weightedSum += weight * neighbourVisibility;
+                weightSum += weight;
+            }
+        }
+        result = weightSum > 0.f ? weightedSum / weightSum : visibility;
+    }
+
+    if (isLastPass)
+        output[pixel] = float4(result, result, result, output[pixel].a);
+    else
+        denoised[source ^ 1][pixel] = result;
+}
@@ -0,0 +1,71 @@
+// Brings shadows and ambient occlusion traced at a reduced resolution back to the display's. Each display pixel blends
+// the traced pixels around it by a tent of the trace spacing, weighted by how alike their surface is to the one the
+// raster pass saw there. ShadowUpsampler.cpp has the same kernel.
+
+#include "RaytracingCommon.hlsli"
+
+// normal and distance from the camera of each display pixel, written by the raster pass
+Texture2D<float4> displaySurface : register(t0, space0);
+RWTexture2D<float4> traced : register(u0, space0);
+RWTexture2D<float4> tracedSurface : register(u1, space0);
+RWTexture2D<float4> output : register(u2, space0);
+
+[numthreads(8, 8, 1)]
+void upsample(uint3 id : SV_DispatchThreadID)
+{
+    uint2 pixel = id.xy;
+    if (pixel.x >= displayWidth || pixel.y >= displayHeight)
+        return;
+
+    uint2 traceDims;
+    traced.GetDimensions(traceDims.x, traceDims.y);
+    float4 centre = displaySurface[pixel];
+    int2 tracePixel = int2(pixel.x / traceScale, checkerboard ? pixel.y : pixel.y / traceScale);
+
+    float4 weightedSum = 0.f;
+    float weightSum = 0.f;
+    float4 closestValue = 0.f;
+    float closestDifference = 3.402823e+38f;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            int2 tap = tracePixel + int2(dx, dy);
+            if (any(tap < 0) || any(tap >= int2(traceDims)))
+                continue;
+
+            float2 offset = abs(GetTracePosition(uint2(tap)) - (pixel + 0.5f)) / float(traceScale);
+            float spatialWeight = max(0.f, 1.f - offset.x) * max(0.f, 1.f - offset.y);
+            if (spatialWeight <= 0.f)
+                continue;
+
+            // sky only blends with sky
+            float4 tapSurface = tracedSurface[tap];
+            float4 tapValue = traced[tap];
+            bool sameKind = (tapSurface.w < 0.f) == (centre.w < 0.f);
+            float difference = sameKind ? abs(tapSurface.w - centre.w) : 1.701411e+38f;
+            if (difference < closestDifference)
+            {
+                closestDifference = difference;
+                closestValue = tapValue;
+            }
+            if (!sameKind)
+                continue;
+
+            float weight = spatialWeight;
+            if (centre.w >= 0.f)
+            {
+                float depthWeight = max(0.f, 1.f - difference / (upsampleDepthSigma * centre.w));
+                float normalWeight = max(0.f, dot(centre.xyz, tapSurface.xyz));
+                for (uint i = 0; i < upsampleNormalSharpness; i++)
+                {
+                    normalWeight *= normalWeight;
+                }
+                weight *= depthWeight * normalWeight;
+            }
+            weightedSum += weight * tapValue;
+            weightSum += weight;
+        }
+    }
+    output[pixel] = weightSum > 1e-4f ? weightedSum / weightSum : closestValue;
+}
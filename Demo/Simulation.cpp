@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "Simulation.h"
+#include "Graphics/TransformSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace
+{
+	const float pi = 3.14159265358979f;
+	const float spinRadiansPerSecond = pi / 6.f;
+	const float sphereSpeed = 2.f;
+	const float sphereTravel = 5.f;
+
+	float Lerp(const float a, const float b, const float t)
+	{
+		return a + (b - a) * t;
+	}
+}
+
+Simulation::~Simulation()
+{
+	Stop();
+}
+
+void Simulation::Initialize(const TransformSystem& transforms, const uint32_t numSpheres, const float stepSeconds)
+{
+	assert(!m_thread.joinable());
+	assert(numSpheres <= transforms.GetCount() && stepSeconds > 0.f);
+	m_numSpheres = numSpheres;
+	m_stepSeconds = stepSeconds;
+	m_step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(stepSeconds));
+
+	m_current = State();
+	m_current.Positions.resize(transforms.GetCount());
+	m_current.Rotations.resize(transforms.GetCount());
+	for (uint32_t i = 0; i < transforms.GetCount(); i++)
+	{
+		m_current.Positions[i] = transforms.GetPosition(i);
+		m_current.Rotations[i] = transforms.GetRotation(i);
+	}
+	m_previous = m_current;
+	m_advancedTime = Clock::time_point();
+	m_currentTime = m_advancedTime;
+	m_numSteps = 0;
+	m_numDroppedSteps = 0;
+	m_stepNanoseconds = 0;
+	RunDueSteps(m_advancedTime);
+}
+
+void Simulation::Start()
+{
+	assert(!m_thread.joinable() && !m_current.Positions.empty());
+	// the steps keep their spacing, only the clock they are due by changes
+	const Clock::duration shift = Clock::now() - m_advancedTime;
+	m_advancedTime += shift;
+	m_currentTime += shift;
+	Publish();
+	m_stopping = false;
+	m_thread = std::thread(&Simulation::Run, this);
+}
+
+void Simulation::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+	m_stopping = true;
+	m_thread.join();
+}
+
+void Simulation::Advance(const Clock::duration elapsed)
+{
+	assert(!m_thread.joinable());
+	m_advancedTime += elapsed;
+	RunDueSteps(m_advancedTime);
+}
+
+void Simulation::Interpolate(TransformSystem& transforms)
+{
+	const Snapshot& snapshot = m_snapshots.Read();
+	if (snapshot.Current.Positions.empty())
+		return;
+	assert(snapshot.Current.Positions.size() == transforms.GetCount());
+
+	// m_advancedTime is only written by this thread when there is no simulation thread
+	const Clock::time_point now = m_thread.joinable() ? Clock::now() : m_advancedTime;
+	const Clock::duration sincePrevious = now - (snapshot.CurrentTime - m_step);
+	const float t = std::min(std::max(static_cast<float>(static_cast<double>(sincePrevious.count()) / m_step.count()),
+		0.f), 1.f);
+	for (uint32_t i = 0; i < transforms.GetCount(); i++)
+	{
+		const Float3& previousPosition = snapshot.Previous.Positions[i];
+		const Float3& currentPosition = snapshot.Current.Positions[i];
+		const Float3& previousRotation = snapshot.Previous.Rotations[i];
+		const Float3& currentRotation = snapshot.Current.Rotations[i];
+		transforms.SetPosition(i, Lerp(previousPosition.x, currentPosition.x, t),
+			Lerp(previousPosition.y, currentPosition.y, t), Lerp(previousPosition.z, currentPosition.z, t));
+		transforms.SetRotation(i, Lerp(previousRotation.x, currentRotation.x, t),
+			Lerp(previousRotation.y, currentRotation.y, t), Lerp(previousRotation.z, currentRotation.z, t));
+	}
+}
+
+Simulation::Statistics Simulation::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.NumSteps = m_numSteps.load(std::memory_order_relaxed);
+	statistics.NumDroppedSteps = m_numDroppedSteps.load(std::memory_order_relaxed);
+	if (statistics.NumSteps)
+		statistics.StepMilliseconds = m_stepNanoseconds.load(std::memory_order_relaxed) * 1e-6 / statistics.NumSteps;
+	return statistics;
+}
+
+void Simulation::Step()
+{
+	PROFILE_SCOPE("Simulation step");
+	m_previous.Positions.swap(m_current.Positions);
+	m_previous.Rotations.swap(m_current.Rotations);
+	m_previous.LeftSphereTranslatePlus = m_current.LeftSphereTranslatePlus;
+	m_previous.RightSphereTranslatePlus = m_current.RightSphereTranslatePlus;
+	m_current.Positions = m_previous.Positions;
+	m_current.Rotations = m_previous.Rotations;
+
+	if (m_numSpheres > 1)
+	{
+		Float3& leftPosition = m_current.Positions[1];
+		if (leftPosition.z >= sphereTravel) m_current.LeftSphereTranslatePlus = false;
+		if (leftPosition.z <= -sphereTravel) m_current.LeftSphereTranslatePlus = true;
+		leftPosition.z += (m_current.LeftSphereTranslatePlus ? sphereSpeed : -sphereSpeed) * m_stepSeconds;
+	}
+	if (m_numSpheres > 2)
+	{
+		Float3& rightPosition = m_current.Positions[2];
+		if (rightPosition.z >= sphereTravel) m_current.RightSphereTranslatePlus = false;
+		if (rightPosition.z <= -sphereTravel) m_current.RightSphereTranslatePlus = true;
+		rightPosition.z += (m_current.RightSphereTranslatePlus ? sphereSpeed : -sphereSpeed) * m_stepSeconds;
+	}
+	if (m_numSpheres > 0)
+	{
+		Float3& centerRotation = m_current.Rotations[0];
+		centerRotation.x += spinRadiansPerSecond * m_stepSeconds;
+		centerRotation.z += spinRadiansPerSecond * m_stepSeconds;
+	}
+}
+
+// The current step is due once its time has come, so that the next one is ready to blend towards.
+void Simulation::RunDueSteps(const Clock::time_point now)
+{
+	const auto start = Clock::now();
+	uint32_t numSteps = 0;
+	for (; now >= m_currentTime && numSteps < maxCatchUpSteps; numSteps++)
+	{
+		Step();
+		m_currentTime += m_step;
+	}
+	if (now >= m_currentTime)
+	{
+		// too far behind: leave the last step where it is and carry on from now
+		m_numDroppedSteps += (now - m_currentTime) / m_step + 1;
+		m_currentTime = now + m_step;
+	}
+	if (!numSteps)
+		return;
+
+	m_numSteps += numSteps;
+	m_stepNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	Publish();
+}
+
+void Simulation::Publish()
+{
+	Snapshot& snapshot = m_snapshots.GetWriteBuffer();
+	snapshot.Previous = m_previous;
+	snapshot.Current = m_current;
+	snapshot.CurrentTime = m_currentTime;
+	m_snapshots.Publish();
+}
+
+void Simulation::Run()
+{
+	// half a step early, so that a late wake up does not leave the render thread without the step it blends towards
+	const Clock::duration lead = m_step / 2;
+	Profiler::SetThreadName("Simulation");
+	while (!m_stopping.load(std::memory_order_relaxed))
+	{
+		RunDueSteps(Clock::now() + lead);
+		std::this_thread::sleep_until(m_currentTime - lead);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "TripleBuffer.h"
+#include "Graphics/Float3.h"
+
+class TransformSystem;
+
+// The demo's animation stepped at a fixed rate: the first sphere spins, the next two move back and forth along z. Each
+// step only depends on the one before, so the same number of steps always gives the same scene whatever the frame rate.
+//
+// Steps run one ahead of time, so that whenever the scene is drawn there is a step before and after that moment to blend
+// between; Interpolate writes that blend into the transforms. When more than maxCatchUpSteps are due at once, after a
+// stall, the rest of the time is dropped rather than simulated. Start runs the steps on a thread of its own that hands
+// each result to the render thread through a triple buffer, so neither ever waits for the other. Without Start the
+// steps run on the calling thread in Advance, for runs that have to be reproducible.
+class Simulation
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static const uint32_t maxCatchUpSteps = 8;
+
+	struct Statistics
+	{
+		uint64_t NumSteps = 0;
+		uint64_t NumDroppedSteps = 0;
+		// average time taken by a step
+		double StepMilliseconds = 0.0;
+	};
+
+public:
+	~Simulation();
+
+	// Takes every object's starting position and rotation from transforms. The first three of numSpheres objects are
+	// animated.
+	void Initialize(const TransformSystem& transforms, const uint32_t numSpheres, const float stepSeconds = 1.f / 60.f);
+	void Start();
+	void Stop();
+	// Without Start: moves the simulation's clock forward and runs the steps that became due.
+	void Advance(const Clock::duration elapsed);
+	// Render thread. Blends the latest two steps for the current time into the positions and rotations of transforms.
+	void Interpolate(TransformSystem& transforms);
+
+	Clock::duration GetStep() const { return m_step; }
+	Statistics GetStatistics() const;
+
+private:
+	struct State
+	{
+		std::vector<Float3> Positions;
+		std::vector<Float3> Rotations;
+		bool LeftSphereTranslatePlus = false;
+		bool RightSphereTranslatePlus = true;
+	};
+
+	struct Snapshot
+	{
+		State Previous;
+		State Current;
+		// when Current is reached, Previous is one step before
+		Clock::time_point CurrentTime;
+	};
+
+	void Step();
+	void RunDueSteps(const Clock::time_point now);
+	void Publish();
+	void Run();
+
+private:
+	uint32_t m_numSpheres = 0;
+	float m_stepSeconds = 0.f;
+	Clock::duration m_step = {};
+
+	// only touched by the thread running the steps
+	State m_previous;
+	State m_current;
+	Clock::time_point m_currentTime;
+	Clock::time_point m_advancedTime;
+
+	TripleBuffer<Snapshot> m_snapshots;
+	std::atomic<uint64_t> m_numSteps = 0;
+	std::atomic<uint64_t> m_numDroppedSteps = 0;
+	std::atomic<uint64_t> m_stepNanoseconds = 0;
+	std::atomic<bool> m_stopping = false;
+	std::thread m_thread;
+};
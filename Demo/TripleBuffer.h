@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest of a stream of values from one writer thread to one reader thread without either ever waiting. The
+// writer fills its own buffer and publishes it by swapping it with the shared middle one; the reader swaps its buffer
+// with the middle one whenever something new has been published there. Values the reader did not get to in time are
+// simply replaced.
+template <class T>
+class TripleBuffer
+{
+public:
+	// Writer thread only. Still holds what was written before the last publish until it is overwritten.
+	T& GetWriteBuffer() { return m_buffers[m_writeIndex]; }
+
+	// Writer thread only.
+	void Publish()
+	{
+		const uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_writeIndex | freshBit),
+			std::memory_order_acq_rel);
+		m_writeIndex = previous & indexMask;
+	}
+
+	// Reader thread only. The most recently published value, or the one read last time when nothing new has been
+	// published since; default constructed until the first publish.
+	const T& Read()
+	{
+		if (m_middle.load(std::memory_order_relaxed) & freshBit)
+		{
+			const uint8_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+			m_readIndex = previous & indexMask;
+		}
+		return m_buffers[m_readIndex];
+	}
+
+private:
+	static const uint8_t indexMask = 0x3;
+	static const uint8_t freshBit = 0x4;
+
+	std::array<T, 3> m_buffers;
+	uint8_t m_writeIndex = 0;
+	std::atomic<uint8_t> m_middle = 1;
+	uint8_t m_readIndex = 2;
+};
@@ -1,8 +1,14 @@
 #include "stdafx.h"
+#include <shellapi.h>
+#include <intrin.h>
 #include "Console.h"
 #include "Window.h"
 #include "Gamepad.h"
-#include "Queue.h"
+#include "MPSCQueue.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "InputRecording.h"
+#include "Simulation.h"
 #include "InputDefinitions.h"
 #include "InputFunctions.h"
 #include "Macros.h"
@@ -11,8 +17,15 @@
 #include "Graphics/InputLayout.h"
 #include "Graphics/RootSignature.h"
 #include "Graphics/GraphicsPipelineState.h"
+#include "Graphics/ComputePipelineState.h"
+#include "Graphics/PipelineCache.h"
+#include "Graphics/PipelineRegistry.h"
+#include "Graphics/ShaderBuilder.h"
 #include "Graphics/DynamicConstantBuffer.h"
+#include "Graphics/DynamicUploadHeap.h"
 #include "Graphics/DescriptorHeap.h"
+#include "Graphics/DescriptorHeapAllocator.h"
+#include "Graphics/BindlessDescriptorTable.h"
 #include "Graphics/StaticVertexBuffer.h"
 #include "Graphics/StaticIndexBuffer.h"
 #include "Graphics/Fence.h"
@@ -21,6 +34,17 @@
 #include "Graphics/SamplerType.h"
 #include "Graphics/Model.h"
 #include "Graphics/TopLevelAccelerationStructure.h"
+#include "Graphics/TransformSystem.h"
+#include "Graphics/SceneVisibility.h"
+#include "Graphics/FlyCamera.h"
+#include "Graphics/ShaderTable.h"
+#include "Graphics/AmbientOcclusion.h"
+#include "Graphics/ShadowDenoiser.h"
+#include "Graphics/ShadowUpsampler.h"
+#include "Graphics/GpuProfiler.h"
+#include "FileWatcher.h"
+#include "Headless.h"
+#include "Benchmark.h"
 
 #include "ThirdParty/Assimp/importer.hpp"
 #include "ThirdParty/Assimp/scene.h"
@@ -34,25 +58,65 @@ static const uint32_t bufferCount = 3;
 // gamepad
 static std::unique_ptr<Gamepad> gamepad;
 
+// jobs
+// One worker per hardware thread, this thread being worker 0, for the CPU work that splits up: asset import today.
+static std::unique_ptr<JobSystem> jobSystem;
+
+// profiling
+// CPU scopes on every thread and GPU ranges around the passes, shown as a flame graph. -trace file writes everything
+// still kept as a Chrome trace on exit.
+static std::unique_ptr<GpuProfiler> gpuProfiler;
+static std::string tracePath;
+static std::vector<Profiler::Track> profilerTracks;
+
 // input
-static std::unique_ptr<Queue<InputEvent>> inputEventQueue;
-static const uint32_t maxPendingInputEvents = 8;
-static bool rightMouseDown = false;
+// Pushed to from the window, gamepad and any other thread that produces input, drained once per frame. Raw mouse input
+// arrives in bursts, so the ring is sized well past a frame's worth of events.
+static std::unique_ptr<MPSCQueue<InputEvent>> inputEventQueue;
+static const uint32_t maxPendingInputEvents = 4096;
+// -record fills inputRecorder and saves it on exit. -replay steps every frame by the recording's timestep with its
+// input in place of the live input, then closes the window and reports the frame times.
+static std::unique_ptr<InputRecording> inputRecorder;
+static std::string inputRecordingPath;
+static std::unique_ptr<InputRecording> inputReplay;
+static uint32_t inputReplayFrame = 0;
+static std::string frameTimesPath;
+static std::vector<float> replayFrameMilliseconds;
 
 // camera
-static XMFLOAT3 cameraPos = { 0.f, 0.f, -5.f };
-static XMFLOAT3 cameraUp = { 0.f, 1.f, 0.f };
-static float cameraYaw = 90.f;
-static float cameraPitch = 0.f;
-static float cameraLookSensitivity = 10.f;
-static bool cameraInvertVerticalLook = false;
-static float cameraSpeed = 5.f;
+static FlyCamera camera;
+static uint32_t cameraMoveFlags = 0;
+static_assert(FlyCamera::lookButton == MOUSEBUTTON_RIGHTMOUSEBUTTON, "FlyCamera expects the right mouse button");
+static_assert(FlyCamera::mouseXAxis == MOUSE_X_AXIS && FlyCamera::mouseYAxis == MOUSE_Y_AXIS,
+	"FlyCamera expects the mouse axes of InputDefinitions.h");
 
 // model
 static std::string textureFilepath = "Assets/checkerTexture.png";
-static std::array<std::unique_ptr<Model>, 3> sphereModels;
+static std::unique_ptr<Model> sphereModel;
 static std::unique_ptr<Model> floorModel;
 
+// scene objects
+// Objects 0-2 are the spheres and object 3 is the floor. Each object draws the mesh given by its mesh ID.
+static const uint32_t numObjects = 4;
+static const uint32_t numSpheres = 3;
+static const uint32_t sphereMeshID = 0;
+static const uint32_t floorMeshID = 1;
+static const std::array<uint32_t, numObjects> objectMeshIDs = { sphereMeshID, sphereMeshID, sphereMeshID, floorMeshID };
+static std::array<Model*, 2> meshes = {};
+// bindless IDs, written into each object's instance data
+static uint32_t objectTextureID = 0;
+static std::array<uint32_t, 2> meshVertexBufferIDs = {};
+static std::array<uint32_t, 2> meshIndexBufferIDs = {};
+// scene BVH, culling and batching, the same steps FrameRenderer runs for the headless reference frame
+static std::unique_ptr<SceneVisibility> sceneVisibility;
+static CullingSystem::Settings cullingSettings;
+
+// raytracing hit groups
+// Every BLAS geometry owns one hit group record per ray type, matching the geometry multiplier passed to TraceRay.
+static const uint32_t numRayTypes = 2;
+// first hit group record of each mesh, one per ray type for each of its submeshes
+static std::array<uint32_t, 2> meshHitGroupOffsets = {};
+
 // directional light
 struct DirectionalLight
 {
@@ -64,21 +128,6 @@ struct DirectionalLight
 	float padding3 = 0.f;
 };
 
-static void AddCameraPitch(const float amount, const float min, const float max)
-{
-	cameraPitch += amount;
-	
-	if (cameraPitch > max)
-		cameraPitch = max;
-	if (cameraPitch < min)
-		cameraPitch = min;
-}
-
-static void AddCameraYaw(const float amount)
-{
-	cameraYaw += amount;
-}
-
 // graphics
 static ComPtr<IDXGIAdapter1> adapter;
 static ComPtr<ID3D12Device5> device;
@@ -95,16 +144,134 @@ static D3D12_VIEWPORT viewport = {};
 static D3D12_RECT scissorRect = {};
 static const float clearColor[4] = { 1.0f, 0.0f, 1.0f, 1.0f };
 static std::unique_ptr<Fence> initializationFence;
-static std::unique_ptr<DescriptorHeap> shaderDescriptorHeap;
-
+static std::unique_ptr<DescriptorHeapAllocator> shaderDescriptorHeap;
+static const uint32_t numPersistentDescriptors = 4096;
+static const uint32_t numTransientDescriptorsPerFrame = 256;
+static std::unique_ptr<BindlessDescriptorTable> bindlessTable;
+static const uint32_t bindlessCapacityPerType = 1024;
+// scene and shadow g-buffer SRVs, bound as one table by the final pass
+static DescriptorHandle gbufferDescriptors;
+// TLAS SRV, shadow output UAV, the two ambient occlusion history UAVs and the surface UAV, bound as one table by the
+// raytracing shaders
+static DescriptorHandle raytracingDescriptors;
+// shadow output, surface, shadow history and a-trous buffer UAVs, bound as one table by the shadow denoiser
+static DescriptorHandle denoiserDescriptors;
+// display surface SRV, then shadow output, surface and upsampled shadow UAVs, bound as one table by the upsampler
+static DescriptorHandle upsamplerDescriptors;
+static D3D12_GPU_DESCRIPTOR_HANDLE raytracingDescriptorTable = {};
+static DescriptorHandle imguiFontDescriptor;
+static uint64_t frameNumber = 0;
+static std::unique_ptr<DynamicUploadHeap> uploadHeap;
+
+static std::unique_ptr<PipelineCache> pipelineCache;
+static std::unique_ptr<PipelineRegistry> pipelineRegistry;
 static std::unique_ptr<Shader> vertexShader;
-static std::unique_ptr<Shader> pixelShader;
 static std::unique_ptr<InputLayout> inputLayout;
-static std::unique_ptr<RootSignature> rootSignature;
-static std::unique_ptr<GraphicsPipelineState> graphicsPipeline;
+static std::shared_ptr<RootSignature> rootSignature;
+static std::shared_ptr<RootSignature> rtGlobalRootSignature;
+
+// Shader permutations. Pipelines are keyed by the mask of enabled features and created the first time it is selected.
+// Each remembers the content key of the shader it was built from, so hot reload can tell which ones an edit affects.
+static const char* rasterShaderPath = "ShaderSource/Shaders.hlsl";
+static const char* raytracingShaderPath = "ShaderSource/RaytracingShaders.hlsl";
+struct GraphicsPipeline
+{
+	std::shared_ptr<GraphicsPipelineState> State;
+	uint64_t PixelShaderKey = 0;
+};
+struct RaytracingPipeline
+{
+	ComPtr<ID3D12StateObject> StateObject;
+	std::unique_ptr<ShaderTable> Table;
+	std::shared_ptr<RootSignature> RayGenRootSignature;
+	std::shared_ptr<RootSignature> HitGroupRootSignature;
+	uint64_t LibraryKey = 0;
+};
+// A compute pipeline with a single fixed shader, rebuilt by hot reload with the same root signature when the shader no
+// longer matches its key.
+struct ComputePipeline
+{
+	const char* ShaderPath = nullptr;
+	const char* EntryPoint = nullptr;
+	std::shared_ptr<RootSignature> Signature;
+	std::shared_ptr<ComputePipelineState> State;
+	uint64_t ShaderKey = 0;
+};
+static std::unique_ptr<ShaderPermutationSet> rasterFeatures;
+static std::unique_ptr<ShaderPermutationSet> raytracingFeatures;
+static uint32_t rasterPermutation = 0;
+static uint32_t raytracingPermutation = 0;
+static std::unordered_map<uint32_t, GraphicsPipeline> graphicsPipelines;
+static std::unordered_map<uint32_t, std::unique_ptr<RaytracingPipeline>> raytracingPipelines;
+static uint64_t vertexShaderKey = 0;
+
+// The final pass composites the g-buffer onto the back buffer. It has no permutations, but hot reload rebuilds it the
+// same way, by the keys of the shaders it was built from.
+static const char* finalPassShaderPath = "ShaderSource/FinalPassShaders.hlsl";
+static std::shared_ptr<RootSignature> finalPassRootSignature;
+static std::unique_ptr<InputLayout> finalPassInputLayout;
+static std::shared_ptr<GraphicsPipelineState> finalPassPipeline;
+static uint64_t finalPassVertexShaderKey = 0;
+static uint64_t finalPassPixelShaderKey = 0;
+
+// shader hot reload
+struct ShaderReload
+{
+	std::unique_ptr<Shader> VertexShader;
+	uint64_t VertexShaderKey = 0;
+	std::vector<std::pair<uint32_t, GraphicsPipeline>> GraphicsPipelines;
+	std::vector<std::pair<uint32_t, std::unique_ptr<RaytracingPipeline>>> RaytracingPipelines;
+	std::shared_ptr<GraphicsPipelineState> FinalPassPipeline;
+	uint64_t FinalPassVertexShaderKey = 0;
+	uint64_t FinalPassPixelShaderKey = 0;
+	// indices into computePipelines
+	std::vector<std::pair<size_t, ComputePipeline>> ComputePipelines;
+};
+static std::unique_ptr<FileWatcher> shaderWatcher;
+static std::future<ShaderReload> shaderReload;
+static bool shaderReloadRequested = false;
 
-static ComPtr<ID3D12StateObject> rtPipelineState;
 static ComPtr<ID3D12Resource> RTShadowMapOutput;
+// ambient occlusion accumulated over frames, ping-ponged between the two
+static std::array<ComPtr<ID3D12Resource>, 2> aoHistory;
+static AmbientOcclusion::Settings aoSettings;
+// drops the ambient occlusion and shadow history next frame
+static bool resetHistory = true;
+
+// soft shadows
+// normal and camera distance of what each pixel sees, written by the raytracing pass to guide the denoiser
+static ComPtr<ID3D12Resource> surfaceOutput;
+// temporally accumulated shadows, ping-ponged between the two like the ambient occlusion history
+static std::array<ComPtr<ID3D12Resource>, 2> shadowHistory;
+// a-trous ping-pong buffers
+static std::array<ComPtr<ID3D12Resource>, 2> shadowDenoised;
+static std::shared_ptr<RootSignature> shadowDenoiserRootSignature;
+static ComputePipeline shadowTemporalPipeline;
+static ComputePipeline shadowATrousPipeline;
+static const uint32_t computeGroupSize = 8;
+static ShadowDenoiser::Settings shadowDenoiserSettings;
+static bool shadowDenoiserEnabled = true;
+static uint32_t shadowRaysPerPixel = 1;
+// angular radius of the light, in degrees
+static float lightConeAngle = 2.f;
+
+// reduced resolution tracing
+// Shadows and ambient occlusion are traced at traceResolution and upsampled to the display when it is not Full.
+// Changes are applied at the start of the next frame, since they recreate the raytracing outputs.
+static ShadowUpsampler::TraceResolution traceResolution = ShadowUpsampler::TraceResolution::Full;
+static ShadowUpsampler::TraceResolution requestedTraceResolution = traceResolution;
+static ShadowUpsampler::Settings upsamplerSettings;
+// normal and camera distance of each display pixel, written by the raster pass as its second render target
+static ComPtr<ID3D12Resource> displaySurfaceGBuffer;
+static const float displaySurfaceClearValue[4] = { 0.f, 0.f, 0.f, -1.f };
+// traced shadows and ambient occlusion at display resolution
+static ComPtr<ID3D12Resource> upsampledShadows;
+static std::shared_ptr<RootSignature> shadowUpsamplerRootSignature;
+static ComputePipeline shadowUpsamplerPipeline;
+
+// compute pipelines checked by shader hot reload
+static const std::array<ComputePipeline*, 3> computePipelines = { &shadowTemporalPipeline, &shadowATrousPipeline,
+	&shadowUpsamplerPipeline };
 
 // GBuffer
 static ComPtr<ID3D12Resource> sceneTextureGBuffer;
@@ -114,23 +281,50 @@ struct PerFrameConstantBuffer
 {
 	XMFLOAT4X4 ViewProjection;
 	DirectionalLight Light;
+	XMFLOAT4 CameraPosition;
 };
-static std::unique_ptr<DynamicConstantBuffer> perFrameDynamicConstantBuffer;
 static PerFrameConstantBuffer perFrameData = {};
 
 struct PerObjectConstantBuffer
 {
 	XMFLOAT4X4 World;
 	XMFLOAT4X4 WorldInvTranspose;
+	uint32_t TextureID = 0;
+	uint32_t VertexBufferID = 0;
+	uint32_t IndexBufferID = 0;
+	uint32_t padding = 0;
 };
-static std::unique_ptr<DynamicConstantBuffer> perObjectDynamicConstantBuffer;
-static std::array<PerObjectConstantBuffer, 4> objectData;
+static std::unique_ptr<TransformSystem> transforms;
+// Animates the spheres at a fixed step on its own thread; the render loop only blends its latest two steps into
+// transforms. Replays advance it by the recording's timestep on the render thread instead, so they stay reproducible.
+static std::unique_ptr<Simulation> simulation;
 
 struct RTPerFrameConstantBuffer
 {
 	XMFLOAT4X4 inverseView;
 	XMFLOAT4X4 inverseProjection;
 	XMFLOAT4 lightDirection = { 0.6f, -1.0f, 1.0f, 0.f };
+	XMFLOAT4X4 previousViewProjection;
+	XMFLOAT4 previousCameraPosition;
+	uint32_t frameIndex = 0;
+	uint32_t aoRaysPerPixel = 0;
+	float aoRadius = 0.f;
+	uint32_t aoMaxHistory = 0;
+	uint32_t resetHistory = 0;
+	uint32_t shadowRaysPerPixel = 0;
+	float lightConeCosAngle = 1.f;
+	float shadowTemporalAlpha = 0.f;
+	float shadowVarianceClipGamma = 0.f;
+	float shadowMinimumClipSigma = 0.f;
+	float shadowDepthSigma = 0.f;
+	uint32_t shadowNormalSharpness = 0;
+	float shadowVisibilitySigma = 0.f;
+	uint32_t displayWidth = 0;
+	uint32_t displayHeight = 0;
+	uint32_t traceScale = 1;
+	uint32_t checkerboard = 0;
+	float upsampleDepthSigma = 0.f;
+	uint32_t upsampleNormalSharpness = 0;
 };
 static std::unique_ptr<DynamicConstantBuffer> rtPerFrameDynamicConstantBuffer;
 static RTPerFrameConstantBuffer rtPerFrameData = {};
@@ -160,9 +354,34 @@ static void InitializeGBuffer(const uint32_t width, const uint32_t height)
 		nullptr,
 		IID_PPV_ARGS(&sceneTextureGBuffer));
 
-	// shadow map from raytrace pass.
+	displaySurfaceGBuffer.Reset();
+	auto displaySurfaceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height);
+	displaySurfaceDesc.MipLevels = 1;
+	displaySurfaceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+	device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&displaySurfaceDesc,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		&CD3DX12_CLEAR_VALUE(DXGI_FORMAT_R16G16B16A16_FLOAT, displaySurfaceClearValue),
+		IID_PPV_ARGS(&displaySurfaceGBuffer));
+
+	upsampledShadows.Reset();
+	auto upsampledShadowsDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height);
+	upsampledShadowsDesc.MipLevels = 1;
+	upsampledShadowsDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&upsampledShadowsDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(&upsampledShadows));
+
+	// shadow map from raytrace pass. It and everything else the raytracing pass and denoiser write is at the trace
+	// resolution.
+	const uint32_t traceWidth = ShadowUpsampler::GetTraceWidth(traceResolution, width);
+	const uint32_t traceHeight = ShadowUpsampler::GetTraceHeight(traceResolution, height);
 	RTShadowMapOutput.Reset();
-	auto shadowMapDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height);
+	auto shadowMapDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, traceWidth, traceHeight);
 	shadowMapDesc.MipLevels = 1;
 	shadowMapDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 	device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
@@ -182,6 +401,116 @@ static void InitializeGBuffer(const uint32_t width, const uint32_t height)
 		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
 		nullptr,
 		IID_PPV_ARGS(&shadowMapTextureGBuffer));
+
+	auto aoHistoryDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, traceWidth, traceHeight);
+	aoHistoryDesc.MipLevels = 1;
+	aoHistoryDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	for (auto& history : aoHistory)
+	{
+		history.Reset();
+		device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&aoHistoryDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&history));
+	}
+
+	surfaceOutput.Reset();
+	auto surfaceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, traceWidth, traceHeight);
+	surfaceDesc.MipLevels = 1;
+	surfaceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&surfaceDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(&surfaceOutput));
+
+	for (auto& history : shadowHistory)
+	{
+		history.Reset();
+		device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&aoHistoryDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&history));
+	}
+
+	auto shadowDenoisedDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16_FLOAT, traceWidth, traceHeight);
+	shadowDenoisedDesc.MipLevels = 1;
+	shadowDenoisedDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	for (auto& denoised : shadowDenoised)
+	{
+		denoised.Reset();
+		device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&shadowDenoisedDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&denoised));
+	}
+	resetHistory = true;
+}
+
+static void CreateGBufferViews()
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	device->CreateShaderResourceView(sceneTextureGBuffer.Get(), &srvDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(gbufferDescriptors, 0));
+
+	device->CreateShaderResourceView(shadowMapTextureGBuffer.Get(), &srvDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(gbufferDescriptors, 1));
+
+	srvDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	device->CreateShaderResourceView(displaySurfaceGBuffer.Get(), &srvDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(upsamplerDescriptors, 0));
+	// the display surface's RTV follows the back buffers'
+	device->CreateRenderTargetView(displaySurfaceGBuffer.Get(), nullptr,
+		CD3DX12_CPU_DESCRIPTOR_HANDLE(rtvHeap->GetCPUDescriptorHandleForHeapStart(), bufferCount,
+		device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV)));
+}
+
+static void CreateRaytracingOutputViews()
+{
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	device->CreateUnorderedAccessView(RTShadowMapOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(raytracingDescriptors, 1));
+	for (uint32_t i = 0; i < aoHistory.size(); i++)
+	{
+		device->CreateUnorderedAccessView(aoHistory[i].Get(), nullptr, &uavDesc,
+			shaderDescriptorHeap->GetCPUDescriptorHandle(raytracingDescriptors, 2 + i));
+	}
+	device->CreateUnorderedAccessView(surfaceOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(raytracingDescriptors, 4));
+
+	device->CreateUnorderedAccessView(RTShadowMapOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(denoiserDescriptors, 0));
+	device->CreateUnorderedAccessView(surfaceOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(denoiserDescriptors, 1));
+	for (uint32_t i = 0; i < shadowHistory.size(); i++)
+	{
+		device->CreateUnorderedAccessView(shadowHistory[i].Get(), nullptr, &uavDesc,
+			shaderDescriptorHeap->GetCPUDescriptorHandle(denoiserDescriptors, 2 + i));
+	}
+	for (uint32_t i = 0; i < shadowDenoised.size(); i++)
+	{
+		device->CreateUnorderedAccessView(shadowDenoised[i].Get(), nullptr, &uavDesc,
+			shaderDescriptorHeap->GetCPUDescriptorHandle(denoiserDescriptors, 4 + i));
+	}
+
+	device->CreateUnorderedAccessView(RTShadowMapOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(upsamplerDescriptors, 1));
+	device->CreateUnorderedAccessView(surfaceOutput.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(upsamplerDescriptors, 2));
+	device->CreateUnorderedAccessView(upsampledShadows.Get(), nullptr, &uavDesc,
+		shaderDescriptorHeap->GetCPUDescriptorHandle(upsamplerDescriptors, 3));
 }
 
 static void InputEventCallback(const InputEvent& event)
@@ -217,74 +546,109 @@ static void WindowResizedCallback(const uint32_t newWidth, const uint32_t newHei
 	scissorRect.bottom = static_cast<LONG>(newHeight);
 
 	InitializeGBuffer(newWidth, newHeight);
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	device->CreateShaderResourceView(sceneTextureGBuffer.Get(), &srvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(1));
-
-	device->CreateShaderResourceView(shadowMapTextureGBuffer.Get(), &srvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(2));
-
-	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	device->CreateUnorderedAccessView(RTShadowMapOutput.Get(), nullptr, &uavDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(4));
+	CreateGBufferViews();
+	CreateRaytracingOutputViews();
 }
 
-static void ProcessInputEventQueue(const float deltaSeconds)
+static void HandleInputEvent(const InputEvent& event, const float deltaSeconds)
 {
-	const int maxPending = inputEventQueue->GetMaxPending();
-	const int tail = inputEventQueue->GetTail();
-	for (int i = inputEventQueue->GetHead(); i != tail; i = (i + 1) % maxPending)
+	if (!event.consumed)
 	{
-		const auto& event = inputEventQueue->PopNextItem();
-		if (!event.consumed)
-		{
-			if (event.input == KEY_ESCAPE && event.data == 1.0f && !event.repeatKey)
-				window->Close();
+		if (event.input == KEY_ESCAPE && event.data == 1.0f && !event.repeatKey)
+			window->Close();
 
-			if (event.input == KEY_F && event.data == 1.0f && !event.repeatKey)
-				window->ToggleFullscreen();
+		if (event.input == KEY_F && event.data == 1.0f && !event.repeatKey)
+			window->ToggleFullscreen();
 
-			if (event.input == KEY_C && event.data == 1.0f && !event.repeatKey)
+		if (event.input == KEY_C && event.data == 1.0f && !event.repeatKey)
+		{
+			for (int i = 0; i < 5000; i++)
 			{
-				for (int i = 0; i < 5000; i++)
-				{
-					std::cout << std::endl;
-				}
+				std::cout << std::endl;
 			}
+		}
+	}
+	camera.HandleInputEvent(event, deltaSeconds);
+}
 
-			if (event.input == MOUSEBUTTON_RIGHTMOUSEBUTTON && event.data == 1.f)
-			{
-				rightMouseDown = true;
-			}
+static uint32_t GetCameraMoveFlags()
+{
+	static const std::array<std::pair<int, uint32_t>, 6> keys = { {
+		{ KEY_W, FlyCamera::MoveForward }, { KEY_S, FlyCamera::MoveBack }, { KEY_D, FlyCamera::MoveRight },
+		{ KEY_A, FlyCamera::MoveLeft }, { KEY_E, FlyCamera::MoveUp }, { KEY_Q, FlyCamera::MoveDown } } };
+	uint32_t flags = 0;
+	for (const auto& [key, flag] : keys)
+	{
+		if (Input::IsKeyDown(key))
+			flags |= flag;
+	}
+	return flags;
+}
 
-			if (event.input == MOUSEBUTTON_RIGHTMOUSEBUTTON && event.data == 0.f)
-			{
-				rightMouseDown = false;
-			}
+static void ReportReplayFrameTimes()
+{
+	if (!frameTimesPath.empty())
+	{
+		std::ofstream file(frameTimesPath);
+		file << "frame,milliseconds\n";
+		for (uint32_t i = 0; i < replayFrameMilliseconds.size(); i++)
+			file << i << "," << replayFrameMilliseconds[i] << "\n";
+	}
 
-			if (rightMouseDown)
-			{
-				if (event.input == MOUSE_X_AXIS && !event.consumed)
-				{
-					float delta = cameraInvertVerticalLook ? event.data : -event.data;
-					AddCameraYaw(delta *cameraLookSensitivity * deltaSeconds);
-				}
-
-				if (event.input == MOUSE_Y_AXIS && !event.consumed)
-				{
-					float delta = cameraInvertVerticalLook ? event.data : -event.data;
-					AddCameraPitch(delta * cameraLookSensitivity * deltaSeconds, -89.9f, 89.9f);
-				}
-			}
+	std::vector<float> sorted = replayFrameMilliseconds;
+	std::sort(sorted.begin(), sorted.end());
+	if (sorted.empty())
+		return;
+	double total = 0.0;
+	for (const float milliseconds : sorted)
+		total += milliseconds;
+	std::cout << "Replayed " << inputReplay->GetNumFrames() << " frames at a " << inputReplay->GetTimestep() * 1000.f <<
+		" ms step. Frame time average " << total / sorted.size() << " ms, median " << sorted[sorted.size() / 2] <<
+		" ms, 99th percentile " << sorted[sorted.size() * 99 / 100] << " ms, max " << sorted.back() << " ms" << std::endl;
+}
+
+// Handles this frame's input: the live events and keys, recorded when recording, or the next recorded frame when
+// replaying. Live input during a replay is dropped apart from Escape, so a run can still be cut short.
+static void ProcessInputEventQueue(const float deltaSeconds)
+{
+	PROFILE_SCOPE("Input");
+	if (inputReplay)
+	{
+		inputEventQueue->Drain([](const InputEvent& event, const MPSCQueue<InputEvent>::Clock::time_point)
+		{
+			if (event.input == KEY_ESCAPE && event.data == 1.0f && !event.repeatKey)
+				window->Close();
+		});
+		if (inputReplayFrame == inputReplay->GetNumFrames())
+		{
+			window->Close();
+			return;
 		}
+		const InputRecording::Frame& frame = inputReplay->GetFrame(inputReplayFrame++);
+		cameraMoveFlags = frame.KeyState;
+		for (uint32_t i = frame.FirstEvent; i < frame.FirstEvent + frame.NumEvents; i++)
+		{
+			HandleInputEvent(inputReplay->GetEvent(i).Input, deltaSeconds);
+		}
+		return;
 	}
+
+	cameraMoveFlags = GetCameraMoveFlags();
+	if (inputRecorder)
+		inputRecorder->BeginFrame(cameraMoveFlags);
+	inputEventQueue->Drain([deltaSeconds](const InputEvent& event,
+		const MPSCQueue<InputEvent>::Clock::time_point timestamp)
+	{
+		if (inputRecorder)
+			inputRecorder->AddEvent(event, timestamp);
+		HandleInputEvent(event, deltaSeconds);
+	});
 }
 
 static void ProcessMesh(aiMesh* mesh, const aiScene* scene, Model* const model)
 {
+	model->BeginSubmesh(mesh->mMaterialIndex);
+
 	for (uint32_t i = 0; i < mesh->mNumVertices; i++)
 	{
 		Vertex vert = {};
@@ -318,6 +682,8 @@ static void ProcessMesh(aiMesh* mesh, const aiScene* scene, Model* const model)
 			model->PushBackIndex(face.mIndices[j]);
 		}
 	}
+
+	model->EndSubmesh();
 }
 
 static void ProcessNode(aiNode* node, const aiScene* scene, Model* const model)
@@ -346,26 +712,589 @@ static void LoadModel(Model* const model, const std::string& filepath)
 	ProcessNode(scene->mRootNode, scene, model);
 }
 
+static void DrawModel(ID3D12GraphicsCommandList4* const commandList, const Model* const model, const uint32_t instanceCount)
+{
+	for (const auto& submesh : model->GetSubmeshes())
+	{
+		commandList->DrawIndexedInstanced(submesh.IndexCount, instanceCount, submesh.IndexOffset,
+			static_cast<INT>(submesh.VertexOffset), 0);
+	}
+}
+
+static void WriteObjectData(PerObjectConstantBuffer& data, const uint32_t objectIndex)
+{
+	memcpy(&data.World, transforms->GetWorldMatrix(objectIndex), sizeof(XMFLOAT4X4));
+	memcpy(&data.WorldInvTranspose, transforms->GetWorldInverseTransposeMatrix(objectIndex), sizeof(XMFLOAT4X4));
+	data.TextureID = objectTextureID;
+	data.VertexBufferID = meshVertexBufferIDs[objectMeshIDs[objectIndex]];
+	data.IndexBufferID = meshIndexBufferIDs[objectMeshIDs[objectIndex]];
+}
+
 std::unique_ptr<TopLevelAccelerationStructure> sceneAccelerationStructure;
 void BuildSceneAccelerationStructure()
 {
-	sceneAccelerationStructure->SetInstance(0, 0, sphereModels[0]->GetWorldMatrix(), 0xFF, D3D12_RAYTRACING_INSTANCE_FLAG_NONE,
-		sphereModels[0]->GetBottomLevelAccelerationStructureGPUVirtualAddress());
-	sceneAccelerationStructure->SetInstance(1, 0, sphereModels[1]->GetWorldMatrix(), 0xFF, D3D12_RAYTRACING_INSTANCE_FLAG_NONE,
-		sphereModels[0]->GetBottomLevelAccelerationStructureGPUVirtualAddress());
-	sceneAccelerationStructure->SetInstance(2, 0, sphereModels[2]->GetWorldMatrix(), 0xFF, D3D12_RAYTRACING_INSTANCE_FLAG_NONE,
-		sphereModels[0]->GetBottomLevelAccelerationStructureGPUVirtualAddress());
-	sceneAccelerationStructure->SetInstance(3, 0, floorModel->GetWorldMatrix(), 0xFF, D3D12_RAYTRACING_INSTANCE_FLAG_NONE,
-		floorModel->GetBottomLevelAccelerationStructureGPUVirtualAddress());
+	PROFILE_SCOPE("Scene acceleration structure");
+	SceneVisibility::UpdateInstances(*transforms, objectMeshIDs.data(), numObjects, numObjects,
+		[](const uint32_t slot, const uint32_t meshID, const float* const transform, const uint8_t mask)
+	{
+		sceneAccelerationStructure->SetInstance(slot, meshHitGroupOffsets[meshID], transform, mask,
+			D3D12_RAYTRACING_INSTANCE_FLAG_NONE,
+			meshes[meshID]->GetBottomLevelAccelerationStructureGPUVirtualAddress());
+	});
+}
+
+static std::shared_ptr<GraphicsPipelineState> CreateGraphicsPipeline(const Shader& vertex, const Shader& pixel)
+{
+	std::unique_ptr<GraphicsPipelineState> description = std::make_unique<GraphicsPipelineState>();
+	description->SetInputLayout(inputLayout->GetInterfacePtr());
+	description->SetRootSignature(*rootSignature);
+	description->SetVertexShader(vertex.BufferLength(), vertex.BufferPointer());
+	description->SetPixelShader(pixel.BufferLength(), pixel.BufferPointer());
+	description->SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+	description->SetRTVFormats(1, DXGI_FORMAT_R8G8B8A8_UNORM);
+	description->SetRTVFormat(1, DXGI_FORMAT_R16G16B16A16_FLOAT);
+	description->SetDSVFormat(DXGI_FORMAT_D32_FLOAT);
+	description->SetSampleDesc(window->GetSwapChainSampleDesc());
+	description->SetSampleMask(0xffffffff);
+	description->SetRasterizerState(RasterizerState::BackCulling);
+	description->SetDepthStencilState(DepthStencilState::Default);
+	description->SetBlendState(BlendState::Opaque);
+	description->SetNumRenderTargets(2);
+	return pipelineRegistry->GetGraphicsPipelineState(std::move(description));
+}
+
+static std::shared_ptr<GraphicsPipelineState> CreateFinalPassPipeline(const Shader& vertex, const Shader& pixel)
+{
+	std::unique_ptr<GraphicsPipelineState> description = std::make_unique<GraphicsPipelineState>();
+	description->SetInputLayout(finalPassInputLayout->GetInterfacePtr());
+	description->SetRootSignature(*finalPassRootSignature);
+	description->SetVertexShader(vertex.BufferLength(), vertex.BufferPointer());
+	description->SetPixelShader(pixel.BufferLength(), pixel.BufferPointer());
+	description->SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+	description->SetRTVFormats(1, DXGI_FORMAT_R8G8B8A8_UNORM);
+	description->SetDSVFormat(DXGI_FORMAT_D32_FLOAT);
+	description->SetSampleDesc(window->GetSwapChainSampleDesc());
+	description->SetSampleMask(0xffffffff);
+	description->SetRasterizerState(RasterizerState::BackCulling);
+	description->SetDepthStencilState(DepthStencilState::None);
+	description->SetBlendState(BlendState::Opaque);
+	description->SetNumRenderTargets(1);
+	return pipelineRegistry->GetGraphicsPipelineState(std::move(description));
+}
+
+static std::shared_ptr<ComputePipelineState> CreateComputePipeline(const RootSignature& rootSignature,
+	const Shader& shader)
+{
+	std::unique_ptr<ComputePipelineState> description = std::make_unique<ComputePipelineState>();
+	description->SetRootSignature(rootSignature);
+	description->SetComputeShader(shader.BufferLength(), shader.BufferPointer());
+	return pipelineRegistry->GetComputePipelineState(std::move(description));
+}
+
+static void InitializeComputePipeline(ComputePipeline& pipeline, const char* const shaderPath,
+	const char* const entryPoint, std::shared_ptr<RootSignature> signature)
+{
+	pipeline.ShaderPath = shaderPath;
+	pipeline.EntryPoint = entryPoint;
+	pipeline.Signature = std::move(signature);
+	Shader shader;
+	shader.FXCCompile(std::filesystem::path(shaderPath).c_str(), entryPoint, "cs_5_1", pipelineCache.get());
+	pipeline.State = CreateComputePipeline(*pipeline.Signature, shader);
+	pipeline.ShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, shaderPath, entryPoint, "cs_5_1", {});
+}
+
+static GraphicsPipelineState* GetGraphicsPipeline(const uint32_t permutation)
+{
+	GraphicsPipeline& pipeline = graphicsPipelines[permutation];
+	if (pipeline.State)
+		return pipeline.State.get();
+
+	const std::vector<ShaderDefine> defines = rasterFeatures->GetDefines(permutation);
+	Shader pixelShader;
+	pixelShader.FXCCompile(std::filesystem::path(rasterShaderPath).c_str(), "pixel", "ps_5_1", pipelineCache.get(), defines);
+	pipeline.State = CreateGraphicsPipeline(*vertexShader, pixelShader);
+	pipeline.PixelShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, rasterShaderPath, "pixel", "ps_5_1", defines);
+	return pipeline.State.get();
+}
+
+// Builds the state object and its shader table. Only reads state that is fixed after startup, so hot reload calls it from
+// its background thread.
+static std::unique_ptr<RaytracingPipeline> CreateRaytracingPipeline(const Shader& library)
+{
+	std::unique_ptr<RaytracingPipeline> pipeline = std::make_unique<RaytracingPipeline>();
+
+	CD3DX12_STATE_OBJECT_DESC rtpsoDesc = {};
+	rtpsoDesc.SetStateObjectType(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE);
+
+	const WCHAR* hitGroupExportName = L"HitGroup";
+	const WCHAR* shadowHitGroupExportName = L"ShadowHitGroup";
+
+	const WCHAR* rayGenExportName = L"RayGen";
+	const WCHAR* missExportName = L"Miss";
+	const WCHAR* closestHitExportName = L"ClosestHit";
+	const WCHAR* shadowMissExportName = L"ShadowMiss";
+	const WCHAR* shadowClosestHitExportName = L"ShadowClosestHit";
+	const WCHAR* exports[] = { rayGenExportName, missExportName, closestHitExportName, shadowMissExportName, 
+		shadowClosestHitExportName };
+	CD3DX12_DXIL_LIBRARY_SUBOBJECT dxilLibSubobject;
+	dxilLibSubobject.SetDXILLibrary(&CD3DX12_SHADER_BYTECODE(library.BufferPointer(), library.BufferLength()));
+	dxilLibSubobject.DefineExports<_countof(exports)>(exports);
+	dxilLibSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_HIT_GROUP_SUBOBJECT hitGroupSubobject;
+	hitGroupSubobject.SetIntersectionShaderImport(nullptr);
+	hitGroupSubobject.SetAnyHitShaderImport(nullptr);
+	hitGroupSubobject.SetClosestHitShaderImport(closestHitExportName);
+	hitGroupSubobject.SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+	hitGroupSubobject.SetHitGroupExport(hitGroupExportName);
+	hitGroupSubobject.AddToStateObject(rtpsoDesc);
+
+	std::unique_ptr<RootSignature> hitGroupRootSig = std::make_unique<RootSignature>();
+	hitGroupRootSig->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	hitGroupRootSig->AddRootDescriptorTableParameter({
+		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
+		}, D3D12_SHADER_VISIBILITY_ALL);
+	// the geometry's index and vertex offsets into its model's buffers
+	hitGroupRootSig->AddRootConstantsParameter(2, 1, 0, D3D12_SHADER_VISIBILITY_ALL);
+	hitGroupRootSig->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
+	pipeline->HitGroupRootSignature = pipelineRegistry->GetRootSignature(std::move(hitGroupRootSig));
+	CD3DX12_LOCAL_ROOT_SIGNATURE_SUBOBJECT hitGroupLocalRootSigSubobject;
+	hitGroupLocalRootSigSubobject.SetRootSignature(pipeline->HitGroupRootSignature->GetInterfacePtr());
+	hitGroupLocalRootSigSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_SUBOBJECT_TO_EXPORTS_ASSOCIATION_SUBOBJECT hitGroupAssociationSubobject;
+	hitGroupAssociationSubobject.AddExport(hitGroupExportName);
+	hitGroupAssociationSubobject.SetSubobjectToAssociate(hitGroupLocalRootSigSubobject);
+	hitGroupAssociationSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_HIT_GROUP_SUBOBJECT shadowHitGroupSubobject;
+	shadowHitGroupSubobject.SetIntersectionShaderImport(nullptr);
+	shadowHitGroupSubobject.SetAnyHitShaderImport(nullptr);
+	shadowHitGroupSubobject.SetClosestHitShaderImport(shadowClosestHitExportName);
+	shadowHitGroupSubobject.SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
+	shadowHitGroupSubobject.SetHitGroupExport(shadowHitGroupExportName);
+	shadowHitGroupSubobject.AddToStateObject(rtpsoDesc);
+
+	// color, normal and hit distance of the primary ray
+	UINT payloadSize = sizeof(float) * 7;
+	UINT attributeSize = sizeof(float) * 2;
+	CD3DX12_RAYTRACING_SHADER_CONFIG_SUBOBJECT rtShaderConfigSubobject;
+	rtShaderConfigSubobject.Config(payloadSize, attributeSize);
+	rtShaderConfigSubobject.AddToStateObject(rtpsoDesc);
+
+	std::unique_ptr<RootSignature> rayGenRootSig = std::make_unique<RootSignature>();
+	rayGenRootSig->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	rayGenRootSig->AddRootDescriptorTableParameter({
+		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND},
+		{D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 4, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
+		}, D3D12_SHADER_VISIBILITY_ALL);
+	rayGenRootSig->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
+	pipeline->RayGenRootSignature = pipelineRegistry->GetRootSignature(std::move(rayGenRootSig));
+	CD3DX12_LOCAL_ROOT_SIGNATURE_SUBOBJECT rayGenLocalRootSigSubobject;
+	rayGenLocalRootSigSubobject.SetRootSignature(pipeline->RayGenRootSignature->GetInterfacePtr());
+	rayGenLocalRootSigSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_SUBOBJECT_TO_EXPORTS_ASSOCIATION_SUBOBJECT rayGenAssociationSubobject;
+	rayGenAssociationSubobject.AddExport(rayGenExportName);
+	rayGenAssociationSubobject.SetSubobjectToAssociate(rayGenLocalRootSigSubobject);
+	rayGenAssociationSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT globalRootSigSubobject;
+	globalRootSigSubobject.SetRootSignature(rtGlobalRootSignature->GetInterfacePtr());
+	globalRootSigSubobject.AddToStateObject(rtpsoDesc);
+
+	CD3DX12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT rtPipelineConfigSubobject;
+	UINT traceRecursionDepth = 2;
+	rtPipelineConfigSubobject.Config(traceRecursionDepth);
+	rtPipelineConfigSubobject.AddToStateObject(rtpsoDesc);
+
+	HRESULT hr = device->CreateStateObject(rtpsoDesc, IID_PPV_ARGS(&pipeline->StateObject));
+	assert(SUCCEEDED(hr));
+
+	// -- shader table
+	const D3D12_GPU_VIRTUAL_ADDRESS perFrameConstants = rtPerFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(0, 0);
+	pipeline->Table = std::make_unique<ShaderTable>();
+	ShaderTable& table = *pipeline->Table;
+	table.AddRecord(ShaderRecordType::RayGen, rayGenExportName, pipeline->RayGenRootSignature.get());
+	table.AddRecord(ShaderRecordType::Miss, missExportName);
+	table.AddRecord(ShaderRecordType::Miss, shadowMissExportName);
+	for (uint32_t meshID = 0; meshID < meshes.size(); meshID++)
+	{
+		const uint32_t firstRecord = table.AddHitGroupRecords(meshes[meshID]->GetNumSubmeshes(),
+			{ hitGroupExportName, shadowHitGroupExportName }, { pipeline->HitGroupRootSignature.get(), nullptr });
+		assert(firstRecord == meshHitGroupOffsets[meshID]);
+	}
+	table.Create(device.Get(), pipeline->StateObject.Get());
+
+	table.SetRootDescriptor(ShaderRecordType::RayGen, 0, 0, perFrameConstants);
+	table.SetRootDescriptorTable(ShaderRecordType::RayGen, 0, 1, raytracingDescriptorTable);
+	for (uint32_t meshID = 0; meshID < meshes.size(); meshID++)
+	{
+		const auto& submeshes = meshes[meshID]->GetSubmeshes();
+		for (uint32_t i = 0; i < submeshes.size(); i++)
+		{
+			// the primary ray's hit group; the shadow ray's record that follows takes no arguments
+			const uint32_t record = meshHitGroupOffsets[meshID] + i * numRayTypes;
+			const uint32_t geometryOffsets[] = { submeshes[i].IndexOffset, submeshes[i].VertexOffset };
+			table.SetRootDescriptor(ShaderRecordType::HitGroup, record, 0, perFrameConstants);
+			table.SetRootDescriptorTable(ShaderRecordType::HitGroup, record, 1, raytracingDescriptorTable);
+			table.SetRootConstants(ShaderRecordType::HitGroup, record, 2, geometryOffsets, _countof(geometryOffsets));
+		}
+	}
+	table.Update();
+
+	return pipeline;
+}
+
+static RaytracingPipeline* GetRaytracingPipeline(const uint32_t permutation)
+{
+	std::unique_ptr<RaytracingPipeline>& pipeline = raytracingPipelines[permutation];
+	if (pipeline)
+		return pipeline.get();
+
+	const std::vector<ShaderDefine> defines = raytracingFeatures->GetDefines(permutation);
+	Shader rtShaderLib;
+	rtShaderLib.DXCCompile(std::filesystem::path(raytracingShaderPath).c_str(), L"", L"lib_6_3", pipelineCache.get(),
+		defines);
+	pipeline = CreateRaytracingPipeline(rtShaderLib);
+	pipeline->LibraryKey = Shader::ComputeKey(ShaderCompiler::DXC, raytracingShaderPath, "", "lib_6_3", defines);
+	return pipeline.get();
+}
+
+// Rebuilds every pipeline whose shader sources no longer match the key it was built from. Runs on a background thread
+// while frames keep rendering with the current pipelines. Shaders that fail to compile are reported and left as they are.
+static ShaderReload ReloadShaders(const uint64_t currentVertexShaderKey,
+	std::vector<std::pair<uint32_t, uint64_t>> pixelShaderKeys, std::vector<std::pair<uint32_t, uint64_t>> libraryKeys,
+	const uint64_t currentFinalPassVertexShaderKey, const uint64_t currentFinalPassPixelShaderKey,
+	std::vector<ComputePipeline> currentComputePipelines)
+{
+	ShaderReload reload;
+
+	const Shader* vertex = vertexShader.get();
+	const uint64_t newVertexShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, rasterShaderPath, "vertex", "vs_5_1", {});
+	if (newVertexShaderKey != currentVertexShaderKey)
+	{
+		std::unique_ptr<Shader> shader = std::make_unique<Shader>();
+		std::string errors;
+		if (shader->TryCompile(ShaderCompiler::FXC, rasterShaderPath, "vertex", "vs_5_1", pipelineCache.get(), {}, errors))
+		{
+			reload.VertexShader = std::move(shader);
+			reload.VertexShaderKey = newVertexShaderKey;
+			vertex = reload.VertexShader.get();
+		}
+		else
+		{
+			std::cout << errors << std::endl;
+		}
+	}
+
+	for (const auto& [permutation, currentKey] : pixelShaderKeys)
+	{
+		const std::vector<ShaderDefine> defines = rasterFeatures->GetDefines(permutation);
+		const uint64_t key = Shader::ComputeKey(ShaderCompiler::FXC, rasterShaderPath, "pixel", "ps_5_1", defines);
+		if (key == currentKey && !reload.VertexShader)
+			continue;
+
+		Shader pixelShader;
+		std::string errors;
+		if (!pixelShader.TryCompile(ShaderCompiler::FXC, rasterShaderPath, "pixel", "ps_5_1", pipelineCache.get(), defines,
+			errors))
+		{
+			std::cout << errors << std::endl;
+			continue;
+		}
+		reload.GraphicsPipelines.push_back({ permutation, { CreateGraphicsPipeline(*vertex, pixelShader), key } });
+	}
+
+	for (const auto& [permutation, currentKey] : libraryKeys)
+	{
+		const std::vector<ShaderDefine> defines = raytracingFeatures->GetDefines(permutation);
+		const uint64_t key = Shader::ComputeKey(ShaderCompiler::DXC, raytracingShaderPath, "", "lib_6_3", defines);
+		if (key == currentKey)
+			continue;
+
+		Shader library;
+		std::string errors;
+		if (!library.TryCompile(ShaderCompiler::DXC, raytracingShaderPath, "", "lib_6_3", pipelineCache.get(), defines, errors))
+		{
+			std::cout << errors << std::endl;
+			continue;
+		}
+		std::unique_ptr<RaytracingPipeline> pipeline = CreateRaytracingPipeline(library);
+		pipeline->LibraryKey = key;
+		reload.RaytracingPipelines.push_back({ permutation, std::move(pipeline) });
+	}
+
+	const uint64_t finalPassVertexKey =
+		Shader::ComputeKey(ShaderCompiler::FXC, finalPassShaderPath, "vertex", "vs_5_1", {});
+	const uint64_t finalPassPixelKey = Shader::ComputeKey(ShaderCompiler::FXC, finalPassShaderPath, "pixel", "ps_5_1", {});
+	if (finalPassVertexKey != currentFinalPassVertexShaderKey || finalPassPixelKey != currentFinalPassPixelShaderKey)
+	{
+		Shader finalPassVertex;
+		Shader finalPassPixel;
+		std::string errors;
+		if (finalPassVertex.TryCompile(ShaderCompiler::FXC, finalPassShaderPath, "vertex", "vs_5_1", pipelineCache.get(),
+			{}, errors) && finalPassPixel.TryCompile(ShaderCompiler::FXC, finalPassShaderPath, "pixel", "ps_5_1",
+			pipelineCache.get(), {}, errors))
+		{
+			reload.FinalPassPipeline = CreateFinalPassPipeline(finalPassVertex, finalPassPixel);
+			reload.FinalPassVertexShaderKey = finalPassVertexKey;
+			reload.FinalPassPixelShaderKey = finalPassPixelKey;
+		}
+		else
+		{
+			std::cout << errors << std::endl;
+		}
+	}
+
+	for (size_t i = 0; i < currentComputePipelines.size(); i++)
+	{
+		const ComputePipeline& current = currentComputePipelines[i];
+		const uint64_t key =
+			Shader::ComputeKey(ShaderCompiler::FXC, current.ShaderPath, current.EntryPoint, "cs_5_1", {});
+		if (key == current.ShaderKey)
+			continue;
+
+		Shader shader;
+		std::string errors;
+		if (!shader.TryCompile(ShaderCompiler::FXC, current.ShaderPath, current.EntryPoint, "cs_5_1",
+			pipelineCache.get(), {}, errors))
+		{
+			std::cout << errors << std::endl;
+			continue;
+		}
+		ComputePipeline pipeline = current;
+		pipeline.State = CreateComputePipeline(*pipeline.Signature, shader);
+		pipeline.ShaderKey = key;
+		reload.ComputePipelines.push_back({ i, std::move(pipeline) });
+	}
+
+	return reload;
+}
+
+static void StartShaderReload()
+{
+	std::vector<std::pair<uint32_t, uint64_t>> pixelShaderKeys;
+	for (const auto& [permutation, pipeline] : graphicsPipelines)
+	{
+		pixelShaderKeys.push_back({ permutation, pipeline.PixelShaderKey });
+	}
+	std::vector<std::pair<uint32_t, uint64_t>> libraryKeys;
+	for (const auto& [permutation, pipeline] : raytracingPipelines)
+	{
+		libraryKeys.push_back({ permutation, pipeline->LibraryKey });
+	}
+	std::vector<ComputePipeline> currentComputePipelines;
+	for (const ComputePipeline* const pipeline : computePipelines)
+	{
+		currentComputePipelines.push_back(*pipeline);
+	}
+	shaderReload = std::async(std::launch::async, ReloadShaders, vertexShaderKey, std::move(pixelShaderKeys),
+		std::move(libraryKeys), finalPassVertexShaderKey, finalPassPixelShaderKey, std::move(currentComputePipelines));
+}
+
+// Must only run between frames, once the GPU is done with the pipelines being replaced.
+static void ApplyShaderReload(ShaderReload reload)
+{
+	const size_t numRasterPipelines = reload.GraphicsPipelines.size() + (reload.FinalPassPipeline ? 1 : 0);
+	if (reload.VertexShader)
+	{
+		vertexShader = std::move(reload.VertexShader);
+		vertexShaderKey = reload.VertexShaderKey;
+	}
+	for (auto& [permutation, pipeline] : reload.GraphicsPipelines)
+	{
+		graphicsPipelines[permutation] = std::move(pipeline);
+	}
+	for (auto& [permutation, pipeline] : reload.RaytracingPipelines)
+	{
+		raytracingPipelines[permutation] = std::move(pipeline);
+	}
+	if (reload.FinalPassPipeline)
+	{
+		finalPassPipeline = std::move(reload.FinalPassPipeline);
+		finalPassVertexShaderKey = reload.FinalPassVertexShaderKey;
+		finalPassPixelShaderKey = reload.FinalPassPixelShaderKey;
+	}
+	for (auto& [index, pipeline] : reload.ComputePipelines)
+	{
+		*computePipelines[index] = std::move(pipeline);
+	}
+	pipelineRegistry->Trim();
+
+	std::cout << "Reloaded " << numRasterPipelines << " raster, " << reload.ComputePipelines.size() <<
+		" compute and " << reload.RaytracingPipelines.size() << " raytracing pipelines" << std::endl;
+}
+
+static void ShowFeatureCheckboxes(const char* const label, const ShaderPermutationSet& features, uint32_t& permutation)
+{
+	ImGui::PushID(label);
+	ImGui::Text("%s", label);
+	for (uint32_t i = 0; i < features.GetNumFeatures(); i++)
+	{
+		ImGui::CheckboxFlags(features.GetFeatureName(i).c_str(), &permutation, 1u << i);
+	}
+	ImGui::PopID();
+}
+
+// The frame that last had its GPU ranges read back, which is the one this back buffer was last used for: a row per
+// nesting level under each track, on the frame's time axis.
+static void ShowProfiler()
+{
+	Profiler::Frame frame;
+	if (!Profiler::GetFrame(bufferCount - 1, frame))
+		return;
+	Profiler::Collect(frame.Begin, frame.End, profilerTracks);
+
+	ImGui::Begin("Profiler");
+	ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(frame.Index), (frame.End - frame.Begin) * 1e-6);
+	ImDrawList* const drawList = ImGui::GetWindowDrawList();
+	const float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	const double pixelsPerNanosecond = width / static_cast<double>(std::max(frame.End - frame.Begin, int64_t(1)));
+	for (const Profiler::Track& track : profilerTracks)
+	{
+		if (track.Events.empty())
+			continue;
+		ImGui::Text("%s", track.Name.c_str());
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		uint32_t maxDepth = 0;
+		for (const Profiler::Event& event : track.Events)
+		{
+			maxDepth = std::max(maxDepth, event.Depth);
+			const float x0 = origin.x + static_cast<float>(std::max(event.Begin - frame.Begin, int64_t(0)) *
+				pixelsPerNanosecond);
+			const float x1 = origin.x + static_cast<float>(std::min(event.End - frame.Begin, frame.End - frame.Begin) *
+				pixelsPerNanosecond);
+			const ImVec2 min(x0, origin.y + event.Depth * rowHeight);
+			const ImVec2 max(std::max(x1, x0 + 1.f), min.y + rowHeight - 1.f);
+			const float hue = static_cast<float>(std::hash<std::string>()(event.Name) % 360) / 360.f;
+			drawList->AddRectFilled(min, max, ImColor::HSV(hue, 0.5f, 0.6f));
+			drawList->PushClipRect(min, max, true);
+			drawList->AddText(ImVec2(min.x + 2.f, min.y), IM_COL32_WHITE, event.Name);
+			drawList->PopClipRect();
+			if (ImGui::IsMouseHoveringRect(min, max))
+				ImGui::SetTooltip("%s: %.3f ms", event.Name, (event.End - event.Begin) * 1e-6);
+		}
+		ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+	}
+	ImGui::End();
+}
+
+// The project is built with /arch:AVX2, so the CPU must support AVX2 and the OS must save the YMM registers.
+static bool IsAVX2Supported()
+{
+	int info[4] = {};
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+// Splits the command line like a console program's argv, in UTF-8.
+static std::vector<std::string> GetCommandLineArguments(PCWSTR commandLine)
+{
+	int numArguments = 0;
+	LPWSTR* const wideArguments = CommandLineToArgvW(commandLine, &numArguments);
+	std::vector<std::string> arguments;
+	for (int i = 0; i < numArguments; i++)
+	{
+		const int length = WideCharToMultiByte(CP_UTF8, 0, wideArguments[i], -1, nullptr, 0, nullptr, nullptr);
+		std::string argument(std::max(length, 1) - 1, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, wideArguments[i], -1, argument.data(), length, nullptr, nullptr);
+		arguments.push_back(std::move(argument));
+	}
+	LocalFree(wideArguments);
+	return arguments;
 }
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
+	if (!IsAVX2Supported())
+	{
+		MessageBoxW(nullptr, L"This program requires a CPU with AVX2.", L"Unsupported CPU", MB_OK | MB_ICONERROR);
+		return -1;
+	}
+
+	// Offline shader build, run from the post-build step. Compiles everything in the manifest that changed into
+	// ShaderBinary and exits with the number of failures.
+	if (pCmdLine && wcsstr(pCmdLine, L"-buildshaders"))
+	{
+		ShaderBuilder shaderBuilder;
+		if (!shaderBuilder.LoadManifest("ShaderSource/Shaders.manifest"))
+			return -1;
+		const uint32_t numFailed = shaderBuilder.Build("ShaderBinary");
+		shaderBuilder.Prune("ShaderBinary");
+		return static_cast<int>(numFailed);
+	}
+
+	// Renders a reference frame of the demo scene without a window through a RenderBackend and prints timings, see
+	// Headless.h. It is not the frame the window renders.
+	if (pCmdLine && wcsstr(pCmdLine, L"-headless"))
+	{
+		Console::RedirectIOToConsole();
+		const int result = Headless::Run(GetCommandLineArguments(pCmdLine));
+		Console::ReleaseConsole();
+		return result;
+	}
+
+	// Times the CPU side systems on synthetic data, see Benchmark.h.
+	if (pCmdLine && wcsstr(pCmdLine, L"-benchmark"))
+	{
+		Console::RedirectIOToConsole();
+		const int result = Benchmark::Run(GetCommandLineArguments(pCmdLine));
+		Console::ReleaseConsole();
+		return result;
+	}
+
 #ifdef _DEBUG
 	Console::RedirectIOToConsole();
 #endif
 
-	inputEventQueue = std::make_unique<Queue<InputEvent>>(maxPendingInputEvents);
+	// Input recording for reproducible runs, see InputRecording.h. -record file saves this run's input, -replay file
+	// flies a saved one and prints its frame times, also written as CSV to the -frametimes file when given.
+	const std::vector<std::string> arguments = pCmdLine && *pCmdLine ? GetCommandLineArguments(pCmdLine) :
+		std::vector<std::string>();
+	for (size_t i = 0; i + 1 < arguments.size(); i++)
+	{
+		if (arguments[i] == "-record")
+		{
+			inputRecorder = std::make_unique<InputRecording>();
+			inputRecordingPath = arguments[++i];
+		}
+		else if (arguments[i] == "-replay")
+		{
+#ifndef _DEBUG
+			Console::RedirectIOToConsole();
+#endif
+			inputReplay = std::make_unique<InputRecording>();
+			if (!inputReplay->Load(arguments[++i]))
+			{
+				std::cout << "Could not load input recording " << arguments[i] << std::endl;
+				return -1;
+			}
+		}
+		else if (arguments[i] == "-frametimes")
+		{
+			frameTimesPath = arguments[++i];
+		}
+		else if (arguments[i] == "-trace")
+		{
+			tracePath = arguments[++i];
+		}
+	}
+
+	Profiler::SetThreadName("Main");
+	jobSystem = std::make_unique<JobSystem>();
+	jobSystem->Initialize();
+	Profiler::ProfileJobs(*jobSystem);
+	inputEventQueue = std::make_unique<MPSCQueue<InputEvent>>(maxPendingInputEvents);
 
 	window = std::make_unique<Window>();
 	window->Initialize(L"Game window", false);
@@ -382,9 +1311,12 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	device = Direct3D::CreateDevice(adapter.Get());
 	graphicsQueue = Direct3D::CreateCommandQueue(device.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT);
 	window->CreateSwapChain(bufferCount, graphicsQueue.Get());
+	gpuProfiler = std::make_unique<GpuProfiler>();
+	gpuProfiler->Initialize(device.Get(), graphicsQueue.Get(), bufferCount);
 	
 	rtvHeap = std::make_unique<DescriptorHeap>();
-	rtvHeap->Initialize(device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, bufferCount, false);
+	// the back buffers, then the display surface
+	rtvHeap->Initialize(device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, bufferCount + 1, false);
 	Direct3D::CreateRenderTargetsForWindow(device.Get(), window.get(), bufferCount, rtvHeap->GetCPUDescriptorHandleForHeapStart(),
 		renderTargets.data());
 	
@@ -423,24 +1355,42 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	scissorRect.right = static_cast<LONG>(window->GetClientWidth());
 	scissorRect.bottom = static_cast<LONG>(window->GetClientHeight());
 
+	pipelineCache = std::make_unique<PipelineCache>();
+	pipelineCache->Initialize("PipelineCache");
+	pipelineRegistry = std::make_unique<PipelineRegistry>();
+	pipelineRegistry->Initialize(device.Get(), pipelineCache.get());
+
+	// build descriptor heaps
+	shaderDescriptorHeap = std::make_unique<DescriptorHeapAllocator>();
+	shaderDescriptorHeap->Initialize(device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, numPersistentDescriptors,
+		numTransientDescriptorsPerFrame, bufferCount);
+	gbufferDescriptors = shaderDescriptorHeap->Allocate(2);
+	raytracingDescriptors = shaderDescriptorHeap->Allocate(5);
+	raytracingDescriptorTable = shaderDescriptorHeap->GetGPUDescriptorHandle(raytracingDescriptors);
+	denoiserDescriptors = shaderDescriptorHeap->Allocate(6);
+	upsamplerDescriptors = shaderDescriptorHeap->Allocate(4);
+	imguiFontDescriptor = shaderDescriptorHeap->Allocate(1);
+	bindlessTable = std::make_unique<BindlessDescriptorTable>();
+	bindlessTable->Initialize(shaderDescriptorHeap.get(), bindlessCapacityPerType);
+	auto bindlessRanges = bindlessTable->GetDescriptorRanges();
+
 	// build rasterization pipelines
-	rootSignature = std::make_unique<RootSignature>();
-	rootSignature->AddStaticSampler(SamplerType::LinearWrap, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
-	rootSignature->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
-	rootSignature->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
-	rootSignature->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
-	rootSignature->AddRootDescriptorTableParameter({
-		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
-		}, D3D12_SHADER_VISIBILITY_PIXEL);
-	rootSignature->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+	std::unique_ptr<RootSignature> rootSignatureDescription = std::make_unique<RootSignature>();
+	rootSignatureDescription->AddStaticSampler(SamplerType::LinearWrap, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	rootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	rootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootSignatureDescription->AddRootDescriptorTableParameter(bindlessRanges.data(),
+		static_cast<uint32_t>(bindlessRanges.size()), D3D12_SHADER_VISIBILITY_PIXEL);
+	rootSignatureDescription->AddRootConstantsParameter(1, 1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	rootSignatureDescription->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
-	rootSignature->Create(device.Get());
+	rootSignature = pipelineRegistry->GetRootSignature(std::move(rootSignatureDescription));
 	vertexShader = std::make_unique<Shader>();
-	vertexShader->FXCCompile(L"ShaderSource/Shaders.hlsl", "vertex", "vs_5_1");
-	pixelShader = std::make_unique<Shader>();
-	pixelShader->FXCCompile(L"ShaderSource/Shaders.hlsl", "pixel", "ps_5_1");
+	vertexShader->FXCCompile(std::filesystem::path(rasterShaderPath).c_str(), "vertex", "vs_5_1", pipelineCache.get());
+	vertexShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, rasterShaderPath, "vertex", "vs_5_1", {});
 	inputLayout = std::make_unique<InputLayout>();
 	inputLayout->AddInputElement("POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
 	inputLayout->AddInputElement("NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Norm),
@@ -448,41 +1398,66 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	inputLayout->AddInputElement("TEXTURECOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Vertex, Uv),
 		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
 	inputLayout->Create();
-	graphicsPipeline = std::make_unique<GraphicsPipelineState>();
-	graphicsPipeline->SetInputLayout(inputLayout->GetInterfacePtr());
-	graphicsPipeline->SetRootSignature(rootSignature->GetInterfacePtr());
-	graphicsPipeline->SetVertexShader(vertexShader->BufferLength(), vertexShader->BufferPointer());
-	graphicsPipeline->SetPixelShader(pixelShader->BufferLength(), pixelShader->BufferPointer());
-	graphicsPipeline->SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
-	graphicsPipeline->SetRTVFormats(1, DXGI_FORMAT_R8G8B8A8_UNORM);
-	graphicsPipeline->SetDSVFormat(DXGI_FORMAT_D32_FLOAT);
-	graphicsPipeline->SetSampleDesc(window->GetSwapChainSampleDesc());
-	graphicsPipeline->SetSampleMask(0xffffffff);
-	graphicsPipeline->SetRasterizerState(RasterizerState::BackCulling);
-	graphicsPipeline->SetDepthStencilState(DepthStencilState::Default);
-	graphicsPipeline->SetBlendState(BlendState::Opaque);
-	graphicsPipeline->SetNumRenderTargets(1);
-	graphicsPipeline->Create(device.Get());
+	rasterFeatures = std::make_unique<ShaderPermutationSet>();
+	rasterFeatures->LoadFeatures(rasterShaderPath);
+	rasterPermutation = rasterFeatures->GetAllFeaturesKey();
+	GetGraphicsPipeline(rasterPermutation);
+
+	// The model imports only fill in their own Model, so they run as jobs while this thread decodes the texture.
+	// Sphere model data is only being loaded for sphereModel[0]. Other sphere model's share the data from this instance.
+	sphereModel = std::make_unique<Model>();
+	floorModel = std::make_unique<Model>();
+	JobSystem::Counter modelImports = 0;
+	jobSystem->Run("Import Sphere.fbx", []() { LoadModel(sphereModel.get(), "Assets/Sphere.fbx"); }, &modelImports);
+	jobSystem->Run("Import floor.fbx", []() { LoadModel(floorModel.get(), "Assets/floor.fbx"); }, &modelImports);
 
 	std::unique_ptr<Texture2D> texture = std::make_unique<Texture2D>();
 	texture->Initialize(device.Get(), textureFilepath);
 	texture->StageData(texture->GetData());
+	jobSystem->Wait(modelImports);
 
-	// Sphere model data is only being loaded for sphereModel[0]. Other sphere model's share the data from this instance.
-	sphereModels[0] = std::make_unique<Model>();
-	LoadModel(sphereModels[0].get(), "Assets/Sphere.fbx");
-	sphereModels[0]->Initialize(device.Get());
-	sphereModels[0]->Stage(device.Get());
-	sphereModels[1] = std::make_unique<Model>();
-	sphereModels[1]->SetPosition(-2.2f, 0.f, 0.f);
-	sphereModels[2] = std::make_unique<Model>();
-	sphereModels[2]->SetPosition(2.2f, 0.f, 0.f);
+	sphereModel->Initialize(device.Get());
+	sphereModel->Stage(device.Get());
 
-	floorModel = std::make_unique<Model>();
-	LoadModel(floorModel.get(), "Assets/floor.fbx");
 	floorModel->Initialize(device.Get());
 	floorModel->Stage(device.Get());
 
+	meshes[sphereMeshID] = sphereModel.get();
+	meshes[floorMeshID] = floorModel.get();
+	sceneVisibility = std::make_unique<SceneVisibility>();
+	for (uint32_t i = 0; i < meshes.size(); i++)
+	{
+		// submesh indices are relative to the submesh's first vertex
+		std::vector<uint32_t> occluderIndices;
+		for (const Submesh& submesh : meshes[i]->GetSubmeshes())
+		{
+			for (uint32_t index = submesh.IndexOffset; index < submesh.IndexOffset + submesh.IndexCount; index++)
+				occluderIndices.push_back(submesh.VertexOffset + meshes[i]->GetIndices()[index]);
+		}
+		sceneVisibility->SetMesh(i, meshes[i]->GetVertices().data(), meshes[i]->GetNumVertices(), sizeof(Vertex),
+			occluderIndices.data(), static_cast<uint32_t>(occluderIndices.size()));
+	}
+
+	// objects start with the same 90 degree pitch that models default to
+	transforms = std::make_unique<TransformSystem>();
+	transforms->Resize(numObjects);
+	for (uint32_t i = 0; i < numObjects; i++)
+	{
+		transforms->SetRotation(i, XMConvertToRadians(90.f), 0.f, 0.f);
+	}
+	transforms->SetPosition(1, -2.2f, 0.f, 0.f);
+	transforms->SetPosition(2, 2.2f, 0.f, 0.f);
+	transforms->Update();
+	simulation = std::make_unique<Simulation>();
+	simulation->Initialize(*transforms, numSpheres);
+
+	uint32_t numHitGroupRecords = 0;
+	for (uint32_t i = 0; i < meshes.size(); i++)
+	{
+		meshHitGroupOffsets[i] = numHitGroupRecords;
+		numHitGroupRecords += meshes[i]->GetNumSubmeshes() * numRayTypes;
+	}
+
 	sceneAccelerationStructure = std::make_unique<TopLevelAccelerationStructure>();
 	sceneAccelerationStructure->Initialize(device.Get(), 4, true);
 	BuildSceneAccelerationStructure();
@@ -501,41 +1476,31 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	screenQuadIndices.push_back(1);
 	screenQuadIndices.push_back(3);
 
-	std::unique_ptr<RootSignature> FinalPassRootSignature = std::make_unique<RootSignature>();
-	FinalPassRootSignature->AddStaticSampler(SamplerType::LinearWrap, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
-	FinalPassRootSignature->AddRootDescriptorTableParameter({
+	std::unique_ptr<RootSignature> finalPassRootSignatureDescription = std::make_unique<RootSignature>();
+	finalPassRootSignatureDescription->AddStaticSampler(SamplerType::LinearWrap, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+	finalPassRootSignatureDescription->AddRootDescriptorTableParameter({
 		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
 		}, D3D12_SHADER_VISIBILITY_PIXEL);
-	FinalPassRootSignature->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+	finalPassRootSignatureDescription->SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
-	FinalPassRootSignature->Create(device.Get());
-	std::unique_ptr<Shader> FinalPassVertexShader = std::make_unique<Shader>();
-	FinalPassVertexShader->FXCCompile(L"ShaderSource/FinalPassShaders.hlsl", "vertex", "vs_5_1");
-	std::unique_ptr<Shader> FinalPassPixelShader = std::make_unique<Shader>();
-	FinalPassPixelShader->FXCCompile(L"ShaderSource/FinalPassShaders.hlsl", "pixel", "ps_5_1");
-	std::unique_ptr<InputLayout> FinalPassInputLayout = std::make_unique<InputLayout>();
-	FinalPassInputLayout->AddInputElement("POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
-	FinalPassInputLayout->AddInputElement("TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(ScreenQuadVertex, UV),
+	finalPassRootSignature = pipelineRegistry->GetRootSignature(std::move(finalPassRootSignatureDescription));
+	finalPassInputLayout = std::make_unique<InputLayout>();
+	finalPassInputLayout->AddInputElement("POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
+	finalPassInputLayout->AddInputElement("TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(ScreenQuadVertex, UV),
 		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0);
-	FinalPassInputLayout->Create();
-	std::unique_ptr<GraphicsPipelineState> FinalPassGraphicsPipeline = std::make_unique<GraphicsPipelineState>();
-	FinalPassGraphicsPipeline->SetInputLayout(FinalPassInputLayout->GetInterfacePtr());
-	FinalPassGraphicsPipeline->SetRootSignature(FinalPassRootSignature->GetInterfacePtr());
-	FinalPassGraphicsPipeline->SetVertexShader(FinalPassVertexShader->BufferLength(), FinalPassVertexShader->BufferPointer());
-	FinalPassGraphicsPipeline->SetPixelShader(FinalPassPixelShader->BufferLength(), FinalPassPixelShader->BufferPointer());
-	FinalPassGraphicsPipeline->SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
-	FinalPassGraphicsPipeline->SetRTVFormats(1, DXGI_FORMAT_R8G8B8A8_UNORM);
-	FinalPassGraphicsPipeline->SetDSVFormat(DXGI_FORMAT_D32_FLOAT);
-	FinalPassGraphicsPipeline->SetSampleDesc(window->GetSwapChainSampleDesc());
-	FinalPassGraphicsPipeline->SetSampleMask(0xffffffff);
-	FinalPassGraphicsPipeline->SetRasterizerState(RasterizerState::BackCulling);
-	FinalPassGraphicsPipeline->SetDepthStencilState(DepthStencilState::None);
-	FinalPassGraphicsPipeline->SetBlendState(BlendState::Opaque);
-	FinalPassGraphicsPipeline->SetNumRenderTargets(1);
-	FinalPassGraphicsPipeline->Create(device.Get());
+	finalPassInputLayout->Create();
+	Shader finalPassVertexShader;
+	finalPassVertexShader.FXCCompile(std::filesystem::path(finalPassShaderPath).c_str(), "vertex", "vs_5_1",
+		pipelineCache.get());
+	Shader finalPassPixelShader;
+	finalPassPixelShader.FXCCompile(std::filesystem::path(finalPassShaderPath).c_str(), "pixel", "ps_5_1",
+		pipelineCache.get());
+	finalPassPipeline = CreateFinalPassPipeline(finalPassVertexShader, finalPassPixelShader);
+	finalPassVertexShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, finalPassShaderPath, "vertex", "vs_5_1", {});
+	finalPassPixelShaderKey = Shader::ComputeKey(ShaderCompiler::FXC, finalPassShaderPath, "pixel", "ps_5_1", {});
 
 	std::unique_ptr<StaticVertexBuffer> screenQuadVertexBuffer = std::make_unique<StaticVertexBuffer>();
 	screenQuadVertexBuffer->Initialize(device.Get(), static_cast<uint32_t>(sizeof(ScreenQuadVertex) * screenQuadVertices.size()),
@@ -545,43 +1510,33 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	screenQuadIndexBuffer->Initialize(device.Get(), static_cast<uint32_t>(sizeof(DWORD) * screenQuadIndices.size()));
 	screenQuadIndexBuffer->StageData(screenQuadIndices.data());
 
-	perFrameDynamicConstantBuffer = std::make_unique<DynamicConstantBuffer>();
-	perFrameDynamicConstantBuffer->Initialize(device.Get(), ALIGN_TO(sizeof(PerFrameConstantBuffer), _64KB), bufferCount, 1);
+	uploadHeap = std::make_unique<DynamicUploadHeap>();
+	uploadHeap->Initialize(device.Get(), _64KB, bufferCount);
 
+	// The raytracing constants are referenced from the shader table so they keep a fixed slot.
 	rtPerFrameDynamicConstantBuffer = std::make_unique<DynamicConstantBuffer>();
-	rtPerFrameDynamicConstantBuffer->Initialize(device.Get(), ALIGN_TO(sizeof(RTPerFrameConstantBuffer), _64KB), bufferCount, 1);
-
-	perObjectDynamicConstantBuffer = std::make_unique<DynamicConstantBuffer>();
-	perObjectDynamicConstantBuffer->Initialize(device.Get(), ALIGN_TO(sizeof(PerObjectConstantBuffer), _64KB), bufferCount, 4);
+	rtPerFrameDynamicConstantBuffer->Initialize(device.Get(), sizeof(RTPerFrameConstantBuffer), bufferCount, 1);
 
 	InitializeGBuffer(window->GetClientWidth(), window->GetClientHeight());
 
-	// build descriptor heaps
-	const uint32_t numDescriptors = 6;
-	shaderDescriptorHeap = std::make_unique<DescriptorHeap>();
-	shaderDescriptorHeap->Initialize(device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, numDescriptors, true);
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = texture->GetFormat();
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	device->CreateShaderResourceView(texture->GetResource(), &srvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(0));
-
-	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	device->CreateShaderResourceView(sceneTextureGBuffer.Get(), &srvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(1));
+	// fill descriptor heaps
+	objectTextureID = bindlessTable->AddTexture(device.Get(), texture->GetResource(), texture->GetFormat());
+	for (uint32_t i = 0; i < meshes.size(); i++)
+	{
+		meshVertexBufferIDs[i] = bindlessTable->AddVertexBuffer(device.Get(), meshes[i]->GetVertexBuffer()->GetResource(),
+			meshes[i]->GetNumVertices(), sizeof(Vertex));
+		meshIndexBufferIDs[i] = bindlessTable->AddIndexBuffer(device.Get(), meshes[i]->GetIndexBuffer()->GetResource(),
+			meshes[i]->GetNumIndices());
+	}
 
-	device->CreateShaderResourceView(shadowMapTextureGBuffer.Get(), &srvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(2));
+	CreateGBufferViews();
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC asSrvDesc = {};
 	asSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
 	asSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	asSrvDesc.RaytracingAccelerationStructure.Location = sceneAccelerationStructure->GetGPUVirtualAddress();
-	device->CreateShaderResourceView(nullptr, &asSrvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(3));
-
-	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-	device->CreateUnorderedAccessView(RTShadowMapOutput.Get(), nullptr, &uavDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(4));
+	device->CreateShaderResourceView(nullptr, &asSrvDesc, shaderDescriptorHeap->GetCPUDescriptorHandle(raytracingDescriptors, 0));
+	CreateRaytracingOutputViews();
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -590,146 +1545,59 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	ImGui_ImplWin32_Init(window->GetHWND());
 	ImGui_ImplDX12_Init(device.Get(), bufferCount,
 		DXGI_FORMAT_R8G8B8A8_UNORM, shaderDescriptorHeap->GetInterfacePtr(),
-		shaderDescriptorHeap->GetCPUDescriptorHandle(shaderDescriptorHeap->GetNumDescriptors() - 1),
-		shaderDescriptorHeap->GetGPUDescriptorHandle(shaderDescriptorHeap->GetNumDescriptors() - 1));
+		shaderDescriptorHeap->GetCPUDescriptorHandle(imguiFontDescriptor),
+		shaderDescriptorHeap->GetGPUDescriptorHandle(imguiFontDescriptor));
 
 	// build raytracing pipeline
-	std::unique_ptr<Shader> rtShaderLib = std::make_unique<Shader>();
-	rtShaderLib->DXCCompile(L"ShaderSource/RaytracingShaders.hlsl", L"", L"lib_6_3");
-
-	CD3DX12_STATE_OBJECT_DESC rtpsoDesc = {};
-	rtpsoDesc.SetStateObjectType(D3D12_STATE_OBJECT_TYPE_RAYTRACING_PIPELINE);
-
-	const WCHAR* hitGroupExportName = L"HitGroup";
-	const WCHAR* shadowHitGroupExportName = L"ShadowHitGroup";
-
-	const WCHAR* rayGenExportName = L"RayGen";
-	const WCHAR* missExportName = L"Miss";
-	const WCHAR* closestHitExportName = L"ClosestHit";
-	const WCHAR* shadowMissExportName = L"ShadowMiss";
-	const WCHAR* shadowClosestHitExportName = L"ShadowClosestHit";
-	const WCHAR* exports[] = { rayGenExportName, missExportName, closestHitExportName, shadowMissExportName, 
-		shadowClosestHitExportName };
-	CD3DX12_DXIL_LIBRARY_SUBOBJECT dxilLibSubobject;
-	dxilLibSubobject.SetDXILLibrary(&CD3DX12_SHADER_BYTECODE(rtShaderLib->BufferPointer(), rtShaderLib->BufferLength()));
-	dxilLibSubobject.DefineExports<_countof(exports)>(exports);
-	dxilLibSubobject.AddToStateObject(rtpsoDesc);
-
-	CD3DX12_HIT_GROUP_SUBOBJECT hitGroupSubobject;
-	hitGroupSubobject.SetIntersectionShaderImport(nullptr);
-	hitGroupSubobject.SetAnyHitShaderImport(nullptr);
-	hitGroupSubobject.SetClosestHitShaderImport(closestHitExportName);
-	hitGroupSubobject.SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
-	hitGroupSubobject.SetHitGroupExport(hitGroupExportName);
-	hitGroupSubobject.AddToStateObject(rtpsoDesc);
-
-	RootSignature hitGroupRootSig;
-	hitGroupRootSig.AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
-	hitGroupRootSig.AddRootDescriptorTableParameter({
-		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
+	std::unique_ptr<RootSignature> rtGlobalRootSignatureDescription = std::make_unique<RootSignature>();
+	rtGlobalRootSignatureDescription->AddRootDescriptorTableParameter(bindlessRanges.data(),
+		static_cast<uint32_t>(bindlessRanges.size()), D3D12_SHADER_VISIBILITY_ALL);
+	rtGlobalRootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1, 0,
+		D3D12_SHADER_VISIBILITY_ALL);
+	rtGlobalRootSignature = pipelineRegistry->GetRootSignature(std::move(rtGlobalRootSignatureDescription));
+
+	raytracingFeatures = std::make_unique<ShaderPermutationSet>();
+	raytracingFeatures->LoadFeatures(raytracingShaderPath);
+	raytracingPermutation = raytracingFeatures->GetAllFeaturesKey();
+	GetRaytracingPipeline(raytracingPermutation);
+	const uint32_t softShadowFeatures = raytracingFeatures->GetFeatureBit("SHADOWS") |
+		raytracingFeatures->GetFeatureBit("SOFT_SHADOWS");
+
+	// shadow denoiser, reading the raytracing pass's constants
+	std::unique_ptr<RootSignature> shadowDenoiserRootSignatureDescription = std::make_unique<RootSignature>();
+	shadowDenoiserRootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0,
+		D3D12_SHADER_VISIBILITY_ALL);
+	// a-trous step size, source buffer and whether it is the last pass
+	shadowDenoiserRootSignatureDescription->AddRootConstantsParameter(3, 1, 0, D3D12_SHADER_VISIBILITY_ALL);
+	shadowDenoiserRootSignatureDescription->AddRootDescriptorTableParameter({
+		{D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 6, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
 		}, D3D12_SHADER_VISIBILITY_ALL);
-	hitGroupRootSig.SetFlags(D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
-	hitGroupRootSig.Create(device.Get());
-	CD3DX12_LOCAL_ROOT_SIGNATURE_SUBOBJECT hitGroupLocalRootSigSubobject;
-	hitGroupLocalRootSigSubobject.SetRootSignature(hitGroupRootSig.GetInterfacePtr());
-	hitGroupLocalRootSigSubobject.AddToStateObject(rtpsoDesc);
-
-	CD3DX12_SUBOBJECT_TO_EXPORTS_ASSOCIATION_SUBOBJECT hitGroupAssociationSubobject;
-	hitGroupAssociationSubobject.AddExport(hitGroupExportName);
-	hitGroupAssociationSubobject.SetSubobjectToAssociate(hitGroupLocalRootSigSubobject);
-	hitGroupAssociationSubobject.AddToStateObject(rtpsoDesc);
-
-	CD3DX12_HIT_GROUP_SUBOBJECT shadowHitGroupSubobject;
-	shadowHitGroupSubobject.SetIntersectionShaderImport(nullptr);
-	shadowHitGroupSubobject.SetAnyHitShaderImport(nullptr);
-	shadowHitGroupSubobject.SetClosestHitShaderImport(shadowClosestHitExportName);
-	shadowHitGroupSubobject.SetHitGroupType(D3D12_HIT_GROUP_TYPE_TRIANGLES);
-	shadowHitGroupSubobject.SetHitGroupExport(shadowHitGroupExportName);
-	shadowHitGroupSubobject.AddToStateObject(rtpsoDesc);
-
-	UINT payloadSize = sizeof(float) * 3;
-	UINT attributeSize = sizeof(float) * 2;
-	CD3DX12_RAYTRACING_SHADER_CONFIG_SUBOBJECT rtShaderConfigSubobject;
-	rtShaderConfigSubobject.Config(payloadSize, attributeSize);
-	rtShaderConfigSubobject.AddToStateObject(rtpsoDesc);
-
-	RootSignature rayGenRootSig;
-	rayGenRootSig.AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
-	rayGenRootSig.AddRootDescriptorTableParameter({
+	shadowDenoiserRootSignature = pipelineRegistry->GetRootSignature(std::move(shadowDenoiserRootSignatureDescription));
+	InitializeComputePipeline(shadowTemporalPipeline, "ShaderSource/ShadowDenoiser.hlsl", "temporal",
+		shadowDenoiserRootSignature);
+	InitializeComputePipeline(shadowATrousPipeline, "ShaderSource/ShadowDenoiser.hlsl", "atrous",
+		shadowDenoiserRootSignature);
+
+	std::unique_ptr<RootSignature> shadowUpsamplerRootSignatureDescription = std::make_unique<RootSignature>();
+	shadowUpsamplerRootSignatureDescription->AddRootDescriptorParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, 0, 0,
+		D3D12_SHADER_VISIBILITY_ALL);
+	shadowUpsamplerRootSignatureDescription->AddRootDescriptorTableParameter({
 		{D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND},
-		{D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
+		{D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}
 		}, D3D12_SHADER_VISIBILITY_ALL);
-	rayGenRootSig.SetFlags(D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
-	rayGenRootSig.Create(device.Get());
-	CD3DX12_LOCAL_ROOT_SIGNATURE_SUBOBJECT rayGenLocalRootSigSubobject;
-	rayGenLocalRootSigSubobject.SetRootSignature(rayGenRootSig.GetInterfacePtr());
-	rayGenLocalRootSigSubobject.AddToStateObject(rtpsoDesc);
+	shadowUpsamplerRootSignature = pipelineRegistry->GetRootSignature(std::move(shadowUpsamplerRootSignatureDescription));
+	InitializeComputePipeline(shadowUpsamplerPipeline, "ShaderSource/ShadowUpsampler.hlsl", "upsample",
+		shadowUpsamplerRootSignature);
 
-	CD3DX12_SUBOBJECT_TO_EXPORTS_ASSOCIATION_SUBOBJECT rayGenAssociationSubobject;
-	rayGenAssociationSubobject.AddExport(rayGenExportName);
-	rayGenAssociationSubobject.SetSubobjectToAssociate(rayGenLocalRootSigSubobject);
-	rayGenAssociationSubobject.AddToStateObject(rtpsoDesc);
+	shaderWatcher = std::make_unique<FileWatcher>();
+	shaderWatcher->Start("ShaderSource", std::chrono::milliseconds(250));
 
-	RootSignature globalRootSig;
-	globalRootSig.Create(device.Get());
-	CD3DX12_GLOBAL_ROOT_SIGNATURE_SUBOBJECT globalRootSigSubobject;
-	globalRootSigSubobject.SetRootSignature(globalRootSig.GetInterfacePtr());
-	globalRootSigSubobject.AddToStateObject(rtpsoDesc);
-
-	CD3DX12_RAYTRACING_PIPELINE_CONFIG_SUBOBJECT rtPipelineConfigSubobject;
-	UINT traceRecursionDepth = 2;
-	rtPipelineConfigSubobject.Config(traceRecursionDepth);
-	rtPipelineConfigSubobject.AddToStateObject(rtpsoDesc);
-
-	device->CreateStateObject(rtpsoDesc, IID_PPV_ARGS(&rtPipelineState));
-
-	// -- shader table
-	ComPtr<ID3D12StateObjectProperties> rtPipelineStateProps;
-	HRESULT hr = rtPipelineState->QueryInterface(IID_PPV_ARGS(&rtPipelineStateProps));
-	assert(SUCCEEDED(hr));
-
-	uint32_t numShaderRecords = 5;
-	uint32_t shaderIDSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-	uint32_t shaderRecordSize = shaderIDSize + 8 + 8; // shader id size + root descriptor size + descriptor table size
-	shaderRecordSize = ALIGN_TO(shaderRecordSize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
-	uint32_t shaderTableSize = shaderRecordSize * numShaderRecords;
-
-	ComPtr<ID3D12Resource> shaderTableBuffer;
-	device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(shaderTableSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&shaderTableBuffer));
-	uint8_t* tableData;
-	shaderTableBuffer->Map(0, nullptr, (void**)&tableData);
-
-	// 0
-	memcpy(tableData, rtPipelineStateProps->GetShaderIdentifier(rayGenExportName), shaderIDSize);
-	*(D3D12_GPU_VIRTUAL_ADDRESS*)(tableData + shaderIDSize) = rtPerFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(0, 0);
-	*(uint64_t*)(tableData + shaderIDSize + 8) = shaderDescriptorHeap->GetGPUDescriptorHandle(3).ptr;
-
-	// 1
-	memcpy(tableData + shaderRecordSize, rtPipelineStateProps->GetShaderIdentifier(missExportName), shaderIDSize);
-
-	// 2
-	memcpy(tableData + shaderRecordSize * 2, rtPipelineStateProps->GetShaderIdentifier(shadowMissExportName), shaderIDSize);
-
-	// 3
-	memcpy(tableData + shaderRecordSize * 3, rtPipelineStateProps->GetShaderIdentifier(hitGroupExportName), shaderIDSize);
-	*(D3D12_GPU_VIRTUAL_ADDRESS*)((tableData + shaderRecordSize * 3) + shaderIDSize) = 
-		rtPerFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(0, 0);
-	*(uint64_t*)((tableData + shaderRecordSize * 3) + shaderIDSize + 8) = shaderDescriptorHeap->GetGPUDescriptorHandle(3).ptr;
-
-	// 4
-	memcpy(tableData + shaderRecordSize * 4, rtPipelineStateProps->GetShaderIdentifier(shadowHitGroupExportName), shaderIDSize);
-
-	hr = graphicsCommandAllocators[0]->Reset();
+	HRESULT hr = graphicsCommandAllocators[0]->Reset();
 	assert(SUCCEEDED(hr));
 	hr = graphicsCommandList->Reset(graphicsCommandAllocators[0].Get(), nullptr);
 	assert(SUCCEEDED(hr));
 
-	sphereModels[0]->Commit(graphicsCommandList.Get());
+	sphereModel->Commit(graphicsCommandList.Get());
 	floorModel->Commit(graphicsCommandList.Get());
 	texture->CommitStagedData(graphicsCommandList.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 	screenQuadVertexBuffer->CommitStagedData(graphicsCommandList.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
@@ -743,7 +1611,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	Direct3D::SignalFenceOnGPU(initializationFence->GetInterfacePtr(), graphicsQueue.Get(), initializationFence->Value());
 
 	Direct3D::WaitForFenceValueOnCPU(initializationFence->GetInterfacePtr(), initializationFence->Value(), fenceEvent);
-	sphereModels[0]->StagingComplete();
+	sphereModel->StagingComplete();
 	floorModel->StagingComplete();
 	texture->StagingComplete();
 	texture->ReleaseData();
@@ -754,16 +1622,23 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 	bool running = true;
 	auto rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 	ID3D12DescriptorHeap* descriptorHeaps[] = { shaderDescriptorHeap->GetInterfacePtr() };
-	bool leftSphereTranslatePlus = false;
-	bool rightSphereTranslatePlus = true;
+	if (!inputReplay)
+		simulation->Start();
 	while (running)
 	{
+		Profiler::BeginFrame();
 		static std::chrono::high_resolution_clock clock;
 		static auto startTime = clock.now();
 		auto currentTime = clock.now();
 		auto frameTime = currentTime - startTime;
 		startTime = currentTime;
 		float frameTimeDeltaSeconds = frameTime.count() * 1e-9f;
+		if (inputReplay)
+		{
+			if (inputReplayFrame > 0)
+				replayFrameMilliseconds.push_back(frameTime.count() * 1e-6f);
+			frameTimeDeltaSeconds = inputReplay->GetTimestep();
+		}
 
 		// update
 		running = window->Update();
@@ -773,167 +1648,171 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
 		ProcessInputEventQueue(frameTimeDeltaSeconds);
 
-		const auto& leftPos = sphereModels[1]->GetPosition();
-		if (leftPos.z >= 5.f) leftSphereTranslatePlus = false;
-		if (leftPos.z <= -5.f) leftSphereTranslatePlus = true;
-		float newLeftZ;
-		if(leftSphereTranslatePlus)
-			newLeftZ = leftPos.z + 2.f * frameTimeDeltaSeconds; 
-		else
-			newLeftZ = leftPos.z - 2.f * frameTimeDeltaSeconds;
-
-		sphereModels[1]->SetPosition(leftPos.x, leftPos.y, newLeftZ);
-
-		const auto& rightPos = sphereModels[2]->GetPosition();
-		if (rightPos.z >= 5.f) rightSphereTranslatePlus = false;
-		if (rightPos.z <= -5.f) rightSphereTranslatePlus = true;
-		float newRightZ;
-		if (rightSphereTranslatePlus)
-			newRightZ = rightPos.z + 2.f * frameTimeDeltaSeconds;
-		else
-			newRightZ = rightPos.z - 2.f * frameTimeDeltaSeconds;
-
-		sphereModels[2]->SetPosition(rightPos.x, rightPos.y, newRightZ);
-
-		sphereModels[0]->SetRotation(sphereModels[0]->GetRotation().x + XMConvertToRadians(0.5f),
-			sphereModels[0]->GetRotation().y,
-			sphereModels[0]->GetRotation().z + XMConvertToRadians(0.5f));
-
-		XMStoreFloat4x4(&objectData[0].World, sphereModels[0]->GetWorldMatrix());
-		XMStoreFloat4x4(&objectData[0].WorldInvTranspose,
-			XMMatrixInverse(nullptr, XMMatrixTranspose(sphereModels[0]->GetWorldMatrix())));
-		XMStoreFloat4x4(&objectData[1].World, sphereModels[1]->GetWorldMatrix());
-		XMStoreFloat4x4(&objectData[1].WorldInvTranspose,
-			XMMatrixInverse(nullptr, XMMatrixTranspose(sphereModels[1]->GetWorldMatrix())));
-		XMStoreFloat4x4(&objectData[2].World, sphereModels[2]->GetWorldMatrix());
-		XMStoreFloat4x4(&objectData[2].WorldInvTranspose,
-			XMMatrixInverse(nullptr, XMMatrixTranspose(sphereModels[2]->GetWorldMatrix())));
-		XMStoreFloat4x4(&objectData[3].World, floorModel->GetWorldMatrix());
-		XMStoreFloat4x4(&objectData[3].WorldInvTranspose,
-			XMMatrixInverse(nullptr, XMMatrixTranspose(floorModel->GetWorldMatrix())));
+		if (inputReplay)
+		{
+			simulation->Advance(std::chrono::duration_cast<Simulation::Clock::duration>(
+				std::chrono::duration<float>(frameTimeDeltaSeconds)));
+		}
+		simulation->Interpolate(*transforms);
+		transforms->Update();
+		sceneVisibility->UpdateBounds(*transforms, objectMeshIDs.data(), numObjects);
 
 		BuildSceneAccelerationStructure();
 
 		if (window->GetClientWidth() > 0.0f && window->GetClientHeight() > 0.0f)
 		{
-			XMFLOAT3 cameraForward;
-			cameraForward.x = XMScalarCos(XMConvertToRadians(cameraYaw)) * XMScalarCos(XMConvertToRadians(cameraPitch));
-			cameraForward.y = XMScalarSin(XMConvertToRadians(cameraPitch));
-			cameraForward.z = XMScalarSin(XMConvertToRadians(cameraYaw)) * XMScalarCos(XMConvertToRadians(cameraPitch));
-			XMVECTOR cameraForwardVector = XMLoadFloat3(&cameraForward);
-			cameraForwardVector = XMVector3Normalize(cameraForwardVector);
-			XMStoreFloat3(&cameraForward, cameraForwardVector);
-
-			XMVECTOR cameraRight = XMVector3Cross(XMLoadFloat3(&cameraForward), XMLoadFloat3(&cameraUp));
-			XMFLOAT3 right;
-			XMStoreFloat3(&right, cameraRight);
-
-			float step = frameTimeDeltaSeconds * cameraSpeed;
-			XMVECTOR vStep = XMVectorSet(step, step, step, 0.f);
-
-			if (Input::IsKeyDown(KEY_W))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorAdd(XMLoadFloat3(&cameraPos), XMVectorMultiply(XMLoadFloat3(&cameraForward), vStep)));
-			}
-
-			if (Input::IsKeyDown(KEY_S))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorSubtract(XMLoadFloat3(&cameraPos), XMVectorMultiply(XMLoadFloat3(&cameraForward), vStep)));
-			}
-
-			if (Input::IsKeyDown(KEY_D))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorSubtract(XMLoadFloat3(&cameraPos), XMVectorMultiply(cameraRight, vStep)));
-			}
-
-			if (Input::IsKeyDown(KEY_A))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorAdd(XMLoadFloat3(&cameraPos), XMVectorMultiply(cameraRight, vStep)));
-			}
-
-			if (Input::IsKeyDown(KEY_E))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorAdd(XMLoadFloat3(&cameraPos), XMVectorMultiply(XMLoadFloat3(&cameraUp), vStep)));
-			}
-
-			if (Input::IsKeyDown(KEY_Q))
-			{
-				XMStoreFloat3(&cameraPos,
-					XMVectorSubtract(XMLoadFloat3(&cameraPos), XMVectorMultiply(XMLoadFloat3(&cameraUp), vStep)));
-			}
+			// last frame's camera, to reproject accumulated ambient occlusion
+			rtPerFrameData.previousViewProjection = perFrameData.ViewProjection;
+			const Float3 previousCameraPosition = camera.GetPosition();
+			rtPerFrameData.previousCameraPosition = XMFLOAT4(previousCameraPosition.x, previousCameraPosition.y,
+				previousCameraPosition.z, 1.f);
 
-			XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&cameraPos),
-				XMVectorAdd(XMLoadFloat3(&cameraPos), XMLoadFloat3(&cameraForward)),
-				XMLoadFloat3(&cameraUp));
+			camera.Move(cameraMoveFlags, frameTimeDeltaSeconds);
+			const Float3 cameraPos = camera.GetPosition();
+			const Float4x4 cameraView = camera.GetView();
+			XMMATRIX view = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(&cameraView.m));
 
 			XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(45.f),
 				static_cast<float>(window->GetClientWidth()) / static_cast<float>(window->GetClientHeight()),
 				0.1f, 1000.f);
 
 			XMStoreFloat4x4(&perFrameData.ViewProjection, view * proj);
+			perFrameData.CameraPosition = XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 1.f);
 
 			XMStoreFloat4x4(&rtPerFrameData.inverseView, XMMatrixInverse(nullptr, view));
 			XMStoreFloat4x4(&rtPerFrameData.inverseProjection, XMMatrixInverse(nullptr, proj));
 		}
 
+		// Shader edits are rebuilt in the background and swapped in here. Every frame waits for the GPU before the next
+		// begins, so nothing in flight still uses the pipelines being replaced.
+		if (!shaderWatcher->TakeChanges().empty())
+			shaderReloadRequested = true;
+		if (shaderReload.valid() && shaderReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			ApplyShaderReload(shaderReload.get());
+		if (shaderReloadRequested && !shaderReload.valid())
+		{
+			shaderReloadRequested = false;
+			StartShaderReload();
+		}
+
+		if (requestedTraceResolution != traceResolution)
+		{
+			traceResolution = requestedTraceResolution;
+			InitializeGBuffer(window->GetClientWidth(), window->GetClientHeight());
+			CreateGBufferViews();
+			CreateRaytracingOutputViews();
+		}
+
 		// render
 		ImGui_ImplDX12_NewFrame();
 		ImGui_ImplWin32_NewFrame();
 		ImGui::NewFrame();
 
 		auto backBufferIndex = window->GetCurrentBackBufferIndex();
-		perFrameDynamicConstantBuffer->Update(backBufferIndex, 0, &perFrameData, sizeof(PerFrameConstantBuffer));
+		// This back buffer's fence was waited on when it was last submitted, so its upload pages can be reused.
+		uploadHeap->BeginFrame(backBufferIndex);
+		// Every frame up to the one that last used this back buffer has retired, since they were submitted before it.
+		frameNumber++;
+		const uint64_t completedFrameNumber = frameNumber > bufferCount ? frameNumber - bufferCount : 0;
+		shaderDescriptorHeap->BeginFrame(backBufferIndex, completedFrameNumber);
+		bindlessTable->BeginFrame(completedFrameNumber);
+		D3D12_GPU_VIRTUAL_ADDRESS perFrameAddress = uploadHeap->Upload(&perFrameData, sizeof(PerFrameConstantBuffer));
+		rtPerFrameData.frameIndex = static_cast<uint32_t>(frameNumber);
+		rtPerFrameData.aoRaysPerPixel = aoSettings.RaysPerPixel;
+		rtPerFrameData.aoRadius = aoSettings.Radius;
+		rtPerFrameData.aoMaxHistory = aoSettings.MaxHistory;
+		rtPerFrameData.resetHistory = resetHistory ? 1 : 0;
+		resetHistory = false;
+		rtPerFrameData.shadowRaysPerPixel = shadowRaysPerPixel;
+		rtPerFrameData.lightConeCosAngle = XMScalarCos(XMConvertToRadians(lightConeAngle));
+		rtPerFrameData.shadowTemporalAlpha = shadowDenoiserSettings.TemporalAlpha;
+		rtPerFrameData.shadowVarianceClipGamma = shadowDenoiserSettings.VarianceClipGamma;
+		rtPerFrameData.shadowMinimumClipSigma = shadowDenoiserSettings.MinimumClipSigma;
+		rtPerFrameData.shadowDepthSigma = shadowDenoiserSettings.DepthSigma;
+		rtPerFrameData.shadowNormalSharpness = shadowDenoiserSettings.NormalSharpness;
+		rtPerFrameData.shadowVisibilitySigma = shadowDenoiserSettings.VisibilitySigma;
+		rtPerFrameData.displayWidth = window->GetClientWidth();
+		rtPerFrameData.displayHeight = window->GetClientHeight();
+		rtPerFrameData.traceScale = ShadowUpsampler::GetScale(traceResolution);
+		rtPerFrameData.checkerboard = ShadowUpsampler::IsCheckerboard(traceResolution) ? 1 : 0;
+		rtPerFrameData.upsampleDepthSigma = upsamplerSettings.DepthSigma;
+		rtPerFrameData.upsampleNormalSharpness = upsamplerSettings.NormalSharpness;
 		rtPerFrameDynamicConstantBuffer->Update(0, 0, &rtPerFrameData, sizeof(RTPerFrameConstantBuffer));
 		HRESULT hr = graphicsCommandAllocators[backBufferIndex]->Reset();
 		assert(SUCCEEDED(hr));
 		hr = graphicsCommandList->Reset(graphicsCommandAllocators[backBufferIndex].Get(), nullptr);
 		assert(SUCCEEDED(hr));
+		// the back buffer's last frame was waited for, so its GPU ranges can be read
+		gpuProfiler->BeginFrame(backBufferIndex);
 		
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[backBufferIndex].Get(),
 			D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		uint32_t gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Raster");
 
 		// raster scene onto backbuffer render target.
 		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart(), backBufferIndex, rtvDescriptorSize);
 		CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(dsvHeap->GetCPUDescriptorHandleForHeapStart());
-		graphicsCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+		// the display surface goes to the second render target, to guide the shadow upsampler
+		CD3DX12_CPU_DESCRIPTOR_HANDLE displaySurfaceHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart(), bufferCount,
+			rtvDescriptorSize);
+		const D3D12_CPU_DESCRIPTOR_HANDLE rasterRenderTargets[] = { rtvHandle, displaySurfaceHandle };
+		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(displaySurfaceGBuffer.Get(),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		graphicsCommandList->OMSetRenderTargets(_countof(rasterRenderTargets), rasterRenderTargets, FALSE, &dsvHandle);
 		graphicsCommandList->RSSetViewports(1, &viewport);
 		graphicsCommandList->RSSetScissorRects(1, &scissorRect);
 		graphicsCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		graphicsCommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+		graphicsCommandList->ClearRenderTargetView(displaySurfaceHandle, displaySurfaceClearValue, 0, nullptr);
 		graphicsCommandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
 		graphicsCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-		graphicsCommandList->SetPipelineState(graphicsPipeline->Get());
+		graphicsCommandList->SetPipelineState(GetGraphicsPipeline(rasterPermutation)->Get());
 		graphicsCommandList->SetGraphicsRootSignature(rootSignature->GetInterfacePtr());
-		graphicsCommandList->SetGraphicsRootConstantBufferView(0, 
-			perFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(backBufferIndex, 0));
-		graphicsCommandList->SetGraphicsRootConstantBufferView(1,
-			perFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(backBufferIndex, 0));
-		graphicsCommandList->SetGraphicsRootDescriptorTable(3, shaderDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-		graphicsCommandList->IASetVertexBuffers(0, 1, sphereModels[0]->GetVertexBufferView());
-		graphicsCommandList->IASetIndexBuffer(sphereModels[0]->GetIndexBufferView());
-		for (uint32_t i = 0; i < 3; i++)
+		graphicsCommandList->SetGraphicsRootConstantBufferView(0, perFrameAddress);
+		graphicsCommandList->SetGraphicsRootConstantBufferView(1, perFrameAddress);
+		graphicsCommandList->SetGraphicsRootDescriptorTable(3, bindlessTable->GetGPUDescriptorHandle());
+
+		// Cull against the frustum and the largest objects, then write every visible object's data contiguously in batch
+		// order and draw each mesh once for all of its instances. Everything is recorded on graphicsCommandList on this
+		// thread, unlike FrameRenderer's reference frame, which can split its draws over lists recorded by the workers.
+		Profiler::BeginScope("Cull and record");
+		sceneVisibility->CullAndBatch(&perFrameData.ViewProjection._11, *transforms, objectMeshIDs.data(), numObjects,
+			cullingSettings);
+		const InstanceBatcher& instanceBatcher = sceneVisibility->GetBatcher();
+
+		// Everything can be culled, for example with the camera facing the sky, and the upload heap takes no empty
+		// allocations.
+		if (instanceBatcher.GetNumInstances() > 0)
 		{
-			perObjectDynamicConstantBuffer->Update(backBufferIndex, i, &objectData[i], sizeof(PerObjectConstantBuffer));
-			graphicsCommandList->SetGraphicsRootConstantBufferView(2,
-				perObjectDynamicConstantBuffer->GetInstanceGPUVirtualAddress(backBufferIndex, i));
-			graphicsCommandList->DrawIndexedInstanced(sphereModels[0]->GetNumIndices(), 1, 0, 0, 0);
+			DynamicAllocation instanceData =
+				uploadHeap->Allocate(sizeof(PerObjectConstantBuffer) * instanceBatcher.GetNumInstances());
+			PerObjectConstantBuffer* instances = static_cast<PerObjectConstantBuffer*>(instanceData.CPUAddress);
+			const auto& sortedObjects = instanceBatcher.GetSortedObjects();
+			for (uint32_t i = 0; i < sortedObjects.size(); i++)
+			{
+				WriteObjectData(instances[i], sortedObjects[i]);
+			}
+			graphicsCommandList->SetGraphicsRootShaderResourceView(2, instanceData.GPUAddress);
+
+			for (const auto& batch : instanceBatcher.GetBatches())
+			{
+				const Model* const mesh = meshes[batch.MeshID];
+				graphicsCommandList->SetGraphicsRoot32BitConstant(4, batch.FirstInstance, 0);
+				graphicsCommandList->IASetVertexBuffers(0, 1, mesh->GetVertexBufferView());
+				graphicsCommandList->IASetIndexBuffer(mesh->GetIndexBufferView());
+				DrawModel(graphicsCommandList.Get(), mesh, batch.InstanceCount);
+			}
 		}
+		Profiler::EndScope();
 
-		graphicsCommandList->IASetVertexBuffers(0, 1, floorModel->GetVertexBufferView());
-		graphicsCommandList->IASetIndexBuffer(floorModel->GetIndexBufferView());
-		perObjectDynamicConstantBuffer->Update(backBufferIndex, 3, &objectData[3], sizeof(PerObjectConstantBuffer));
-		graphicsCommandList->SetGraphicsRootConstantBufferView(2,
-			perObjectDynamicConstantBuffer->GetInstanceGPUVirtualAddress(backBufferIndex, 3));
-		graphicsCommandList->DrawIndexedInstanced(floorModel->GetNumIndices(), 1, 0, 0, 0);
+		graphicsCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(displaySurfaceGBuffer.Get(),
+			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
 
 		// store rastered scene in the GBuffer.
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Copy scene");
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(sceneTextureGBuffer.Get(),
 			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[backBufferIndex].Get(),
@@ -945,66 +1824,126 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[backBufferIndex].Get(),
 			D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
 
 		// raytrace scene to build shadow map.
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "TLAS update");
 		sceneAccelerationStructure->Update(device.Get(), graphicsCommandList.Get());
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
 
+		const RaytracingPipeline* const raytracingPipeline = GetRaytracingPipeline(raytracingPermutation);
 		D3D12_DISPATCH_RAYS_DESC dispatchRaysDesc = {};
-		dispatchRaysDesc.Width = window->GetClientWidth();
-		dispatchRaysDesc.Height = window->GetClientHeight();
+		dispatchRaysDesc.Width = ShadowUpsampler::GetTraceWidth(traceResolution, window->GetClientWidth());
+		dispatchRaysDesc.Height = ShadowUpsampler::GetTraceHeight(traceResolution, window->GetClientHeight());
 		dispatchRaysDesc.Depth = 1;
+		raytracingPipeline->Table->FillDispatchRaysDesc(dispatchRaysDesc);
 
-		dispatchRaysDesc.RayGenerationShaderRecord.StartAddress = shaderTableBuffer->GetGPUVirtualAddress();
-		dispatchRaysDesc.RayGenerationShaderRecord.SizeInBytes = shaderRecordSize;
-
-		dispatchRaysDesc.MissShaderTable.StartAddress = shaderTableBuffer->GetGPUVirtualAddress() + shaderRecordSize;
-		dispatchRaysDesc.MissShaderTable.StrideInBytes = shaderRecordSize;
-		dispatchRaysDesc.MissShaderTable.SizeInBytes = shaderRecordSize * 2;
-
-		dispatchRaysDesc.HitGroupTable.StartAddress = shaderTableBuffer->GetGPUVirtualAddress() + shaderRecordSize * 3;
-		dispatchRaysDesc.HitGroupTable.StrideInBytes = shaderRecordSize;
-		dispatchRaysDesc.HitGroupTable.SizeInBytes = shaderRecordSize * 2;
+		// Hit shaders look objects up by InstanceID, which is the object index, so this copy stays in object order.
+		DynamicAllocation rtObjectData = uploadHeap->Allocate(sizeof(PerObjectConstantBuffer) * numObjects);
+		PerObjectConstantBuffer* rtObjects = static_cast<PerObjectConstantBuffer*>(rtObjectData.CPUAddress);
+		for (uint32_t i = 0; i < numObjects; i++)
+		{
+			WriteObjectData(rtObjects[i], i);
+		}
 
-		graphicsCommandList->SetPipelineState1(rtPipelineState.Get());
+		graphicsCommandList->SetComputeRootSignature(rtGlobalRootSignature->GetInterfacePtr());
+		graphicsCommandList->SetComputeRootDescriptorTable(0, bindlessTable->GetGPUDescriptorHandle());
+		graphicsCommandList->SetComputeRootShaderResourceView(1, rtObjectData.GPUAddress);
+		graphicsCommandList->SetPipelineState1(raytracingPipeline->StateObject.Get());
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "DispatchRays");
 		graphicsCommandList->DispatchRays(&dispatchRaysDesc);
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(RTShadowMapOutput.Get()));
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
+
+		// Soft shadows are traced with a few rays per pixel, so they are denoised in place before being copied out.
+		if (shadowDenoiserEnabled && (raytracingPermutation & softShadowFeatures) == softShadowFeatures)
+		{
+			const uint32_t groupsX = (dispatchRaysDesc.Width + computeGroupSize - 1) / computeGroupSize;
+			const uint32_t groupsY = (dispatchRaysDesc.Height + computeGroupSize - 1) / computeGroupSize;
+			gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Shadow denoise");
+			graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(surfaceOutput.Get()));
+			graphicsCommandList->SetComputeRootSignature(shadowDenoiserRootSignature->GetInterfacePtr());
+			graphicsCommandList->SetComputeRootConstantBufferView(0,
+				rtPerFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(0, 0));
+			graphicsCommandList->SetComputeRootDescriptorTable(2,
+				shaderDescriptorHeap->GetGPUDescriptorHandle(denoiserDescriptors));
+			graphicsCommandList->SetPipelineState(shadowTemporalPipeline.State->Get());
+			graphicsCommandList->Dispatch(groupsX, groupsY, 1);
+
+			graphicsCommandList->SetPipelineState(shadowATrousPipeline.State->Get());
+			const uint32_t numIterations = std::max(shadowDenoiserSettings.NumIterations, 1u);
+			for (uint32_t i = 0; i < numIterations; i++)
+			{
+				graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+				const uint32_t passConstants[] = { 1u << i, i % 2, i + 1 == numIterations ? 1u : 0u };
+				graphicsCommandList->SetComputeRoot32BitConstants(1, _countof(passConstants), passConstants, 0);
+				graphicsCommandList->Dispatch(groupsX, groupsY, 1);
+			}
+			graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+			gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
+		}
+
+		// Shadows traced for fewer pixels than the display has are upsampled, guided by the raster pass's surface.
+		ID3D12Resource* shadowResult = RTShadowMapOutput.Get();
+		if (traceResolution != ShadowUpsampler::TraceResolution::Full)
+		{
+			gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Shadow upsample");
+			graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+			graphicsCommandList->SetComputeRootSignature(shadowUpsamplerRootSignature->GetInterfacePtr());
+			graphicsCommandList->SetComputeRootConstantBufferView(0,
+				rtPerFrameDynamicConstantBuffer->GetInstanceGPUVirtualAddress(0, 0));
+			graphicsCommandList->SetComputeRootDescriptorTable(1,
+				shaderDescriptorHeap->GetGPUDescriptorHandle(upsamplerDescriptors));
+			graphicsCommandList->SetPipelineState(shadowUpsamplerPipeline.State->Get());
+			graphicsCommandList->Dispatch((window->GetClientWidth() + computeGroupSize - 1) / computeGroupSize,
+				(window->GetClientHeight() + computeGroupSize - 1) / computeGroupSize, 1);
+			graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(upsampledShadows.Get()));
+			gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
+			shadowResult = upsampledShadows.Get();
+		}
 
 		// store raytraced shadow map into GBuffer.
-		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(RTShadowMapOutput.Get(),
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Copy shadows");
+		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(shadowResult,
 			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(shadowMapTextureGBuffer.Get(),
 			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
 
-		graphicsCommandList->CopyResource(shadowMapTextureGBuffer.Get(), RTShadowMapOutput.Get());
+		graphicsCommandList->CopyResource(shadowMapTextureGBuffer.Get(), shadowResult);
 
-		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(RTShadowMapOutput.Get(),
+		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(shadowResult,
 			D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(shadowMapTextureGBuffer.Get(),
 			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
-		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(RTShadowMapOutput.Get()));
+		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(shadowResult));
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
 
 		// draw screen quad onto backbuffer rendertarget
-		graphicsCommandList->SetPipelineState(FinalPassGraphicsPipeline->Get());
-		graphicsCommandList->SetGraphicsRootSignature(FinalPassRootSignature->GetInterfacePtr());
-		graphicsCommandList->SetGraphicsRootDescriptorTable(0, shaderDescriptorHeap->GetGPUDescriptorHandle(1));
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "Composite");
+		graphicsCommandList->SetPipelineState(finalPassPipeline->Get());
+		graphicsCommandList->SetGraphicsRootSignature(finalPassRootSignature->GetInterfacePtr());
+		graphicsCommandList->SetGraphicsRootDescriptorTable(0, shaderDescriptorHeap->GetGPUDescriptorHandle(gbufferDescriptors));
 		graphicsCommandList->IASetVertexBuffers(0, 1, screenQuadVertexBuffer->GetView());
 		graphicsCommandList->IASetIndexBuffer(screenQuadIndexBuffer->GetView());
 		graphicsCommandList->DrawIndexedInstanced(screenQuadIndices.size(), 1, 0, 0, 0);
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
 
 		// draw imgui on top of everything
+		Profiler::BeginScope("ImGui");
 		ImGui::Begin("Settings");
 		{
 			ImGui::Text("Use 'WASD' to fly camera.\nHold 'Q' to move down.\nHold 'E' to move up.");
-			ImGui::InputFloat("Camera Speed", &cameraSpeed, 1.f, 2.f, 3);
-			if (cameraSpeed < 1.f) cameraSpeed = 1.f;
-			if (cameraSpeed > 200.f) cameraSpeed = 200.f;
+			FlyCamera::Settings& cameraSettings = camera.GetSettings();
+			ImGui::InputFloat("Camera Speed", &cameraSettings.Speed, 1.f, 2.f, 3);
+			if (cameraSettings.Speed < 1.f) cameraSettings.Speed = 1.f;
+			if (cameraSettings.Speed > 200.f) cameraSettings.Speed = 200.f;
 			ImGui::Spacing();
 			ImGui::Text("Hold down right mouse button\nand move the mouse to look around.");
-			ImGui::InputFloat("Look Sensitivity", &cameraLookSensitivity, 1.f, 2.f, 3);
-			if (cameraLookSensitivity < 1.f) cameraLookSensitivity = 1.f;
-			if (cameraLookSensitivity > 200.f) cameraLookSensitivity = 200.f;
-			ImGui::Checkbox("Invert Vertical Look", &cameraInvertVerticalLook);
+			ImGui::InputFloat("Look Sensitivity", &cameraSettings.LookSensitivity, 1.f, 2.f, 3);
+			if (cameraSettings.LookSensitivity < 1.f) cameraSettings.LookSensitivity = 1.f;
+			if (cameraSettings.LookSensitivity > 200.f) cameraSettings.LookSensitivity = 200.f;
+			ImGui::Checkbox("Invert Vertical Look", &cameraSettings.InvertVerticalLook);
 			ImGui::Spacing();
 			ImGui::Text("Press 'F' to toggle fullscreen/windowed.");
 			ImGui::Spacing();
@@ -1017,11 +1956,68 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 			ImGui::DragFloat3("Ambient", &perFrameData.Light.Ambient.x, 0.01f, 0.f, 1.f);
 			rtPerFrameData.lightDirection = XMFLOAT4(perFrameData.Light.Direction.x, 
 				perFrameData.Light.Direction.y, perFrameData.Light.Direction.z, 0.f);
+			ImGui::Spacing();
+			ImGui::Spacing();
+			ShowFeatureCheckboxes("Raster features", *rasterFeatures, rasterPermutation);
+			const uint32_t previousRaytracingPermutation = raytracingPermutation;
+			ShowFeatureCheckboxes("Raytracing features", *raytracingFeatures, raytracingPermutation);
+			ImGui::Text("Ambient occlusion");
+			int aoRaysPerPixel = static_cast<int>(aoSettings.RaysPerPixel);
+			int aoMaxHistory = static_cast<int>(aoSettings.MaxHistory);
+			bool aoSettingsChanged = ImGui::SliderInt("Rays per pixel", &aoRaysPerPixel, 1, 16);
+			aoSettingsChanged |= ImGui::SliderFloat("Radius", &aoSettings.Radius, 0.1f, 5.f);
+			aoSettingsChanged |= ImGui::SliderInt("Frames accumulated", &aoMaxHistory, 1, 256);
+			aoSettings.RaysPerPixel = static_cast<uint32_t>(aoRaysPerPixel);
+			aoSettings.MaxHistory = static_cast<uint32_t>(aoMaxHistory);
+			if (aoSettingsChanged || raytracingPermutation != previousRaytracingPermutation)
+				resetHistory = true;
+			ImGui::Text("Soft shadows");
+			int softShadowRaysPerPixel = static_cast<int>(shadowRaysPerPixel);
+			ImGui::SliderInt("Shadow rays per pixel", &softShadowRaysPerPixel, 1, 4);
+			shadowRaysPerPixel = static_cast<uint32_t>(softShadowRaysPerPixel);
+			ImGui::SliderFloat("Light angle", &lightConeAngle, 0.f, 10.f, "%.2f deg");
+			ImGui::Checkbox("Denoise", &shadowDenoiserEnabled);
+			int denoiserIterations = static_cast<int>(shadowDenoiserSettings.NumIterations);
+			ImGui::SliderInt("Filter passes", &denoiserIterations, 1, 5);
+			shadowDenoiserSettings.NumIterations = static_cast<uint32_t>(denoiserIterations);
+			ImGui::SliderFloat("Temporal alpha", &shadowDenoiserSettings.TemporalAlpha, 0.01f, 1.f);
+			ImGui::SliderFloat("Variance clip", &shadowDenoiserSettings.VarianceClipGamma, 0.5f, 4.f);
+			ImGui::Text("Trace resolution");
+			int traceResolutionIndex = static_cast<int>(requestedTraceResolution);
+			ImGui::Combo("Resolution", &traceResolutionIndex, "Full\0Checkerboard\0Half\0Quarter\0");
+			requestedTraceResolution = static_cast<ShadowUpsampler::TraceResolution>(traceResolutionIndex);
+			ImGui::SliderFloat("Upsample depth sigma", &upsamplerSettings.DepthSigma, 0.01f, 1.f);
+			ImGui::Text("Pipelines built: %u raster, %u raytracing", static_cast<uint32_t>(graphicsPipelines.size()),
+				static_cast<uint32_t>(raytracingPipelines.size()));
+			ImGui::Text("Registry: %u root signatures, %u pipeline states, %u reused", pipelineRegistry->GetNumRootSignatures(),
+				pipelineRegistry->GetNumPipelineStates(), pipelineRegistry->GetNumHits());
+			const CullingSystem::Statistics& culling = sceneVisibility->GetCullingStatistics();
+			ImGui::Checkbox("Occlusion culling", &cullingSettings.OcclusionEnabled);
+			ImGui::Text("Visible objects: %u of %u, %u outside the frustum, %u occluded",
+				static_cast<uint32_t>(sceneVisibility->GetVisibleObjects().size()), culling.NumObjects,
+				culling.NumFrustumCulled, culling.NumOcclusionCulled);
+			ImGui::Text("Occluders: %u, %u triangles", culling.NumOccluders, culling.NumOccluderTriangles);
+			ImGui::Text("Culling: frustum %.3f ms, occluders %.3f ms, occlusion %.3f ms", culling.FrustumMilliseconds,
+				culling.RasterizeMilliseconds, culling.OcclusionMilliseconds);
+			ImGui::Text("Input events: %llu, %llu dropped", static_cast<unsigned long long>(inputEventQueue->GetNumPushed()),
+				static_cast<unsigned long long>(inputEventQueue->GetNumDropped()));
+			const Simulation::Statistics simulationStatistics = simulation->GetStatistics();
+			ImGui::Text("Simulation: %llu steps, %llu dropped, %.3f ms/step",
+				static_cast<unsigned long long>(simulationStatistics.NumSteps),
+				static_cast<unsigned long long>(simulationStatistics.NumDroppedSteps), simulationStatistics.StepMilliseconds);
+			const JobSystem::Statistics jobStatistics = jobSystem->GetStatistics();
+			ImGui::Text("Jobs: %u workers, %llu jobs, %llu stolen", jobSystem->GetNumWorkers(),
+				static_cast<unsigned long long>(jobStatistics.NumJobs), static_cast<unsigned long long>(jobStatistics.NumStolen));
 		}
 		ImGui::End();
+		ShowProfiler();
 
 		ImGui::Render();
+		Profiler::EndScope();
+		gpuRange = gpuProfiler->BeginRange(graphicsCommandList.Get(), "ImGui");
 		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), graphicsCommandList.Get());
+		gpuProfiler->EndRange(graphicsCommandList.Get(), gpuRange);
+		gpuProfiler->EndFrame(graphicsCommandList.Get());
 
 		graphicsCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[backBufferIndex].Get(),
 			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -1032,20 +2028,37 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 		graphicsQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
 		Direct3D::SignalFenceOnGPU(backBufferFences[backBufferIndex]->GetInterfacePtr(), graphicsQueue.Get(), 
 			backBufferFences[backBufferIndex]->Value());
+		Profiler::BeginScope("Wait for GPU");
 		Direct3D::WaitForFenceValueOnCPU(backBufferFences[backBufferIndex]->GetInterfacePtr(),
 			backBufferFences[backBufferIndex]->Value(), fenceEvent);
+		Profiler::EndScope();
 
+		Profiler::BeginScope("Present");
 		window->PresentFrame();
+		Profiler::EndScope();
 	}
 
+	shaderWatcher->Stop();
+	if (shaderReload.valid())
+		shaderReload.wait();
+
 	for (uint32_t i = 0; i < bufferCount; i++)
 	{
 		Direct3D::SignalFenceOnGPU(backBufferFences[i]->GetInterfacePtr(), graphicsQueue.Get(), backBufferFences[i]->Value());
 		Direct3D::WaitForFenceValueOnCPU(backBufferFences[i]->GetInterfacePtr(), backBufferFences[i]->Value(), fenceEvent);
 	}
+	simulation->Stop();
+	jobSystem->Shutdown();
+	if (!tracePath.empty())
+		Profiler::WriteChromeTrace(tracePath);
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+
+	if (inputRecorder && !inputRecorder->Save(inputRecordingPath))
+		std::cout << "Could not save input recording " << inputRecordingPath << std::endl;
+	if (inputReplay)
+		ReportReplayFrameTimes();
 #ifdef _DEBUG
 	Console::ReleaseConsole();
 #endif
@@ -1,5 +1,8 @@
 #pragma once
 
+// Everything Windows specific is kept behind _WIN32 so the std only parts of the renderer, and the headless frame loop
+// built on them, compile on other platforms too.
+#if defined(_WIN32)
 #include "ThirdParty/Imgui/imgui.h"
 #include "ThirdParty/Imgui/imgui_impl_win32.h"
 #include "ThirdParty/Imgui/imgui_impl_dx12.h"
@@ -39,6 +42,7 @@ using namespace DirectX;
 #ifdef CreateWindow
 #undef CreateWindow
 #endif
+#endif
 
 #include <assert.h>
 #include <iostream>
@@ -46,6 +50,11 @@ using namespace DirectX;
 #include <fstream>
 #include <filesystem>
 #include <array>
+#include <unordered_map>
 #include <functional>
+#include <future>
+#include <algorithm>
 
+#if defined(_WIN32)
 #include "ThirdParty/d3dx12.h"
+#endif